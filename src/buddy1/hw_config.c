@@ -20,20 +20,22 @@ https://github.com/carlk3/no-OS-FatFS-SD-SDIO-SPI-RPi-Pico/tree/main#customizing
 */
 
 #include "hw_config.h"
+#include "sd_card.h"
 
 /* Configuration of RP2040 hardware SPI object */
 static spi_t spi = {  
     .hw_inst = spi1,  // RP2040 SPI component
-    .sck_gpio = 10,    // GPIO number (not Pico pin number)
-    .mosi_gpio = 11, // SDO
-    .miso_gpio = 12, // SDI
-    .baud_rate = 12 * 1000 * 1000   // Actual frequency: 10416666.
+    .sck_gpio = SD_SPI_SCK_PIN,    // GPIO number (not Pico pin number)
+    .mosi_gpio = SD_SPI_MOSI_PIN, // SDO
+    .miso_gpio = SD_SPI_MISO_PIN, // SDI
+    .baud_rate = 12 * 1000 * 1000,   // Actual frequency: 10416666.
+    .DMA_IRQ_num = SD_DMA_IRQ
 };
 
 /* SPI Interface */
 static sd_spi_if_t spi_if = {
     .spi = &spi,  // Pointer to the SPI driving this card
-    .ss_gpio = 15      // The SPI slave select GPIO for this SD card
+    .ss_gpio = SD_SPI_CS_PIN      // The SPI slave select GPIO for this SD card
 };
 
 /* SDIO Interface */
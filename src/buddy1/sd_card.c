@@ -3,12 +3,24 @@
 #include "hw_config.h"
 #include "f_util.h"
 #include "ff.h"
+#include "sd_card.h"
+#include "resources.h"
+#include "dma_service.h"
 
 
 // SD card initialization function stays the same
 FRESULT initialiseSD() {
     printf("Setting up SD card...\n");
 
+    if (!res_claim_pins("sd_card", SD_PIN_MASK, RES_PIN_EXCLUSIVE)) {
+        printf("SD card pins are in use\n");
+        return FR_NOT_READY;
+    }
+
+    // The library adds its handler to SD_DMA_IRQ as a shared one; make sure
+    // the dispatcher is already there so it keeps first place on the line
+    dma_service_init();
+
     // Get SD card
     sd_card_t *pSD = sd_get_by_num(0);
     if (pSD == NULL) {
@@ -28,6 +40,19 @@ FRESULT initialiseSD() {
     return fr;
 }
 
+// Mount on first use so firmware that never touches the card still boots without one
+FRESULT ensureSDMounted() {
+    static bool mounted = false;
+    if (mounted) {
+        return FR_OK;
+    }
+    FRESULT fr = initialiseSD();
+    if (fr == FR_OK) {
+        mounted = true;
+    }
+    return fr;
+}
+
 // Update function to use const char* for filename
 int readFile(const char* filename) {
     FIL file;
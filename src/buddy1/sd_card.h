@@ -6,9 +6,19 @@
 #include "ff.h"
 #include <stdbool.h>
 
+// SD card wiring (spi1), shared by hw_config.c and the resource claims
+#define SD_SPI_SCK_PIN 10
+#define SD_SPI_MOSI_PIN 11
+#define SD_SPI_MISO_PIN 12
+#define SD_SPI_CS_PIN 15
+#define SD_PIN_MASK ((1u << SD_SPI_SCK_PIN) | (1u << SD_SPI_MOSI_PIN) | \
+                     (1u << SD_SPI_MISO_PIN) | (1u << SD_SPI_CS_PIN))
+#define SD_DMA_IRQ DMA_IRQ_1    // Storage line; DMA_IRQ_0 is kept for capture
+
 // Function prototypes
 FRESULT initialiseSD(void);
-int readFile(char* filename);
+FRESULT ensureSDMounted(void);
+int readFile(const char* filename);
 int writeDataToSD(const char* filename, const char* content, bool append);
 int createNewFile(const char* filename);
 
@@ -1,12 +1,20 @@
 #include "digital.h"
 #include "buddy1/sd_card.h"
 #include "buddy5/wifi.h"
+#include "resources.h"
+#include "gpio_irq.h"
 #include <string.h>
 
 static PulseCapture capture = {0};
-static void gpio_callback(uint gpio, uint32_t events);
+static void input_edge_irq(uint gpio, uint32_t events, uint32_t now);
 
 void digital_init(void) {
+    if (!res_claim_pins("digital", 1u << DIGITAL_INPUT_PIN, RES_PIN_SHARED_INPUT) ||
+        !res_claim_pins("digital", 1u << DIGITAL_OUTPUT_PIN, RES_PIN_EXCLUSIVE)) {
+        printf("Digital capture/replay disabled\n");
+        return;
+    }
+
     // Initialize input pin
     gpio_init(DIGITAL_INPUT_PIN);
     gpio_set_dir(DIGITAL_INPUT_PIN, GPIO_IN);
@@ -18,19 +26,17 @@ void digital_init(void) {
     gpio_put(DIGITAL_OUTPUT_PIN, 0);    // Start with output low
 
     // Setup GPIO interrupt for input pin
-    gpio_set_irq_enabled_with_callback(DIGITAL_INPUT_PIN, 
-        GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, 
-        true, 
-        &gpio_callback);
+    gpio_irq_register(DIGITAL_INPUT_PIN, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL,
+                      GPIO_IRQ_PRIO_SIGNAL, input_edge_irq);
 
     printf("Digital pulse capture initialized on GP%d\n", DIGITAL_INPUT_PIN);
     printf("Digital pulse replay configured on GP%d\n", DIGITAL_OUTPUT_PIN);
 }
 
-static void gpio_callback(uint gpio, uint32_t events) {
-    if (gpio != DIGITAL_INPUT_PIN || !capture.capturing) return;
+static void input_edge_irq(uint gpio, uint32_t events, uint32_t now) {
+    if (!capture.capturing) return;
 
-    uint32_t current_time = time_us_32();
+    uint32_t current_time = now;
     bool is_rising = (events & GPIO_IRQ_EDGE_RISE) != 0;
     
     if ((is_rising && capture.expecting_high) || (!is_rising && !capture.expecting_high)) {
@@ -0,0 +1,29 @@
+// cycles.h
+
+#ifndef CYCLES_H
+#define CYCLES_H
+
+#include "pico/stdlib.h"
+#include "hardware/structs/systick.h"
+
+// clk_sys cycle counting on SysTick for handler timing and benchmarks. The
+// counter is 24 bits and counts down, so spans must stay under ~134 ms at
+// 125 MHz.
+
+static inline void cycles_init(void) {
+    if (!(systick_hw->csr & M0PLUS_SYST_CSR_ENABLE_BITS)) {
+        systick_hw->rvr = 0xFFFFFF;
+        systick_hw->cvr = 0;
+        systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+    }
+}
+
+static inline uint32_t cycles_now(void) {
+    return systick_hw->cvr;
+}
+
+static inline uint32_t cycles_since(uint32_t start) {
+    return (start - systick_hw->cvr) & 0xFFFFFF;
+}
+
+#endif // CYCLES_H
@@ -0,0 +1,160 @@
+#include "dma_service.h"
+#include "resources.h"
+#include "hardware/clocks.h"
+#include "cycles.h"
+#include <string.h>
+
+typedef struct {
+    dma_service_handler_t handler;
+    void* ctx;
+    uint8_t irq;
+} ChannelSlot;
+
+static ChannelSlot slots[NUM_DMA_CHANNELS];
+static volatile DMAChannelStats stats[NUM_DMA_CHANNELS];
+static uint32_t stats_start_us;
+static bool initialized = false;
+
+static void __not_in_flash_func(dispatch)(uint irq, io_rw_32* ints) {
+    uint32_t pending = *ints;
+    uint32_t now_us = timer_hw->timerawl;
+
+    while (pending) {
+        uint ch = __builtin_ctz(pending);
+        pending &= pending - 1;
+
+        volatile DMAChannelStats* s = &stats[ch];
+        if (s->irq_count && now_us - s->last_irq_us > s->max_gap_us) {
+            s->max_gap_us = now_us - s->last_irq_us;
+        }
+        s->last_irq_us = now_us;
+        s->irq_count++;
+
+        const ChannelSlot* slot = &slots[ch];
+        if (!slot->handler || slot->irq != irq) {
+            continue;       // A chained handler owns this one
+        }
+        *ints = 1u << ch;
+        uint32_t start = cycles_now();
+        slot->handler(ch, slot->ctx);
+        uint32_t cycles = cycles_since(start);
+        s->handler_cycles += cycles;
+        if (cycles > s->max_handler_cycles) {
+            s->max_handler_cycles = cycles;
+        }
+    }
+}
+
+static void __isr __not_in_flash_func(dma_irq0_handler)(void) {
+    dispatch(DMA_IRQ_0, &dma_hw->ints0);
+}
+
+static void __isr __not_in_flash_func(dma_irq1_handler)(void) {
+    dispatch(DMA_IRQ_1, &dma_hw->ints1);
+}
+
+void dma_service_init(void) {
+    if (initialized) {
+        return;
+    }
+    res_claim_irq("dma_service", DMA_IRQ_0);
+    res_claim_irq("dma_service", DMA_IRQ_1);
+
+    cycles_init();
+
+    irq_add_shared_handler(DMA_IRQ_0, dma_irq0_handler, PICO_SHARED_IRQ_HANDLER_HIGHEST_ORDER_PRIORITY);
+    irq_add_shared_handler(DMA_IRQ_1, dma_irq1_handler, PICO_SHARED_IRQ_HANDLER_HIGHEST_ORDER_PRIORITY);
+    irq_set_priority(DMA_IRQ_0, PICO_HIGHEST_IRQ_PRIORITY);
+    irq_set_priority(DMA_IRQ_1, PICO_DEFAULT_IRQ_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0, true);
+    irq_set_enabled(DMA_IRQ_1, true);
+
+    stats_start_us = time_us_32();
+    initialized = true;
+}
+
+bool dma_service_register(uint channel, uint irq, dma_service_handler_t handler, void* ctx) {
+    if (channel >= NUM_DMA_CHANNELS || (irq != DMA_IRQ_0 && irq != DMA_IRQ_1) || !handler) {
+        return false;
+    }
+    dma_service_init();
+
+    uint32_t save = save_and_disable_interrupts();
+    slots[channel].handler = handler;
+    slots[channel].ctx = ctx;
+    slots[channel].irq = irq;
+    restore_interrupts(save);
+
+    dma_channel_set_irq0_enabled(channel, irq == DMA_IRQ_0);
+    dma_channel_set_irq1_enabled(channel, irq == DMA_IRQ_1);
+    return true;
+}
+
+void dma_service_unregister(uint channel) {
+    if (channel >= NUM_DMA_CHANNELS) {
+        return;
+    }
+    dma_channel_set_irq0_enabled(channel, false);
+    dma_channel_set_irq1_enabled(channel, false);
+    uint32_t save = save_and_disable_interrupts();
+    slots[channel].handler = NULL;
+    slots[channel].ctx = NULL;
+    restore_interrupts(save);
+}
+
+// Claim a channel through the resource manager and hook its handler
+int dma_service_claim(const char* owner, uint irq, dma_service_handler_t handler, void* ctx) {
+    int channel = res_claim_dma(owner);
+    if (channel < 0) {
+        return -1;
+    }
+    if (!dma_service_register(channel, irq, handler, ctx)) {
+        res_release_dma(channel);
+        return -1;
+    }
+    return channel;
+}
+
+void dma_service_release(int channel) {
+    if (channel < 0) {
+        return;
+    }
+    dma_service_unregister(channel);
+    dma_channel_abort(channel);
+    res_release_dma(channel);
+}
+
+void dma_service_get_stats(uint channel, DMAChannelStats* out) {
+    uint32_t save = save_and_disable_interrupts();
+    memcpy(out, (const void*)&stats[channel], sizeof(*out));
+    restore_interrupts(save);
+}
+
+void dma_service_reset_stats(void) {
+    uint32_t save = save_and_disable_interrupts();
+    memset((void*)stats, 0, sizeof(stats));
+    stats_start_us = time_us_32();
+    restore_interrupts(save);
+}
+
+void dma_service_print_stats(void) {
+    float elapsed_s = (time_us_32() - stats_start_us) / 1e6f;
+    float cycles_per_us = clock_get_hz(clk_sys) / 1e6f;
+
+    printf("DMA IRQ stats over %.1f s:\n", elapsed_s);
+    printf("  ch line owner            irqs      irq/s  avg us  max us  max gap ms  cpu %%\n");
+    for (uint ch = 0; ch < NUM_DMA_CHANNELS; ch++) {
+        DMAChannelStats s;
+        dma_service_get_stats(ch, &s);
+        if (s.irq_count == 0 && !slots[ch].handler) continue;
+
+        const char* owner = res_dma_owner(ch);
+        float avg_us = s.irq_count ? (float)s.handler_cycles / s.irq_count / cycles_per_us : 0.0f;
+        float cpu = elapsed_s > 0 ? (float)s.handler_cycles / cycles_per_us / (elapsed_s * 1e4f) : 0.0f;
+        printf("  %2u %4s %-16s %8lu %10.1f %7.2f %7.2f %11.2f %6.2f\n",
+               ch, slots[ch].handler ? (slots[ch].irq == DMA_IRQ_0 ? "0" : "1") : "-",
+               owner ? owner : "(chained)", s.irq_count,
+               elapsed_s > 0 ? s.irq_count / elapsed_s : 0.0f,
+               avg_us, s.max_handler_cycles / cycles_per_us, s.max_gap_us / 1000.0f, cpu);
+    }
+}
@@ -0,0 +1,39 @@
+// dma_service.h
+
+#ifndef DMA_SERVICE_H
+#define DMA_SERVICE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+
+// One dispatcher sits first on both DMA IRQ lines and calls a per-channel
+// handler for each INTS bit, so capture engines never have to install their
+// own line handler. DMA_IRQ_0 runs at the highest priority for real-time
+// capture; DMA_IRQ_1 is for storage. The SD library keeps its own shared
+// handler on line 1, chained after ours. Its channel is counted but left for
+// it to clear.
+
+typedef void (*dma_service_handler_t)(uint channel, void* ctx);
+
+typedef struct {
+    uint32_t irq_count;
+    uint64_t handler_cycles;    // Total time spent in the channel's handler
+    uint32_t max_handler_cycles;
+    uint32_t last_irq_us;
+    uint32_t max_gap_us;        // Longest time between completions
+} DMAChannelStats;
+
+// Function declarations
+void dma_service_init(void);
+bool dma_service_register(uint channel, uint irq, dma_service_handler_t handler, void* ctx);
+void dma_service_unregister(uint channel);
+int dma_service_claim(const char* owner, uint irq, dma_service_handler_t handler, void* ctx);
+void dma_service_release(int channel);
+void dma_service_get_stats(uint channel, DMAChannelStats* out);
+void dma_service_reset_stats(void);
+void dma_service_print_stats(void);
+
+#endif // DMA_SERVICE_H
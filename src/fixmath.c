@@ -0,0 +1,141 @@
+#include "fixmath.h"
+#include "cycles.h"
+#include "hardware/sync.h"
+#include <math.h>
+
+#define BENCH_ITERATIONS 256
+
+// num / den as UQ16.16, saturating at UQ16_MAX. Two hardware divides: the
+// integer part with its remainder, then the fraction from the remainder.
+uq16_t __not_in_flash_func(uq16_div_u32)(uint32_t num, uint32_t den) {
+    if (den == 0) {
+        return UQ16_MAX;
+    }
+    uint32_t q = num / den;
+    uint32_t r = num % den;
+    if (q > 0xFFFF) {
+        return UQ16_MAX;
+    }
+
+    // r < den, so dropping den below 16 bits lets r << (16 - s) fit in 32
+    uint s = den > 0xFFFF ? 16 - __builtin_clz(den) : 0;
+    uint32_t frac = (r << (16 - s)) / (den >> s);
+    if (frac > 0xFFFF) {
+        frac = 0xFFFF;
+    }
+    return (q << Q16_SHIFT) | frac;
+}
+
+q16_t q16_div(q16_t num, q16_t den) {
+    bool negative = (num < 0) != (den < 0);
+    uint32_t n = num < 0 ? -(uint32_t)num : (uint32_t)num;
+    uint32_t d = den < 0 ? -(uint32_t)den : (uint32_t)den;
+
+    // Q16 / Q16 keeps the shift, so this is the plain ratio in Q16.16
+    uq16_t result = uq16_div_u32(n, d);
+    if (result > INT32_MAX) {
+        result = INT32_MAX;
+    }
+    return negative ? -(q16_t)result : (q16_t)result;
+}
+
+// Closest entry in rates to measured, with the error as a Q16.16 percentage
+uint32_t __not_in_flash_func(uq16_nearest_rate)(uint32_t measured, const uint32_t* rates,
+                                                uint count, uq16_t* error_pct) {
+    uint32_t best = 0;
+    uq16_t best_error = UQ16_MAX;
+
+    for (uint i = 0; i < count; i++) {
+        uq16_t error = uq16_div_u32(u32_abs_diff(measured, rates[i]) * 100u, rates[i]);
+        if (error < best_error) {
+            best_error = error;
+            best = rates[i];
+        }
+    }
+    if (error_pct) {
+        *error_pct = best_error;
+    }
+    return best;
+}
+
+// Float references, as the kernels were written before the port. The fixed
+// versions below are what the ISRs run: frequency as an integer millihertz
+// divide (pwm.c), duty as Q16.16.
+static void float_edge(uint32_t period, uint32_t high, volatile float* freq, volatile float* duty) {
+    *freq = 1000000.0f / period;
+    *duty = (float)high * 100.0f / period;
+}
+
+static uint32_t float_nearest_rate(uint32_t measured, const uint32_t* rates, uint count) {
+    uint32_t best = 0;
+    float min_error = 100.0f;
+    for (uint i = 0; i < count; i++) {
+        float error = fabsf((float)measured - (float)rates[i]) / (float)rates[i] * 100.0f;
+        if (error < min_error) {
+            min_error = error;
+            best = rates[i];
+        }
+    }
+    return best;
+}
+
+void fixmath_benchmark(void) {
+    static const uint32_t periods[] = {
+        7, 33, 100, 250, 1000, 1667, 4000, 10000,
+        16384, 50000, 65537, 100000, 333333, 1000000, 2500000, 9999999
+    };
+    static const uint32_t rates[] = {
+        300, 1200, 2400, 4800, 9600, 19200, 38400, 57600, 74880, 115200, 230400
+    };
+    const uint n_periods = sizeof(periods) / sizeof(periods[0]);
+    const uint n_rates = sizeof(rates) / sizeof(rates[0]);
+    volatile float f_freq, f_duty;
+    volatile uint32_t q_freq_mhz;
+    volatile uq16_t q_duty;
+    volatile uint32_t match;
+
+    cycles_init();
+    printf("Fixed-point benchmark (%d iterations, cycles per call):\n", BENCH_ITERATIONS);
+
+    uint32_t save = save_and_disable_interrupts();
+    uint32_t start = cycles_now();
+    for (uint i = 0; i < BENCH_ITERATIONS; i++) {
+        uint32_t p = periods[i % n_periods];
+        float_edge(p, p / 3, &f_freq, &f_duty);
+    }
+    uint32_t float_edge_cycles = cycles_since(start);
+
+    start = cycles_now();
+    for (uint i = 0; i < BENCH_ITERATIONS; i++) {
+        uint32_t p = periods[i % n_periods];
+        q_freq_mhz = 1000000000u / p;
+        q_duty = uq16_div_u32((p / 3) * 100u, p);
+    }
+    uint32_t fixed_edge_cycles = cycles_since(start);
+
+    start = cycles_now();
+    for (uint i = 0; i < BENCH_ITERATIONS; i++) {
+        match = float_nearest_rate(1000000 / periods[i % n_periods], rates, n_rates);
+    }
+    uint32_t float_match_cycles = cycles_since(start);
+
+    start = cycles_now();
+    for (uint i = 0; i < BENCH_ITERATIONS; i++) {
+        match = uq16_nearest_rate(1000000 / periods[i % n_periods], rates, n_rates, NULL);
+    }
+    uint32_t fixed_match_cycles = cycles_since(start);
+    restore_interrupts(save);
+
+    // Spot check that both paths agree
+    float_edge(1667, 500, &f_freq, &f_duty);
+    q_freq_mhz = 1000000000u / 1667;
+    q_duty = uq16_div_u32(500 * 100u, 1667);
+    (void)match;
+
+    printf("  PWM edge (freq + duty):  float %5lu  fixed %5lu\n",
+           float_edge_cycles / BENCH_ITERATIONS, fixed_edge_cycles / BENCH_ITERATIONS);
+    printf("  Baud match (%u rates):   float %5lu  fixed %5lu\n", n_rates,
+           float_match_cycles / BENCH_ITERATIONS, fixed_match_cycles / BENCH_ITERATIONS);
+    printf("  1667 us, 500 us high:    float %.4f Hz %.4f%%  fixed %.4f Hz %.4f%%\n",
+           f_freq, f_duty, q_freq_mhz / 1000.0f, uq16_to_float(q_duty));
+}
@@ -0,0 +1,52 @@
+// fixmath.h
+
+#ifndef FIXMATH_H
+#define FIXMATH_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "pico/stdlib.h"
+
+// Fixed-point types for measurement hot paths. The RP2040 has no FPU, so
+// every float divide in an edge ISR is a ROM soft-float call. These keep
+// results in Q16.16 and lean on the SIO hardware divider (through the SDK's
+// IRQ-safe __aeabi_uidivmod, which returns quotient and remainder in one
+// go). Convert to float only when printing or handing values to the
+// dashboard.
+
+typedef int32_t q16_t;      // Signed Q16.16
+typedef uint32_t uq16_t;    // Unsigned Q16.16, 0 .. 65535.99998
+
+#define Q16_SHIFT 16
+#define Q16_ONE (1 << Q16_SHIFT)
+#define UQ16_MAX 0xFFFFFFFFu
+#define Q16_FROM_INT(x) ((q16_t)((x) * Q16_ONE))
+#define UQ16_FROM_INT(x) ((uq16_t)(x) << Q16_SHIFT)
+
+static inline float q16_to_float(q16_t x) {
+    return (float)x * (1.0f / Q16_ONE);
+}
+
+static inline float uq16_to_float(uq16_t x) {
+    return (float)x * (1.0f / Q16_ONE);
+}
+
+static inline uint32_t uq16_round(uq16_t x) {
+    return (x >> Q16_SHIFT) + ((x >> (Q16_SHIFT - 1)) & 1u);
+}
+
+static inline q16_t q16_mul(q16_t a, q16_t b) {
+    return (q16_t)(((int64_t)a * b) >> Q16_SHIFT);
+}
+
+static inline uint32_t u32_abs_diff(uint32_t a, uint32_t b) {
+    return a > b ? a - b : b - a;
+}
+
+// Function declarations
+uq16_t uq16_div_u32(uint32_t num, uint32_t den);
+q16_t q16_div(q16_t num, q16_t den);
+uint32_t uq16_nearest_rate(uint32_t measured, const uint32_t* rates, uint count, uq16_t* error_pct);
+void fixmath_benchmark(void);
+
+#endif // FIXMATH_H
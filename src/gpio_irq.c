@@ -0,0 +1,148 @@
+#include "gpio_irq.h"
+#include "hardware/irq.h"
+#include "hardware/structs/iobank0.h"
+#include "hardware/sync.h"
+
+#define STABLE_MASK ((1u << GPIO_BUTTON_STABLE_SAMPLES) - 1)
+
+typedef struct {
+    gpio_irq_handler_t handler;
+    uint8_t prio;
+} PinSlot;
+
+typedef struct {
+    uint8_t pin;
+    bool pressed;
+    uint32_t history;           // One bit per sample, 1 = high (released)
+    gpio_button_handler_t on_press;
+} Button;
+
+static PinSlot slots[NUM_BANK0_GPIOS];
+static volatile uint32_t tier_mask[GPIO_IRQ_PRIO_COUNT];
+static bool irq_installed = false;
+
+static Button buttons[GPIO_MAX_BUTTONS];
+static uint8_t button_count = 0;
+static repeating_timer_t button_timer;
+
+// Walk the pending status for just this tier's pins. Each 32-bit INTS
+// register holds four event bits for eight pins.
+static void __not_in_flash_func(dispatch)(uint32_t mask) {
+    io_irq_ctrl_hw_t* ctrl = get_core_num() ? &io_bank0_hw->proc1_irq_ctrl
+                                            : &io_bank0_hw->proc0_irq_ctrl;
+    uint32_t now = time_us_32();
+
+    for (uint reg = 0; mask; reg++, mask >>= 8) {
+        uint32_t reg_pins = mask & 0xFF;
+        if (!reg_pins) continue;
+
+        uint32_t status = ctrl->ints[reg];
+        while (status) {
+            uint shift = __builtin_ctz(status) & ~3u;
+            uint32_t events = (status >> shift) & 0xF;
+            status &= ~(0xFu << shift);
+
+            uint slot = shift / 4;
+            if (!(reg_pins & (1u << slot))) continue;     // Another tier's pin
+            uint gpio = reg * 8 + slot;
+            gpio_acknowledge_irq(gpio, events);
+            slots[gpio].handler(gpio, events, now);
+        }
+    }
+}
+
+static void __isr __not_in_flash_func(signal_irq_handler)(void) {
+    dispatch(tier_mask[GPIO_IRQ_PRIO_SIGNAL]);
+}
+
+static void __isr __not_in_flash_func(control_irq_handler)(void) {
+    dispatch(tier_mask[GPIO_IRQ_PRIO_CONTROL]);
+}
+
+static void install_handlers(void) {
+    if (irq_installed) {
+        return;
+    }
+    irq_add_shared_handler(IO_IRQ_BANK0, signal_irq_handler,
+                           PICO_SHARED_IRQ_HANDLER_HIGHEST_ORDER_PRIORITY);
+    irq_add_shared_handler(IO_IRQ_BANK0, control_irq_handler,
+                           PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_priority(IO_IRQ_BANK0, PICO_HIGHEST_IRQ_PRIORITY);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+    irq_installed = true;
+}
+
+bool gpio_irq_register(uint gpio, uint32_t events, GpioIrqPriority prio, gpio_irq_handler_t handler) {
+    if (gpio >= NUM_BANK0_GPIOS || prio >= GPIO_IRQ_PRIO_COUNT || !handler) {
+        return false;
+    }
+    if (slots[gpio].handler) {
+        printf("GPIO IRQ: GP%u already has a handler\n", gpio);
+        return false;
+    }
+    install_handlers();
+
+    uint32_t save = save_and_disable_interrupts();
+    slots[gpio].handler = handler;
+    slots[gpio].prio = prio;
+    tier_mask[prio] |= 1u << gpio;
+    restore_interrupts(save);
+
+    gpio_acknowledge_irq(gpio, events);
+    gpio_set_irq_enabled(gpio, events, true);
+    return true;
+}
+
+void gpio_irq_unregister(uint gpio) {
+    if (gpio >= NUM_BANK0_GPIOS || !slots[gpio].handler) {
+        return;
+    }
+    gpio_set_irq_enabled(gpio, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL |
+                         GPIO_IRQ_LEVEL_HIGH | GPIO_IRQ_LEVEL_LOW, false);
+
+    uint32_t save = save_and_disable_interrupts();
+    tier_mask[slots[gpio].prio] &= ~(1u << gpio);
+    slots[gpio].handler = NULL;
+    restore_interrupts(save);
+}
+
+static bool button_tick(repeating_timer_t* rt) {
+    (void)rt;
+    uint32_t levels = gpio_get_all();
+
+    for (uint i = 0; i < button_count; i++) {
+        Button* b = &buttons[i];
+        b->history = (b->history << 1) | ((levels >> b->pin) & 1u);
+
+        if (!b->pressed && (b->history & STABLE_MASK) == 0) {
+            b->pressed = true;
+            b->on_press(b->pin);
+        } else if (b->pressed && (b->history & STABLE_MASK) == STABLE_MASK) {
+            b->pressed = false;
+        }
+    }
+    return true;
+}
+
+// Active-low button with pull-up; on_press runs from the timer IRQ
+bool gpio_button_add(uint gpio, gpio_button_handler_t on_press) {
+    if (gpio >= NUM_BANK0_GPIOS || !on_press || button_count >= GPIO_MAX_BUTTONS) {
+        return false;
+    }
+
+    gpio_init(gpio);
+    gpio_set_dir(gpio, GPIO_IN);
+    gpio_pull_up(gpio);
+
+    Button* b = &buttons[button_count];
+    b->pin = gpio;
+    b->pressed = false;
+    b->history = 0xFFFFFFFF;
+    b->on_press = on_press;
+
+    if (button_count++ == 0) {
+        // Negative delay keeps a fixed sample rate regardless of callback time
+        add_repeating_timer_ms(-GPIO_BUTTON_SAMPLE_MS, button_tick, NULL, &button_timer);
+    }
+    return true;
+}
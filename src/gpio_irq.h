@@ -0,0 +1,40 @@
+// gpio_irq.h
+
+#ifndef GPIO_IRQ_H
+#define GPIO_IRQ_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+
+// Per-pin GPIO interrupt dispatch. The SDK's gpio_set_irq_callback() gives
+// the whole bank one callback, so every edge on a fast signal pin paid for
+// the button and protocol checks too. Here each pin gets its own handler and
+// sits in a priority tier; each tier is its own raw handler on IO_IRQ_BANK0,
+// and the signal tier is called first.
+//
+// Buttons don't use GPIO interrupts at all. A repeating timer samples them
+// and a press is reported once the pin has read low for
+// GPIO_BUTTON_STABLE_SAMPLES ticks in a row, so bounce never reaches the IRQ.
+
+#define GPIO_BUTTON_SAMPLE_MS 5
+#define GPIO_BUTTON_STABLE_SAMPLES 6    // 30 ms of steady low
+#define GPIO_MAX_BUTTONS 8
+
+typedef enum {
+    GPIO_IRQ_PRIO_SIGNAL = 0,   // Edge timing pins, dispatched first
+    GPIO_IRQ_PRIO_CONTROL,      // Slow inputs
+    GPIO_IRQ_PRIO_COUNT
+} GpioIrqPriority;
+
+// now_us is sampled once on IRQ entry so handlers share one timestamp
+typedef void (*gpio_irq_handler_t)(uint gpio, uint32_t events, uint32_t now_us);
+typedef void (*gpio_button_handler_t)(uint gpio);
+
+// Function declarations
+bool gpio_irq_register(uint gpio, uint32_t events, GpioIrqPriority prio, gpio_irq_handler_t handler);
+void gpio_irq_unregister(uint gpio);
+bool gpio_button_add(uint gpio, gpio_button_handler_t on_press);
+
+#endif // GPIO_IRQ_H
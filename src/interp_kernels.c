@@ -0,0 +1,230 @@
+#include "interp_kernels.h"
+#include "cycles.h"
+#include "hardware/sync.h"
+#include <stdlib.h>
+
+#if PICO_ON_DEVICE
+#include "hardware/interp.h"
+#endif
+
+#define BENCH_SAMPLES 1024
+
+// lut[code] = millivolts for a raw code after offset and gain correction
+void adc_cal_build_lut(uint16_t* lut, int16_t offset_counts, uq16_t gain) {
+    for (int code = 0; code < ADC_CAL_LUT_SIZE; code++) {
+        int32_t corrected = code - offset_counts;
+        if (corrected < 0) corrected = 0;
+        uint64_t mv = ((uint64_t)corrected * ADC_VREF_MV * gain) >> (12 + Q16_SHIFT);
+        lut[code] = mv > 0xFFFF ? 0xFFFF : (uint16_t)mv;
+    }
+}
+
+void adc_scale_block_c(const uint16_t* raw, uint16_t* out, uint n, const uint16_t* lut) {
+    for (uint i = 0; i < n; i++) {
+        out[i] = lut[raw[i] & 0xFFF];
+    }
+}
+
+void hysteresis_crossings_c(const volatile uint16_t* buf, uint start, uint n,
+                            uint16_t lower, uint16_t upper, CrossingResult* r) {
+    bool above = r->above;
+    for (uint i = start; i < n; i++) {
+        uint16_t x = buf[i];
+        if (x == 0) continue;
+        if ((above && x < lower) || (!above && x > upper)) {
+            if (r->first == 0) r->first = i;
+            r->last = i;
+            r->count++;
+            above = !above;
+        }
+    }
+    r->above = above;
+}
+
+uint32_t crc32_lut_update_c(uint32_t crc, const uint8_t* data, size_t len, const uint32_t* table) {
+    for (size_t i = 0; i < len; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if PICO_ON_DEVICE
+
+// Both lanes mask the same 12-bit code out of ACCUM0 and PEEK_FULL adds them
+// to BASE2, so the full result is lut + 2 * code: the address of a uint16_t
+// entry, with the ADC error bit and any stray high bits dropped for free.
+void adc_scale_block(const uint16_t* raw, uint16_t* out, uint n, const uint16_t* lut) {
+    interp_hw_save_t saved;
+    interp_save(interp0, &saved);
+
+    interp_config cfg = interp_default_config();
+    interp_config_set_mask(&cfg, 0, 11);
+    interp_set_config(interp0, 0, &cfg);
+    interp_config_set_cross_input(&cfg, true);
+    interp_set_config(interp0, 1, &cfg);
+    interp0->base[0] = 0;
+    interp0->base[1] = 0;
+    interp0->base[2] = (uintptr_t)lut;
+
+    for (uint i = 0; i < n; i++) {
+        interp0->accum[0] = raw[i];
+        out[i] = *(const uint16_t*)interp0->peek[2];
+    }
+    interp_restore(interp0, &saved);
+}
+
+// INTERP1 lane 0 clamps each sample to [lower - 1, upper + 1], so hitting
+// either bound is the same as falling outside the hysteresis band.
+void hysteresis_crossings(const volatile uint16_t* buf, uint start, uint n,
+                          uint16_t lower, uint16_t upper, CrossingResult* r) {
+    if (lower == 0) {
+        hysteresis_crossings_c(buf, start, n, lower, upper, r);    // lower - 1 would wrap
+        return;
+    }
+    interp_hw_save_t saved;
+    interp_save(interp1, &saved);
+
+    interp_config cfg = interp_default_config();
+    interp_config_set_clamp(&cfg, true);
+    interp_config_set_mask(&cfg, 0, 15);
+    interp_set_config(interp1, 0, &cfg);
+    const uint32_t lo = lower - 1u;
+    const uint32_t hi = upper + 1u;
+    interp1->base[0] = lo;
+    interp1->base[1] = hi;
+
+    bool above = r->above;
+    uint32_t edge = above ? lo : hi;    // Clamp value that means a crossing
+    for (uint i = start; i < n; i++) {
+        uint16_t x = buf[i];
+        if (x == 0) continue;
+        interp1->accum[0] = x;
+        if (interp1->peek[0] == edge) {
+            if (r->first == 0) r->first = i;
+            r->last = i;
+            r->count++;
+            above = !above;
+            edge = above ? lo : hi;
+        }
+    }
+    r->above = above;
+    interp_restore(interp1, &saved);
+}
+
+// Lane 0 is the table index and lane 1 the shifted register, both from the
+// one write of crc ^ byte (the byte only touches the bits lane 1 drops).
+uint32_t crc32_lut_update(uint32_t crc, const uint8_t* data, size_t len, const uint32_t* table) {
+    interp_hw_save_t saved;
+    interp_save(interp0, &saved);
+
+    interp_config cfg = interp_default_config();
+    interp_config_set_mask(&cfg, 0, 7);
+    interp_set_config(interp0, 0, &cfg);
+    cfg = interp_default_config();
+    interp_config_set_cross_input(&cfg, true);
+    interp_config_set_shift(&cfg, 8);
+    interp_config_set_mask(&cfg, 0, 23);
+    interp_set_config(interp0, 1, &cfg);
+    interp0->base[0] = 0;
+    interp0->base[1] = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        interp0->accum[0] = crc ^ data[i];
+        crc = table[interp0->peek[0]] ^ interp0->peek[1];
+    }
+    interp_restore(interp0, &saved);
+    return crc;
+}
+
+#else
+
+void adc_scale_block(const uint16_t* raw, uint16_t* out, uint n, const uint16_t* lut) {
+    adc_scale_block_c(raw, out, n, lut);
+}
+
+void hysteresis_crossings(const volatile uint16_t* buf, uint start, uint n,
+                          uint16_t lower, uint16_t upper, CrossingResult* r) {
+    hysteresis_crossings_c(buf, start, n, lower, upper, r);
+}
+
+uint32_t crc32_lut_update(uint32_t crc, const uint8_t* data, size_t len, const uint32_t* table) {
+    return crc32_lut_update_c(crc, data, len, table);
+}
+
+#endif
+
+static void print_result(const char* name, uint32_t c_cycles, uint32_t interp_cycles, bool match) {
+    printf("  %-22s C %6lu  interp %6lu  (%s)\n", name, c_cycles, interp_cycles,
+           match ? "results match" : "MISMATCH");
+}
+
+void interp_kernels_benchmark(void) {
+    uint16_t* lut = malloc(ADC_CAL_LUT_SIZE * sizeof(uint16_t));
+    uint16_t* raw = malloc(BENCH_SAMPLES * sizeof(uint16_t));
+    uint16_t* out_c = malloc(BENCH_SAMPLES * sizeof(uint16_t));
+    uint16_t* out_i = malloc(BENCH_SAMPLES * sizeof(uint16_t));
+    uint32_t* crc_table = malloc(256 * sizeof(uint32_t));
+    if (!lut || !raw || !out_c || !out_i || !crc_table) {
+        printf("Benchmark: out of memory\n");
+        free(lut); free(raw); free(out_c); free(out_i); free(crc_table);
+        return;
+    }
+
+    // A triangle wave with some noise, so the hysteresis path sees crossings
+    uint32_t seed = 12345;
+    for (uint i = 0; i < BENCH_SAMPLES; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        uint32_t phase = i % 200;
+        uint32_t tri = phase < 100 ? phase * 40 : (200 - phase) * 40;
+        raw[i] = (uint16_t)(tri + 20 + (seed >> 28));
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+        }
+        crc_table[i] = c;
+    }
+    adc_cal_build_lut(lut, 0, Q16_ONE);
+
+    cycles_init();
+    printf("Interpolator benchmark (%d samples, cycles per call):\n", BENCH_SAMPLES);
+    uint32_t save = save_and_disable_interrupts();
+
+    uint32_t start = cycles_now();
+    adc_scale_block_c(raw, out_c, BENCH_SAMPLES, lut);
+    uint32_t scale_c = cycles_since(start);
+    start = cycles_now();
+    adc_scale_block(raw, out_i, BENCH_SAMPLES, lut);
+    uint32_t scale_i = cycles_since(start);
+
+    CrossingResult cross_c = { .above = false };
+    CrossingResult cross_i = { .above = false };
+    start = cycles_now();
+    hysteresis_crossings_c(raw, 1, BENCH_SAMPLES, 1800, 2200, &cross_c);
+    uint32_t hyst_c = cycles_since(start);
+    start = cycles_now();
+    hysteresis_crossings(raw, 1, BENCH_SAMPLES, 1800, 2200, &cross_i);
+    uint32_t hyst_i = cycles_since(start);
+
+    const uint8_t* bytes = (const uint8_t*)raw;
+    start = cycles_now();
+    uint32_t crc_c = crc32_lut_update_c(0xFFFFFFFF, bytes, BENCH_SAMPLES * 2, crc_table);
+    uint32_t crc_cycles_c = cycles_since(start);
+    start = cycles_now();
+    uint32_t crc_i = crc32_lut_update(0xFFFFFFFF, bytes, BENCH_SAMPLES * 2, crc_table);
+    uint32_t crc_cycles_i = cycles_since(start);
+
+    restore_interrupts(save);
+
+    bool scale_match = true;
+    for (uint i = 0; i < BENCH_SAMPLES; i++) {
+        if (out_c[i] != out_i[i]) scale_match = false;
+    }
+    print_result("ADC scale (LUT)", scale_c, scale_i, scale_match);
+    print_result("Hysteresis crossings", hyst_c, hyst_i,
+                 cross_c.count == cross_i.count && cross_c.last == cross_i.last);
+    print_result("CRC-32 (2 KB)", crc_cycles_c, crc_cycles_i, crc_c == crc_i);
+
+    free(lut); free(raw); free(out_c); free(out_i); free(crc_table);
+}
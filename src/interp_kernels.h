@@ -0,0 +1,45 @@
+// interp_kernels.h
+
+#ifndef INTERP_KERNELS_H
+#define INTERP_KERNELS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "pico/stdlib.h"
+#include "fixmath.h"
+
+// Per-sample hot loops with the SIO interpolator doing the index and clamp
+// work. Every kernel has a plain C twin (the _c versions) that host builds
+// fall back to and that the benchmark compares against. Kernels run from
+// thread context and save/restore the interpolator they use, so an IRQ
+// handler may use the interpolators too as long as it does the same.
+
+#define ADC_CAL_LUT_SIZE 4096       // One entry per 12-bit code
+#define ADC_VREF_MV 3300
+
+typedef struct {
+    uint32_t count;
+    uint32_t first;                 // Index of the first crossing, 0 if none
+    uint32_t last;
+    bool above;                     // Current side; seed before the call
+} CrossingResult;
+
+// Function declarations
+void adc_cal_build_lut(uint16_t* lut, int16_t offset_counts, uq16_t gain);
+void adc_scale_block(const uint16_t* raw, uint16_t* out, uint n, const uint16_t* lut);
+void adc_scale_block_c(const uint16_t* raw, uint16_t* out, uint n, const uint16_t* lut);
+
+void hysteresis_crossings(const volatile uint16_t* buf, uint start, uint n,
+                          uint16_t lower, uint16_t upper, CrossingResult* r);
+void hysteresis_crossings_c(const volatile uint16_t* buf, uint start, uint n,
+                            uint16_t lower, uint16_t upper, CrossingResult* r);
+
+// Any reflected CRC up to 32 bits with a byte table. None of the protocol
+// decoders check a CRC, so its user is the image side of SPI flash verify.
+uint32_t crc32_lut_update(uint32_t crc, const uint8_t* data, size_t len, const uint32_t* table);
+uint32_t crc32_lut_update_c(uint32_t crc, const uint8_t* data, size_t len, const uint32_t* table);
+
+void interp_kernels_benchmark(void);
+
+#endif // INTERP_KERNELS_H
@@ -0,0 +1,215 @@
+#include "resources.h"
+#include <string.h>
+
+typedef struct {
+    const char* owners[RES_MAX_PIN_SHARERS];
+    uint8_t count;
+    ResPinUse use;
+} PinClaim;
+
+static PinClaim pins[RES_NUM_PINS];
+static const char* sm_owner[NUM_PIOS][NUM_PIO_STATE_MACHINES];
+static const char* dma_owner[NUM_DMA_CHANNELS];
+static const char* irq_owner[NUM_IRQS];
+
+static bool same_owner(const char* a, const char* b) {
+    return a && b && strcmp(a, b) == 0;
+}
+
+static int find_sharer(const PinClaim* p, const char* owner) {
+    for (int i = 0; i < p->count; i++) {
+        if (same_owner(p->owners[i], owner)) return i;
+    }
+    return -1;
+}
+
+// Exclusive wins only on a free pin (or one we hold alone); shared inputs stack
+static bool pin_available(uint pin, const char* owner, ResPinUse use) {
+    const PinClaim* p = &pins[pin];
+    if (p->count == 0) {
+        return true;
+    }
+    if (find_sharer(p, owner) >= 0) {
+        return use == RES_PIN_SHARED_INPUT || p->count == 1;
+    }
+    return use == RES_PIN_SHARED_INPUT && p->use == RES_PIN_SHARED_INPUT &&
+           p->count < RES_MAX_PIN_SHARERS;
+}
+
+static void report_pin_conflict(uint pin, const char* owner, ResPinUse use) {
+    const PinClaim* p = &pins[pin];
+    printf("Resource conflict: GP%u wanted by %s (%s) is held by", pin, owner,
+           use == RES_PIN_EXCLUSIVE ? "exclusive" : "shared input");
+    for (int i = 0; i < p->count; i++) {
+        if (!same_owner(p->owners[i], owner)) printf(" %s", p->owners[i]);
+    }
+    printf(" (%s)\n", p->use == RES_PIN_EXCLUSIVE ? "exclusive" : "shared input");
+}
+
+static void claim_pin(uint pin, const char* owner, ResPinUse use) {
+    PinClaim* p = &pins[pin];
+    if (find_sharer(p, owner) >= 0) {
+        if (use == RES_PIN_EXCLUSIVE) p->use = RES_PIN_EXCLUSIVE;
+        return;
+    }
+    if (p->count == 0) {
+        p->use = use;
+    }
+    p->owners[p->count++] = owner;
+}
+
+// All or nothing: on any conflict nothing is claimed
+bool res_claim_pins(const char* owner, uint32_t mask, ResPinUse use) {
+    bool ok = true;
+    for (uint pin = 0; pin < RES_NUM_PINS; pin++) {
+        if ((mask & (1u << pin)) && !pin_available(pin, owner, use)) {
+            report_pin_conflict(pin, owner, use);
+            ok = false;
+        }
+    }
+    if (mask >> RES_NUM_PINS) {
+        printf("Resource conflict: %s asked for pins beyond GP%d\n", owner, RES_NUM_PINS - 1);
+        ok = false;
+    }
+    if (!ok) {
+        return false;
+    }
+    for (uint pin = 0; pin < RES_NUM_PINS; pin++) {
+        if (mask & (1u << pin)) claim_pin(pin, owner, use);
+    }
+    return true;
+}
+
+// Best effort: claims whatever is free and returns that subset
+uint32_t res_claim_available_pins(const char* owner, uint32_t mask, ResPinUse use) {
+    uint32_t claimed = 0;
+    for (uint pin = 0; pin < RES_NUM_PINS; pin++) {
+        if (!(mask & (1u << pin))) continue;
+        if (pin_available(pin, owner, use)) {
+            claim_pin(pin, owner, use);
+            claimed |= 1u << pin;
+        } else {
+            report_pin_conflict(pin, owner, use);
+        }
+    }
+    return claimed;
+}
+
+void res_release_pins(const char* owner, uint32_t mask) {
+    for (uint pin = 0; pin < RES_NUM_PINS; pin++) {
+        if (!(mask & (1u << pin))) continue;
+        PinClaim* p = &pins[pin];
+        int i = find_sharer(p, owner);
+        if (i < 0) continue;
+        p->owners[i] = p->owners[--p->count];
+        p->owners[p->count] = NULL;
+    }
+}
+
+const char* res_pin_owner(uint pin) {
+    if (pin >= RES_NUM_PINS || pins[pin].count == 0) {
+        return NULL;
+    }
+    return pins[pin].owners[0];
+}
+
+int res_claim_pio_sm(const char* owner, PIO pio) {
+    int sm = pio_claim_unused_sm(pio, false);
+    if (sm < 0) {
+        printf("Resource conflict: %s found no free state machine on PIO%u\n",
+               owner, pio_get_index(pio));
+        return -1;
+    }
+    sm_owner[pio_get_index(pio)][sm] = owner;
+    return sm;
+}
+
+void res_release_pio_sm(PIO pio, uint sm) {
+    pio_sm_unclaim(pio, sm);
+    sm_owner[pio_get_index(pio)][sm] = NULL;
+}
+
+int res_claim_dma(const char* owner) {
+    int channel = dma_claim_unused_channel(false);
+    if (channel < 0) {
+        printf("Resource conflict: %s found no free DMA channel\n", owner);
+        return -1;
+    }
+    dma_owner[channel] = owner;
+    return channel;
+}
+
+void res_release_dma(int channel) {
+    if (channel < 0) {
+        return;
+    }
+    dma_channel_unclaim(channel);
+    dma_owner[channel] = NULL;
+}
+
+const char* res_dma_owner(uint channel) {
+    if (channel >= NUM_DMA_CHANNELS) {
+        return NULL;
+    }
+    return dma_owner[channel];
+}
+
+bool res_claim_irq(const char* owner, uint irq) {
+    if (irq_owner[irq] && !same_owner(irq_owner[irq], owner)) {
+        printf("Resource conflict: IRQ %u wanted by %s is held by %s\n", irq, owner, irq_owner[irq]);
+        return false;
+    }
+    irq_owner[irq] = owner;
+    return true;
+}
+
+void res_release_irq(uint irq) {
+    irq_owner[irq] = NULL;
+}
+
+void res_release_all(const char* owner) {
+    res_release_pins(owner, (1u << RES_NUM_PINS) - 1);
+    for (uint p = 0; p < NUM_PIOS; p++) {
+        for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+            if (same_owner(sm_owner[p][sm], owner)) {
+                res_release_pio_sm(p ? pio1 : pio0, sm);
+            }
+        }
+    }
+    for (int ch = 0; ch < NUM_DMA_CHANNELS; ch++) {
+        if (same_owner(dma_owner[ch], owner)) res_release_dma(ch);
+    }
+    for (uint irq = 0; irq < NUM_IRQS; irq++) {
+        if (same_owner(irq_owner[irq], owner)) res_release_irq(irq);
+    }
+}
+
+// Claims made straight through the SDK (SD card library, CYW43) show as "sdk"
+void res_print(void) {
+    printf("Pins:\n");
+    for (uint pin = 0; pin < RES_NUM_PINS; pin++) {
+        const PinClaim* p = &pins[pin];
+        if (p->count == 0) continue;
+        printf("  GP%-2u %s:", pin, p->use == RES_PIN_EXCLUSIVE ? "exclusive" : "shared   ");
+        for (int i = 0; i < p->count; i++) printf(" %s", p->owners[i]);
+        printf("\n");
+    }
+    printf("PIO state machines:\n");
+    for (uint p = 0; p < NUM_PIOS; p++) {
+        for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+            const char* owner = sm_owner[p][sm];
+            if (!owner && pio_sm_is_claimed(p ? pio1 : pio0, sm)) owner = "sdk";
+            if (owner) printf("  PIO%u SM%u: %s\n", p, sm, owner);
+        }
+    }
+    printf("DMA channels:\n");
+    for (int ch = 0; ch < NUM_DMA_CHANNELS; ch++) {
+        const char* owner = dma_owner[ch];
+        if (!owner && dma_channel_is_claimed(ch)) owner = "sdk";
+        if (owner) printf("  DMA%-2d: %s\n", ch, owner);
+    }
+    printf("IRQs:\n");
+    for (uint irq = 0; irq < NUM_IRQS; irq++) {
+        if (irq_owner[irq]) printf("  IRQ%-2u: %s\n", irq, irq_owner[irq]);
+    }
+}
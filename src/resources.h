@@ -0,0 +1,47 @@
+// resources.h
+
+#ifndef RESOURCES_H
+#define RESOURCES_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+
+// Runtime ownership of GPIOs, PIO state machines, DMA channels and IRQ lines.
+// Engines claim what they touch when they start and release it when they
+// stop, so anything that doesn't collide can run at the same time and a
+// collision is reported by name instead of silently re-muxing a pin.
+//
+// Owners are identified by a string literal, e.g. "sd_card" or "jtag".
+
+#define RES_NUM_PINS 30
+#define RES_MAX_PIN_SHARERS 4
+
+typedef enum {
+    RES_PIN_EXCLUSIVE = 0,      // Driven, or muxed to a peripheral
+    RES_PIN_SHARED_INPUT        // Plain input; other listeners may share it
+} ResPinUse;
+
+// Function declarations
+bool res_claim_pins(const char* owner, uint32_t mask, ResPinUse use);
+uint32_t res_claim_available_pins(const char* owner, uint32_t mask, ResPinUse use);
+void res_release_pins(const char* owner, uint32_t mask);
+const char* res_pin_owner(uint pin);
+
+int res_claim_pio_sm(const char* owner, PIO pio);
+void res_release_pio_sm(PIO pio, uint sm);
+
+int res_claim_dma(const char* owner);
+void res_release_dma(int channel);
+const char* res_dma_owner(uint channel);
+
+bool res_claim_irq(const char* owner, uint irq);
+void res_release_irq(uint irq);
+
+void res_release_all(const char* owner);
+void res_print(void);
+
+#endif // RESOURCES_H
@@ -1,11 +1,21 @@
 #include "adc.h"
+#include "resources.h"
+#include "dma_service.h"
+#include "fixmath.h"
+#include "interp_kernels.h"
+#include "adc_decimate.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 
 // Private ADC configuration structure
 typedef struct {
     uint16_t* capture_buf;
     uint capture_depth;
+    uint max_capture_depth;         // What capture_buf was allocated for
+    uint32_t sample_rate_hz;
+    uint16_t trigger_level;         // 0 = midpoint of each capture
+    uint16_t trigger_hysteresis;
     uint button_pin;
     uint analog_pin;
     bool capturing;
@@ -19,6 +29,10 @@ typedef struct {
 static ADC_Config adc_config = {
     .capture_buf = NULL,
     .capture_depth = DEFAULT_CAPTURE_DEPTH,
+    .max_capture_depth = DEFAULT_CAPTURE_DEPTH,
+    .sample_rate_hz = ADC_SAMPLE_RATE_HZ,
+    .trigger_level = 0,
+    .trigger_hysteresis = 0,
     .button_pin = ADC_BUTTON_PIN,
     .analog_pin = DEFAULT_ANALOG_PIN,
     .capturing = false,
@@ -28,10 +42,27 @@ static ADC_Config adc_config = {
     .continuous_mode = false
 };
 
-static void dma_handler(void) {
-    if (adc_config.dma_chan < 0) return;
-    
-    dma_hw->ints0 = 1u << adc_config.dma_chan;
+// Raw code to millivolts, indexed through the interpolator
+static uint16_t adc_cal_lut[ADC_CAL_LUT_SIZE];
+
+// Block streaming: two DMA channels ping-pong between the halves of
+// stream_buf and each half is handed to the consumer as it completes
+static uint16_t stream_buf[2][ADC_STREAM_HALF_SAMPLES] __attribute__((aligned(4)));
+static int stream_chan[2] = { -1, -1 };
+static adc_block_handler_t stream_handler = NULL;
+static void* stream_ctx = NULL;
+static bool stream_running = false;
+
+// Enhanced-resolution mode is a stream consumer feeding the decimator
+static uint16_t hires_out[ADC_HIRES_OUT_SIZE];
+static volatile uint hires_head = 0;
+static volatile uint hires_tail = 0;
+static volatile uint32_t hires_overruns = 0;
+static AdcDecimator decimator;
+
+// Called from the DMA dispatcher, which has already acknowledged the channel
+static void dma_handler(uint channel, void* ctx) {
+    (void)ctx;
     
     if (adc_config.continuous_mode) {
         adc_config.transfer_complete = true;
@@ -61,12 +92,19 @@ void adc_analyzer_init(void) {
     printf("Initializing ADC and DMA...\n");
     
     // Allocate capture buffer
-    adc_config.capture_buf = (uint16_t*)malloc(adc_config.capture_depth * sizeof(uint16_t));
+    adc_config.capture_buf = (uint16_t*)malloc(adc_config.max_capture_depth * sizeof(uint16_t));
     if (!adc_config.capture_buf) {
         printf("Error: Failed to allocate capture buffer\n");
         return;
     }
     
+    if (!res_claim_pins("adc", 1u << adc_config.analog_pin, RES_PIN_EXCLUSIVE)) {
+        printf("Error: ADC resources are in use\n");
+        return;
+    }
+
+    adc_cal_build_lut(adc_cal_lut, ADC_CAL_OFFSET_COUNTS, ADC_CAL_GAIN_Q16);
+
     // Initialize ADC
     adc_gpio_init(adc_config.analog_pin);
     adc_init();
@@ -80,24 +118,19 @@ void adc_analyzer_init(void) {
         false    // Don't shift samples
     );
     
-    adc_set_clkdiv(4800);  // 10kHz sampling
+    adc_restore_rate();
     adc_fifo_drain();
     
-    // Claim DMA channel
-    adc_config.dma_chan = dma_claim_unused_channel(true);
+    // Claim DMA channel and take its completions on the capture IRQ line
+    adc_config.dma_chan = dma_service_claim("adc", DMA_IRQ_0, dma_handler, NULL);
     if (adc_config.dma_chan < 0) {
         printf("Error: Could not claim a DMA channel\n");
         return;
     }
-    
-    // Configure DMA interrupts
-    dma_channel_set_irq0_enabled(adc_config.dma_chan, true);
-    irq_set_exclusive_handler(DMA_IRQ_0, dma_handler);
-    irq_set_enabled(DMA_IRQ_0, true);
 }
 
 void adc_start_capture(void) {
-    if (!adc_config.capturing) {
+    if (!adc_config.capturing && !stream_running) {
         printf("\nStarting continuous capture...\n");
         adc_config.capturing = true;
         adc_config.transfer_complete = false;
@@ -134,6 +167,229 @@ void adc_stop_capture(void) {
     }
 }
 
+// Runs on the storage IRQ line so consumers never hold off capture IRQs.
+// The finished channel only needs its write address back; the chain from
+// the other half re-triggers it with the count reloaded.
+static void stream_dma_handler(uint channel, void* ctx) {
+    uint half = (uint)(uintptr_t)ctx;
+    dma_channel_set_write_addr(channel, stream_buf[half], false);
+    stream_handler(stream_buf[half], ADC_STREAM_HALF_SAMPLES, stream_ctx);
+}
+
+static void stream_configure(uint half) {
+    dma_channel_config cfg = dma_channel_get_default_config(stream_chan[half]);
+    channel_config_set_transfer_data_size(&cfg, DMA_SIZE_16);
+    channel_config_set_read_increment(&cfg, false);
+    channel_config_set_write_increment(&cfg, true);
+    channel_config_set_dreq(&cfg, DREQ_ADC);
+    channel_config_set_chain_to(&cfg, stream_chan[half ^ 1]);
+    dma_channel_configure(stream_chan[half], &cfg, stream_buf[half], &adc_hw->fifo,
+                          ADC_STREAM_HALF_SAMPLES, false);
+}
+
+// Continuous capture at rate_hz, ADC_STREAM_HALF_SAMPLES raw samples per
+// call to handler (from the DMA IRQ; bit 15 is the ADC error flag)
+bool adc_start_stream(uint32_t rate_hz, adc_block_handler_t handler, void* ctx) {
+    if (!adc_is_idle() || !handler || rate_hz < ADC_MIN_RATE_HZ || rate_hz > ADC_MAX_RATE_HZ) {
+        return false;
+    }
+    stream_chan[1] = dma_service_claim("adc", DMA_IRQ_1, stream_dma_handler, (void*)1);
+    if (stream_chan[1] < 0) {
+        return false;
+    }
+    stream_chan[0] = adc_config.dma_chan;
+    dma_service_register(stream_chan[0], DMA_IRQ_1, stream_dma_handler, (void*)0);
+
+    stream_handler = handler;
+    stream_ctx = ctx;
+    stream_configure(0);
+    stream_configure(1);
+
+    adc_fifo_drain();
+    adc_set_clkdiv(ADC_CLOCK_HZ / rate_hz - 1);
+    stream_running = true;
+    dma_channel_start(stream_chan[0]);
+    adc_run(true);
+    return true;
+}
+
+void adc_stop_stream(void) {
+    if (!stream_running) {
+        return;
+    }
+    adc_run(false);
+
+    // Chained channels have to be aborted together or one restarts the other
+    dma_hw->abort = (1u << stream_chan[0]) | (1u << stream_chan[1]);
+    while (dma_hw->abort) {
+        tight_loop_contents();
+    }
+    adc_fifo_drain();
+
+    dma_service_release(stream_chan[1]);
+    stream_chan[1] = -1;
+    dma_service_register(adc_config.dma_chan, DMA_IRQ_0, dma_handler, NULL);
+    adc_restore_rate();
+    stream_running = false;
+}
+
+static void hires_block(const uint16_t* block, uint n, void* ctx) {
+    (void)ctx;
+    uint16_t out[ADC_STREAM_HALF_SAMPLES / ADC_DECIM_MIN_RATIO];
+    uint produced = adc_decimator_process(&decimator, block, n, out);
+
+    for (uint i = 0; i < produced; i++) {
+        uint next = (hires_head + 1) % ADC_HIRES_OUT_SIZE;
+        if (next == hires_tail) {
+            hires_overruns++;
+            break;
+        }
+        hires_out[hires_head] = out[i];
+        hires_head = next;
+    }
+}
+
+// ratio is the total decimation: 16, 32, 64 or 128
+bool adc_start_hires(uint ratio) {
+    if (!adc_is_idle()) {
+        return false;
+    }
+    if (!adc_decimator_init(&decimator, ratio)) {
+        printf("Error: Unsupported decimation ratio %u\n", ratio);
+        return false;
+    }
+    hires_head = hires_tail = 0;
+    hires_overruns = 0;
+    return adc_start_stream(ADC_HIRES_INPUT_RATE_HZ, hires_block, NULL);
+}
+
+void adc_stop_hires(void) {
+    adc_stop_stream();
+}
+
+// Copies out up to max decimated samples (16-bit, code << 4)
+uint adc_hires_read(uint16_t* out, uint max) {
+    uint n = 0;
+    while (n < max && hires_tail != hires_head) {
+        out[n++] = hires_out[hires_tail];
+        hires_tail = (hires_tail + 1) % ADC_HIRES_OUT_SIZE;
+    }
+    return n;
+}
+
+// Runs the enhanced-resolution path for duration_ms and reports the result.
+// With a steady input the spread of the output is the noise floor.
+bool adc_hires_measure(uint ratio, uint32_t duration_ms) {
+    if (!adc_start_hires(ratio)) {
+        printf("Error: ADC is busy\n");
+        return false;
+    }
+    printf("Enhanced ADC: %u x oversampling, %u Hz out, %lu ms...\n",
+           ratio, ADC_HIRES_INPUT_RATE_HZ / ratio, duration_ms);
+
+    uint16_t chunk[64];
+    uint32_t count = 0;
+    uint64_t sum = 0;
+    uint64_t sum_sq = 0;
+    uint16_t min_val = 0xFFFF;
+    uint16_t max_val = 0;
+    uint skip = ADC_DECIM_FIR_TAPS;     // Let the filters settle
+
+    absolute_time_t end = make_timeout_time_ms(duration_ms);
+    while (!time_reached(end)) {
+        uint n = adc_hires_read(chunk, 64);
+        for (uint i = 0; i < n; i++) {
+            if (skip) {
+                skip--;
+                continue;
+            }
+            uint16_t x = chunk[i];
+            sum += x;
+            sum_sq += (uint32_t)x * x;
+            if (x < min_val) min_val = x;
+            if (x > max_val) max_val = x;
+            count++;
+        }
+        if (n == 0) sleep_us(500);
+    }
+    uint32_t overruns = hires_overruns;
+    adc_stop_hires();
+
+    if (count == 0) {
+        printf("  No samples\n");
+        return false;
+    }
+    float mean = (float)sum / count;
+    float variance = (float)sum_sq / count - mean * mean;
+    float rms = variance > 0 ? sqrtf(variance) : 0.0f;
+    uint32_t p2p = max_val - min_val;
+
+    printf("  Samples: %lu (%lu overruns)\n", count, overruns);
+    printf("  Mean: %.1f / 65536 = %.3f mV\n", mean, mean * ADC_VREF_MV / 65536.0f);
+    printf("  Noise: %.2f LSB16 rms, %lu LSB16 p-p\n", rms, p2p);
+    printf("  Effective bits: %.1f (noise-free %.1f)\n",
+           16.0f - log2f(rms > 0 ? rms * 3.4641f : 1.0f),     // sqrt(12)
+           16.0f - log2f(p2p > 0 ? (float)p2p : 1.0f));
+    return true;
+}
+
+void adc_restore_rate(void) {
+    adc_set_clkdiv(ADC_CLOCK_HZ / adc_config.sample_rate_hz - 1);
+}
+
+// Capture settings for the button-driven path, e.g. from autoset. A zero
+// trigger level goes back to the midpoint of each capture.
+bool adc_configure(uint32_t rate_hz, uint depth, uint16_t trigger_level, uint16_t hysteresis) {
+    if (!adc_is_idle() || rate_hz < ADC_MIN_RATE_HZ || rate_hz > ADC_MAX_RATE_HZ ||
+        depth < 2 || depth > adc_config.max_capture_depth) {
+        return false;
+    }
+    adc_config.sample_rate_hz = rate_hz;
+    adc_config.capture_depth = depth;
+    adc_config.trigger_level = trigger_level;
+    adc_config.trigger_hysteresis = hysteresis;
+    adc_restore_rate();
+    return true;
+}
+
+// Blocking one-shot capture on a temporary DMA channel, leaving the
+// button path's channel and settings alone
+bool adc_snapshot(uint16_t* buf, uint n, uint32_t rate_hz) {
+    if (!adc_is_idle() || rate_hz < ADC_MIN_RATE_HZ || rate_hz > ADC_MAX_RATE_HZ) {
+        return false;
+    }
+    int chan = res_claim_dma("adc_snapshot");
+    if (chan < 0) {
+        return false;
+    }
+    adc_fifo_drain();
+    adc_set_clkdiv(ADC_CLOCK_HZ / rate_hz - 1);
+
+    dma_channel_config cfg = dma_channel_get_default_config(chan);
+    channel_config_set_transfer_data_size(&cfg, DMA_SIZE_16);
+    channel_config_set_read_increment(&cfg, false);
+    channel_config_set_write_increment(&cfg, true);
+    channel_config_set_dreq(&cfg, DREQ_ADC);
+    dma_channel_configure(chan, &cfg, buf, &adc_hw->fifo, n, true);
+
+    adc_run(true);
+    dma_channel_wait_for_finish_blocking(chan);
+    adc_run(false);
+    adc_fifo_drain();
+
+    res_release_dma(chan);
+    adc_restore_rate();
+    for (uint i = 0; i < n; i++) {
+        buf[i] &= 0xFFF;
+    }
+    return true;
+}
+
+// True when neither capture path is using the ADC and its DMA
+bool adc_is_idle(void) {
+    return !adc_config.capturing && !stream_running && adc_config.dma_chan >= 0;
+}
+
 bool is_adc_capturing(void) {
     return adc_config.capturing;
 }
@@ -150,6 +406,34 @@ void clear_transfer_complete(void) {
     adc_config.transfer_complete = false;
 }
 
+// Level of the capture in millivolts. Samples go through the calibration
+// LUT a chunk at a time into a stack buffer; zero codes are skipped, as for
+// the raw minimum.
+static void capture_levels_mv(uint16_t* min_mv, uint16_t* max_mv, uint16_t* mean_mv) {
+    uint16_t mv[ADC_SCALE_CHUNK];
+    uint32_t sum = 0;
+    uint32_t count = 0;
+    *min_mv = 0xFFFF;
+    *max_mv = 0;
+
+    for (uint start = 0; start < adc_config.capture_depth; start += ADC_SCALE_CHUNK) {
+        const uint16_t* raw = adc_config.capture_buf + start;
+        uint n = MIN(ADC_SCALE_CHUNK, adc_config.capture_depth - start);
+        adc_scale_block(raw, mv, n, adc_cal_lut);
+        for (uint i = 0; i < n; i++) {
+            if (raw[i] == 0) continue;
+            sum += mv[i];
+            count++;
+            if (mv[i] < *min_mv) *min_mv = mv[i];
+            if (mv[i] > *max_mv) *max_mv = mv[i];
+        }
+    }
+    if (count == 0) {
+        *min_mv = 0;
+    }
+    *mean_mv = count ? sum / count : 0;
+}
+
 float analyze_current_capture(void) {
     uint16_t max_val = 0;
     uint16_t min_val = 4096;
@@ -165,40 +449,34 @@ float analyze_current_capture(void) {
     if(amplitude > 500) {
         uint16_t threshold = (max_val + min_val) / 2;
         uint16_t hysteresis = amplitude / 10;
+        if (adc_config.trigger_level) {
+            threshold = adc_config.trigger_level;
+            hysteresis = adc_config.trigger_hysteresis;
+        }
         uint16_t upper_threshold = threshold + hysteresis;
         uint16_t lower_threshold = threshold - hysteresis;
-        uint32_t first_crossing = 0;
-        uint32_t last_crossing = 0;
-        int crossing_count = 0;
-        bool above = adc_config.capture_buf[0] > threshold;
-        
-        for(int i = 1; i < adc_config.capture_depth; i++) {
-            if(adc_config.capture_buf[i] != 0) {
-                if(above && adc_config.capture_buf[i] < lower_threshold) {
-                    if(first_crossing == 0) first_crossing = i;
-                    last_crossing = i;
-                    crossing_count++;
-                    above = false;
-                }
-                else if(!above && adc_config.capture_buf[i] > upper_threshold) {
-                    if(first_crossing == 0) first_crossing = i;
-                    last_crossing = i;
-                    crossing_count++;
-                    above = true;
-                }
-            }
-        }
+        CrossingResult crossings = { .above = adc_config.capture_buf[0] > threshold };
+        hysteresis_crossings(adc_config.capture_buf, 1, adc_config.capture_depth,
+                             lower_threshold, upper_threshold, &crossings);
+        uint32_t first_crossing = crossings.first;
+        uint32_t last_crossing = crossings.last;
+        uint32_t crossing_count = crossings.count;
+        uint16_t min_mv, max_mv, mean_mv;
+        capture_levels_mv(&min_mv, &max_mv, &mean_mv);
+        printf("  Amplitude: %u mV (%u-%u mV, mean %u mV)\n", max_mv - min_mv, min_mv, max_mv, mean_mv);
         
         if(crossing_count >= 4) {
-            float sample_period = 1.0f / 10000.0f;  // 10kHz sampling
-            float measurement_time = (last_crossing - first_crossing) * sample_period;
-            float cycles = (float)(crossing_count) / 2.0f;
-            frequency = cycles / measurement_time;
+            // (crossings / 2) cycles over (last - first) samples, in millihertz
+            // so the whole range up to Nyquist fits
+            uint32_t freq_mhz = (uint32_t)((uint64_t)crossing_count * adc_config.sample_rate_hz * 500 /
+                                           (last_crossing - first_crossing));
+            frequency = freq_mhz / 1000.0f;
+            uint32_t max_hz = adc_config.sample_rate_hz / 2;
             
-            if(frequency > 1.0f && frequency < 5000.0f) {
+            if(freq_mhz > 1000 && freq_mhz < max_hz * 1000) {
                 adc_config.last_frequency = frequency;
             } else {
-                printf("  Frequency out of range (1-5000 Hz)\n");
+                printf("  Frequency out of range (1-%lu Hz)\n", max_hz);
             }
         } else {
             printf("  Not enough signal transitions for frequency measurement\n");
@@ -216,9 +494,8 @@ float analyze_current_capture(void) {
 }
 
 void adc_cleanup(void) {
-    if (adc_config.dma_chan >= 0) {
-        dma_channel_unclaim(adc_config.dma_chan);
-    }
+    dma_service_release(adc_config.dma_chan);
+    adc_config.dma_chan = -1;
     if (adc_config.capture_buf) {
         free(adc_config.capture_buf);
         adc_config.capture_buf = NULL;
@@ -7,6 +7,16 @@
 #include <stdbool.h>
 
 #define DEFAULT_CAPTURE_DEPTH 10000
+#define ADC_SAMPLE_RATE_HZ 10000
+#define ADC_CLOCK_HZ 48000000
+#define ADC_MIN_RATE_HZ 1000
+#define ADC_MAX_RATE_HZ 500000
+#define ADC_HIRES_INPUT_RATE_HZ 250000
+#define ADC_STREAM_HALF_SAMPLES 512  // Per DMA half; a multiple of the largest hires ratio
+#define ADC_HIRES_OUT_SIZE 1024
+#define ADC_CAL_OFFSET_COUNTS 0       // Code read with the input grounded
+#define ADC_CAL_GAIN_Q16 0x10000      // Measured / ideal full scale, Q16.16
+#define ADC_SCALE_CHUNK 256           // Samples per pass through the calibration LUT
 #define ADC_BUTTON_PIN 21
 #define DEFAULT_ANALOG_PIN 26
 
@@ -14,11 +24,23 @@
 void adc_analyzer_init(void);
 void adc_cleanup(void);
 bool is_adc_capturing(void);
+bool adc_is_idle(void);
+void adc_restore_rate(void);
+bool adc_configure(uint32_t rate_hz, uint depth, uint16_t trigger_level, uint16_t hysteresis);
+bool adc_snapshot(uint16_t* buf, uint n, uint32_t rate_hz);
 void adc_start_capture(void);
 void adc_stop_capture(void);
 float get_last_frequency(void);
 bool is_transfer_complete(void);
 void clear_transfer_complete(void);
 float analyze_current_capture(void);
+typedef void (*adc_block_handler_t)(const uint16_t* block, uint n, void* ctx);
+
+bool adc_start_stream(uint32_t rate_hz, adc_block_handler_t handler, void* ctx);
+void adc_stop_stream(void);
+bool adc_start_hires(uint ratio);
+void adc_stop_hires(void);
+uint adc_hires_read(uint16_t* out, uint max);
+bool adc_hires_measure(uint ratio, uint32_t duration_ms);
 
 #endif // ADC_H
\ No newline at end of file
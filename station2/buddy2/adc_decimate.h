@@ -0,0 +1,36 @@
+#ifndef ADC_DECIMATE_H
+#define ADC_DECIMATE_H
+
+#include "pico/stdlib.h"
+#include <stdbool.h>
+
+// Oversample-and-decimate stage for the ADC. A third-order CIC decimates by
+// ratio / 2, then a 31-tap compensating FIR flattens the CIC droop and
+// decimates by the last factor of 2. Output is 16-bit (ADC code << 4), and
+// each doubling of the ratio buys about half a bit over the 12-bit input:
+// roughly 14 bits at 16x up to 15.5 bits at 128x.
+//
+// The CIC runs in wrapping uint32 arithmetic; 12 + 3 * log2(64) = 30 bits
+// of growth at the largest ratio still fits.
+
+#define ADC_DECIM_MIN_RATIO 16
+#define ADC_DECIM_MAX_RATIO 128
+#define ADC_DECIM_CIC_ORDER 3
+#define ADC_DECIM_FIR_TAPS 31
+
+typedef struct {
+    uint32_t integ[ADC_DECIM_CIC_ORDER];
+    uint32_t comb[ADC_DECIM_CIC_ORDER];
+    uint cic_ratio;
+    uint cic_shift;             // Brings the CIC gain down to 16-bit output
+    uint cic_phase;
+    int32_t fir_hist[2 * ADC_DECIM_FIR_TAPS];   // Doubled so taps read contiguously
+    uint fir_pos;
+    bool fir_skip;              // Decimate-by-2 phase
+} AdcDecimator;
+
+// Function declarations
+bool adc_decimator_init(AdcDecimator* d, uint ratio);
+uint adc_decimator_process(AdcDecimator* d, const uint16_t* in, uint n, uint16_t* out);
+
+#endif // ADC_DECIMATE_H
@@ -0,0 +1,193 @@
+#include "autoset.h"
+#include "adc.h"
+#include "pwm.h"
+#include "buddy3/protocol_analyzer.h"
+#include "interp_kernels.h"
+
+typedef struct {
+    uint16_t min;
+    uint16_t max;
+    CrossingResult crossings;
+} Shape;
+
+static uint16_t snapshot[AUTOSET_SNAPSHOT_SAMPLES];
+
+static void measure_shape(const uint16_t* buf, uint n, Shape* s) {
+    s->min = 0xFFFF;
+    s->max = 0;
+    for (uint i = 0; i < n; i++) {
+        if (buf[i] < s->min) s->min = buf[i];
+        if (buf[i] > s->max) s->max = buf[i];
+    }
+    uint16_t mid = (s->min + s->max) / 2;
+    uint16_t hysteresis = (s->max - s->min) / 10;
+    s->crossings = (CrossingResult){ .above = buf[0] > mid };
+    hysteresis_crossings(buf, 1, n, mid - hysteresis, mid + hysteresis, &s->crossings);
+}
+
+// Half a cycle between neighbouring crossings; 0 if under two cycles fit
+static uint32_t shape_freq(const Shape* s, uint32_t rate_hz) {
+    const CrossingResult* c = &s->crossings;
+    if (c->count < 4 || c->last <= c->first) {
+        return 0;
+    }
+    return (c->count - 1) * (rate_hz / 2) / (c->last - c->first);
+}
+
+static uint32_t clamp_rate(uint32_t hz) {
+    if (hz < ADC_MIN_RATE_HZ) return ADC_MIN_RATE_HZ;
+    if (hz > ADC_MAX_RATE_HZ) return ADC_MAX_RATE_HZ;
+    return hz;
+}
+
+static void autoset_analog(AutosetResult* r, bool* too_fast) {
+    uint32_t rate = ADC_MAX_RATE_HZ;
+    uint32_t prev_freq = 0;
+    Shape shape;
+    *too_fast = false;
+
+    for (r->iterations = 1; r->iterations <= AUTOSET_MAX_ITERATIONS; r->iterations++) {
+        if (!adc_snapshot(snapshot, AUTOSET_SNAPSHOT_SAMPLES, rate)) {
+            printf("Autoset: ADC is busy\n");
+            return;
+        }
+        measure_shape(snapshot, AUTOSET_SNAPSHOT_SAMPLES, &shape);
+        r->min_code = shape.min;
+        r->max_code = shape.max;
+        if (shape.max - shape.min < AUTOSET_MIN_AMPLITUDE) {
+            return;                             // Flat input
+        }
+        r->analog_found = true;
+
+        uint32_t freq = shape_freq(&shape, rate);
+        if (freq == 0) {
+            if (rate == ADC_MIN_RATE_HZ) break; // DC or slower than we can wait for
+            rate = clamp_rate(rate / 10);
+            continue;
+        }
+        if (rate == ADC_MAX_RATE_HZ && rate / freq < 4) {
+            *too_fast = true;
+        }
+
+        uint32_t target = clamp_rate(freq * AUTOSET_SAMPLES_PER_PERIOD);
+        bool agrees = prev_freq && u32_abs_diff(freq, prev_freq) * 10 <= prev_freq;
+        r->analog_freq_hz = freq;
+        if (agrees || target == rate || *too_fast) {
+            break;
+        }
+        prev_freq = freq;
+        rate = target;
+    }
+    if (r->iterations > AUTOSET_MAX_ITERATIONS) {
+        r->iterations = AUTOSET_MAX_ITERATIONS;
+    }
+
+    r->sample_rate_hz = rate;
+    uint32_t depth = r->analog_freq_hz ? rate / r->analog_freq_hz * AUTOSET_TARGET_PERIODS
+                                       : DEFAULT_CAPTURE_DEPTH;
+    r->depth = MAX(AUTOSET_MIN_DEPTH, MIN(depth, DEFAULT_CAPTURE_DEPTH));
+    r->trigger_level = (r->min_code + r->max_code) / 2;
+    r->trigger_hysteresis = (r->max_code - r->min_code) / 10;
+}
+
+// Polls the PWM and UART inputs together and times their edges
+static void autoset_digital(AutosetResult* r) {
+    const uint32_t pwm_bit = 1u << PWM_PIN;
+    const uint32_t uart_bit = 1u << UART_RX_PIN;
+    uint32_t prev = gpio_get_all();
+    uint32_t first_rise = 0, last_rise = 0, rises = 0;
+    uint32_t last_uart_edge = 0;
+    r->uart_min_pulse_us = UINT32_MAX;
+
+    uint32_t start = time_us_32();
+    uint32_t now = start;
+    while (now - start < AUTOSET_DIGITAL_WINDOW_MS * 1000) {
+        uint32_t cur = gpio_get_all();
+        uint32_t changed = (cur ^ prev) & (pwm_bit | uart_bit);
+        now = time_us_32();
+        if (changed & pwm_bit) {
+            r->pwm_edges++;
+            if (cur & pwm_bit) {
+                if (rises++ == 0) first_rise = now;
+                last_rise = now;
+            }
+        }
+        if (changed & uart_bit) {
+            if (r->uart_edges++ > 0 && now - last_uart_edge < r->uart_min_pulse_us) {
+                r->uart_min_pulse_us = now - last_uart_edge;
+            }
+            last_uart_edge = now;
+        }
+        prev = cur;
+    }
+
+    if (rises >= 2 && last_rise > first_rise) {
+        r->pwm_freq_hz = (rises - 1) * 1000000u / (last_rise - first_rise);
+    }
+    if (r->uart_edges >= 2 && r->uart_min_pulse_us > 0 && r->uart_min_pulse_us != UINT32_MAX) {
+        r->uart_baud_estimate = 1000000u / r->uart_min_pulse_us;
+    } else {
+        r->uart_min_pulse_us = 0;
+    }
+}
+
+const char* autoset_analyzer_name(AutosetAnalyzer analyzer) {
+    switch (analyzer) {
+        case AUTOSET_ADC:  return "ADC (button GP21)";
+        case AUTOSET_PWM:  return "PWM (button GP20)";
+        case AUTOSET_UART: return "Protocol / UART (button GP22)";
+        case AUTOSET_ETS:  return "Equivalent-time sampling ('t')";
+        default:           return "none";
+    }
+}
+
+bool autoset_run(AutosetResult* r) {
+    *r = (AutosetResult){0};
+    uint32_t start = time_us_32();
+    bool too_fast;
+
+    printf("Autoset...\n");
+    autoset_digital(r);
+    autoset_analog(r, &too_fast);
+
+    // Digital traffic first: a logic signal wired to GP26 as well would
+    // otherwise read as a square wave on the ADC
+    if (r->uart_edges >= 10) {
+        r->analyzer = AUTOSET_UART;
+    } else if (r->pwm_edges >= 4) {
+        r->analyzer = AUTOSET_PWM;
+    } else if (too_fast) {
+        r->analyzer = AUTOSET_ETS;
+    } else if (r->analog_found) {
+        r->analyzer = AUTOSET_ADC;
+    }
+
+    bool applied = true;
+    if (r->analog_found && r->analog_freq_hz && !too_fast) {
+        applied = adc_configure(r->sample_rate_hz, r->depth, r->trigger_level, r->trigger_hysteresis);
+    }
+    r->elapsed_ms = (time_us_32() - start) / 1000;
+
+    if (r->analog_found) {
+        printf("  Analog: %lu-%lu mV, %lu Hz after %u captures\n",
+               (uint32_t)r->min_code * ADC_VREF_MV / 4096,
+               (uint32_t)r->max_code * ADC_VREF_MV / 4096, r->analog_freq_hz, r->iterations);
+        printf("    -> %lu S/s, %u samples, trigger %u +/- %u\n",
+               r->sample_rate_hz, r->depth, r->trigger_level, r->trigger_hysteresis);
+    } else {
+        printf("  Analog: no signal\n");
+    }
+    if (r->pwm_edges) {
+        printf("  PWM GP%d: %lu edges, %lu Hz\n", PWM_PIN, r->pwm_edges, r->pwm_freq_hz);
+    }
+    if (r->uart_edges) {
+        printf("  UART GP%d: %lu edges, shortest %lu us (~%lu baud)\n", UART_RX_PIN,
+               r->uart_edges, r->uart_min_pulse_us, r->uart_baud_estimate);
+    }
+    printf("  Use: %s (settled in %lu ms)\n", autoset_analyzer_name(r->analyzer), r->elapsed_ms);
+    if (!applied) {
+        printf("Autoset: ADC settings not applied (capture running or depth too large)\n");
+        return false;
+    }
+    return r->analyzer != AUTOSET_NONE;
+}
@@ -0,0 +1,59 @@
+#ifndef AUTOSET_H
+#define AUTOSET_H
+
+#include "pico/stdlib.h"
+#include <stdio.h>
+#include <stdbool.h>
+
+// Autoset: short coarse captures on the ADC and the digital inputs to find
+// out what is connected. It then picks the ADC sample rate, depth and trigger
+// level and the analyzer to use. The ADC settings are applied to the
+// button-driven capture.
+//
+// The analog path starts at the top rate and drops 10x until at least two
+// cycles fit. It then re-captures at ~AUTOSET_SAMPLES_PER_PERIOD samples
+// per cycle until two estimates agree.
+
+#define AUTOSET_SNAPSHOT_SAMPLES 512
+#define AUTOSET_MAX_ITERATIONS 5
+#define AUTOSET_SAMPLES_PER_PERIOD 20
+#define AUTOSET_TARGET_PERIODS 10       // Cycles per capture at the chosen depth
+#define AUTOSET_MIN_AMPLITUDE 100       // Codes; below this the input is idle
+#define AUTOSET_DIGITAL_WINDOW_MS 20
+#define AUTOSET_MIN_DEPTH 256
+
+typedef enum {
+    AUTOSET_NONE = 0,
+    AUTOSET_ADC,
+    AUTOSET_PWM,
+    AUTOSET_UART,
+    AUTOSET_ETS                         // Repetitive but too fast for the ADC
+} AutosetAnalyzer;
+
+typedef struct {
+    // Analog input
+    bool analog_found;
+    uint16_t min_code;
+    uint16_t max_code;
+    uint32_t analog_freq_hz;
+    uint32_t sample_rate_hz;
+    uint depth;
+    uint16_t trigger_level;
+    uint16_t trigger_hysteresis;
+    uint iterations;
+    // Digital inputs
+    uint32_t pwm_edges;
+    uint32_t pwm_freq_hz;
+    uint32_t uart_edges;
+    uint32_t uart_min_pulse_us;
+    uint32_t uart_baud_estimate;
+    // Outcome
+    AutosetAnalyzer analyzer;
+    uint32_t elapsed_ms;
+} AutosetResult;
+
+// Function declarations
+bool autoset_run(AutosetResult* result);
+const char* autoset_analyzer_name(AutosetAnalyzer analyzer);
+
+#endif // AUTOSET_H
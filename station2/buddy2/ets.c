@@ -0,0 +1,204 @@
+#include "ets.h"
+#include "ets.pio.h"
+#include "adc.h"
+#include "resources.h"
+#include "interp_kernels.h"
+#include "buddy1/sd_card.h"
+#include "hardware/adc.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include <stdlib.h>
+
+typedef struct {
+    uint32_t magic;                 // "ETS1"
+    uint32_t steps;
+    uint32_t points;
+    uint32_t sample_period_ps;
+} ETSFileHeader;
+
+typedef struct {
+    int sm;
+    uint offset;
+    int start_dma;
+    int burst_dma;
+} ETSHardware;
+
+static ETSHardware ets = { .sm = -1, .start_dma = -1, .burst_dma = -1 };
+static uint16_t burst_buf[ETS_BURST_SAMPLES] __attribute__((aligned(4)));
+
+static void ets_release(void) {
+    if (ets.sm >= 0) {
+        pio_sm_set_enabled(ETS_PIO, ets.sm, false);
+        pio_remove_program(ETS_PIO, &ets_trigger_program, ets.offset);
+        res_release_pio_sm(ETS_PIO, ets.sm);
+        ets.sm = -1;
+    }
+    if (ets.start_dma >= 0) dma_channel_abort(ets.start_dma);
+    if (ets.burst_dma >= 0) dma_channel_abort(ets.burst_dma);
+    res_release_dma(ets.start_dma);
+    res_release_dma(ets.burst_dma);
+    ets.start_dma = ets.burst_dma = -1;
+    res_release_pins("ets", 1u << ETS_TRIGGER_PIN);
+}
+
+static bool ets_setup(void) {
+    if (!pio_can_add_program(ETS_PIO, &ets_trigger_program)) {
+        printf("Error: No PIO space for ETS\n");
+        return false;
+    }
+    if (!res_claim_pins("ets", 1u << ETS_TRIGGER_PIN, RES_PIN_SHARED_INPUT)) {
+        return false;
+    }
+    ets.sm = res_claim_pio_sm("ets", ETS_PIO);
+    ets.start_dma = res_claim_dma("ets");
+    ets.burst_dma = res_claim_dma("ets");
+    if (ets.sm < 0 || ets.start_dma < 0 || ets.burst_dma < 0) {
+        int sm = ets.sm;
+        ets.sm = -1;                // Program not loaded yet
+        if (sm >= 0) res_release_pio_sm(ETS_PIO, sm);
+        ets_release();
+        return false;
+    }
+    ets.offset = pio_add_program(ETS_PIO, &ets_trigger_program);
+    ets_trigger_program_init(ETS_PIO, ets.sm, ets.offset, ETS_TRIGGER_PIN);
+
+    // Free-running conversions on the input adc.c selected
+    uint32_t start_cs = (adc_hw->cs & (ADC_CS_AINSEL_BITS | ADC_CS_TS_EN_BITS)) |
+                        ADC_CS_EN_BITS | ADC_CS_START_MANY_BITS;
+    pio_sm_put_blocking(ETS_PIO, ets.sm, start_cs);
+
+    dma_channel_config cfg = dma_channel_get_default_config(ets.start_dma);
+    channel_config_set_transfer_data_size(&cfg, DMA_SIZE_32);
+    channel_config_set_read_increment(&cfg, false);
+    channel_config_set_write_increment(&cfg, false);
+    channel_config_set_dreq(&cfg, pio_get_dreq(ETS_PIO, ets.sm, false));
+    dma_channel_configure(ets.start_dma, &cfg, &adc_hw->cs, &ETS_PIO->rxf[ets.sm],
+                          ETS_MAX_STEPS, true);
+    return true;
+}
+
+static void adc_halt(void) {
+    hw_clear_bits(&adc_hw->cs, ADC_CS_START_MANY_BITS);
+    while (!(adc_hw->cs & ADC_CS_READY_BITS)) {
+        tight_loop_contents();
+    }
+    adc_fifo_drain();
+}
+
+// One trigger: arm the burst, hand the PIO its delay, wait for the samples
+static bool acquire(uint32_t delay_cycles) {
+    dma_channel_config cfg = dma_channel_get_default_config(ets.burst_dma);
+    channel_config_set_transfer_data_size(&cfg, DMA_SIZE_16);
+    channel_config_set_read_increment(&cfg, false);
+    channel_config_set_write_increment(&cfg, true);
+    channel_config_set_dreq(&cfg, DREQ_ADC);
+    dma_channel_configure(ets.burst_dma, &cfg, burst_buf, &adc_hw->fifo,
+                          ETS_BURST_SAMPLES, true);
+
+    pio_sm_put_blocking(ETS_PIO, ets.sm, delay_cycles);
+
+    absolute_time_t timeout = make_timeout_time_ms(ETS_TRIGGER_TIMEOUT_MS);
+    while (dma_channel_is_busy(ets.burst_dma)) {
+        if (time_reached(timeout)) {
+            dma_channel_abort(ets.burst_dma);
+            return false;
+        }
+        tight_loop_contents();
+    }
+    adc_halt();
+    return true;
+}
+
+static bool save_waveform(const uint16_t* wave, const ETSResult* r) {
+    if (ensureSDMounted() != FR_OK) {
+        return false;
+    }
+    FIL file;
+    if (f_open(&file, ETS_FILE, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) {
+        printf("ETS: f_open failed\n");
+        return false;
+    }
+    ETSFileHeader header = {
+        .magic = 0x31535445,
+        .steps = r->steps,
+        .points = r->points,
+        .sample_period_ps = r->sample_period_ps
+    };
+    UINT written;
+    bool ok = f_write(&file, &header, sizeof(header), &written) == FR_OK && written == sizeof(header) &&
+              f_write(&file, wave, r->points * sizeof(uint16_t), &written) == FR_OK &&
+              written == r->points * sizeof(uint16_t);
+    f_close(&file);
+    if (!ok) printf("ETS: f_write failed\n");
+    return ok;
+}
+
+bool ets_capture(uint steps, ETSResult* result) {
+    if (steps < 1 || steps > ETS_MAX_STEPS) {
+        printf("Error: ETS steps must be 1-%d\n", ETS_MAX_STEPS);
+        return false;
+    }
+    if (!adc_is_idle()) {
+        printf("Error: ADC is busy\n");
+        return false;
+    }
+    uint32_t points = steps * ETS_BURST_SAMPLES;
+    uint16_t* wave = malloc(points * sizeof(uint16_t));
+    if (!wave) {
+        printf("Error: Out of memory for %lu ETS points\n", points);
+        return false;
+    }
+    if (!ets_setup()) {
+        free(wave);
+        return false;
+    }
+
+    adc_halt();
+    adc_set_clkdiv(0);              // 96 ADC clocks: 2 us per conversion
+
+    uint32_t cycles_per_sample = clock_get_hz(clk_sys) / ETS_ADC_RATE_HZ;
+    uint32_t start_us = time_us_32();
+    bool ok = true;
+
+    for (uint j = 0; j < steps; j++) {
+        uint32_t delay = (j * cycles_per_sample + steps / 2) / steps;
+        if (!acquire(delay)) {
+            printf("ETS: no trigger on GP%d\n", ETS_TRIGGER_PIN);
+            ok = false;
+            break;
+        }
+        for (uint k = 0; k < ETS_BURST_SAMPLES; k++) {
+            wave[k * steps + j] = burst_buf[k] & 0xFFF;
+        }
+    }
+
+    result->acquisition_us = time_us_32() - start_us;
+    adc_halt();
+    adc_restore_rate();
+    ets_release();
+
+    if (ok) {
+        result->steps = steps;
+        result->points = points;
+        result->effective_rate_hz = steps * ETS_ADC_RATE_HZ;
+        result->sample_period_ps = 2000000 / steps;
+        result->min_code = 0xFFFF;
+        result->max_code = 0;
+        for (uint32_t i = 0; i < points; i++) {
+            if (wave[i] < result->min_code) result->min_code = wave[i];
+            if (wave[i] > result->max_code) result->max_code = wave[i];
+        }
+
+        printf("ETS: %lu points at %.2f MS/s effective (%lu ps), %lu us window\n",
+               points, result->effective_rate_hz / 1e6f, result->sample_period_ps,
+               (unsigned long)(ETS_BURST_SAMPLES * 1000000 / ETS_ADC_RATE_HZ));
+        printf("  Acquisition: %u triggers in %lu us\n", steps, result->acquisition_us);
+        printf("  Range: %lu - %lu mV\n",
+               (uint32_t)result->min_code * ADC_VREF_MV / 4096,
+               (uint32_t)result->max_code * ADC_VREF_MV / 4096);
+        ok = save_waveform(wave, result);
+        if (ok) printf("  Saved to %s\n", ETS_FILE);
+    }
+    free(wave);
+    return ok;
+}
@@ -0,0 +1,38 @@
+#ifndef ETS_H
+#define ETS_H
+
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include <stdio.h>
+#include <stdbool.h>
+
+// Equivalent-time sampling for repetitive signals on the ADC input (GP26).
+// Each acquisition waits for a rising edge on the trigger pin (the PWM
+// input, GP7). The ADC then runs a short 500 kS/s burst, started a little
+// later every time. Interleaving the bursts gives one waveform at
+// steps x 500 kS/s. The ADC start is synchronised to its 48 MHz clock, so
+// steps finer than ~21 ns (96 per sample) only add jitter.
+
+#define ETS_TRIGGER_PIN 7
+#define ETS_PIO pio1
+#define ETS_ADC_RATE_HZ 500000
+#define ETS_BURST_SAMPLES 64            // 128 us window per trigger
+#define ETS_DEFAULT_STEPS 24
+#define ETS_MAX_STEPS 96
+#define ETS_TRIGGER_TIMEOUT_MS 200
+#define ETS_FILE "ets.bin"
+
+typedef struct {
+    uint steps;
+    uint32_t points;
+    uint32_t effective_rate_hz;
+    uint32_t sample_period_ps;
+    uint32_t acquisition_us;            // Wall time for all the triggers
+    uint16_t min_code;
+    uint16_t max_code;
+} ETSResult;
+
+// Function declarations
+bool ets_capture(uint steps, ETSResult* result);
+
+#endif // ETS_H
@@ -0,0 +1,268 @@
+#include "goertzel.h"
+#include "adc.h"
+#include "pdm.h"
+#include "cycles.h"
+#include "hardware/clocks.h"
+#include "hardware/sync.h"
+#include <math.h>
+#include <string.h>
+
+static const uint16_t DTMF_FREQS[8] = { 697, 770, 852, 941, 1209, 1336, 1477, 1633 };
+static const char DTMF_KEYS[4][4] = {
+    { '1', '2', '3', 'A' },
+    { '4', '5', '6', 'B' },
+    { '7', '8', '9', 'C' },
+    { '*', '0', '#', 'D' }
+};
+
+static GoertzelBank run_bank;
+static volatile uint64_t run_cycles = 0;
+
+static void push_event(GoertzelBank* bank, GoertzelEventType type, char digit,
+                       const GoertzelTone* tone) {
+    uint next = (bank->event_head + 1) % GOERTZEL_EVENT_QUEUE;
+    if (next == bank->event_tail) {
+        bank->dropped_events++;
+        return;
+    }
+    GoertzelEvent* e = &bank->events[bank->event_head];
+    e->type = type;
+    e->timestamp_ms = (uint32_t)(bank->samples * 1000 / bank->rate_hz);
+    e->digit = digit;
+    e->freq_hz = tone ? tone->freq_hz : 0;
+    e->ratio = tone ? tone->ratio : 0;
+    bank->event_head = next;
+}
+
+bool goertzel_init(GoertzelBank* bank, uint32_t rate_hz, bool dtmf) {
+    if (rate_hz < GOERTZEL_MIN_RATE_HZ || rate_hz > GOERTZEL_MAX_RATE_HZ) {
+        return false;
+    }
+    memset(bank, 0, sizeof(*bank));
+    bank->rate_hz = rate_hz;
+    bank->hop = rate_hz / (GOERTZEL_BIN_HZ * GOERTZEL_PHASES);
+    bank->block_len = bank->hop * GOERTZEL_PHASES;
+    bank->dc = 2048;
+
+    // Keep block_len * (2048 >> shift) under 2^17
+    while ((bank->block_len * (2048u >> bank->input_shift)) >= (1u << 17)) {
+        bank->input_shift++;
+    }
+
+    bank->dtmf = dtmf;
+    if (dtmf) {
+        for (uint i = 0; i < 8; i++) {
+            goertzel_add_tone(bank, DTMF_FREQS[i]);
+        }
+    }
+    return true;
+}
+
+bool goertzel_add_tone(GoertzelBank* bank, uint16_t freq_hz) {
+    if (bank->tone_count >= GOERTZEL_MAX_TONES || freq_hz == 0 || freq_hz >= bank->rate_hz / 2) {
+        return false;
+    }
+    GoertzelTone* t = &bank->tones[bank->tone_count++];
+    memset(t, 0, sizeof(*t));
+    t->freq_hz = freq_hz;
+
+    float c = 2.0f * cosf(2.0f * (float)M_PI * freq_hz / bank->rate_hz);
+    t->upper = c < 0;
+    t->delta = (int32_t)lroundf((2.0f - fabsf(c)) * (1 << 14));
+    return true;
+}
+
+// |X|^2 as a share of block energy, Q16. A pure tone on the bin gives ~1.0.
+static uq16_t tone_ratio(const GoertzelTone* t, uint phase, uint block_len, uint64_t energy) {
+    int64_t s1 = t->s1[phase], s2 = t->s2[phase];
+    int64_t coeff = t->upper ? -(2 * (1 << 14) - t->delta) : (2 * (1 << 14) - t->delta);
+    int64_t power = s1 * s1 + s2 * s2 - ((coeff * s1) >> 14) * s2;
+    if (power <= 0 || energy == 0) {
+        return 0;
+    }
+    uint64_t ratio = ((uint64_t)power << 17) / ((uint64_t)block_len * energy);
+    return ratio > UQ16_MAX ? UQ16_MAX : (uq16_t)ratio;
+}
+
+static char decode_dtmf(const GoertzelBank* bank) {
+    const GoertzelTone* t = bank->tones;
+    uint lo = 0, hi = 4;
+    for (uint i = 1; i < 4; i++) {
+        if (t[i].ratio > t[lo].ratio) lo = i;
+        if (t[4 + i].ratio > t[hi].ratio) hi = 4 + i;
+    }
+    // A key shares the energy between two tones
+    if (t[lo].ratio < GOERTZEL_TONE_RATIO || t[hi].ratio < GOERTZEL_TONE_RATIO) {
+        return 0;
+    }
+    // and between them most of the block, which speech and noise don't
+    if ((uint64_t)t[lo].ratio + t[hi].ratio < GOERTZEL_DTMF_RATIO) {
+        return 0;
+    }
+    // Twist within ~8 dB, and each winner well clear of its group
+    if (t[lo].ratio > t[hi].ratio * 6 || t[hi].ratio > t[lo].ratio * 6) {
+        return 0;
+    }
+    for (uint i = 0; i < 4; i++) {
+        if (i != lo && t[i].ratio * 4 > t[lo].ratio) return 0;
+        if (4 + i != hi && t[4 + i].ratio * 4 > t[hi].ratio) return 0;
+    }
+    return DTMF_KEYS[lo][hi - 4];
+}
+
+static void end_block(GoertzelBank* bank, uint phase) {
+    uint n = bank->block_len;
+    uint shift = bank->input_shift;
+    uint64_t raw_energy = bank->energy[phase] << (2 * shift);
+    bool loud = raw_energy >= (uint64_t)n * GOERTZEL_MIN_RMS * GOERTZEL_MIN_RMS;
+
+    for (uint i = 0; i < bank->tone_count; i++) {
+        GoertzelTone* t = &bank->tones[i];
+        t->ratio = loud ? tone_ratio(t, phase, n, bank->energy[phase]) : 0;
+    }
+
+    if (bank->dtmf) {
+        // One block is enough; a block without a digit re-arms for the next key
+        char digit = loud ? decode_dtmf(bank) : 0;
+        if (digit && digit != bank->last_digit) {
+            push_event(bank, GOERTZEL_EVENT_DIGIT, digit, NULL);
+        }
+        bank->last_digit = digit;
+    }
+
+    for (uint i = bank->dtmf ? 8 : 0; i < bank->tone_count; i++) {
+        GoertzelTone* t = &bank->tones[i];
+        bool present = t->ratio >= GOERTZEL_TONE_RATIO;
+        if (present != t->present) {
+            t->present = present;
+            push_event(bank, present ? GOERTZEL_EVENT_TONE_ON : GOERTZEL_EVENT_TONE_OFF, 0, t);
+        }
+    }
+
+    bank->blocks++;
+}
+
+// Each hop completes the block that started two hops ago. The first hop
+// only half fills the block ending there, so that one is thrown away.
+static void end_hop(GoertzelBank* bank) {
+    uint phase = bank->phase;
+    if (bank->hops++ > 0) {
+        end_block(bank, phase);
+    }
+    for (uint i = 0; i < bank->tone_count; i++) {
+        bank->tones[i].s1[phase] = bank->tones[i].s2[phase] = 0;
+    }
+    bank->energy[phase] = 0;
+    bank->phase = (phase + 1) % GOERTZEL_PHASES;
+
+    bank->dc = bank->sum / (int32_t)bank->hop;
+    bank->sum = 0;
+    bank->count = 0;
+}
+
+void __not_in_flash_func(goertzel_process)(GoertzelBank* bank, const uint16_t* samples, uint n) {
+    for (uint i = 0; i < n; i++) {
+        int32_t raw = samples[i] & 0xFFF;
+        int32_t x = (raw - bank->dc) >> bank->input_shift;
+        uint32_t x2 = (uint32_t)(x * x);
+        bank->sum += raw;
+        for (uint p = 0; p < GOERTZEL_PHASES; p++) {
+            bank->energy[p] += x2;
+        }
+
+        for (uint k = 0; k < bank->tone_count; k++) {
+            GoertzelTone* t = &bank->tones[k];
+            for (uint p = 0; p < GOERTZEL_PHASES; p++) {
+                int32_t s1 = t->s1[p];
+                int32_t term = (t->delta * s1) >> 14;
+                int32_t s = t->upper ? x - 2 * s1 - t->s2[p] + term
+                                     : x + 2 * s1 - t->s2[p] - term;
+                t->s2[p] = s1;
+                t->s1[p] = s;
+            }
+        }
+
+        bank->samples++;
+        if (++bank->count == bank->hop) {
+            end_hop(bank);
+        }
+    }
+}
+
+bool goertzel_next_event(GoertzelBank* bank, GoertzelEvent* event) {
+    if (bank->event_tail == bank->event_head) {
+        return false;
+    }
+    *event = bank->events[bank->event_tail];
+    bank->event_tail = (bank->event_tail + 1) % GOERTZEL_EVENT_QUEUE;
+    return true;
+}
+
+static void stream_block(const uint16_t* block, uint n, void* ctx) {
+    uint32_t start = cycles_now();
+    goertzel_process((GoertzelBank*)ctx, block, n);
+    run_cycles += cycles_since(start);
+}
+
+// PCM from the mic as 12-bit offset codes, so both sources share one path
+static void pdm_block(const int16_t* pcm, uint n, void* ctx) {
+    uint16_t codes[64];
+    uint32_t start = cycles_now();
+    while (n) {
+        uint k = n < count_of(codes) ? n : count_of(codes);
+        for (uint i = 0; i < k; i++) {
+            codes[i] = (uint16_t)((pcm[i] >> 4) + 2048);
+        }
+        goertzel_process((GoertzelBank*)ctx, codes, k);
+        pcm += k;
+        n -= k;
+    }
+    run_cycles += cycles_since(start);
+}
+
+// DTMF plus any extra tones until a key is pressed
+bool goertzel_run(uint32_t rate_hz, GoertzelSource source, const uint16_t* extra_tones, uint extra_count) {
+    if (!goertzel_init(&run_bank, rate_hz, true)) {
+        printf("Error: Tone detector runs at %d-%d S/s\n", GOERTZEL_MIN_RATE_HZ, GOERTZEL_MAX_RATE_HZ);
+        return false;
+    }
+    for (uint i = 0; i < extra_count; i++) {
+        goertzel_add_tone(&run_bank, extra_tones[i]);
+    }
+    cycles_init();
+    run_cycles = 0;
+    bool started = source == GOERTZEL_SRC_PDM ? pdm_start(rate_hz, pdm_block, &run_bank)
+                                              : adc_start_stream(rate_hz, stream_block, &run_bank);
+    if (!started) {
+        printf("Error: %s is busy\n", source == GOERTZEL_SRC_PDM ? "PDM mic" : "ADC");
+        return false;
+    }
+    printf("Tone detector: %lu S/s, %u-sample blocks every %u (%u Hz bins), %u tones. Any key stops.\n",
+           rate_hz, run_bank.block_len, run_bank.hop, GOERTZEL_BIN_HZ, run_bank.tone_count);
+
+    uint32_t start_us = time_us_32();
+    GoertzelEvent e;
+    while (getchar_timeout_us(0) == PICO_ERROR_TIMEOUT) {
+        while (goertzel_next_event(&run_bank, &e)) {
+            if (e.type == GOERTZEL_EVENT_DIGIT) {
+                printf("  %8lu ms  DTMF %c\n", e.timestamp_ms, e.digit);
+            } else {
+                printf("  %8lu ms  %u Hz %s (%.0f%%)\n", e.timestamp_ms, e.freq_hz,
+                       e.type == GOERTZEL_EVENT_TONE_ON ? "on" : "off",
+                       uq16_to_float(e.ratio) * 100.0f);
+            }
+        }
+        sleep_ms(10);
+    }
+    if (source == GOERTZEL_SRC_PDM) {
+        pdm_stop();
+    } else {
+        adc_stop_stream();
+    }
+
+    float elapsed_us = (float)(time_us_32() - start_us);
+    float cpu = (float)run_cycles / (clock_get_hz(clk_sys) / 1e6f) / elapsed_us * 100.0f;
+    printf("Tone detector stopped: %lu blocks, %lu dropped events, %.2f%% CPU\n",
+           run_bank.blocks, run_bank.dropped_events, cpu);
+    return true;
+}
@@ -0,0 +1,92 @@
+#ifndef GOERTZEL_H
+#define GOERTZEL_H
+
+#include "pico/stdlib.h"
+#include <stdio.h>
+#include <stdbool.h>
+#include "fixmath.h"
+
+// Streaming Goertzel filter bank for DTMF and tone signalling. Each tone
+// costs one multiply-add per sample per block phase and the power comes out
+// once per half block. Eight DTMF tones run in a few percent of the CPU at 40 kS/s,
+// where an FFT per block would compute hundreds of bins that nobody reads.
+//
+// Each tone keeps its coefficient as the distance from +/-2 (Q14), so the
+// per-sample product is bounded by N * amplitude whatever the frequency.
+// The input is shifted down just enough that this can't overflow int32.
+//
+// Two blocks run half a block apart, so a result comes every half block and
+// any tone 1.5 blocks long fills one block completely: 37.5 ms at 40 Hz
+// bins, inside the 40 ms minimum DTMF tone. A digit is taken from a single
+// block, with the twist, group and energy checks guarding against talk-off.
+
+#define GOERTZEL_MAX_TONES 16
+#define GOERTZEL_BIN_HZ 40              // Block length = rate / bin width
+#define GOERTZEL_PHASES 2               // Overlapping blocks, half a block apart
+#define GOERTZEL_TONE_RATIO 0x4000      // Q16 share of block energy: 0.25
+#define GOERTZEL_DTMF_RATIO 0xA000      // Q16 share both DTMF tones need together: 0.625
+#define GOERTZEL_MIN_RMS 8              // Codes; quieter blocks are silence
+#define GOERTZEL_EVENT_QUEUE 32
+#define GOERTZEL_MIN_RATE_HZ 8000
+#define GOERTZEL_MAX_RATE_HZ 40000
+
+typedef enum {
+    GOERTZEL_EVENT_DIGIT = 0,           // DTMF key went down
+    GOERTZEL_EVENT_TONE_ON,
+    GOERTZEL_EVENT_TONE_OFF
+} GoertzelEventType;
+
+typedef enum {
+    GOERTZEL_SRC_ADC = 0,               // GP26
+    GOERTZEL_SRC_PDM                    // PDM mic, pdm.h
+} GoertzelSource;
+
+typedef struct {
+    GoertzelEventType type;
+    uint32_t timestamp_ms;              // From the first sample of the run
+    char digit;
+    uint16_t freq_hz;
+    uq16_t ratio;                       // Energy share of the tone, Q16
+} GoertzelEvent;
+
+typedef struct {
+    uint16_t freq_hz;
+    int32_t delta;                      // |2cos(2 pi f / fs)| = 2 - delta, Q14
+    bool upper;                         // Above fs / 4, where the cosine is negative
+    int32_t s1[GOERTZEL_PHASES];
+    int32_t s2[GOERTZEL_PHASES];
+    uq16_t ratio;                       // Last block's result
+    bool present;
+} GoertzelTone;
+
+typedef struct {
+    uint32_t rate_hz;
+    uint block_len;
+    uint hop;                           // Half a block
+    uint input_shift;
+    uint count;                         // Samples into the current hop
+    uint phase;                         // Block that ends with this hop
+    uint32_t hops;
+    uint64_t energy[GOERTZEL_PHASES];
+    int32_t dc;                         // Previous hop's mean
+    int32_t sum;
+    GoertzelTone tones[GOERTZEL_MAX_TONES];
+    uint tone_count;
+    bool dtmf;                          // First 8 tones are the DTMF grid
+    char last_digit;
+    uint64_t samples;
+    uint32_t blocks;
+    GoertzelEvent events[GOERTZEL_EVENT_QUEUE];
+    volatile uint event_head;
+    volatile uint event_tail;
+    volatile uint32_t dropped_events;
+} GoertzelBank;
+
+// Function declarations
+bool goertzel_init(GoertzelBank* bank, uint32_t rate_hz, bool dtmf);
+bool goertzel_add_tone(GoertzelBank* bank, uint16_t freq_hz);
+void goertzel_process(GoertzelBank* bank, const uint16_t* samples, uint n);
+bool goertzel_next_event(GoertzelBank* bank, GoertzelEvent* event);
+bool goertzel_run(uint32_t rate_hz, GoertzelSource source, const uint16_t* extra_tones, uint extra_count);
+
+#endif // GOERTZEL_H
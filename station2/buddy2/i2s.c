@@ -0,0 +1,312 @@
+#include "i2s.h"
+#include "i2s.pio.h"
+#include "wav.h"
+#include "resources.h"
+#include "dma_service.h"
+#include "fixmath.h"
+#include "cycles.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include <stdlib.h>
+
+#define I2S_PIN_MASK ((1u << I2S_DATA_PIN) | (1u << I2S_BCLK_PIN) | (1u << I2S_LRCLK_PIN))
+
+static const uint32_t STANDARD_RATES[] = {
+    8000, 11025, 16000, 22050, 32000, 44100, 48000, 88200, 96000, 176400, 192000
+};
+
+typedef struct {
+    int sm;
+    const pio_program_t* program;
+    uint offset;
+    int dma[2];
+    I2SMode mode;
+    uint slots;
+    uint sample_bytes;
+    volatile uint32_t dropped_frames;
+    volatile uint32_t pio_stalls;
+    volatile uint64_t cycles;
+} I2SEngine;
+
+static I2SEngine i2s = { .sm = -1, .dma = { -1, -1 } };
+static uint32_t i2s_buf[2][I2S_BLOCK_WORDS] __attribute__((aligned(4)));
+
+// Byte ring of packed frames. Head and tail run freely; used = head - tail.
+static uint8_t* ring = NULL;
+static volatile uint32_t ring_head = 0;
+static volatile uint32_t ring_tail = 0;
+
+// Packs whole frames of slot words into the ring as little-endian samples.
+// The slot data is left-justified, so the sample is the top bytes.
+static void __not_in_flash_func(pack_frames)(const uint32_t* words, uint n) {
+    uint frame_bytes = i2s.slots * i2s.sample_bytes;
+    uint drop_shift = 32 - 8 * i2s.sample_bytes;
+    uint32_t head = ring_head;
+    uint32_t space = I2S_RING_BYTES - (head - ring_tail);
+    uint pos = head % I2S_RING_BYTES;
+
+    for (uint i = 0; i + i2s.slots <= n; i += i2s.slots) {
+        if (space < frame_bytes) {
+            i2s.dropped_frames++;
+            continue;
+        }
+        uint8_t* dst = ring + pos;
+        for (uint s = 0; s < i2s.slots; s++) {
+            uint32_t sample = words[i + s] >> drop_shift;
+            for (uint b = 0; b < i2s.sample_bytes; b++) {
+                *dst++ = (uint8_t)sample;
+                sample >>= 8;
+            }
+        }
+        pos += frame_bytes;
+        if (pos == I2S_RING_BYTES) pos = 0;
+        head += frame_bytes;
+        space -= frame_bytes;
+    }
+    ring_head = head;
+}
+
+// Storage IRQ line. The finished channel only needs its write address
+// back; the chain from the other half restarts it.
+static void i2s_dma_handler(uint channel, void* ctx) {
+    uint half = (uint)(uintptr_t)ctx;
+    uint32_t start = cycles_now();
+
+    dma_channel_set_write_addr(channel, i2s_buf[half], false);
+    uint32_t stall = 1u << (PIO_FDEBUG_RXSTALL_LSB + i2s.sm);
+    if (I2S_PIO->fdebug & stall) {
+        I2S_PIO->fdebug = stall;
+        i2s.pio_stalls++;
+    }
+    pack_frames(i2s_buf[half], I2S_BLOCK_WORDS);
+    i2s.cycles += cycles_since(start);
+}
+
+static void i2s_release(void) {
+    if (i2s.sm >= 0) {
+        pio_sm_set_enabled(I2S_PIO, i2s.sm, false);
+        pio_remove_program(I2S_PIO, i2s.program, i2s.offset);
+        res_release_pio_sm(I2S_PIO, i2s.sm);
+        i2s.sm = -1;
+    }
+    if (i2s.dma[0] >= 0 && i2s.dma[1] >= 0) {
+        // Chained channels have to be aborted together or one restarts the other
+        dma_hw->abort = (1u << i2s.dma[0]) | (1u << i2s.dma[1]);
+        while (dma_hw->abort) {
+            tight_loop_contents();
+        }
+    }
+    dma_service_release(i2s.dma[0]);
+    dma_service_release(i2s.dma[1]);
+    i2s.dma[0] = i2s.dma[1] = -1;
+    res_release_pins("i2s", I2S_PIN_MASK);
+}
+
+static bool i2s_setup(I2SMode mode, uint slots, bool with_dma) {
+    // I2S frames start on a falling LRCLK, TDM frames on a rising FS
+    i2s.program = mode == I2S_MODE_I2S ? &i2s_in_falling_program : &i2s_in_program;
+    if (!pio_can_add_program(I2S_PIO, i2s.program)) {
+        printf("Error: No PIO space for I2S\n");
+        return false;
+    }
+    if (!res_claim_pins("i2s", I2S_PIN_MASK, RES_PIN_SHARED_INPUT)) {
+        return false;
+    }
+    i2s.sm = res_claim_pio_sm("i2s", I2S_PIO);
+    if (with_dma) {
+        i2s.dma[0] = dma_service_claim("i2s", DMA_IRQ_1, i2s_dma_handler, (void*)0);
+        i2s.dma[1] = dma_service_claim("i2s", DMA_IRQ_1, i2s_dma_handler, (void*)1);
+    }
+    if (i2s.sm < 0 || (with_dma && (i2s.dma[0] < 0 || i2s.dma[1] < 0))) {
+        int sm = i2s.sm;
+        i2s.sm = -1;                    // Program not loaded yet
+        if (sm >= 0) res_release_pio_sm(I2S_PIO, sm);
+        i2s_release();
+        return false;
+    }
+    i2s.mode = mode;
+    i2s.slots = slots;
+
+    for (uint pin = I2S_DATA_PIN; pin <= I2S_LRCLK_PIN; pin++) {
+        gpio_init(pin);
+        gpio_set_dir(pin, GPIO_IN);
+    }
+
+    i2s.offset = pio_add_program(I2S_PIO, i2s.program);
+    i2s_in_program_init(I2S_PIO, i2s.sm, i2s.offset, I2S_DATA_PIN, mode == I2S_MODE_I2S);
+    pio_sm_put_blocking(I2S_PIO, i2s.sm, slots * 32 - 1);
+    I2S_PIO->fdebug = 1u << (PIO_FDEBUG_RXSTALL_LSB + i2s.sm);
+    return true;
+}
+
+// Counts slot words straight off the FIFO for I2S_DETECT_MS; the frame
+// rate is taken between the first and last word so start-up doesn't count
+static uint32_t measure_rate(void) {
+    pio_sm_set_enabled(I2S_PIO, i2s.sm, true);
+    absolute_time_t end = make_timeout_time_ms(I2S_DETECT_MS);
+    uint32_t words = 0;
+    uint32_t first_us = 0, last_us = 0;
+
+    while (!time_reached(end)) {
+        if (pio_sm_is_rx_fifo_empty(I2S_PIO, i2s.sm)) {
+            continue;
+        }
+        pio_sm_get(I2S_PIO, i2s.sm);
+        last_us = time_us_32();
+        if (words++ == 0) first_us = last_us;
+    }
+    pio_sm_set_enabled(I2S_PIO, i2s.sm, false);
+
+    // Start again from the top so the recording begins on slot 0
+    pio_sm_clear_fifos(I2S_PIO, i2s.sm);
+    pio_sm_restart(I2S_PIO, i2s.sm);
+    pio_sm_exec(I2S_PIO, i2s.sm, pio_encode_jmp(i2s.offset));
+    pio_sm_put_blocking(I2S_PIO, i2s.sm, i2s.slots * 32 - 1);
+
+    if (words <= i2s.slots || last_us == first_us) {
+        return 0;
+    }
+    return (uint32_t)((uint64_t)(words - 1) * 1000000 / i2s.slots / (last_us - first_us));
+}
+
+static uint32_t snap_rate(uint32_t measured) {
+    uq16_t error;
+    uint32_t rate = uq16_nearest_rate(measured, STANDARD_RATES, count_of(STANDARD_RATES), &error);
+    return error <= UQ16_FROM_INT(1) ? rate : measured;
+}
+
+static bool valid_format(uint slots, uint bits) {
+    return (slots == 2 || slots == 4 || slots == 8) && (bits == 16 || bits == 24 || bits == 32);
+}
+
+bool i2s_detect_rate(I2SMode mode, uint slots, uint32_t* rate_hz, uint32_t* measured_hz) {
+    if (!valid_format(slots, 16) || (mode == I2S_MODE_I2S && slots != 2)) {
+        return false;
+    }
+    if (!i2s_setup(mode, slots, false)) {
+        return false;
+    }
+    *measured_hz = measure_rate();
+    *rate_hz = snap_rate(*measured_hz);
+    i2s_release();
+    return *measured_hz != 0;
+}
+
+static void configure_dma(uint half) {
+    dma_channel_config cfg = dma_channel_get_default_config(i2s.dma[half]);
+    channel_config_set_transfer_data_size(&cfg, DMA_SIZE_32);
+    channel_config_set_read_increment(&cfg, false);
+    channel_config_set_write_increment(&cfg, true);
+    channel_config_set_dreq(&cfg, pio_get_dreq(I2S_PIO, i2s.sm, false));
+    channel_config_set_chain_to(&cfg, i2s.dma[half ^ 1]);
+    dma_channel_configure(i2s.dma[half], &cfg, i2s_buf[half], &I2S_PIO->rxf[i2s.sm],
+                          I2S_BLOCK_WORDS, false);
+}
+
+// Stops the PIO and packs whatever the active DMA half holds
+static void stop_capture(void) {
+    pio_sm_set_enabled(I2S_PIO, i2s.sm, false);
+    uint half = dma_channel_is_busy(i2s.dma[1]) ? 1 : 0;
+    uint words = I2S_BLOCK_WORDS - dma_channel_hw_addr(i2s.dma[half])->transfer_count;
+    i2s_release();
+    pack_frames(i2s_buf[half], words - words % i2s.slots);
+}
+
+static bool write_ring(WavWriter* wav, uint32_t bytes) {
+    while (bytes) {
+        uint pos = ring_tail % I2S_RING_BYTES;
+        uint n = MIN(bytes, I2S_RING_BYTES - pos);
+        if (!wav_write(wav, ring + pos, n)) {
+            return false;
+        }
+        ring_tail += n;
+        bytes -= n;
+    }
+    return true;
+}
+
+// Records I2S_FILE until a key is pressed
+bool i2s_record(I2SMode mode, uint slots, uint bits, I2SStats* stats) {
+    if (!valid_format(slots, bits) || (mode == I2S_MODE_I2S && slots != 2)) {
+        printf("Error: I2S needs 2 slots, TDM 2/4/8; 16, 24 or 32 bits\n");
+        return false;
+    }
+    ring = malloc(I2S_RING_BYTES);
+    if (!ring) {
+        printf("Error: Out of memory for the I2S ring\n");
+        return false;
+    }
+    if (!i2s_setup(mode, slots, true)) {
+        free(ring);
+        ring = NULL;
+        return false;
+    }
+
+    stats->measured_rate_hz = measure_rate();
+    if (stats->measured_rate_hz == 0) {
+        printf("I2S: no frames - check BCLK GP%d and LRCLK GP%d\n", I2S_BCLK_PIN, I2S_LRCLK_PIN);
+        i2s_release();
+        free(ring);
+        ring = NULL;
+        return false;
+    }
+    stats->rate_hz = snap_rate(stats->measured_rate_hz);
+    stats->slots = slots;
+    stats->bits = bits;
+
+    WavWriter wav;
+    if (!wav_open(&wav, I2S_FILE, stats->rate_hz, slots, bits)) {
+        i2s_release();
+        free(ring);
+        ring = NULL;
+        return false;
+    }
+
+    ring_head = ring_tail = 0;
+    i2s.sample_bytes = bits / 8;
+    i2s.dropped_frames = 0;
+    i2s.pio_stalls = 0;
+    i2s.cycles = 0;
+    cycles_init();
+    configure_dma(0);
+    configure_dma(1);
+    dma_channel_start(i2s.dma[0]);
+    pio_sm_set_enabled(I2S_PIO, i2s.sm, true);
+
+    printf("I2S: %s, %u slots x %u bits at %lu Hz (measured %lu), any key stops\n",
+           mode == I2S_MODE_I2S ? "I2S" : "TDM", slots, bits,
+           stats->rate_hz, stats->measured_rate_hz);
+
+    bool ok = true;
+    uint32_t start_us = time_us_32();
+    while (ok && getchar_timeout_us(0) == PICO_ERROR_TIMEOUT) {
+        if (ring_head - ring_tail < I2S_WRITE_CHUNK) {
+            sleep_ms(1);
+            continue;
+        }
+        ok = write_ring(&wav, I2S_WRITE_CHUNK);
+    }
+    uint32_t elapsed_us = time_us_32() - start_us;
+    stop_capture();
+    ok = ok && write_ring(&wav, ring_head - ring_tail);
+    ok = wav_close(&wav) && ok;
+    free(ring);
+    ring = NULL;
+
+    uint frame_bytes = slots * i2s.sample_bytes;
+    stats->frames = wav.data_bytes / frame_bytes;
+    stats->dropped_frames = i2s.dropped_frames;
+    stats->pio_stalls = i2s.pio_stalls;
+    stats->duration_ms = elapsed_us / 1000;
+    stats->cpu_percent = (float)i2s.cycles / (clock_get_hz(clk_sys) / 1e6f) / elapsed_us * 100.0f;
+
+    printf("I2S: %lu frames in %lu ms, %lu dropped (ring full), %lu PIO stalls, %.2f%% CPU\n",
+           stats->frames, stats->duration_ms, stats->dropped_frames, stats->pio_stalls,
+           stats->cpu_percent);
+    if (ok) {
+        printf("  Saved to %s\n", I2S_FILE);
+    } else {
+        printf("I2S: SD write failed\n");
+    }
+    return ok;
+}
@@ -0,0 +1,54 @@
+#ifndef I2S_H
+#define I2S_H
+
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include <stdio.h>
+#include <stdbool.h>
+
+// I2S / TDM bus capture to WAV on SD. A PIO state machine follows the
+// target's BCLK and frame sync and turns each 32-BCLK slot into one word.
+// Two DMA channels ping-pong blocks of words; the DMA IRQ packs whole
+// frames into a byte ring and the thread streams the ring to the card.
+//
+// The sample rate is measured from the frame count before recording starts
+// and snapped to a standard rate. Frames are dropped whole: if the ring is
+// full (the card stalled) or the PIO stalled on a full FIFO. Both are
+// counted and reported. 48 kHz stereo at 24 bits is 288 KB/s on the card.
+//
+// The pins are only listened to, so they may share the SPI master header.
+// Slots must be 32 BCLKs wide (64 BCLK/frame for stereo I2S).
+
+#define I2S_DATA_PIN 16                 // BCLK and LRCLK follow on GP17 / GP18
+#define I2S_BCLK_PIN (I2S_DATA_PIN + 1)
+#define I2S_LRCLK_PIN (I2S_DATA_PIN + 2)
+#define I2S_PIO pio1
+#define I2S_MAX_SLOTS 8
+#define I2S_BLOCK_WORDS 1024            // Per DMA half
+#define I2S_RING_BYTES (48 * 1024)      // Whole frames for 2/4/8 slots of 2/3/4 bytes
+#define I2S_WRITE_CHUNK (8 * 1024)      // Bytes per f_write; divides the ring
+#define I2S_DETECT_MS 100
+#define I2S_FILE "i2s.wav"
+
+typedef enum {
+    I2S_MODE_I2S = 0,                   // Stereo, left on LRCLK low
+    I2S_MODE_TDM                        // Frame starts on a rising FS pulse
+} I2SMode;
+
+typedef struct {
+    uint32_t measured_rate_hz;
+    uint32_t rate_hz;                   // Snapped to a standard rate
+    uint slots;
+    uint bits;
+    uint32_t frames;                    // Written to the file
+    uint32_t dropped_frames;            // Ring full
+    uint32_t pio_stalls;                // FIFO overflowed, a frame lost each time
+    uint32_t duration_ms;
+    float cpu_percent;
+} I2SStats;
+
+// Function declarations
+bool i2s_detect_rate(I2SMode mode, uint slots, uint32_t* rate_hz, uint32_t* measured_hz);
+bool i2s_record(I2SMode mode, uint slots, uint bits, I2SStats* stats);
+
+#endif // I2S_H
@@ -0,0 +1,342 @@
+#include "pdm.h"
+#include "pdm.pio.h"
+#include "wav.h"
+#include "resources.h"
+#include "dma_service.h"
+#include "cycles.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include <string.h>
+
+#define PDM_PIN_MASK ((1u << PDM_CLK_PIN) | (1u << PDM_DATA_PIN))
+#define HIST_WORDS 8                    // Power of two, >= the largest CIC window
+#define WINDOW_BYTES (PDM_CIC_ORDER * PDM_CIC_MAX_RATIO / 8)
+#define WRITE_CHUNK 1024                // Samples per f_write
+
+// Half-band taps at odd offsets 1, 3 ... 15 from the centre, Q15. The
+// even offsets are zero. Flat to 0.002 dB up to 0.34 of the output rate
+// and 76 dB down where the decimation would alias onto that band.
+static const int16_t HB_FIR[(PDM_HB_TAPS + 1) / 4] = {
+    10279, -3046, 1437, -705, 322, -128, 40, -8
+};
+#define HB_CENTER 16386
+
+typedef struct {
+    uint32_t hist[HIST_WORDS];
+    uint hist_pos;
+    uint hop_words;                     // A CIC output every cic_ratio bits
+    uint window_words;                  // CIC impulse response length
+    uint phase;
+    int32_t cic_mid;                    // Half the CIC gain, i.e. zero
+    int cic_shift;                      // Brings the CIC output to 16 bits
+    int32_t hb_hist[2 * PDM_HB_TAPS];   // Doubled so taps read contiguously
+    uint hb_pos;
+    bool hb_skip;
+    int32_t dc;                         // Running mean, Q8
+} PdmDecimator;
+
+typedef struct {
+    int sm;
+    uint offset;
+    int dma[2];
+    uint32_t rate_hz;
+    uint32_t pdm_clock_hz;
+    pdm_pcm_handler_t handler;
+    void* ctx;
+    volatile uint64_t cycles;
+    bool running;
+} PdmEngine;
+
+static PdmEngine pdm = { .sm = -1, .dma = { -1, -1 } };
+static PdmDecimator dec;
+static uint32_t pdm_buf[2][PDM_BLOCK_WORDS] __attribute__((aligned(4)));
+
+// Byte-at-a-time CIC: entry [p][v] is the sum of the impulse response taps
+// that the set bits of byte v hit when it sits p bytes into the window
+static uint16_t cic_lut[WINDOW_BYTES][256];
+
+// Recorder ring, filled from the IRQ and drained to SD by pdm_record()
+static int16_t pcm_ring[PDM_PCM_RING];
+static volatile uint ring_head = 0;
+static volatile uint ring_tail = 0;
+static volatile uint32_t ring_overruns = 0;
+
+static void build_cic_lut(uint ratio) {
+    static uint32_t h[PDM_CIC_ORDER * PDM_CIC_MAX_RATIO];
+    static uint32_t tmp[PDM_CIC_ORDER * PDM_CIC_MAX_RATIO];
+    uint len = PDM_CIC_ORDER * ratio;
+
+    // Impulse response of the CIC: a unit impulse through ORDER boxcars
+    memset(h, 0, sizeof(h));
+    h[0] = 1;
+    for (uint stage = 0; stage < PDM_CIC_ORDER; stage++) {
+        uint32_t acc = 0;
+        for (uint n = 0; n < len; n++) {
+            acc += h[n];
+            if (n >= ratio) acc -= h[n - ratio];
+            tmp[n] = acc;
+        }
+        memcpy(h, tmp, len * sizeof(uint32_t));
+    }
+
+    // Bit 7 of each byte is the oldest
+    for (uint p = 0; p < len / 8; p++) {
+        for (uint v = 0; v < 256; v++) {
+            uint32_t sum = 0;
+            for (uint i = 0; i < 8; i++) {
+                if (v & (1u << i)) sum += h[p * 8 + 7 - i];
+            }
+            cic_lut[p][v] = (uint16_t)sum;
+        }
+    }
+}
+
+static void decimator_init(uint cic_ratio) {
+    memset(&dec, 0, sizeof(dec));
+    build_cic_lut(cic_ratio);
+    dec.hop_words = cic_ratio / 32;
+    dec.window_words = PDM_CIC_ORDER * cic_ratio / 32;
+    uint log2_ratio = 31 - __builtin_clz(cic_ratio);
+    dec.cic_mid = 1 << (PDM_CIC_ORDER * log2_ratio - 1);
+    dec.cic_shift = (int)(PDM_CIC_ORDER * log2_ratio) - 16;
+}
+
+static inline int32_t cic_output(void) {
+    uint32_t acc = 0;
+    for (uint j = 0; j < dec.window_words; j++) {
+        uint32_t w = dec.hist[(dec.hist_pos - dec.window_words + j) & (HIST_WORDS - 1)];
+        const uint16_t (*t)[256] = &cic_lut[j * 4];
+        acc += t[0][w >> 24] + t[1][(w >> 16) & 0xFF] + t[2][(w >> 8) & 0xFF] + t[3][w & 0xFF];
+    }
+    int32_t x = (int32_t)acc - dec.cic_mid;
+    return dec.cic_shift >= 0 ? x >> dec.cic_shift : x << -dec.cic_shift;
+}
+
+// Symmetric with every other tap zero, so 8 multiplies for 31 taps
+static inline int32_t hb_output(void) {
+    const int32_t* x = &dec.hb_hist[dec.hb_pos];
+    const uint c = PDM_HB_TAPS / 2;
+    int32_t acc = HB_CENTER * x[c];
+    for (uint k = 0; k < count_of(HB_FIR); k++) {
+        uint off = 2 * k + 1;
+        acc += HB_FIR[k] * (x[c - off] + x[c + off]);
+    }
+    return (acc + (1 << 14)) >> 15;
+}
+
+// Returns the number of PCM samples written to out
+static uint __not_in_flash_func(decimate)(const uint32_t* in, uint n, int16_t* out) {
+    uint produced = 0;
+
+    for (uint i = 0; i < n; i++) {
+        dec.hist[dec.hist_pos++ & (HIST_WORDS - 1)] = in[i];
+        if (++dec.phase < dec.hop_words) {
+            continue;
+        }
+        dec.phase = 0;
+
+        // Newest sample at the front of the window
+        int32_t sample = cic_output();
+        dec.hb_pos = dec.hb_pos ? dec.hb_pos - 1 : PDM_HB_TAPS - 1;
+        dec.hb_hist[dec.hb_pos] = sample;
+        dec.hb_hist[dec.hb_pos + PDM_HB_TAPS] = sample;
+
+        dec.hb_skip = !dec.hb_skip;
+        if (dec.hb_skip) {
+            continue;
+        }
+        int32_t y = hb_output();
+        dec.dc += ((y << 8) - dec.dc) >> 10;
+        y -= dec.dc >> 8;
+        if (y > INT16_MAX) y = INT16_MAX;
+        if (y < INT16_MIN) y = INT16_MIN;
+        out[produced++] = (int16_t)y;
+    }
+    return produced;
+}
+
+// Storage IRQ line, like the ADC stream. The finished channel only needs
+// its write address back; the chain from the other half restarts it.
+static void pdm_dma_handler(uint channel, void* ctx) {
+    uint half = (uint)(uintptr_t)ctx;
+    uint32_t start = cycles_now();
+    int16_t pcm[PDM_BLOCK_WORDS / 2];
+
+    dma_channel_set_write_addr(channel, pdm_buf[half], false);
+    uint n = decimate(pdm_buf[half], PDM_BLOCK_WORDS, pcm);
+    pdm.handler(pcm, n, pdm.ctx);
+    pdm.cycles += cycles_since(start);
+}
+
+static void pdm_release(void) {
+    if (pdm.sm >= 0) {
+        pio_sm_set_enabled(PDM_PIO, pdm.sm, false);
+        pio_remove_program(PDM_PIO, &pdm_in_program, pdm.offset);
+        res_release_pio_sm(PDM_PIO, pdm.sm);
+        pdm.sm = -1;
+    }
+    if (pdm.dma[0] >= 0 && pdm.dma[1] >= 0) {
+        // Chained channels have to be aborted together or one restarts the other
+        dma_hw->abort = (1u << pdm.dma[0]) | (1u << pdm.dma[1]);
+        while (dma_hw->abort) {
+            tight_loop_contents();
+        }
+    }
+    dma_service_release(pdm.dma[0]);
+    dma_service_release(pdm.dma[1]);
+    pdm.dma[0] = pdm.dma[1] = -1;
+    res_release_pins("pdm", PDM_PIN_MASK);
+}
+
+static void configure_dma(uint half) {
+    dma_channel_config cfg = dma_channel_get_default_config(pdm.dma[half]);
+    channel_config_set_transfer_data_size(&cfg, DMA_SIZE_32);
+    channel_config_set_read_increment(&cfg, false);
+    channel_config_set_write_increment(&cfg, true);
+    channel_config_set_dreq(&cfg, pio_get_dreq(PDM_PIO, pdm.sm, false));
+    channel_config_set_chain_to(&cfg, pdm.dma[half ^ 1]);
+    dma_channel_configure(pdm.dma[half], &cfg, pdm_buf[half], &PDM_PIO->rxf[pdm.sm],
+                          PDM_BLOCK_WORDS, false);
+}
+
+// Continuous capture at rate_hz; handler gets each decimated block
+bool pdm_start(uint32_t rate_hz, pdm_pcm_handler_t handler, void* ctx) {
+    if (pdm.running || !handler || rate_hz < PDM_MIN_RATE_HZ || rate_hz > PDM_MAX_RATE_HZ) {
+        return false;
+    }
+    if (!pio_can_add_program(PDM_PIO, &pdm_in_program)) {
+        printf("Error: No PIO space for PDM\n");
+        return false;
+    }
+    if (!res_claim_pins("pdm", PDM_PIN_MASK, RES_PIN_EXCLUSIVE)) {
+        return false;
+    }
+    pdm.sm = res_claim_pio_sm("pdm", PDM_PIO);
+    pdm.dma[0] = dma_service_claim("pdm", DMA_IRQ_1, pdm_dma_handler, (void*)0);
+    pdm.dma[1] = dma_service_claim("pdm", DMA_IRQ_1, pdm_dma_handler, (void*)1);
+    if (pdm.sm < 0 || pdm.dma[0] < 0 || pdm.dma[1] < 0) {
+        int sm = pdm.sm;
+        pdm.sm = -1;                    // Program not loaded yet
+        if (sm >= 0) res_release_pio_sm(PDM_PIO, sm);
+        pdm_release();
+        return false;
+    }
+
+    uint ratio = rate_hz * 64 >= PDM_MIN_CLOCK_HZ ? 64 : 128;
+    decimator_init(ratio / 2);
+    pdm.rate_hz = rate_hz;
+    pdm.pdm_clock_hz = rate_hz * ratio;
+    pdm.handler = handler;
+    pdm.ctx = ctx;
+    pdm.cycles = 0;
+    cycles_init();
+
+    pdm.offset = pio_add_program(PDM_PIO, &pdm_in_program);
+    pdm_in_program_init(PDM_PIO, pdm.sm, pdm.offset, PDM_CLK_PIN, PDM_DATA_PIN,
+                        clock_get_hz(clk_sys) / (4.0f * pdm.pdm_clock_hz));
+    configure_dma(0);
+    configure_dma(1);
+
+    pdm.running = true;
+    dma_channel_start(pdm.dma[0]);
+    pio_sm_set_enabled(PDM_PIO, pdm.sm, true);
+    return true;
+}
+
+void pdm_stop(void) {
+    if (!pdm.running) {
+        return;
+    }
+    pdm_release();
+    pdm.running = false;
+}
+
+bool pdm_is_running(void) {
+    return pdm.running;
+}
+
+static void ring_block(const int16_t* pcm, uint n, void* ctx) {
+    (void)ctx;
+    for (uint i = 0; i < n; i++) {
+        uint next = (ring_head + 1) % PDM_PCM_RING;
+        if (next == ring_tail) {
+            ring_overruns += n - i;
+            break;
+        }
+        pcm_ring[ring_head] = pcm[i];
+        ring_head = next;
+    }
+}
+
+static uint ring_available(void) {
+    return (ring_head + PDM_PCM_RING - ring_tail) % PDM_PCM_RING;
+}
+
+static uint ring_read(int16_t* out, uint max) {
+    uint n = 0;
+    while (n < max && ring_tail != ring_head) {
+        out[n++] = pcm_ring[ring_tail];
+        ring_tail = (ring_tail + 1) % PDM_PCM_RING;
+    }
+    return n;
+}
+
+// Records PDM_FILE for duration_ms or until a key is pressed
+bool pdm_record(uint32_t rate_hz, uint32_t duration_ms, PdmStats* stats) {
+    static int16_t chunk[WRITE_CHUNK];
+    WavWriter wav;
+
+    if (rate_hz < PDM_MIN_RATE_HZ || rate_hz > PDM_MAX_RATE_HZ) {
+        printf("Error: PDM rate must be %d-%d Hz\n", PDM_MIN_RATE_HZ, PDM_MAX_RATE_HZ);
+        return false;
+    }
+    if (!wav_open(&wav, PDM_FILE, rate_hz, 1, 16)) {
+        return false;
+    }
+    ring_head = ring_tail = 0;
+    ring_overruns = 0;
+    if (!pdm_start(rate_hz, ring_block, NULL)) {
+        printf("Error: PDM capture unavailable\n");
+        wav_close(&wav);
+        return false;
+    }
+    printf("PDM: %lu Hz from a %lu Hz mic clock (CLK GP%d, DATA GP%d), any key stops\n",
+           rate_hz, pdm.pdm_clock_hz, PDM_CLK_PIN, PDM_DATA_PIN);
+
+    bool ok = true;
+    uint32_t start_us = time_us_32();
+    absolute_time_t end = make_timeout_time_ms(duration_ms);
+    while (ok && !time_reached(end) && getchar_timeout_us(0) == PICO_ERROR_TIMEOUT) {
+        if (ring_available() < WRITE_CHUNK) {
+            sleep_ms(1);
+            continue;
+        }
+        uint n = ring_read(chunk, WRITE_CHUNK);
+        ok = wav_write(&wav, chunk, n * sizeof(int16_t));
+    }
+    uint32_t elapsed_us = time_us_32() - start_us;
+    float cpu = (float)pdm.cycles / (clock_get_hz(clk_sys) / 1e6f) / elapsed_us * 100.0f;
+    pdm_stop();
+
+    uint n;
+    while (ok && (n = ring_read(chunk, WRITE_CHUNK)) > 0) {
+        ok = wav_write(&wav, chunk, n * sizeof(int16_t));
+    }
+    ok = wav_close(&wav) && ok;
+
+    stats->rate_hz = rate_hz;
+    stats->pdm_clock_hz = pdm.pdm_clock_hz;
+    stats->samples = wav.data_bytes / sizeof(int16_t);
+    stats->overruns = ring_overruns;
+    stats->duration_ms = elapsed_us / 1000;
+    stats->cpu_percent = cpu;
+
+    printf("PDM: %lu samples in %lu ms, %lu overruns, decimation %.2f%% CPU\n",
+           stats->samples, stats->duration_ms, stats->overruns, stats->cpu_percent);
+    if (ok) {
+        printf("  Saved to %s\n", PDM_FILE);
+    } else {
+        printf("PDM: SD write failed\n");
+    }
+    return ok;
+}
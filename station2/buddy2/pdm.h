@@ -0,0 +1,54 @@
+#ifndef PDM_H
+#define PDM_H
+
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include <stdio.h>
+#include <stdbool.h>
+
+// PDM microphone capture. A PIO state machine clocks the mic and DMA
+// ping-pongs the bitstream into two word buffers. Each completed half is
+// decimated in the DMA IRQ to 16-bit PCM:
+//
+//   - A third-order CIC by 32 or 64, done a byte at a time from lookup
+//     tables, so it costs a dozen table reads per CIC output instead of
+//     three adds per bit.
+//   - A 31-tap half-band FIR by 2 (8 multiplies per output).
+//   - A one-pole DC blocker, since PDM mics sit well off zero.
+//
+// The PDM clock is rate x 64, or rate x 128 below 16 kHz, to keep the mic
+// between 1 and 3.1 MHz. The fractional PIO divider adds a little clock
+// jitter, which the mics tolerate.
+
+#define PDM_CLK_PIN 13
+#define PDM_DATA_PIN 14
+#define PDM_PIO pio1
+#define PDM_MIN_RATE_HZ 8000
+#define PDM_MAX_RATE_HZ 48000
+#define PDM_MIN_CLOCK_HZ 1000000
+#define PDM_BLOCK_WORDS 256             // Per DMA half: 8192 PDM bits
+#define PDM_CIC_ORDER 3
+#define PDM_CIC_MAX_RATIO 64
+#define PDM_HB_TAPS 31
+#define PDM_PCM_RING 8192               // Samples; ~170 ms at 48 kHz
+#define PDM_FILE "pdm.wav"
+
+// Called from the DMA IRQ with each decimated block
+typedef void (*pdm_pcm_handler_t)(const int16_t* pcm, uint n, void* ctx);
+
+typedef struct {
+    uint32_t rate_hz;
+    uint32_t pdm_clock_hz;
+    uint32_t samples;
+    uint32_t overruns;                  // Samples the SD writer couldn't keep up with
+    uint32_t duration_ms;
+    float cpu_percent;                  // Decimation share of one core
+} PdmStats;
+
+// Function declarations
+bool pdm_start(uint32_t rate_hz, pdm_pcm_handler_t handler, void* ctx);
+void pdm_stop(void);
+bool pdm_is_running(void);
+bool pdm_record(uint32_t rate_hz, uint32_t duration_ms, PdmStats* stats);
+
+#endif // PDM_H
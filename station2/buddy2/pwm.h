@@ -5,13 +5,14 @@
 #include "hardware/gpio.h"
 #include <stdio.h>
 #include <stdbool.h>
+#include "fixmath.h"
 
 #define PWM_PIN 7
 #define PWM_BUTTON_PIN 20
 
 typedef struct {
-    float frequency;
-    float duty_cycle;
+    uint32_t frequency_mhz; // Millihertz, up to the 1 MHz the us timestamps resolve
+    uq16_t duty_cycle;      // Percent, Q16.16
     uint32_t last_rise;
     uint32_t last_fall;
     uint32_t period;
@@ -0,0 +1,445 @@
+#include "pwm_multi.h"
+#include "pwm_multi.pio.h"
+#include "resources.h"
+#include "hardware/pwm.h"
+#include "hardware/clocks.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include <string.h>
+
+#define GUARD_US 2000                   // Duty windows close this long before the next half
+
+// Six slice B inputs and two PIO pins, clear of the SD card, the CYW43, the
+// PDM mic (GP13-14) and the encoder index (GP0). Listed in the station2 menu.
+static const uint DEFAULT_PINS[] = { 7, 5, 9, 17, 19, 27, 6, 18 };
+
+typedef enum {
+    PHASE_FREQ = 0,
+    PHASE_DUTY
+} Phase;
+
+typedef struct {
+    PwmChannelResult r;
+    PIO pio;
+
+    // Slice path
+    uint32_t wrap_n;                    // Edges per wrap IRQ in the frequency half
+    volatile uint32_t wraps;
+    volatile uint32_t first_wrap_us;
+    volatile uint32_t last_wrap_us;
+    uint32_t frequency_mhz;             // From this update's frequency half
+    uint32_t window_us;
+    uint32_t window_periods;            // 0 if the window isn't whole periods
+    alarm_id_t alarm;
+    uint64_t high_ticks;
+    volatile bool duty_done;
+
+    // PIO path
+    uint32_t pio_x;                     // High word waiting for its low word
+    bool pio_have_x;
+    uint64_t pio_high;
+    uint64_t pio_period;
+    uint32_t pio_pairs;
+} Channel;
+
+typedef struct {
+    Channel ch[PWM_MULTI_MAX_CHANNELS];
+    uint count;
+    int8_t slice_chan[NUM_PWM_SLICES];
+    uint32_t slice_mask;
+    int prog_offset[2];                 // pwm_measure per PIO, -1 if not loaded
+    uint32_t half_us;
+    uint32_t clk_hz;
+    volatile Phase phase;
+    uint32_t freq_start_us;
+    repeating_timer_t timer;
+    bool running;
+} PwmMulti;
+
+static PwmMulti pm;
+static PwmChannelResult results[PWM_MULTI_MAX_CHANNELS];
+
+static void __isr __not_in_flash_func(pwm_wrap_irq)(void) {
+    uint32_t now = timer_hw->timerawl;
+    uint32_t status = pwm_hw->ints & pm.slice_mask;
+    pwm_hw->intr = status;
+
+    while (status) {
+        uint slice = __builtin_ctz(status);
+        status &= status - 1;
+        Channel* ch = &pm.ch[pm.slice_chan[slice]];
+        if (pm.phase == PHASE_FREQ) {
+            if (ch->wraps == 0) ch->first_wrap_us = now;
+            ch->last_wrap_us = now;
+        }
+        ch->wraps++;
+    }
+}
+
+static void configure_slice(Channel* ch, enum pwm_clkdiv_mode mode, uint div, uint32_t top) {
+    pwm_config c = pwm_get_default_config();
+    pwm_config_set_clkdiv_mode(&c, mode);
+    pwm_config_set_clkdiv_int(&c, div);
+    pwm_config_set_wrap(&c, top);
+    pwm_init(ch->r.slice, &c, false);
+    ch->wraps = 0;
+}
+
+static void start_freq(void) {
+    for (uint i = 0; i < pm.count; i++) {
+        Channel* ch = &pm.ch[i];
+        if (ch->r.source == PWM_SRC_SLICE) {
+            configure_slice(ch, PWM_DIV_B_RISING, 1, ch->wrap_n - 1);
+        }
+    }
+    pm.phase = PHASE_FREQ;
+    pwm_hw->intr = pm.slice_mask;
+    pm.freq_start_us = time_us_32();
+    hw_set_bits(&pwm_hw->en, pm.slice_mask);
+}
+
+static void finish_freq(void) {
+    hw_clear_bits(&pwm_hw->en, pm.slice_mask);
+    uint32_t elapsed_us = time_us_32() - pm.freq_start_us;
+
+    for (uint i = 0; i < pm.count; i++) {
+        Channel* ch = &pm.ch[i];
+        if (ch->r.source != PWM_SRC_SLICE) continue;
+
+        uint32_t wraps = ch->wraps;
+        uint64_t f;
+        if (wraps >= 2 && ch->last_wrap_us != ch->first_wrap_us) {
+            // Reciprocal: whole groups of N edges between two timestamps
+            f = (uint64_t)ch->wrap_n * (wraps - 1) * 1000000000ull /
+                (ch->last_wrap_us - ch->first_wrap_us);
+        } else {
+            uint64_t edges = (uint64_t)wraps * ch->wrap_n + pwm_get_counter(ch->r.slice);
+            f = elapsed_us ? edges * 1000000000ull / elapsed_us : 0;
+        }
+        ch->frequency_mhz = f > UINT32_MAX ? UINT32_MAX : (uint32_t)f;
+
+        uint32_t n = ch->frequency_mhz / (PWM_MULTI_WRAP_HZ * 1000u);
+        ch->wrap_n = n < 1 ? 1 : (n > 0xFFFF ? 0xFFFF : n);
+    }
+}
+
+static int64_t duty_alarm(alarm_id_t id, void* user_data) {
+    (void)id;
+    Channel* ch = (Channel*)user_data;
+    uint32_t save = save_and_disable_interrupts();
+    pwm_set_enabled(ch->r.slice, false);
+    uint32_t wraps = ch->wraps;
+    // A wrap the IRQ hasn't taken yet
+    if (pwm_hw->intr & (1u << ch->r.slice)) {
+        pwm_hw->intr = 1u << ch->r.slice;
+        wraps++;
+    }
+    ch->high_ticks = ((uint64_t)wraps << 16) + pwm_get_counter(ch->r.slice);
+    restore_interrupts(save);
+    ch->duty_done = true;
+    ch->alarm = 0;
+    return 0;
+}
+
+static void start_duty(void) {
+    uint32_t max_window = pm.half_us - GUARD_US;
+
+    for (uint i = 0; i < pm.count; i++) {
+        Channel* ch = &pm.ch[i];
+        if (ch->r.source != PWM_SRC_SLICE) continue;
+
+        configure_slice(ch, PWM_DIV_B_HIGH, PWM_MULTI_DUTY_DIV, 0xFFFF);
+        ch->duty_done = false;
+        ch->window_us = max_window;
+        ch->window_periods = 0;
+        if (ch->frequency_mhz) {
+            uint64_t period_ps = 1000000000000000ull / ch->frequency_mhz;
+            uint64_t k = (uint64_t)max_window * 1000000 / period_ps;
+            if (k >= 1) {
+                ch->window_periods = (uint32_t)k;
+                ch->window_us = (uint32_t)((k * period_ps + 500000) / 1000000);
+            }
+        }
+    }
+
+    pm.phase = PHASE_DUTY;
+    pwm_hw->intr = pm.slice_mask;
+    hw_set_bits(&pwm_hw->en, pm.slice_mask);
+    uint64_t start_us = time_us_64();
+
+    for (uint i = 0; i < pm.count; i++) {
+        Channel* ch = &pm.ch[i];
+        if (ch->r.source != PWM_SRC_SLICE) continue;
+        ch->alarm = add_alarm_at(from_us_since_boot(start_us + ch->window_us), duty_alarm, ch, true);
+    }
+}
+
+static void finish_duty(Channel* ch, PwmChannelResult* r) {
+    if (ch->alarm > 0) {
+        cancel_alarm(ch->alarm);
+        ch->alarm = 0;
+    }
+    pwm_set_enabled(ch->r.slice, false);
+    if (!ch->duty_done || !ch->frequency_mhz || !ch->window_us) {
+        return;
+    }
+    uint64_t tick_hz = pm.clk_hz / PWM_MULTI_DUTY_DIV;
+    uint64_t window_ticks = (uint64_t)ch->window_us * tick_hz / 1000000;
+    uint64_t duty = window_ticks ? (ch->high_ticks * 100 << Q16_SHIFT) / window_ticks : 0;
+    r->duty = duty > UQ16_FROM_INT(100) ? UQ16_FROM_INT(100) : (uq16_t)duty;
+
+    uint64_t high_ns = ch->high_ticks * 1000000000ull / tick_hz;
+    if (ch->window_periods) {
+        high_ns /= ch->window_periods;
+    } else {
+        high_ns = (uint64_t)r->duty * 10000000000ull / ((uint64_t)ch->frequency_mhz << Q16_SHIFT);
+    }
+    r->high_ns = high_ns > UINT32_MAX ? UINT32_MAX : (uint32_t)high_ns;
+    r->frequency_mhz = ch->frequency_mhz;
+    r->signal = true;
+}
+
+// Pairs each high word with the low word after it. A high word followed by
+// another, or a low word with none before it, lost its partner to a full
+// FIFO and is dropped; a high word at the end waits for the next call.
+static void collect_pio(Channel* ch) {
+    uint sm = ch->r.slice;
+    uint level = pio_sm_get_rx_fifo_level(ch->pio, sm);
+    while (level--) {
+        uint32_t word = pio_sm_get(ch->pio, sm);
+        if (word & PWM_MEASURE_HIGH_WORD) {
+            ch->pio_x = word;
+            ch->pio_have_x = true;
+            continue;
+        }
+        if (!ch->pio_have_x) {
+            continue;
+        }
+        ch->pio_have_x = false;
+        uint64_t high = 2ull * ~ch->pio_x + PWM_MEASURE_HIGH_OVERHEAD;
+        uint64_t low = 2ull * word + PWM_MEASURE_LOW_OVERHEAD;
+        ch->pio_high += high;
+        ch->pio_period += high + low;
+        ch->pio_pairs++;
+    }
+}
+
+static void finish_pio(Channel* ch, PwmChannelResult* r) {
+    if (ch->pio_pairs && ch->pio_period) {
+        r->frequency_mhz = (uint32_t)((uint64_t)pm.clk_hz * 1000 * ch->pio_pairs / ch->pio_period);
+        r->duty = (uq16_t)((ch->pio_high * 100 << Q16_SHIFT) / ch->pio_period);
+        r->high_ns = (uint32_t)(ch->pio_high * 1000000000ull / pm.clk_hz / ch->pio_pairs);
+        r->signal = true;
+    }
+    ch->pio_high = ch->pio_period = 0;
+    ch->pio_pairs = 0;
+}
+
+// Both halves are done: publish one result per channel
+static void publish(void) {
+    for (uint i = 0; i < pm.count; i++) {
+        Channel* ch = &pm.ch[i];
+        PwmChannelResult r = ch->r;
+        r.signal = false;
+        r.frequency_mhz = 0;
+        r.duty = 0;
+        r.high_ns = 0;
+
+        if (ch->r.source == PWM_SRC_SLICE) {
+            finish_duty(ch, &r);
+        } else if (ch->r.source == PWM_SRC_PIO) {
+            finish_pio(ch, &r);
+        }
+        if (!r.signal) {
+            r.level = gpio_get(r.pin);
+            r.duty = r.level ? UQ16_FROM_INT(100) : 0;
+        }
+        r.updates = ++ch->r.updates;
+        results[i] = r;
+    }
+}
+
+static bool pwm_multi_tick(repeating_timer_t* rt) {
+    (void)rt;
+    for (uint i = 0; i < pm.count; i++) {
+        if (pm.ch[i].r.source == PWM_SRC_PIO) collect_pio(&pm.ch[i]);
+    }
+    if (pm.phase == PHASE_FREQ) {
+        finish_freq();
+        start_duty();
+    } else {
+        publish();
+        start_freq();
+    }
+    return true;
+}
+
+static bool claim_pio(Channel* ch) {
+    static const PIO pios[2] = { pio0, pio1 };
+    for (uint p = 0; p < 2; p++) {
+        if (pm.prog_offset[p] < 0) {
+            if (!pio_can_add_program(pios[p], &pwm_measure_program)) continue;
+        }
+        int sm = res_claim_pio_sm("pwm_multi", pios[p]);
+        if (sm < 0) continue;
+        if (pm.prog_offset[p] < 0) {
+            pm.prog_offset[p] = pio_add_program(pios[p], &pwm_measure_program);
+        }
+        ch->pio = pios[p];
+        ch->r.slice = sm;
+        pwm_measure_program_init(ch->pio, sm, pm.prog_offset[p], ch->r.pin);
+        pio_sm_set_enabled(ch->pio, sm, true);
+        return true;
+    }
+    return false;
+}
+
+static void release_all(void) {
+    hw_clear_bits(&pwm_hw->en, pm.slice_mask);
+    pwm_set_irq_mask_enabled(pm.slice_mask, false);
+
+    for (uint i = 0; i < pm.count; i++) {
+        Channel* ch = &pm.ch[i];
+        if (ch->alarm > 0) cancel_alarm(ch->alarm);
+        if (ch->r.source == PWM_SRC_PIO) {
+            pio_sm_set_enabled(ch->pio, ch->r.slice, false);
+            res_release_pio_sm(ch->pio, ch->r.slice);
+        } else if (ch->r.source == PWM_SRC_SLICE) {
+            gpio_init(ch->r.pin);       // Back to a plain input
+        }
+        res_release_pins("pwm_multi", 1u << ch->r.pin);
+    }
+    if (pm.prog_offset[0] >= 0) pio_remove_program(pio0, &pwm_measure_program, pm.prog_offset[0]);
+    if (pm.prog_offset[1] >= 0) pio_remove_program(pio1, &pwm_measure_program, pm.prog_offset[1]);
+    if (pm.slice_mask) {
+        irq_remove_handler(PWM_IRQ_WRAP, pwm_wrap_irq);
+        res_release_irq(PWM_IRQ_WRAP);
+    }
+    pm.count = 0;
+    pm.slice_mask = 0;
+}
+
+bool pwm_multi_start(const uint* pins, uint count, uint32_t update_ms) {
+    if (pm.running || count == 0 || count > PWM_MULTI_MAX_CHANNELS ||
+        update_ms < PWM_MULTI_MIN_UPDATE_MS) {
+        return false;
+    }
+    memset(&pm, 0, sizeof(pm));
+    memset(results, 0, sizeof(results));
+    memset(pm.slice_chan, -1, sizeof(pm.slice_chan));
+    pm.prog_offset[0] = pm.prog_offset[1] = -1;
+    pm.half_us = update_ms * 500;
+    pm.clk_hz = clock_get_hz(clk_sys);
+
+    for (uint i = 0; i < count; i++) {
+        Channel* ch = &pm.ch[i];
+        uint pin = pins[i];
+        // A slice B input is only listened to, so the pin can be shared
+        if (pin >= NUM_BANK0_GPIOS || !res_claim_pins("pwm_multi", 1u << pin, RES_PIN_SHARED_INPUT)) {
+            release_all();
+            return false;
+        }
+        pm.count++;
+        ch->r.pin = pin;
+        ch->wrap_n = 1;
+        gpio_init(pin);
+        gpio_set_dir(pin, GPIO_IN);
+
+        uint slice = pwm_gpio_to_slice_num(pin);
+        if (pwm_gpio_to_channel(pin) == PWM_CHAN_B && pm.slice_chan[slice] < 0) {
+            ch->r.source = PWM_SRC_SLICE;
+            ch->r.slice = slice;
+            pm.slice_chan[slice] = i;
+            pm.slice_mask |= 1u << slice;
+            gpio_set_function(pin, GPIO_FUNC_PWM);
+        } else if (claim_pio(ch)) {
+            ch->r.source = PWM_SRC_PIO;
+        } else {
+            printf("PWM multi: no slice or state machine left for GP%u\n", pin);
+        }
+    }
+
+    if (pm.slice_mask) {
+        if (!res_claim_irq("pwm_multi", PWM_IRQ_WRAP)) {
+            pm.slice_mask = 0;          // Not hooked yet
+            release_all();
+            return false;
+        }
+        irq_add_shared_handler(PWM_IRQ_WRAP, pwm_wrap_irq, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        irq_set_enabled(PWM_IRQ_WRAP, true);
+        pwm_set_irq_mask_enabled(pm.slice_mask, true);
+    }
+
+    start_freq();
+    add_repeating_timer_ms(-(int32_t)(update_ms / 2), pwm_multi_tick, NULL, &pm.timer);
+    pm.running = true;
+    return true;
+}
+
+void pwm_multi_stop(void) {
+    if (!pm.running) {
+        return;
+    }
+    cancel_repeating_timer(&pm.timer);
+    release_all();
+    pm.running = false;
+}
+
+bool pwm_multi_is_running(void) {
+    return pm.running;
+}
+
+uint pwm_multi_get_results(PwmChannelResult* out, uint max) {
+    uint32_t save = save_and_disable_interrupts();
+    uint n = pm.count < max ? pm.count : max;
+    memcpy(out, results, n * sizeof(PwmChannelResult));
+    restore_interrupts(save);
+    return n;
+}
+
+void pwm_multi_print(void) {
+    PwmChannelResult r[PWM_MULTI_MAX_CHANNELS];
+    uint n = pwm_multi_get_results(r, PWM_MULTI_MAX_CHANNELS);
+
+    printf("  pin  source      frequency Hz    duty %%     high us\n");
+    for (uint i = 0; i < n; i++) {
+        char source[12];
+        if (r[i].source == PWM_SRC_SLICE) {
+            snprintf(source, sizeof(source), "slice %u", r[i].slice);
+        } else if (r[i].source == PWM_SRC_PIO) {
+            snprintf(source, sizeof(source), "pio sm %u", r[i].slice);
+        } else {
+            snprintf(source, sizeof(source), "-");
+        }
+        if (r[i].signal) {
+            printf("  GP%-2u %-10s %14.3f %9.3f %11.2f\n", r[i].pin, source,
+                   r[i].frequency_mhz / 1000.0, uq16_to_float(r[i].duty), r[i].high_ns / 1000.0f);
+        } else {
+            printf("  GP%-2u %-10s %14s %9s %11s  (steady %s)\n", r[i].pin, source,
+                   "-", "-", "-", r[i].level ? "high" : "low");
+        }
+    }
+}
+
+// Default pins, a table every update until a key is pressed
+bool pwm_multi_run(uint32_t update_ms) {
+    if (!pwm_multi_start(DEFAULT_PINS, count_of(DEFAULT_PINS), update_ms)) {
+        printf("Error: Multi-channel PWM measurement couldn't start\n");
+        return false;
+    }
+    printf("Multi-channel PWM: %u channels, %lu ms updates, any key stops\n",
+           pm.count, update_ms);
+
+    uint32_t last_update = 0;
+    while (getchar_timeout_us(0) == PICO_ERROR_TIMEOUT) {
+        PwmChannelResult first;
+        if (pwm_multi_get_results(&first, 1) && first.updates != last_update) {
+            last_update = first.updates;
+            printf("Update %lu:\n", last_update);
+            pwm_multi_print();
+        }
+        sleep_ms(20);
+    }
+    pwm_multi_stop();
+    return true;
+}
@@ -0,0 +1,61 @@
+#ifndef PWM_MULTI_H
+#define PWM_MULTI_H
+
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include <stdio.h>
+#include <stdbool.h>
+#include "fixmath.h"
+
+// Concurrent PWM / servo measurement on up to 8 pins. A pin that is a
+// PWM slice's B input gets that slice; any other pin, or a second pin on a
+// slice already taken, falls back to a PIO state machine timing every pulse.
+//
+// Each update period is split in two halves, and every slice runs both
+// halves in step:
+//
+//   - Frequency: the slice counts rising edges with TOP = N - 1, and the
+//     wrap IRQ timestamps every N edges (reciprocal counting). N is picked
+//     from the last result to give about PWM_MULTI_WRAP_HZ IRQs per second.
+//   - Duty: the slice counts clk_sys / 16 while B is high, gated over a
+//     whole number of the periods just measured. A window that isn't a
+//     whole number of periods would cut a pulse at either end, which for a
+//     50 Hz servo would be most of the reading. A one-shot alarm per
+//     channel closes its window, and wraps extend the 16-bit counter.
+//
+// The PIO fallback gives the high and low time of each pulse to a couple of
+// cycles. The pairs are averaged over the update.
+
+#define PWM_MULTI_MAX_CHANNELS 8
+#define PWM_MULTI_DEFAULT_UPDATE_MS 500
+#define PWM_MULTI_MIN_UPDATE_MS 100
+#define PWM_MULTI_WRAP_HZ 200
+#define PWM_MULTI_DUTY_DIV 16
+
+typedef enum {
+    PWM_SRC_NONE = 0,
+    PWM_SRC_SLICE,
+    PWM_SRC_PIO
+} PwmSource;
+
+typedef struct {
+    uint pin;
+    PwmSource source;
+    uint slice;                         // Or the state machine for PWM_SRC_PIO
+    bool signal;                        // Edges seen in the last update
+    bool level;                         // Pin level when there were none
+    uint32_t frequency_mhz;             // Milli-hertz
+    uq16_t duty;                        // Percent, Q16.16
+    uint32_t high_ns;                   // Pulse width
+    uint32_t updates;
+} PwmChannelResult;
+
+// Function declarations
+bool pwm_multi_start(const uint* pins, uint count, uint32_t update_ms);
+void pwm_multi_stop(void);
+bool pwm_multi_is_running(void);
+uint pwm_multi_get_results(PwmChannelResult* out, uint max);
+void pwm_multi_print(void);
+bool pwm_multi_run(uint32_t update_ms);
+
+#endif // PWM_MULTI_H
@@ -0,0 +1,245 @@
+#include "quadrature.h"
+#include "quadrature.pio.h"
+#include "resources.h"
+#include "gpio_irq.h"
+#include "buddy1/sd_card.h"
+#include "hardware/sync.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define QUAD_PIN_MASK ((1u << QUAD_A_PIN) | (1u << QUAD_B_PIN))
+
+typedef struct {
+    int sm;
+    bool use_index;
+    bool running;
+    repeating_timer_t timer;
+    int32_t last_count;
+    int direction;
+    volatile uint32_t last_edge_us;
+    volatile uint32_t edge_period_us;   // A rising to A rising; 0 until two edges
+    QuadMetrics metrics;
+} QuadEngine;
+
+static QuadEngine quad = { .sm = -1 };
+
+static QuadSample log_ring[QUAD_LOG_RING];
+static volatile uint log_head = 0;
+static volatile uint log_tail = 0;
+static volatile uint32_t log_overruns = 0;
+
+// The PIO pushes without blocking, so a full FIFO drops new counts and
+// holds the oldest ones since the last read. Drain it and take the next
+// push, at most a pass of the loop away. The tick and the index IRQ both
+// read it, so this runs with interrupts off and neither can drain the
+// FIFO under the other.
+static int32_t read_count(void) {
+    uint32_t save = save_and_disable_interrupts();
+    uint n = pio_sm_get_rx_fifo_level(QUAD_PIO, quad.sm);
+    while (n--) {
+        pio_sm_get(QUAD_PIO, quad.sm);
+    }
+    int32_t count = (int32_t)pio_sm_get_blocking(QUAD_PIO, quad.sm);
+    restore_interrupts(save);
+    return count;
+}
+
+static void quad_edge_irq(uint gpio, uint32_t events, uint32_t now_us) {
+    (void)gpio;
+    (void)events;
+    if (quad.last_edge_us) {
+        quad.edge_period_us = now_us - quad.last_edge_us;
+    }
+    quad.last_edge_us = now_us;
+}
+
+static void quad_index_irq(uint gpio, uint32_t events, uint32_t now_us) {
+    (void)gpio;
+    (void)events;
+    (void)now_us;
+    quad.metrics.index_count = read_count();
+    quad.metrics.index_pulses++;
+}
+
+static void set_period_mode(bool on) {
+    if (on == quad.metrics.period_mode) {
+        return;
+    }
+    if (on) {
+        quad.last_edge_us = 0;
+        quad.edge_period_us = 0;
+    }
+    gpio_set_irq_enabled(QUAD_A_PIN, GPIO_IRQ_EDGE_RISE, on);
+    quad.metrics.period_mode = on;
+}
+
+static bool quad_tick(repeating_timer_t* rt) {
+    (void)rt;
+    int32_t count = read_count();
+    int32_t delta = count - quad.last_count;
+    quad.last_count = count;
+    if (delta) {
+        quad.direction = delta > 0 ? 1 : -1;
+    }
+
+    q16_t window_velocity = (q16_t)(((int64_t)delta << Q16_SHIFT) / QUAD_WINDOW_MS);
+    q16_t velocity = window_velocity;
+
+    if (abs(delta) >= QUAD_PERIOD_THRESHOLD) {
+        set_period_mode(false);
+    } else {
+        set_period_mode(true);
+        uint32_t period = quad.edge_period_us;
+        uint32_t since = time_us_32() - quad.last_edge_us;
+        if (quad.last_edge_us && since > QUAD_STOP_MS * 1000u) {
+            velocity = 0;
+        } else if (period) {
+            // No edge yet this period means we are at most this fast
+            if (since > period) period = since;
+            velocity = quad.direction * (q16_t)uq16_div_u32(4000, period);
+        }
+    }
+
+    quad.metrics.count = count;
+    quad.metrics.velocity = velocity;
+
+    uint next = (log_head + 1) % QUAD_LOG_RING;
+    if (next == log_tail) {
+        log_overruns++;
+    } else {
+        log_ring[log_head].time_ms = to_ms_since_boot(get_absolute_time());
+        log_ring[log_head].count = count;
+        log_ring[log_head].velocity = velocity;
+        log_head = next;
+    }
+    return true;
+}
+
+bool quad_start(bool use_index) {
+    if (quad.running) {
+        return true;
+    }
+    if (!pio_can_add_program_at_offset(QUAD_PIO, &quadrature_program, 0)) {
+        printf("Error: Quadrature decoder needs PIO offset 0 free\n");
+        return false;
+    }
+    uint32_t pins = QUAD_PIN_MASK | (use_index ? 1u << QUAD_INDEX_PIN : 0);
+    if (!res_claim_pins("quadrature", pins, RES_PIN_SHARED_INPUT)) {
+        return false;
+    }
+    quad.sm = res_claim_pio_sm("quadrature", QUAD_PIO);
+    if (quad.sm < 0) {
+        res_release_pins("quadrature", pins);
+        return false;
+    }
+
+    pio_add_program_at_offset(QUAD_PIO, &quadrature_program, 0);
+    quadrature_program_init(QUAD_PIO, quad.sm, QUAD_A_PIN);
+    pio_sm_set_enabled(QUAD_PIO, quad.sm, true);
+
+    quad.use_index = use_index;
+    quad.last_count = 0;
+    quad.direction = 1;
+    memset(&quad.metrics, 0, sizeof(quad.metrics));
+    log_head = log_tail = 0;
+    log_overruns = 0;
+
+    // Registered disabled; the tick turns it on at low speed
+    gpio_irq_register(QUAD_A_PIN, GPIO_IRQ_EDGE_RISE, GPIO_IRQ_PRIO_SIGNAL, quad_edge_irq);
+    gpio_set_irq_enabled(QUAD_A_PIN, GPIO_IRQ_EDGE_RISE, false);
+    if (use_index) {
+        gpio_init(QUAD_INDEX_PIN);
+        gpio_set_dir(QUAD_INDEX_PIN, GPIO_IN);
+        gpio_pull_up(QUAD_INDEX_PIN);
+        gpio_irq_register(QUAD_INDEX_PIN, GPIO_IRQ_EDGE_RISE, GPIO_IRQ_PRIO_SIGNAL, quad_index_irq);
+    }
+
+    add_repeating_timer_ms(-QUAD_WINDOW_MS, quad_tick, NULL, &quad.timer);
+    quad.running = true;
+    return true;
+}
+
+void quad_stop(void) {
+    if (!quad.running) {
+        return;
+    }
+    cancel_repeating_timer(&quad.timer);
+    gpio_irq_unregister(QUAD_A_PIN);
+    if (quad.use_index) {
+        gpio_irq_unregister(QUAD_INDEX_PIN);
+    }
+    pio_sm_set_enabled(QUAD_PIO, quad.sm, false);
+    pio_remove_program(QUAD_PIO, &quadrature_program, 0);
+    res_release_pio_sm(QUAD_PIO, quad.sm);
+    quad.sm = -1;
+    res_release_pins("quadrature", QUAD_PIN_MASK | (quad.use_index ? 1u << QUAD_INDEX_PIN : 0));
+    quad.running = false;
+}
+
+bool quad_is_running(void) {
+    return quad.running;
+}
+
+QuadMetrics quad_get_metrics(void) {
+    uint32_t save = save_and_disable_interrupts();
+    QuadMetrics m = quad.metrics;
+    restore_interrupts(save);
+    return m;
+}
+
+float quad_counts_per_s(const QuadMetrics* m) {
+    return q16_to_float(m->velocity) * 1000.0f;
+}
+
+float quad_rpm(const QuadMetrics* m, uint32_t cpr) {
+    return cpr ? quad_counts_per_s(m) * 60.0f / cpr : 0.0f;
+}
+
+// Streams every window to SD as CSV, and to USB at 10 Hz, until a key is pressed
+bool quad_log(uint32_t cpr) {
+    bool started_here = !quad.running;
+    if (!quad_start(false)) {
+        return false;
+    }
+    if (ensureSDMounted() != FR_OK) {
+        if (started_here) quad_stop();
+        return false;
+    }
+    FIL file;
+    if (f_open(&file, QUAD_FILE, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) {
+        printf("Quadrature: f_open failed\n");
+        if (started_here) quad_stop();
+        return false;
+    }
+    f_puts("time_ms,count,counts_per_s,rpm\n", &file);
+    printf("Quadrature log: A GP%d, B GP%d, %u ms windows, %lu CPR, any key stops\n",
+           QUAD_A_PIN, QUAD_B_PIN, QUAD_WINDOW_MS, cpr);
+
+    log_tail = log_head;
+    uint32_t lines = 0;
+    bool ok = true;
+    while (ok && getchar_timeout_us(0) == PICO_ERROR_TIMEOUT) {
+        if (log_tail == log_head) {
+            sleep_ms(QUAD_WINDOW_MS);
+            continue;
+        }
+        QuadSample s = log_ring[log_tail];
+        log_tail = (log_tail + 1) % QUAD_LOG_RING;
+
+        QuadMetrics m = { .count = s.count, .velocity = s.velocity };
+        float cps = quad_counts_per_s(&m);
+        float rpm = quad_rpm(&m, cpr);
+        char line[64];
+        int len = snprintf(line, sizeof(line), "%lu,%ld,%.2f,%.2f\n", s.time_ms, s.count, cps, rpm);
+        ok = f_puts(line, &file) == len;
+        if (lines++ % (100 / QUAD_WINDOW_MS) == 0) {
+            printf("  %8lu ms  %10ld counts  %10.1f counts/s  %8.1f rpm\n", s.time_ms, s.count, cps, rpm);
+        }
+    }
+    ok = f_close(&file) == FR_OK && ok;
+    printf("Quadrature log: %lu samples, %lu overruns%s\n", lines, log_overruns,
+           ok ? "" : ", SD write failed");
+    if (ok) printf("  Saved to %s\n", QUAD_FILE);
+    if (started_here) quad_stop();
+    return ok;
+}
@@ -0,0 +1,57 @@
+#ifndef QUADRATURE_H
+#define QUADRATURE_H
+
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include <stdio.h>
+#include <stdbool.h>
+#include "fixmath.h"
+
+// Quadrature encoder input. A PIO state machine counts every A/B edge, so
+// the position never costs the CPU anything at any speed. Velocity comes
+// from a repeating timer:
+//
+//   - Normally the count delta over each QUAD_WINDOW_MS window.
+//   - Below QUAD_PERIOD_THRESHOLD counts per window that gets too coarse, so
+//     a rising-edge IRQ on A is switched on and the A period (4 counts) is
+//     used instead. If no edge has come for longer than the last period,
+//     the estimate decays towards zero instead of holding the old speed.
+//
+// The optional index pulse latches the count once per revolution. Each
+// window also goes into a small ring that quad_log() streams to USB and SD.
+
+#define QUAD_A_PIN 27                   // B is GP28
+#define QUAD_B_PIN (QUAD_A_PIN + 1)
+#define QUAD_INDEX_PIN 0                // GP13 is the PDM mic clock
+#define QUAD_PIO pio0
+#define QUAD_WINDOW_MS 10
+#define QUAD_PERIOD_THRESHOLD 16        // Counts per window
+#define QUAD_STOP_MS 500                // No edge for this long is standstill
+#define QUAD_DEFAULT_CPR 2048           // Counts per revolution (x4 decoding)
+#define QUAD_LOG_RING 256
+#define QUAD_FILE "quad.csv"
+
+typedef struct {
+    int32_t count;
+    q16_t velocity;                     // Counts per ms
+    bool period_mode;                   // Velocity from edge timing
+    uint32_t index_pulses;
+    int32_t index_count;                // Count at the last index pulse
+} QuadMetrics;
+
+typedef struct {
+    uint32_t time_ms;
+    int32_t count;
+    q16_t velocity;
+} QuadSample;
+
+// Function declarations
+bool quad_start(bool use_index);
+void quad_stop(void);
+bool quad_is_running(void);
+QuadMetrics quad_get_metrics(void);
+float quad_counts_per_s(const QuadMetrics* m);
+float quad_rpm(const QuadMetrics* m, uint32_t cpr);
+bool quad_log(uint32_t cpr);
+
+#endif // QUADRATURE_H
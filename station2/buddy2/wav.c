@@ -0,0 +1,125 @@
+#include "wav.h"
+#include <string.h>
+
+#define WAV_FORMAT_PCM 1
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE
+
+typedef struct __attribute__((packed)) {
+    char riff[4];
+    uint32_t riff_size;
+    char wave[4];
+    char fmt[4];
+    uint32_t fmt_size;
+    uint16_t format;
+    uint16_t channels;
+    uint32_t rate_hz;
+    uint32_t byte_rate;
+    uint16_t block_align;
+    uint16_t bits;
+} WavFmt;
+
+// WAVE_FORMAT_EXTENSIBLE tail of the fmt chunk, needed for more than 16
+// bits or more than 2 channels
+typedef struct __attribute__((packed)) {
+    uint16_t ext_size;
+    uint16_t valid_bits;
+    uint32_t channel_mask;      // 0 leaves the channels unassigned, as TDM slots are
+    uint8_t subformat[16];
+} WavFmtExtensible;
+
+typedef struct __attribute__((packed)) {
+    char data[4];
+    uint32_t data_size;
+} WavData;
+
+// KSDATAFORMAT_SUBTYPE_PCM
+static const uint8_t PCM_SUBFORMAT[16] = {
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00,
+    0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71
+};
+
+static bool write_header(WavWriter* w) {
+    bool extensible = w->bits > 16 || w->channels > 2;
+    uint16_t block_align = w->channels * (w->bits / 8);
+    uint32_t header_size = sizeof(WavFmt) + sizeof(WavData) +
+                           (extensible ? sizeof(WavFmtExtensible) : 0);
+    WavFmt fmt = {
+        .riff = { 'R', 'I', 'F', 'F' },
+        .riff_size = header_size - 8 + w->data_bytes,
+        .wave = { 'W', 'A', 'V', 'E' },
+        .fmt = { 'f', 'm', 't', ' ' },
+        .fmt_size = 16 + (extensible ? sizeof(WavFmtExtensible) : 0),
+        .format = extensible ? WAV_FORMAT_EXTENSIBLE : WAV_FORMAT_PCM,
+        .channels = w->channels,
+        .rate_hz = w->rate_hz,
+        .byte_rate = w->rate_hz * block_align,
+        .block_align = block_align,
+        .bits = w->bits
+    };
+    WavFmtExtensible ext = {
+        .ext_size = sizeof(WavFmtExtensible) - 2,
+        .valid_bits = w->bits,
+        .channel_mask = w->channels == 1 ? 0x4 : w->channels == 2 ? 0x3 : 0
+    };
+    memcpy(ext.subformat, PCM_SUBFORMAT, sizeof(PCM_SUBFORMAT));
+    WavData data = {
+        .data = { 'd', 'a', 't', 'a' },
+        .data_size = w->data_bytes
+    };
+
+    uint8_t h[sizeof(WavFmt) + sizeof(WavFmtExtensible) + sizeof(WavData)];
+    uint32_t n = 0;
+    memcpy(&h[n], &fmt, sizeof(fmt));
+    n += sizeof(fmt);
+    if (extensible) {
+        memcpy(&h[n], &ext, sizeof(ext));
+        n += sizeof(ext);
+    }
+    memcpy(&h[n], &data, sizeof(data));
+    n += sizeof(data);
+
+    UINT written;
+    return f_lseek(&w->file, 0) == FR_OK &&
+           f_write(&w->file, h, n, &written) == FR_OK && written == n;
+}
+
+bool wav_open(WavWriter* w, const char* path, uint32_t rate_hz, uint16_t channels, uint16_t bits) {
+    memset(w, 0, sizeof(*w));
+    if (ensureSDMounted() != FR_OK) {
+        return false;
+    }
+    if (f_open(&w->file, path, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) {
+        printf("WAV: f_open %s failed\n", path);
+        return false;
+    }
+    w->rate_hz = rate_hz;
+    w->channels = channels;
+    w->bits = bits;
+    if (!write_header(w)) {
+        printf("WAV: header write failed\n");
+        f_close(&w->file);
+        return false;
+    }
+    w->open = true;
+    return true;
+}
+
+bool wav_write(WavWriter* w, const void* data, uint32_t bytes) {
+    UINT written;
+    if (!w->open || f_write(&w->file, data, bytes, &written) != FR_OK || written != bytes) {
+        return false;
+    }
+    w->data_bytes += bytes;
+    return true;
+}
+
+bool wav_close(WavWriter* w) {
+    if (!w->open) {
+        return false;
+    }
+    bool ok = write_header(w);
+    ok = f_close(&w->file) == FR_OK && ok;
+    w->open = false;
+    if (!ok) printf("WAV: closing failed\n");
+    return ok;
+}
@@ -0,0 +1,29 @@
+#ifndef WAV_H
+#define WAV_H
+
+#include "pico/stdlib.h"
+#include <stdio.h>
+#include <stdbool.h>
+#include "buddy1/sd_card.h"
+
+// Minimal PCM WAV writer on the SD card. The header goes out with zero
+// sizes when the file is opened and is rewritten on close, so a recording
+// cut short by a reset still holds its samples and only needs the sizes
+// fixing on the host. More than 16 bits or 2 channels get the
+// WAVE_FORMAT_EXTENSIBLE header that players expect for them.
+
+typedef struct {
+    FIL file;
+    uint32_t rate_hz;
+    uint16_t channels;
+    uint16_t bits;              // Per sample; 24-bit samples are packed in 3 bytes
+    uint32_t data_bytes;
+    bool open;
+} WavWriter;
+
+// Function declarations
+bool wav_open(WavWriter* w, const char* path, uint32_t rate_hz, uint16_t channels, uint16_t bits);
+bool wav_write(WavWriter* w, const void* data, uint32_t bytes);
+bool wav_close(WavWriter* w);
+
+#endif // WAV_H
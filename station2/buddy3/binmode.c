@@ -0,0 +1,373 @@
+#include "binmode.h"
+#include "spi.h"
+#include "i2c.h"
+#include "resources.h"
+#include "pico/stdio_usb.h"
+#include <string.h>
+
+// Private binary mode state
+typedef struct {
+    uint uart_baud;
+    bool uart_ready;
+    bool exit_requested;
+} Binmode_Config;
+
+static Binmode_Config binmode = {
+    .uart_baud = 0,
+    .uart_ready = false,
+    .exit_requested = false
+};
+
+static uint8_t request[BINMODE_MAX_REQUEST];
+static uint8_t response[7 + BINMODE_MAX_RESPONSE];
+
+// Cursors over the request ops and the response results
+typedef struct {
+    const uint8_t* p;
+    uint32_t left;
+} ReqCursor;
+
+typedef struct {
+    uint8_t* p;
+    uint32_t used;
+} RespCursor;
+
+// Talk to the CDC driver directly. Its stdio route is disabled while in binary
+// mode so stray printf()s from the peripheral drivers can't corrupt frames.
+static bool read_exact(uint8_t* dst, uint32_t len, uint32_t timeout_us) {
+    uint32_t got = 0;
+    uint32_t last = time_us_32();
+    while (got < len) {
+        int n = stdio_usb.in_chars((char*)dst + got, len - got);
+        if (n > 0) {
+            got += n;
+            last = time_us_32();
+        } else if (time_us_32() - last > timeout_us) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Drops the payload of a frame too long to run, so its bytes aren't taken
+// for a sync byte when the loop looks for the next frame
+static bool skip_exact(uint32_t len, uint32_t timeout_us) {
+    while (len > 0) {
+        uint32_t n = MIN(len, sizeof(request));
+        if (!read_exact(request, n, timeout_us)) {
+            return false;
+        }
+        len -= n;
+    }
+    return true;
+}
+
+static void write_all(const uint8_t* src, uint32_t len) {
+    stdio_usb.out_chars((const char*)src, len);
+    stdio_usb.out_flush();
+}
+
+static bool take_u8(ReqCursor* c, uint8_t* v) {
+    if (c->left < 1) return false;
+    *v = c->p[0];
+    c->p += 1;
+    c->left -= 1;
+    return true;
+}
+
+static bool take_u16(ReqCursor* c, uint16_t* v) {
+    if (c->left < 2) return false;
+    *v = c->p[0] | (c->p[1] << 8);
+    c->p += 2;
+    c->left -= 2;
+    return true;
+}
+
+static bool take_u32(ReqCursor* c, uint32_t* v) {
+    if (c->left < 4) return false;
+    *v = c->p[0] | (c->p[1] << 8) | (c->p[2] << 16) | ((uint32_t)c->p[3] << 24);
+    c->p += 4;
+    c->left -= 4;
+    return true;
+}
+
+static const uint8_t* take_bytes(ReqCursor* c, uint32_t n) {
+    if (c->left < n) return NULL;
+    const uint8_t* data = c->p;
+    c->p += n;
+    c->left -= n;
+    return data;
+}
+
+// Reserve n result bytes, or NULL if the response is full
+static uint8_t* reserve(RespCursor* r, uint32_t n) {
+    if (r->used + n > BINMODE_MAX_RESPONSE) return NULL;
+    uint8_t* out = r->p + r->used;
+    r->used += n;
+    return out;
+}
+
+static void put_u16(uint8_t* out, uint16_t v) {
+    out[0] = v & 0xFF;
+    out[1] = v >> 8;
+}
+
+static void put_u32(uint8_t* out, uint32_t v) {
+    out[0] = v & 0xFF;
+    out[1] = (v >> 8) & 0xFF;
+    out[2] = (v >> 16) & 0xFF;
+    out[3] = v >> 24;
+}
+
+static bool ensure_uart(uint baud) {
+    if (!binmode.uart_ready) {
+        uint32_t mask = (1u << BINMODE_UART_TX_PIN) | (1u << BINMODE_UART_RX_PIN);
+        if (!res_claim_pins("binmode", mask, RES_PIN_EXCLUSIVE)) {
+            return false;
+        }
+        gpio_set_function(BINMODE_UART_TX_PIN, GPIO_FUNC_UART);
+        gpio_set_function(BINMODE_UART_RX_PIN, GPIO_FUNC_UART);
+        binmode.uart_baud = uart_init(BINMODE_UART, baud);
+        binmode.uart_ready = true;
+    } else if (baud != 0) {
+        binmode.uart_baud = uart_set_baudrate(BINMODE_UART, baud);
+    }
+    return binmode.uart_baud != 0;
+}
+
+// Outputs only on pins binary mode claimed with PIN_MODE
+static bool same_pin_owner(uint pin) {
+    const char* owner = res_pin_owner(pin);
+    return owner && strcmp(owner, "binmode") == 0;
+}
+
+static uint8_t i2c_result(int ret) {
+    if (ret == PICO_ERROR_TIMEOUT) return BINI2C_TIMEOUT;
+    return ret < 0 ? BINI2C_NACK : BINI2C_OK;
+}
+
+// Execute one op. Returns BINMODE_OK to carry on with the next.
+static BinmodeStatus run_op(ReqCursor* c, RespCursor* r) {
+    uint8_t op, pin, arg;
+    uint16_t n;
+    uint32_t v, mask;
+    uint8_t* out;
+    const uint8_t* data;
+
+    if (!take_u8(c, &op)) return BINMODE_ERR_TRUNCATED;
+
+    switch (op) {
+        case BINOP_NOP:
+            return BINMODE_OK;
+
+        case BINOP_EXIT:
+            binmode.exit_requested = true;
+            return BINMODE_OK;
+
+        case BINOP_PIN_MODE:
+            if (!take_u8(c, &pin) || !take_u8(c, &arg)) return BINMODE_ERR_TRUNCATED;
+            if (pin > BINMODE_MAX_PIN || arg > BINPIN_PULL_DOWN) return BINMODE_ERR_ARG;
+            if (!res_claim_pins("binmode", 1u << pin, RES_PIN_EXCLUSIVE)) return BINMODE_ERR_ARG;
+            gpio_init(pin);
+            gpio_set_dir(pin, arg == BINPIN_OUTPUT);
+            gpio_set_pulls(pin, arg == BINPIN_PULL_UP, arg == BINPIN_PULL_DOWN);
+            return BINMODE_OK;
+
+        case BINOP_PIN_WRITE:
+            if (!take_u8(c, &pin) || !take_u8(c, &arg)) return BINMODE_ERR_TRUNCATED;
+            if (pin > BINMODE_MAX_PIN || !same_pin_owner(pin)) return BINMODE_ERR_ARG;
+            gpio_put(pin, arg != 0);
+            return BINMODE_OK;
+
+        case BINOP_PIN_READ:
+            if (!take_u8(c, &pin)) return BINMODE_ERR_TRUNCATED;
+            if (pin > BINMODE_MAX_PIN) return BINMODE_ERR_ARG;
+            if (!(out = reserve(r, 1))) return BINMODE_ERR_OVERFLOW;
+            out[0] = gpio_get(pin);
+            return BINMODE_OK;
+
+        case BINOP_PORT_WRITE:
+            if (!take_u32(c, &mask) || !take_u32(c, &v)) return BINMODE_ERR_TRUNCATED;
+            if (mask >> (BINMODE_MAX_PIN + 1)) return BINMODE_ERR_ARG;
+            for (uint p = 0; p <= BINMODE_MAX_PIN; p++) {
+                if ((mask & (1u << p)) && !same_pin_owner(p)) return BINMODE_ERR_ARG;
+            }
+            gpio_put_masked(mask, v);
+            return BINMODE_OK;
+
+        case BINOP_PORT_READ:
+            if (!(out = reserve(r, 4))) return BINMODE_ERR_OVERFLOW;
+            put_u32(out, gpio_get_all() & ((1u << (BINMODE_MAX_PIN + 1)) - 1));
+            return BINMODE_OK;
+
+        case BINOP_DELAY_US:
+            if (!take_u16(c, &n)) return BINMODE_ERR_TRUNCATED;
+            busy_wait_us_32(n);
+            return BINMODE_OK;
+
+        case BINOP_SPI_CONFIG:
+            if (!take_u32(c, &v)) return BINMODE_ERR_TRUNCATED;
+            if (v == 0 || v > SPI_MASTER_MAX_BAUD) return BINMODE_ERR_ARG;
+            if (!spi_master_init(v)) return BINMODE_ERR_INIT;
+            if (!(out = reserve(r, 4))) return BINMODE_ERR_OVERFLOW;
+            put_u32(out, spi_master_get_baud());
+            return BINMODE_OK;
+
+        case BINOP_SPI_CS:
+            if (!take_u8(c, &arg)) return BINMODE_ERR_TRUNCATED;
+            if (!spi_master_init(spi_master_get_baud() ? spi_master_get_baud() : SPI_MASTER_DEFAULT_BAUD)) {
+                return BINMODE_ERR_INIT;
+            }
+            if (arg) spi_master_deselect();
+            else spi_master_select();
+            return BINMODE_OK;
+
+        case BINOP_SPI_XFER:
+        case BINOP_SPI_READ:
+        case BINOP_SPI_WRITE:
+            if (!take_u16(c, &n)) return BINMODE_ERR_TRUNCATED;
+            data = NULL;
+            if (op != BINOP_SPI_READ && !(data = take_bytes(c, n))) return BINMODE_ERR_TRUNCATED;
+            out = NULL;
+            if (op != BINOP_SPI_WRITE && !(out = reserve(r, n))) return BINMODE_ERR_OVERFLOW;
+            if (!spi_master_init(spi_master_get_baud() ? spi_master_get_baud() : SPI_MASTER_DEFAULT_BAUD)) {
+                return BINMODE_ERR_INIT;
+            }
+            if (op == BINOP_SPI_XFER) spi_master_transfer(data, out, n);
+            else if (op == BINOP_SPI_READ) spi_master_read(out, n);
+            else spi_master_write(data, n);
+            return BINMODE_OK;
+
+        case BINOP_I2C_CONFIG:
+            if (!take_u32(c, &v)) return BINMODE_ERR_TRUNCATED;
+            if (v == 0 || v > I2C_BAUD_FAST_PLUS) return BINMODE_ERR_ARG;
+            if (!i2c_master_init(v)) return BINMODE_ERR_INIT;
+            if (!(out = reserve(r, 4))) return BINMODE_ERR_OVERFLOW;
+            put_u32(out, i2c_master_get_baud());
+            return BINMODE_OK;
+
+        case BINOP_I2C_WRITE:
+        case BINOP_I2C_READ: {
+            uint8_t addr;
+            if (!take_u8(c, &addr) || !take_u8(c, &arg) || !take_u16(c, &n)) {
+                return BINMODE_ERR_TRUNCATED;
+            }
+            if (addr > 0x7F) return BINMODE_ERR_ARG;
+            data = NULL;
+            if (op == BINOP_I2C_WRITE && !(data = take_bytes(c, n))) return BINMODE_ERR_TRUNCATED;
+            if (!(out = reserve(r, op == BINOP_I2C_READ ? 1 + n : 1))) return BINMODE_ERR_OVERFLOW;
+            if (!i2c_master_init(i2c_master_get_baud() ? i2c_master_get_baud() : I2C_BAUD_FAST)) {
+                return BINMODE_ERR_INIT;
+            }
+
+            // Budget ~10 bit times per byte plus the address, at the slowest rate
+            uint timeout = I2C_PROBE_TIMEOUT_US + n * 100;
+            bool nostop = arg & BINI2C_FLAG_NOSTOP;
+            int ret;
+            if (op == BINOP_I2C_WRITE) {
+                ret = i2c_write_timeout_us(I2C_MASTER_INST, addr, data, n, nostop, timeout);
+            } else {
+                memset(out + 1, 0, n);
+                ret = i2c_read_timeout_us(I2C_MASTER_INST, addr, out + 1, n, nostop, timeout);
+            }
+            out[0] = i2c_result(ret);
+            return BINMODE_OK;      // NACK is a result, not a protocol error
+        }
+
+        case BINOP_UART_CONFIG:
+            if (!take_u32(c, &v)) return BINMODE_ERR_TRUNCATED;
+            if (v == 0) return BINMODE_ERR_ARG;
+            if (!ensure_uart(v)) return BINMODE_ERR_INIT;
+            if (!(out = reserve(r, 4))) return BINMODE_ERR_OVERFLOW;
+            put_u32(out, binmode.uart_baud);
+            return BINMODE_OK;
+
+        case BINOP_UART_WRITE:
+            if (!take_u16(c, &n)) return BINMODE_ERR_TRUNCATED;
+            if (!(data = take_bytes(c, n))) return BINMODE_ERR_TRUNCATED;
+            if (!ensure_uart(binmode.uart_ready ? 0 : BINMODE_UART_DEFAULT_BAUD)) return BINMODE_ERR_INIT;
+            uart_write_blocking(BINMODE_UART, data, n);
+            return BINMODE_OK;
+
+        case BINOP_UART_READ: {
+            uint16_t timeout_ms;
+            if (!take_u16(c, &n) || !take_u16(c, &timeout_ms)) return BINMODE_ERR_TRUNCATED;
+            if (!(out = reserve(r, 2 + n))) return BINMODE_ERR_OVERFLOW;
+            if (!ensure_uart(binmode.uart_ready ? 0 : BINMODE_UART_DEFAULT_BAUD)) return BINMODE_ERR_INIT;
+
+            uint16_t got = 0;
+            uint32_t start = time_us_32();
+            while (got < n && time_us_32() - start < (uint32_t)timeout_ms * 1000) {
+                if (uart_is_readable(BINMODE_UART)) {
+                    out[2 + got++] = uart_getc(BINMODE_UART);
+                }
+            }
+            put_u16(out, got);
+            r->used -= n - got;     // Give back what didn't arrive
+            return BINMODE_OK;
+        }
+
+        default:
+            return BINMODE_ERR_OPCODE;
+    }
+}
+
+static void send_response(uint8_t seq, BinmodeStatus status, uint16_t done, uint32_t len) {
+    response[0] = BINMODE_RESP_SYNC;
+    response[1] = seq;
+    response[2] = status;
+    put_u16(&response[3], done);
+    put_u16(&response[5], len);
+    write_all(response, 7 + len);
+}
+
+void binmode_run(void) {
+    printf("Entering binary mode, send an EXIT op to return\n");
+    stdio_flush();
+    stdio_set_driver_enabled(&stdio_usb, false);
+
+    binmode.exit_requested = false;
+    write_all((const uint8_t*)BINMODE_BANNER, strlen(BINMODE_BANNER));
+
+    while (!binmode.exit_requested && stdio_usb_connected()) {
+        // Bytes outside a frame are dropped, which also resyncs after an error
+        uint8_t hdr[4];
+        if (!read_exact(hdr, 1, BINMODE_FRAME_TIMEOUT_US) || hdr[0] != BINMODE_REQ_SYNC) {
+            continue;
+        }
+        if (!read_exact(&hdr[1], 3, BINMODE_FRAME_TIMEOUT_US)) {
+            send_response(0, BINMODE_ERR_TIMEOUT, 0, 0);
+            continue;
+        }
+        uint8_t seq = hdr[1];
+        uint16_t len = hdr[2] | (hdr[3] << 8);
+        if (len > BINMODE_MAX_REQUEST) {
+            bool skipped = skip_exact(len, BINMODE_FRAME_TIMEOUT_US);
+            send_response(seq, skipped ? BINMODE_ERR_TOO_LONG : BINMODE_ERR_TIMEOUT, 0, 0);
+            continue;
+        }
+        if (!read_exact(request, len, BINMODE_FRAME_TIMEOUT_US)) {
+            send_response(seq, BINMODE_ERR_TIMEOUT, 0, 0);
+            continue;
+        }
+
+        ReqCursor c = { .p = request, .left = len };
+        RespCursor r = { .p = &response[7], .used = 0 };
+        BinmodeStatus status = BINMODE_OK;
+        uint16_t done = 0;
+        while (c.left > 0) {
+            status = run_op(&c, &r);
+            if (status != BINMODE_OK) break;
+            done++;
+        }
+        send_response(seq, status, done, r.used);
+    }
+
+    if (binmode.uart_ready) {
+        uart_deinit(BINMODE_UART);
+        binmode.uart_ready = false;
+    }
+    res_release_all("binmode");
+    stdio_set_driver_enabled(&stdio_usb, true);
+    printf("Left binary mode\n");
+}
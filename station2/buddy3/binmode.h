@@ -0,0 +1,81 @@
+#ifndef BINMODE_H
+#define BINMODE_H
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/uart.h"
+
+// Binary bit-bang mode for host scripting over USB CDC.
+//
+// Request frame:   A5 seq len_lo len_hi ops[len]
+// Response frame:  5A seq status done_lo done_hi len_lo len_hi results[len]
+//
+// The ops in a request run back-to-back at device speed and their results are
+// appended in order, so one USB round-trip covers a whole scripted sequence.
+// Execution stops at the first failing op; 'done' counts the ops that ran.
+// Multi-byte fields are little-endian.
+
+#define BINMODE_REQ_SYNC 0xA5
+#define BINMODE_RESP_SYNC 0x5A
+#define BINMODE_BANNER "BBIO1"
+#define BINMODE_MAX_REQUEST 4096
+#define BINMODE_MAX_RESPONSE 8192
+#define BINMODE_FRAME_TIMEOUT_US 100000     // Gap allowed inside one frame
+
+// Raw UART for scripting (the I2C sniffer pins, unused by the passive analyzer)
+#define BINMODE_UART uart1
+#define BINMODE_UART_TX_PIN 8
+#define BINMODE_UART_RX_PIN 9
+#define BINMODE_UART_DEFAULT_BAUD 115200
+
+#define BINMODE_MAX_PIN 22      // GP23-25 and GP29 belong to the CYW43 on Pico W
+
+// Opcodes                          args                              -> results
+#define BINOP_NOP 0x00
+#define BINOP_EXIT 0x01             //                                   (leave after reply)
+#define BINOP_PIN_MODE 0x10         // pin, mode (BINPIN_*)
+#define BINOP_PIN_WRITE 0x11        // pin, level
+#define BINOP_PIN_READ 0x12         // pin                            -> level
+#define BINOP_PORT_WRITE 0x13       // mask u32, value u32
+#define BINOP_PORT_READ 0x14        //                                -> u32
+#define BINOP_DELAY_US 0x15         // us u16
+#define BINOP_SPI_CONFIG 0x20       // baud u32                       -> actual u32
+#define BINOP_SPI_CS 0x21           // level
+#define BINOP_SPI_XFER 0x22         // n u16, data[n]                 -> data[n]
+#define BINOP_SPI_READ 0x23         // n u16                          -> data[n]
+#define BINOP_SPI_WRITE 0x24        // n u16, data[n]
+#define BINOP_I2C_CONFIG 0x30       // baud u32                       -> actual u32
+#define BINOP_I2C_WRITE 0x31        // addr, flags, n u16, data[n]    -> BINI2C_*
+#define BINOP_I2C_READ 0x32         // addr, flags, n u16             -> BINI2C_*, data[n]
+#define BINOP_UART_CONFIG 0x40      // baud u32                       -> actual u32
+#define BINOP_UART_WRITE 0x41       // n u16, data[n]
+#define BINOP_UART_READ 0x42        // n u16, timeout_ms u16          -> got u16, data[got]
+
+#define BINPIN_INPUT 0
+#define BINPIN_OUTPUT 1
+#define BINPIN_PULL_UP 2
+#define BINPIN_PULL_DOWN 3
+
+#define BINI2C_FLAG_NOSTOP 0x01     // Keep the bus for a repeated start
+
+#define BINI2C_OK 0
+#define BINI2C_NACK 1
+#define BINI2C_TIMEOUT 2
+
+// Response status
+typedef enum {
+    BINMODE_OK = 0,
+    BINMODE_ERR_OPCODE,         // Unknown opcode
+    BINMODE_ERR_TRUNCATED,      // Op arguments run past the end of the request
+    BINMODE_ERR_ARG,            // Bad pin, length or mode
+    BINMODE_ERR_OVERFLOW,       // Results would exceed BINMODE_MAX_RESPONSE
+    BINMODE_ERR_TOO_LONG,       // Request longer than BINMODE_MAX_REQUEST
+    BINMODE_ERR_TIMEOUT,        // Frame stalled part way through
+    BINMODE_ERR_INIT            // Peripheral could not be brought up
+} BinmodeStatus;
+
+// Function declarations
+void binmode_run(void);
+
+#endif // BINMODE_H
@@ -0,0 +1,470 @@
+#include "i2c.h"
+#include "buddy1/sd_card.h"
+#include "resources.h"
+#include <string.h>
+
+// Private I2C master state
+typedef struct {
+    i2c_inst_t* inst;
+    uint baud;
+    int tx_dma;
+    int rx_dma;
+    bool initialized;
+    // In-flight DMA read
+    size_t pending_len;
+    bool pending_stop;
+} I2C_Master_Config;
+
+static I2C_Master_Config i2c_master = {
+    .inst = I2C_MASTER_INST,
+    .baud = I2C_BAUD_FAST,
+    .tx_dma = -1,
+    .rx_dma = -1,
+    .initialized = false,
+    .pending_len = 0,
+    .pending_stop = false
+};
+
+#define I2C_MASTER_PIN_MASK ((1u << I2C_MASTER_SDA_PIN) | (1u << I2C_MASTER_SCL_PIN))
+
+// A read is requested by pushing a command word per byte into DATA_CMD
+static const uint32_t read_cmd = I2C_IC_DATA_CMD_CMD_BITS;
+
+static uint8_t chunk_buf[2][I2C_CHUNK_SIZE];
+static uint8_t page_buf[2][EEPROM_MAX_PAGE_SIZE];
+static uint32_t page_cmds[2 + EEPROM_MAX_PAGE_SIZE];
+
+bool i2c_master_init(uint baud) {
+    if (i2c_master.initialized) {
+        i2c_master_set_baud(baud);
+        return true;
+    }
+    if (!res_claim_pins("i2c_master", I2C_MASTER_PIN_MASK, RES_PIN_EXCLUSIVE)) {
+        return false;
+    }
+
+    i2c_master.baud = i2c_init(i2c_master.inst, baud);
+    gpio_set_function(I2C_MASTER_SDA_PIN, GPIO_FUNC_I2C);
+    gpio_set_function(I2C_MASTER_SCL_PIN, GPIO_FUNC_I2C);
+    gpio_pull_up(I2C_MASTER_SDA_PIN);
+    gpio_pull_up(I2C_MASTER_SCL_PIN);
+
+    i2c_master.tx_dma = res_claim_dma("i2c_master");
+    i2c_master.rx_dma = res_claim_dma("i2c_master");
+    if (i2c_master.tx_dma < 0 || i2c_master.rx_dma < 0) {
+        printf("Error: Could not claim DMA channels for I2C master\n");
+        i2c_master_deinit();
+        return false;
+    }
+
+    i2c_master.initialized = true;
+    printf("I2C master ready at %u Hz (SDA GP%d, SCL GP%d)\n",
+           i2c_master.baud, I2C_MASTER_SDA_PIN, I2C_MASTER_SCL_PIN);
+    return true;
+}
+
+void i2c_master_deinit(void) {
+    if (i2c_master.tx_dma >= 0) {
+        dma_channel_abort(i2c_master.tx_dma);
+        res_release_dma(i2c_master.tx_dma);
+        i2c_master.tx_dma = -1;
+    }
+    if (i2c_master.rx_dma >= 0) {
+        dma_channel_abort(i2c_master.rx_dma);
+        res_release_dma(i2c_master.rx_dma);
+        i2c_master.rx_dma = -1;
+    }
+    i2c_deinit(i2c_master.inst);
+    res_release_pins("i2c_master", I2C_MASTER_PIN_MASK);
+    i2c_master.initialized = false;
+}
+
+uint i2c_master_set_baud(uint baud) {
+    if (i2c_master.initialized) {
+        baud = i2c_set_baudrate(i2c_master.inst, baud);
+    }
+    i2c_master.baud = baud;
+    if (baud > I2C_BAUD_FAST) {
+        // Internal pull-ups are far too weak for Fast-mode Plus rise times
+        printf("I2C: %u Hz needs ~2.2k external pull-ups\n", baud);
+    }
+    return i2c_master.baud;
+}
+
+uint i2c_master_get_baud(void) {
+    return i2c_master.baud;
+}
+
+static void set_target(uint8_t addr) {
+    i2c_hw_t* hw = i2c_get_hw(i2c_master.inst);
+    hw->enable = 0;
+    hw->tar = addr;
+    hw->enable = 1;
+}
+
+// Wait for the STOP the controller sends at the end of every transaction
+// (including aborts) and report why it aborted, if it did.
+static bool finish_transaction(uint32_t timeout_us, uint32_t* abort_reason) {
+    i2c_hw_t* hw = i2c_get_hw(i2c_master.inst);
+    uint32_t start = time_us_32();
+    while (!(hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_STOP_DET_BITS)) {
+        if (time_us_32() - start > timeout_us) {
+            *abort_reason = hw->tx_abrt_source;
+            return false;
+        }
+    }
+    *abort_reason = hw->tx_abrt_source;
+    if (*abort_reason) {
+        (void)hw->clr_tx_abrt;
+    }
+    (void)hw->clr_stop_det;
+    return true;
+}
+
+// Have the controller send STOP and drop whatever is queued
+static void abort_transaction(void) {
+    i2c_hw_t* hw = i2c_get_hw(i2c_master.inst);
+    hw->enable |= I2C_IC_ENABLE_ABORT_BITS;
+    uint32_t start = time_us_32();
+    while ((hw->enable & I2C_IC_ENABLE_ABORT_BITS) && time_us_32() - start < I2C_PROBE_TIMEOUT_US) {
+        tight_loop_contents();
+    }
+    (void)hw->clr_tx_abrt;
+    (void)hw->clr_stop_det;
+}
+
+static uint8_t eeprom_dev_addr(const EEPROMConfig* cfg, uint32_t mem_addr) {
+    // Small parts take the high address bits in the device address
+    if (cfg->addr_bytes == 1) {
+        return cfg->dev_addr | ((mem_addr >> 8) & 0x07);
+    }
+    return cfg->dev_addr;
+}
+
+bool i2c_master_probe(uint8_t addr) {
+    i2c_hw_t* hw = i2c_get_hw(i2c_master.inst);
+    set_target(addr);
+
+    // One-byte read with STOP: an absent device aborts on the address NACK
+    hw->data_cmd = read_cmd | I2C_IC_DATA_CMD_STOP_BITS;
+
+    uint32_t abort_reason;
+    if (!finish_transaction(I2C_PROBE_TIMEOUT_US, &abort_reason)) {
+        return false;
+    }
+    while (hw->rxflr) {
+        (void)hw->data_cmd;
+    }
+    return abort_reason == 0;
+}
+
+int i2c_master_scan(uint8_t* found, int max_found) {
+    if (!i2c_master_init(i2c_master.baud)) {
+        return -1;
+    }
+
+    int count = 0;
+    uint32_t start = time_us_32();
+    for (uint8_t addr = I2C_SCAN_FIRST_ADDR; addr <= I2C_SCAN_LAST_ADDR; addr++) {
+        if (i2c_master_probe(addr)) {
+            if (found && count < max_found) {
+                found[count] = addr;
+            }
+            count++;
+        }
+    }
+    uint32_t elapsed = time_us_32() - start;
+
+    printf("I2C scan at %u Hz: %d device(s) in %lu us\n", i2c_master.baud, count, elapsed);
+    for (int i = 0; found && i < count && i < max_found; i++) {
+        printf("  0x%02X\n", found[i]);
+    }
+    return count;
+}
+
+// Clock 'len' bytes in via DMA. TX feeds read commands from a constant word;
+// the STOP command is pushed by dma_read_finish() only if 'stop' is set, so a
+// sequential read can run on across chunks as one transaction.
+static void dma_read_start(uint8_t* dst, size_t len, bool stop) {
+    i2c_hw_t* hw = i2c_get_hw(i2c_master.inst);
+    size_t queued = stop ? len - 1 : len;
+
+    dma_channel_config rx_cfg = dma_channel_get_default_config(i2c_master.rx_dma);
+    channel_config_set_transfer_data_size(&rx_cfg, DMA_SIZE_8);
+    channel_config_set_read_increment(&rx_cfg, false);
+    channel_config_set_write_increment(&rx_cfg, true);
+    channel_config_set_dreq(&rx_cfg, i2c_get_dreq(i2c_master.inst, false));
+    dma_channel_configure(i2c_master.rx_dma, &rx_cfg, dst, &hw->data_cmd, len, true);
+
+    if (queued) {
+        dma_channel_config tx_cfg = dma_channel_get_default_config(i2c_master.tx_dma);
+        channel_config_set_transfer_data_size(&tx_cfg, DMA_SIZE_32);
+        channel_config_set_read_increment(&tx_cfg, false);
+        channel_config_set_write_increment(&tx_cfg, false);
+        channel_config_set_dreq(&tx_cfg, i2c_get_dreq(i2c_master.inst, true));
+        dma_channel_configure(i2c_master.tx_dma, &tx_cfg, &hw->data_cmd, &read_cmd, queued, true);
+    }
+
+    i2c_master.pending_len = len;
+    i2c_master.pending_stop = stop;
+}
+
+static bool dma_read_finish(void) {
+    i2c_hw_t* hw = i2c_get_hw(i2c_master.inst);
+    // ~10 clocks per byte at the slowest supported rate, plus stretch margin
+    uint32_t timeout_us = i2c_master.pending_len * 200 + 10000;
+    uint32_t start = time_us_32();
+
+    while (dma_channel_is_busy(i2c_master.tx_dma)) {
+        if ((hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) ||
+            time_us_32() - start > timeout_us) {
+            goto fail;
+        }
+    }
+    if (i2c_master.pending_stop) {
+        hw->data_cmd = read_cmd | I2C_IC_DATA_CMD_STOP_BITS;
+    }
+    while (dma_channel_is_busy(i2c_master.rx_dma)) {
+        if ((hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) ||
+            time_us_32() - start > timeout_us) {
+            goto fail;
+        }
+    }
+    return true;
+
+fail:
+    dma_channel_abort(i2c_master.tx_dma);
+    dma_channel_abort(i2c_master.rx_dma);
+    printf("I2C: Read aborted (source 0x%08lX)\n", hw->tx_abrt_source);
+    abort_transaction();
+    return false;
+}
+
+static void write_mem_address(const EEPROMConfig* cfg, uint32_t mem_addr) {
+    i2c_hw_t* hw = i2c_get_hw(i2c_master.inst);
+    if (cfg->addr_bytes == 2) {
+        hw->data_cmd = (mem_addr >> 8) & 0xFF;
+    }
+    hw->data_cmd = mem_addr & 0xFF;
+}
+
+static void fill_stats(I2CTransferStats* stats, uint32_t bytes, uint32_t elapsed, uint32_t polls) {
+    if (!stats) return;
+    stats->bytes = bytes;
+    stats->elapsed_us = elapsed;
+    stats->baud = i2c_master.baud;
+    stats->ack_polls = polls;
+    stats->kb_per_s = elapsed ? (float)bytes * 1000000.0f / 1024.0f / (float)elapsed : 0.0f;
+}
+
+bool eeprom_dump(const EEPROMConfig* cfg, const char* filename, I2CTransferStats* stats) {
+    if (!i2c_master_init(i2c_master.baud)) {
+        return false;
+    }
+    if (!i2c_master_probe(cfg->dev_addr)) {
+        printf("EEPROM: No response at 0x%02X\n", cfg->dev_addr);
+        return false;
+    }
+    if (ensureSDMounted() != FR_OK) {
+        printf("EEPROM: SD card not available\n");
+        return false;
+    }
+
+    FIL file;
+    FRESULT fr = f_open(&file, filename, FA_CREATE_ALWAYS | FA_WRITE);
+    if (fr != FR_OK) {
+        printf("EEPROM: f_open error: %d\n", fr);
+        return false;
+    }
+    f_expand(&file, cfg->size_bytes, 1);
+
+    printf("Reading %lu byte EEPROM at 0x%02X to %s...\n",
+           cfg->size_bytes, cfg->dev_addr, filename);
+
+    // 1-byte-address parts wrap every 256 bytes, so each block is its own read
+    uint32_t span = (cfg->addr_bytes == 1) ? 256 : cfg->size_bytes;
+    uint32_t offset = 0;
+    uint32_t start = time_us_32();
+    bool ok = true;
+
+    while (offset < cfg->size_bytes && ok) {
+        uint32_t span_end = MIN(offset + span, cfg->size_bytes);
+        set_target(eeprom_dev_addr(cfg, offset));
+        write_mem_address(cfg, offset);
+
+        // Double-buffered: the next chunk is on the bus while the last one is written
+        uint cur = 0;
+        size_t prev_len = 0;
+        while (offset < span_end) {
+            size_t n = MIN(I2C_CHUNK_SIZE, span_end - offset);
+            dma_read_start(chunk_buf[cur], n, offset + n == span_end);
+
+            UINT written;
+            if (prev_len && (f_write(&file, chunk_buf[cur ^ 1], prev_len, &written) != FR_OK ||
+                             written != prev_len)) {
+                printf("EEPROM: f_write failed\n");
+                dma_read_finish();
+                abort_transaction();
+                ok = false;
+                break;
+            }
+            if (!dma_read_finish()) {
+                ok = false;
+                break;
+            }
+            prev_len = n;
+            offset += n;
+            cur ^= 1;
+        }
+
+        uint32_t abort_reason;
+        if (!ok || !finish_transaction(I2C_PROBE_TIMEOUT_US, &abort_reason) || abort_reason) {
+            ok = false;
+            break;
+        }
+
+        UINT written;
+        if (ok && prev_len && (f_write(&file, chunk_buf[cur ^ 1], prev_len, &written) != FR_OK ||
+                               written != prev_len)) {
+            printf("EEPROM: f_write failed\n");
+            ok = false;
+        }
+    }
+
+    uint32_t elapsed = time_us_32() - start;
+    if (f_close(&file) != FR_OK) {
+        ok = false;
+    }
+    if (!ok) {
+        return false;
+    }
+
+    fill_stats(stats, offset, elapsed, 0);
+    printf("EEPROM read: %lu bytes in %lu ms (%.1f KB/s at %u Hz)\n",
+           offset, elapsed / 1000,
+           elapsed ? (float)offset * 1000000.0f / 1024.0f / (float)elapsed : 0.0f,
+           i2c_master.baud);
+    return true;
+}
+
+// Acknowledge polling: the part NACKs its address until the write cycle ends
+static bool eeprom_wait_ready(uint8_t dev_addr, uint32_t* polls) {
+    uint32_t start = time_us_32();
+    while (!i2c_master_probe(dev_addr)) {
+        (*polls)++;
+        if (time_us_32() - start > EEPROM_WRITE_TIMEOUT_US) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool eeprom_write_image(const EEPROMConfig* cfg, const char* filename, I2CTransferStats* stats) {
+    if (cfg->page_size == 0 || cfg->page_size > EEPROM_MAX_PAGE_SIZE) {
+        printf("EEPROM: Unsupported page size %u\n", cfg->page_size);
+        return false;
+    }
+    if (!i2c_master_init(i2c_master.baud)) {
+        return false;
+    }
+    if (!i2c_master_probe(cfg->dev_addr)) {
+        printf("EEPROM: No response at 0x%02X\n", cfg->dev_addr);
+        return false;
+    }
+    if (ensureSDMounted() != FR_OK) {
+        printf("EEPROM: SD card not available\n");
+        return false;
+    }
+
+    FIL file;
+    FRESULT fr = f_open(&file, filename, FA_READ);
+    if (fr != FR_OK) {
+        printf("EEPROM: f_open error: %d\n", fr);
+        return false;
+    }
+    uint32_t image_size = f_size(&file);
+    if (image_size == 0 || image_size > cfg->size_bytes) {
+        printf("EEPROM: Image is %lu bytes, part is %lu bytes\n", image_size, cfg->size_bytes);
+        f_close(&file);
+        return false;
+    }
+
+    printf("Writing %lu bytes from %s to EEPROM at 0x%02X...\n",
+           image_size, filename, cfg->dev_addr);
+
+    i2c_hw_t* hw = i2c_get_hw(i2c_master.inst);
+    dma_channel_config tx_cfg = dma_channel_get_default_config(i2c_master.tx_dma);
+    channel_config_set_transfer_data_size(&tx_cfg, DMA_SIZE_32);
+    channel_config_set_read_increment(&tx_cfg, true);
+    channel_config_set_write_increment(&tx_cfg, false);
+    channel_config_set_dreq(&tx_cfg, i2c_get_dreq(i2c_master.inst, true));
+
+    uint32_t polls = 0;
+    uint32_t start = time_us_32();
+    uint cur = 0;
+    UINT got;
+    bool ok = true;
+
+    size_t n = MIN(cfg->page_size, image_size);
+    if (f_read(&file, page_buf[cur], n, &got) != FR_OK || got != n) {
+        printf("EEPROM: f_read failed\n");
+        f_close(&file);
+        return false;
+    }
+
+    for (uint32_t offset = 0; offset < image_size && ok; ) {
+        // Address bytes then data, STOP on the last byte starts the write cycle
+        size_t cmds = 0;
+        if (cfg->addr_bytes == 2) {
+            page_cmds[cmds++] = (offset >> 8) & 0xFF;
+        }
+        page_cmds[cmds++] = offset & 0xFF;
+        for (size_t i = 0; i < n; i++) {
+            page_cmds[cmds++] = page_buf[cur][i];
+        }
+        page_cmds[cmds - 1] |= I2C_IC_DATA_CMD_STOP_BITS;
+
+        uint8_t dev = eeprom_dev_addr(cfg, offset);
+        set_target(dev);
+        dma_channel_configure(i2c_master.tx_dma, &tx_cfg, &hw->data_cmd, page_cmds, cmds, true);
+
+        // Pull the next page from SD while this one goes out and programs
+        uint32_t next = offset + n;
+        size_t next_n = MIN(cfg->page_size, image_size - next);
+        if (next < image_size &&
+            (f_read(&file, page_buf[cur ^ 1], next_n, &got) != FR_OK || got != next_n)) {
+            printf("EEPROM: f_read failed\n");
+            ok = false;
+        }
+
+        dma_channel_wait_for_finish_blocking(i2c_master.tx_dma);
+        uint32_t abort_reason;
+        if (!finish_transaction(I2C_PROBE_TIMEOUT_US + cmds * 200, &abort_reason) || abort_reason) {
+            printf("EEPROM: Page write at 0x%04lX aborted (source 0x%08lX)\n", offset, abort_reason);
+            ok = false;
+            break;
+        }
+        if (!eeprom_wait_ready(dev, &polls)) {
+            printf("EEPROM: Write cycle timeout at 0x%04lX\n", offset);
+            ok = false;
+            break;
+        }
+
+        offset = next;
+        n = next_n;
+        cur ^= 1;
+    }
+
+    uint32_t elapsed = time_us_32() - start;
+    f_close(&file);
+    if (!ok) {
+        return false;
+    }
+
+    fill_stats(stats, image_size, elapsed, polls);
+    printf("EEPROM write: %lu bytes in %lu ms (%.2f KB/s, %lu ack polls)\n",
+           image_size, elapsed / 1000,
+           elapsed ? (float)image_size * 1000000.0f / 1024.0f / (float)elapsed : 0.0f,
+           polls);
+    return true;
+}
@@ -0,0 +1,60 @@
+#ifndef I2C_H
+#define I2C_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+
+// Active I2C master (i2c0). The sniffer pins in protocol_analyzer.h (GP8/9)
+// stay passive, so the master uses GP0/GP1.
+#define I2C_MASTER_INST i2c0
+#define I2C_MASTER_SDA_PIN 0
+#define I2C_MASTER_SCL_PIN 1
+
+#define I2C_BAUD_STANDARD (100 * 1000)
+#define I2C_BAUD_FAST (400 * 1000)
+#define I2C_BAUD_FAST_PLUS (1000 * 1000)
+
+#define I2C_SCAN_FIRST_ADDR 0x08    // 0x00-0x07 and 0x78-0x7F are reserved
+#define I2C_SCAN_LAST_ADDR 0x77
+#define I2C_PROBE_TIMEOUT_US 2000
+#define I2C_CHUNK_SIZE 4096
+
+#define EEPROM_DUMP_FILE "eeprom.bin"
+#define EEPROM_IMAGE_FILE "eeprom_img.bin"
+#define EEPROM_WRITE_TIMEOUT_US 20000   // Worst case tWR plus margin
+#define EEPROM_MAX_PAGE_SIZE 256
+
+// 24Cxx-style serial EEPROM geometry
+typedef struct {
+    uint8_t dev_addr;       // Usually 0x50
+    uint32_t size_bytes;
+    uint16_t page_size;
+    uint8_t addr_bytes;     // 1 for 24C01-24C16 (block bits in dev_addr), 2 above
+} EEPROMConfig;
+
+// Default part: 24C256
+#define EEPROM_DEFAULT_CONFIG { .dev_addr = 0x50, .size_bytes = 32768, .page_size = 64, .addr_bytes = 2 }
+
+typedef struct {
+    uint32_t bytes;
+    uint32_t elapsed_us;
+    uint32_t baud;
+    uint32_t ack_polls;     // Write only: polls spent waiting for tWR
+    float kb_per_s;
+} I2CTransferStats;
+
+// Function declarations
+bool i2c_master_init(uint baud);
+void i2c_master_deinit(void);
+uint i2c_master_set_baud(uint baud);
+uint i2c_master_get_baud(void);
+bool i2c_master_probe(uint8_t addr);
+int i2c_master_scan(uint8_t* found, int max_found);
+bool eeprom_dump(const EEPROMConfig* cfg, const char* filename, I2CTransferStats* stats);
+bool eeprom_write_image(const EEPROMConfig* cfg, const char* filename, I2CTransferStats* stats);
+
+#endif // I2C_H
@@ -1,4 +1,5 @@
 #include "protocol_analyzer.h"
+#include "resources.h"
 
 static volatile ProtocolMetrics protocol_metrics = {0};
 
@@ -10,23 +11,15 @@ static const uint32_t STANDARD_BAUDS[] = {
 
 void protocol_analyzer_init(void) {
     // Initialize pins
-    gpio_init(UART_RX_PIN);
-    gpio_set_dir(UART_RX_PIN, GPIO_IN);
-    gpio_pull_up(UART_RX_PIN);
-    
-    gpio_init(I2C_SCL_PIN);
-    gpio_init(I2C_SDA_PIN);
-    gpio_set_dir(I2C_SCL_PIN, GPIO_IN);
-    gpio_set_dir(I2C_SDA_PIN, GPIO_IN);
-    gpio_pull_up(I2C_SCL_PIN);
-    gpio_pull_up(I2C_SDA_PIN);
-    
-    gpio_init(SPI_SCK_PIN);
-    gpio_init(SPI_MOSI_PIN);
-    gpio_init(SPI_MISO_PIN);
-    gpio_set_dir(SPI_SCK_PIN, GPIO_IN);
-    gpio_set_dir(SPI_MOSI_PIN, GPIO_IN);
-    gpio_set_dir(SPI_MISO_PIN, GPIO_IN);
+    if (res_claim_pins("protocol_analyzer", 1u << UART_RX_PIN, RES_PIN_SHARED_INPUT)) {
+        gpio_init(UART_RX_PIN);
+        gpio_set_dir(UART_RX_PIN, GPIO_IN);
+        gpio_pull_up(UART_RX_PIN);
+    }
+
+    // The I2C/SPI sniff pins are only taken while capturing (see below). The
+    // SPI ones overlap the SD card, and re-initialising them here would
+    // unmux its bus.
     
     // Initialize metrics
     protocol_metrics.is_capturing = false;
@@ -83,33 +76,26 @@ static bool analyze_uart_timing(void) {
     // Calculate approximate baud rate
     uint32_t raw_baud = 1000000 / min_interval;
     
-    // Find closest standard baud rate
-    uint32_t closest_baud = 9600;
-    float min_error = 100.0f;
-    
-    for (int i = 0; i < sizeof(STANDARD_BAUDS)/sizeof(STANDARD_BAUDS[0]); i++) {
-        float error = fabs((float)raw_baud - (float)STANDARD_BAUDS[i]) / 
-                     (float)STANDARD_BAUDS[i] * 100.0f;
-        if (error < min_error) {
-            min_error = error;
-            closest_baud = STANDARD_BAUDS[i];
-        }
-    }
+    // Find closest standard baud rate. This runs from the edge ISR once
+    // enough edges are in, so the error stays in Q16.16 percent.
+    uq16_t min_error;
+    uint32_t closest_baud = uq16_nearest_rate(raw_baud, STANDARD_BAUDS,
+        sizeof(STANDARD_BAUDS)/sizeof(STANDARD_BAUDS[0]), &min_error);
     
     protocol_metrics.baud_rate = closest_baud;
     protocol_metrics.error_margin = min_error;
     protocol_metrics.sample_count = protocol_metrics.edge_count;
     
     // Calculate error threshold based on baud rate
-    float error_threshold;
+    uq16_t error_threshold;
     if (closest_baud <= 9600) {
-        error_threshold = 5.0f;  // Standard 5% for low baud rates
+        error_threshold = UQ16_FROM_INT(5);  // Standard 5% for low baud rates
     } else if (closest_baud <= 57600) {
-        error_threshold = 10.0f;  // 10% for medium baud rates
+        error_threshold = UQ16_FROM_INT(10);  // 10% for medium baud rates
     } else if (closest_baud <= 115200) {
-        error_threshold = 15.0f;  // 15% for high baud rates
+        error_threshold = UQ16_FROM_INT(15);  // 15% for high baud rates
     } else {
-        error_threshold = 20.0f;  // 20% for very high baud rates
+        error_threshold = UQ16_FROM_INT(20);  // 20% for very high baud rates
     }
     
     return min_error < error_threshold;
@@ -125,7 +111,25 @@ bool is_protocol_capturing(void) {
     return protocol_metrics.is_capturing;
 }
 
+// Claims whichever sniff pins are free; the rest sit this capture out
+static void claim_sniff_pins(void) {
+    uint32_t claimed = res_claim_available_pins("protocol_analyzer", SNIFF_PIN_MASK,
+                                                RES_PIN_SHARED_INPUT);
+    if (claimed & (1u << I2C_SCL_PIN)) {
+        gpio_init(I2C_SCL_PIN);
+        gpio_pull_up(I2C_SCL_PIN);
+    }
+    if (claimed & (1u << I2C_SDA_PIN)) {
+        gpio_init(I2C_SDA_PIN);
+        gpio_pull_up(I2C_SDA_PIN);
+    }
+    if (claimed & (1u << SPI_SCK_PIN)) gpio_init(SPI_SCK_PIN);
+    if (claimed & (1u << SPI_MOSI_PIN)) gpio_init(SPI_MOSI_PIN);
+    if (claimed & (1u << SPI_MISO_PIN)) gpio_init(SPI_MISO_PIN);
+}
+
 void start_protocol_capture(void) {
+    claim_sniff_pins();
     protocol_metrics.is_capturing = true;
     protocol_metrics.edge_count = 0;
     protocol_metrics.detected_protocol = PROTOCOL_UNKNOWN;
@@ -134,12 +138,13 @@ void start_protocol_capture(void) {
 
 void stop_protocol_capture(void) {
     protocol_metrics.is_capturing = false;
+    res_release_pins("protocol_analyzer", SNIFF_PIN_MASK);
     if (protocol_metrics.is_valid) {
         printf("Protocol Analysis Results:\n");
         printf("Protocol: %s\n", get_protocol_name(protocol_metrics.detected_protocol));
         if (protocol_metrics.detected_protocol == PROTOCOL_UART) {
             printf("Baud Rate: %lu\n", protocol_metrics.baud_rate);
-            printf("Error Margin: %.1f%%\n", protocol_metrics.error_margin);
+            printf("Error Margin: %.1f%%\n", uq16_to_float(protocol_metrics.error_margin));
         }
     }
 }
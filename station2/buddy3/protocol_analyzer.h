@@ -7,6 +7,7 @@
 #include "hardware/gpio.h"
 #include "hardware/timer.h"
 #include <math.h>
+#include "fixmath.h"
 
 #define UART_RX_PIN 4 
 #define I2C_SCL_PIN 8     
@@ -15,6 +16,8 @@
 #define SPI_MOSI_PIN 11  
 #define SPI_MISO_PIN 12   
 #define PROTOCOL_BUTTON_PIN 22
+#define SNIFF_PIN_MASK ((1u << I2C_SCL_PIN) | (1u << I2C_SDA_PIN) | (1u << SPI_SCK_PIN) | \
+                        (1u << SPI_MOSI_PIN) | (1u << SPI_MISO_PIN))
 
 #define MAX_EDGES 256
 #define MIN_EDGES_FOR_VALID 20
@@ -38,7 +41,7 @@ typedef struct {
     protocol_type_t detected_protocol;
     uint32_t baud_rate;        // For UART
     uint32_t clock_freq;       // For I2C/SPI
-    float error_margin;
+    uq16_t error_margin;       // Percent, Q16.16
     uint32_t sample_count;
     bool is_capturing;
     bool is_valid;
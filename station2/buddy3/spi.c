@@ -0,0 +1,166 @@
+#include "spi.h"
+#include "resources.h"
+
+// Private SPI master state
+typedef struct {
+    spi_inst_t* inst;
+    uint baud;
+    int tx_dma;
+    int rx_dma;
+    bool initialized;
+} SPI_Master_Config;
+
+static SPI_Master_Config spi_master = {
+    .inst = SPI_MASTER_INST,
+    .baud = 0,
+    .tx_dma = -1,
+    .rx_dma = -1,
+    .initialized = false
+};
+
+#define SPI_MASTER_PIN_MASK ((1u << SPI_MASTER_MISO_PIN) | (1u << SPI_MASTER_CS_PIN) | \
+                             (1u << SPI_MASTER_SCK_PIN) | (1u << SPI_MASTER_MOSI_PIN))
+
+// Constant source / sink for the half of a DMA transfer we don't care about
+static const uint8_t dummy_tx = 0xFF;
+static uint8_t dummy_rx;
+
+bool spi_master_init(uint baud) {
+    if (spi_master.initialized) {
+        spi_master_set_baud(baud);
+        return true;
+    }
+    if (!res_claim_pins("spi_master", SPI_MASTER_PIN_MASK, RES_PIN_EXCLUSIVE)) {
+        return false;
+    }
+
+    spi_master.baud = spi_init(spi_master.inst, baud);
+    spi_set_format(spi_master.inst, 8, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
+
+    gpio_set_function(SPI_MASTER_MISO_PIN, GPIO_FUNC_SPI);
+    gpio_set_function(SPI_MASTER_SCK_PIN, GPIO_FUNC_SPI);
+    gpio_set_function(SPI_MASTER_MOSI_PIN, GPIO_FUNC_SPI);
+    gpio_pull_up(SPI_MASTER_MISO_PIN);
+
+    // Fast edges are needed above ~30 MHz over jumper wires
+    gpio_set_drive_strength(SPI_MASTER_SCK_PIN, GPIO_DRIVE_STRENGTH_12MA);
+    gpio_set_drive_strength(SPI_MASTER_MOSI_PIN, GPIO_DRIVE_STRENGTH_12MA);
+    gpio_set_slew_rate(SPI_MASTER_SCK_PIN, GPIO_SLEW_RATE_FAST);
+    gpio_set_slew_rate(SPI_MASTER_MOSI_PIN, GPIO_SLEW_RATE_FAST);
+
+    // Chip select is driven by software so one command can span many DMA bursts
+    gpio_init(SPI_MASTER_CS_PIN);
+    gpio_set_dir(SPI_MASTER_CS_PIN, GPIO_OUT);
+    gpio_put(SPI_MASTER_CS_PIN, 1);
+
+    spi_master.tx_dma = res_claim_dma("spi_master");
+    spi_master.rx_dma = res_claim_dma("spi_master");
+    if (spi_master.tx_dma < 0 || spi_master.rx_dma < 0) {
+        printf("Error: Could not claim DMA channels for SPI master\n");
+        spi_master_deinit();
+        return false;
+    }
+
+    spi_master.initialized = true;
+    printf("SPI master ready at %u Hz (SCK GP%d, MOSI GP%d, MISO GP%d, CS GP%d)\n",
+           spi_master.baud, SPI_MASTER_SCK_PIN, SPI_MASTER_MOSI_PIN,
+           SPI_MASTER_MISO_PIN, SPI_MASTER_CS_PIN);
+    return true;
+}
+
+void spi_master_deinit(void) {
+    if (spi_master.tx_dma >= 0) {
+        dma_channel_abort(spi_master.tx_dma);
+        res_release_dma(spi_master.tx_dma);
+        spi_master.tx_dma = -1;
+    }
+    if (spi_master.rx_dma >= 0) {
+        dma_channel_abort(spi_master.rx_dma);
+        res_release_dma(spi_master.rx_dma);
+        spi_master.rx_dma = -1;
+    }
+    spi_deinit(spi_master.inst);
+    gpio_set_dir(SPI_MASTER_CS_PIN, GPIO_IN);
+    res_release_pins("spi_master", SPI_MASTER_PIN_MASK);
+    spi_master.initialized = false;
+}
+
+uint spi_master_set_baud(uint baud) {
+    spi_master.baud = spi_set_baudrate(spi_master.inst, baud);
+    return spi_master.baud;
+}
+
+uint spi_master_get_baud(void) {
+    return spi_master.baud;
+}
+
+void spi_master_select(void) {
+    gpio_put(SPI_MASTER_CS_PIN, 0);
+}
+
+void spi_master_deselect(void) {
+    gpio_put(SPI_MASTER_CS_PIN, 1);
+}
+
+void spi_master_write(const uint8_t* src, size_t len) {
+    spi_write_blocking(spi_master.inst, src, len);
+}
+
+void spi_master_read(uint8_t* dst, size_t len) {
+    spi_read_blocking(spi_master.inst, dummy_tx, dst, len);
+}
+
+void spi_master_transfer(const uint8_t* tx, uint8_t* rx, size_t len) {
+    spi_write_read_blocking(spi_master.inst, tx, rx, len);
+}
+
+// Start both channels together; TX is paced by the SPI DREQ and RX drains
+// the FIFO, so the bus runs back-to-back with no CPU involvement.
+static void start_dma_pair(const uint8_t* tx, bool tx_incr, uint8_t* rx, bool rx_incr, size_t len) {
+    dma_channel_config tx_cfg = dma_channel_get_default_config(spi_master.tx_dma);
+    channel_config_set_transfer_data_size(&tx_cfg, DMA_SIZE_8);
+    channel_config_set_read_increment(&tx_cfg, tx_incr);
+    channel_config_set_write_increment(&tx_cfg, false);
+    channel_config_set_dreq(&tx_cfg, spi_get_dreq(spi_master.inst, true));
+
+    dma_channel_config rx_cfg = dma_channel_get_default_config(spi_master.rx_dma);
+    channel_config_set_transfer_data_size(&rx_cfg, DMA_SIZE_8);
+    channel_config_set_read_increment(&rx_cfg, false);
+    channel_config_set_write_increment(&rx_cfg, rx_incr);
+    channel_config_set_dreq(&rx_cfg, spi_get_dreq(spi_master.inst, false));
+    // Keep the sniffer attached if the caller enabled it on this channel
+    channel_config_set_sniff_enable(&rx_cfg, true);
+
+    dma_channel_configure(spi_master.rx_dma, &rx_cfg,
+                          rx, &spi_get_hw(spi_master.inst)->dr, len, false);
+    dma_channel_configure(spi_master.tx_dma, &tx_cfg,
+                          &spi_get_hw(spi_master.inst)->dr, tx, len, false);
+
+    dma_start_channel_mask((1u << spi_master.tx_dma) | (1u << spi_master.rx_dma));
+}
+
+void spi_master_read_dma_start(uint8_t* dst, size_t len) {
+    start_dma_pair(&dummy_tx, false, dst, true, len);
+}
+
+void spi_master_write_dma_start(const uint8_t* src, size_t len) {
+    start_dma_pair(src, true, &dummy_rx, false, len);
+}
+
+// Clock data in without storing it; only useful with the sniffer attached
+void spi_master_read_dma_discard(size_t len) {
+    start_dma_pair(&dummy_tx, false, &dummy_rx, false, len);
+}
+
+bool spi_master_dma_busy(void) {
+    // RX finishes last, once the final byte has actually been clocked in
+    return dma_channel_is_busy(spi_master.rx_dma);
+}
+
+void spi_master_dma_wait(void) {
+    dma_channel_wait_for_finish_blocking(spi_master.rx_dma);
+}
+
+int spi_master_rx_dma_channel(void) {
+    return spi_master.rx_dma;
+}
@@ -0,0 +1,41 @@
+#ifndef SPI_H
+#define SPI_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "pico/stdlib.h"
+#include "hardware/spi.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+
+// Active SPI master (spi0). The sniffer pins in protocol_analyzer.h (GP10-12)
+// stay passive and the SD card keeps spi1, so the master uses its own pins.
+#define SPI_MASTER_INST spi0
+#define SPI_MASTER_MISO_PIN 16
+#define SPI_MASTER_CS_PIN 17
+#define SPI_MASTER_SCK_PIN 18
+#define SPI_MASTER_MOSI_PIN 19
+
+#define SPI_MASTER_DEFAULT_BAUD (1 * 1000 * 1000)   // Safe clock for probing
+#define SPI_MASTER_MAX_BAUD (62500 * 1000)          // clk_peri / 2
+
+// Public function declarations
+bool spi_master_init(uint baud);
+void spi_master_deinit(void);
+uint spi_master_set_baud(uint baud);
+uint spi_master_get_baud(void);
+void spi_master_select(void);
+void spi_master_deselect(void);
+void spi_master_write(const uint8_t* src, size_t len);
+void spi_master_read(uint8_t* dst, size_t len);
+void spi_master_transfer(const uint8_t* tx, uint8_t* rx, size_t len);
+
+// DMA burst helpers - the RX channel can feed the DMA sniffer for CRC32
+void spi_master_read_dma_start(uint8_t* dst, size_t len);
+void spi_master_write_dma_start(const uint8_t* src, size_t len);
+void spi_master_read_dma_discard(size_t len);
+bool spi_master_dma_busy(void);
+void spi_master_dma_wait(void);
+int spi_master_rx_dma_channel(void);
+
+#endif // SPI_H
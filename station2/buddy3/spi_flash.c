@@ -0,0 +1,572 @@
+#include "spi_flash.h"
+#include "buddy1/sd_card.h"
+#include "hardware/regs/dma.h"
+#include "interp_kernels.h"
+#include <string.h>
+
+// Double buffer: the DMA fills one half while FatFs drains the other
+static uint8_t dump_buf[2][FLASH_DUMP_CHUNK_SIZE] __attribute__((aligned(4)));
+
+// Reflected CRC-32 table for the image side of verify (the flash side uses the DMA sniffer)
+static uint32_t crc32_table[256];
+static bool crc32_table_ready = false;
+
+// Clocks tried from fastest down (clk_peri / even prescale)
+static const uint CALIBRATION_BAUDS[] = {
+    62500000, 31250000, 20833333, 15625000, 12500000
+};
+
+static void flash_command(uint8_t cmd) {
+    spi_master_select();
+    spi_master_write(&cmd, 1);
+    spi_master_deselect();
+}
+
+// Send an addressed command and leave CS asserted for the data phase
+static void flash_begin_command(const FlashInfo* info, uint8_t cmd, uint32_t addr, bool dummy) {
+    uint8_t hdr[6];
+    size_t n = 0;
+    hdr[n++] = cmd;
+    if (info->addr_bytes == 4) hdr[n++] = addr >> 24;
+    hdr[n++] = addr >> 16;
+    hdr[n++] = addr >> 8;
+    hdr[n++] = addr;
+    if (dummy) hdr[n++] = 0x00;
+    spi_master_select();
+    spi_master_write(hdr, n);
+}
+
+static void flash_begin_read(const FlashInfo* info, uint32_t addr) {
+    flash_begin_command(info,
+                        (info->addr_bytes == 4) ? FLASH_CMD_FAST_READ_4B : FLASH_CMD_FAST_READ,
+                        addr, true);
+}
+
+static void sfdp_read(uint32_t addr, uint8_t* dst, size_t len) {
+    uint8_t hdr[5] = { FLASH_CMD_READ_SFDP, addr >> 16, addr >> 8, addr, 0x00 };
+    spi_master_select();
+    spi_master_write(hdr, sizeof(hdr));
+    spi_master_read(dst, len);
+    spi_master_deselect();
+}
+
+static uint32_t read_le32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Fill in geometry from the JEDEC Basic Flash Parameter Table
+static bool parse_sfdp(FlashInfo* info) {
+    uint8_t hdr[16];
+    sfdp_read(0, hdr, sizeof(hdr));
+    if (read_le32(hdr) != SFDP_SIGNATURE) {
+        return false;
+    }
+
+    // First parameter header always points at the BFPT
+    uint8_t bfpt_dwords = hdr[11];
+    uint32_t bfpt_addr = hdr[12] | (hdr[13] << 8) | (hdr[14] << 16);
+    if (bfpt_dwords < 2) {
+        return false;
+    }
+    if (bfpt_dwords > 16) bfpt_dwords = 16;
+
+    uint8_t bfpt[64];
+    sfdp_read(bfpt_addr, bfpt, bfpt_dwords * 4);
+
+    uint32_t dw1 = read_le32(&bfpt[0]);
+    uint32_t dw2 = read_le32(&bfpt[4]);
+
+    // Density is in bits: either N+1 or 2^N
+    uint64_t bits = (dw2 & 0x80000000u) ? (1ull << (dw2 & 0x7FFFFFFF)) : ((uint64_t)dw2 + 1);
+    info->size_bytes = (uint32_t)(bits / 8);
+    info->addr_bytes = (((dw1 >> 17) & 0x3) == 0x2 || info->size_bytes > (16u << 20)) ? 4 : 3;
+
+    if ((dw1 & 0x3) == 0x1) {
+        info->sector_size = 4096;
+        info->sector_erase_cmd = (dw1 >> 8) & 0xFF;
+    }
+
+    if (bfpt_dwords >= 11) {
+        uint32_t dw11 = read_le32(&bfpt[40]);
+        info->page_size = 1u << ((dw11 >> 4) & 0xF);
+    }
+    return true;
+}
+
+bool spi_flash_init(void) {
+    return spi_master_init(SPI_MASTER_DEFAULT_BAUD);
+}
+
+bool spi_flash_probe(FlashInfo* info) {
+    if (!spi_flash_init()) {
+        return false;
+    }
+    spi_master_set_baud(SPI_MASTER_DEFAULT_BAUD);
+
+    // Parts left in deep power-down answer JEDEC ID with garbage
+    flash_command(FLASH_CMD_RELEASE_PD);
+    sleep_us(50);
+
+    uint8_t cmd = FLASH_CMD_READ_JEDEC_ID;
+    uint8_t id[3];
+    spi_master_select();
+    spi_master_write(&cmd, 1);
+    spi_master_read(id, sizeof(id));
+    spi_master_deselect();
+
+    memset(info, 0, sizeof(*info));
+    info->manufacturer_id = id[0];
+    info->memory_type = id[1];
+    info->capacity_id = id[2];
+
+    if (id[0] == 0x00 || id[0] == 0xFF) {
+        printf("SPI Flash: No device responded to JEDEC ID\n");
+        return false;
+    }
+
+    // Defaults for a generic 25-series part
+    info->addr_bytes = 3;
+    info->page_size = 256;
+    info->sector_size = 4096;
+    info->sector_erase_cmd = FLASH_CMD_SECTOR_ERASE;
+    if (id[2] >= 0x10 && id[2] <= 0x21) {
+        info->size_bytes = 1u << id[2];
+    }
+
+    info->has_sfdp = parse_sfdp(info);
+    if (info->size_bytes > (16u << 20)) {
+        info->addr_bytes = 4;
+    }
+    if (info->addr_bytes == 4 && info->sector_erase_cmd == FLASH_CMD_SECTOR_ERASE) {
+        info->sector_erase_cmd = FLASH_CMD_SECTOR_ERASE_4B;
+    }
+
+    printf("SPI Flash: JEDEC ID %02X %02X %02X, %lu KB, %s, %d-byte address\n",
+           id[0], id[1], id[2], info->size_bytes / 1024,
+           info->has_sfdp ? "SFDP" : "no SFDP", info->addr_bytes);
+
+    if (info->size_bytes == 0) {
+        printf("SPI Flash: Unknown capacity\n");
+        return false;
+    }
+    return true;
+}
+
+static void read_region_dma(const FlashInfo* info, uint32_t addr, uint8_t* dst, size_t len) {
+    flash_begin_read(info, addr);
+    spi_master_read_dma_start(dst, len);
+    spi_master_dma_wait();
+    spi_master_deselect();
+}
+
+uint spi_flash_calibrate_clock(const FlashInfo* info) {
+    // Reference read at the probe clock, which always works
+    spi_master_set_baud(SPI_MASTER_DEFAULT_BAUD);
+    read_region_dma(info, 0, dump_buf[0], FLASH_CALIBRATION_BYTES);
+
+    bool blank = true;
+    for (int i = 1; i < FLASH_CALIBRATION_BYTES; i++) {
+        if (dump_buf[0][i] != dump_buf[0][0]) {
+            blank = false;
+            break;
+        }
+    }
+    if (blank) {
+        // A uniform window can't reveal bit errors, so stay conservative
+        uint baud = spi_master_set_baud(CALIBRATION_BAUDS[2]);
+        printf("SPI Flash: Start of flash is blank, using %u Hz\n", baud);
+        return baud;
+    }
+
+    for (int i = 0; i < sizeof(CALIBRATION_BAUDS)/sizeof(CALIBRATION_BAUDS[0]); i++) {
+        uint baud = spi_master_set_baud(CALIBRATION_BAUDS[i]);
+        bool ok = true;
+
+        // Two clean passes so a marginal clock doesn't slip through
+        for (int pass = 0; pass < 2 && ok; pass++) {
+            read_region_dma(info, 0, dump_buf[1], FLASH_CALIBRATION_BYTES);
+            ok = memcmp(dump_buf[0], dump_buf[1], FLASH_CALIBRATION_BYTES) == 0;
+        }
+        if (ok) {
+            printf("SPI Flash: Reliable clock %u Hz\n", baud);
+            return baud;
+        }
+        printf("SPI Flash: %u Hz failed verification\n", baud);
+    }
+
+    uint baud = spi_master_set_baud(SPI_MASTER_DEFAULT_BAUD);
+    printf("SPI Flash: Falling back to %u Hz\n", baud);
+    return baud;
+}
+
+static void crc_sniffer_start(void) {
+    // Hardware CRC-32 on the RX channel: reflected in, reflected + inverted out
+    dma_sniffer_enable(spi_master_rx_dma_channel(), DMA_SNIFF_CTRL_CALC_VALUE_CRC32R, true);
+    hw_set_bits(&dma_hw->sniff_ctrl, DMA_SNIFF_CTRL_OUT_REV_BITS | DMA_SNIFF_CTRL_OUT_INV_BITS);
+    dma_hw->sniff_data = 0xFFFFFFFF;
+}
+
+static uint32_t crc_sniffer_stop(void) {
+    uint32_t crc = dma_hw->sniff_data;
+    dma_sniffer_disable();
+    hw_clear_bits(&dma_hw->sniff_ctrl, DMA_SNIFF_CTRL_OUT_REV_BITS | DMA_SNIFF_CTRL_OUT_INV_BITS);
+    return crc;
+}
+
+bool spi_flash_dump(const char* filename, FlashTransferStats* stats) {
+    FlashInfo info;
+    if (!spi_flash_probe(&info)) {
+        return false;
+    }
+    if (ensureSDMounted() != FR_OK) {
+        printf("SPI Flash: SD card not available\n");
+        return false;
+    }
+
+    uint baud = spi_flash_calibrate_clock(&info);
+
+    FIL file;
+    FRESULT fr = f_open(&file, filename, FA_CREATE_ALWAYS | FA_WRITE);
+    if (fr != FR_OK) {
+        printf("SPI Flash: f_open error: %d\n", fr);
+        return false;
+    }
+    // Contiguous allocation keeps FatFs from walking the FAT mid-stream
+    fr = f_expand(&file, info.size_bytes, 1);
+    if (fr != FR_OK) {
+        printf("SPI Flash: Could not preallocate %lu bytes (err %d), continuing\n",
+               info.size_bytes, fr);
+    }
+
+    printf("Dumping %lu bytes to %s...\n", info.size_bytes, filename);
+
+    crc_sniffer_start();
+    uint32_t start = time_us_32();
+    flash_begin_read(&info, 0);
+
+    uint32_t offset = 0;
+    uint cur = 0;
+    size_t cur_len = MIN(FLASH_DUMP_CHUNK_SIZE, info.size_bytes);
+    bool ok = true;
+
+    spi_master_read_dma_start(dump_buf[cur], cur_len);
+    while (true) {
+        spi_master_dma_wait();
+        uint done = cur;
+        size_t done_len = cur_len;
+        offset += done_len;
+
+        // Kick off the next burst before touching the card
+        if (offset < info.size_bytes) {
+            cur ^= 1;
+            cur_len = MIN(FLASH_DUMP_CHUNK_SIZE, info.size_bytes - offset);
+            spi_master_read_dma_start(dump_buf[cur], cur_len);
+        }
+
+        UINT written;
+        fr = f_write(&file, dump_buf[done], done_len, &written);
+        if (fr != FR_OK || written != done_len) {
+            printf("SPI Flash: f_write error: %d\n", fr);
+            spi_master_dma_wait();
+            ok = false;
+            break;
+        }
+
+        if ((offset & 0xFFFFF) == 0) {
+            printf("  %lu / %lu KB\n", offset / 1024, info.size_bytes / 1024);
+        }
+        if (offset >= info.size_bytes) break;
+    }
+
+    spi_master_deselect();
+    uint32_t elapsed = time_us_32() - start;
+    uint32_t crc = crc_sniffer_stop();
+
+    fr = f_close(&file);
+    if (fr != FR_OK) {
+        printf("SPI Flash: f_close error: %d\n", fr);
+        ok = false;
+    }
+    if (!ok) {
+        return false;
+    }
+
+    if (stats) {
+        stats->bytes = offset;
+        stats->crc32 = crc;
+        stats->elapsed_us = elapsed;
+        stats->spi_baud = baud;
+        stats->mb_per_s = elapsed ? (float)offset / (float)elapsed : 0.0f;
+    }
+
+    printf("Dump complete: %lu bytes in %.2f s (%.2f MB/s), CRC32 0x%08lX\n",
+           offset, elapsed / 1000000.0f,
+           elapsed ? (float)offset / (float)elapsed : 0.0f, crc);
+    return true;
+}
+
+static void crc32_init_table(void) {
+    if (crc32_table_ready) return;
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+        }
+        crc32_table[i] = c;
+    }
+    crc32_table_ready = true;
+}
+
+// Running CRC-32 register; start at 0xFFFFFFFF and invert at the end
+static uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t len) {
+    return crc32_lut_update(crc, data, len, crc32_table);
+}
+
+static uint8_t flash_read_status(void) {
+    uint8_t cmd = FLASH_CMD_READ_STATUS;
+    uint8_t status;
+    spi_master_select();
+    spi_master_write(&cmd, 1);
+    spi_master_read(&status, 1);
+    spi_master_deselect();
+    return status;
+}
+
+// Keep CS low and clock the status register back-to-back: the part streams
+// it continuously, so completion is seen within one byte time.
+static bool flash_wait_ready(uint32_t timeout_us) {
+    uint8_t cmd = FLASH_CMD_READ_STATUS;
+    uint8_t status;
+    uint32_t start = time_us_32();
+    spi_master_select();
+    spi_master_write(&cmd, 1);
+    do {
+        spi_master_read(&status, 1);
+        if (!(status & FLASH_STATUS_WIP)) break;
+    } while (time_us_32() - start < timeout_us);
+    spi_master_deselect();
+    return !(status & FLASH_STATUS_WIP);
+}
+
+static bool flash_unprotect(void) {
+    uint8_t status = flash_read_status();
+    if (!(status & FLASH_STATUS_BP_MASK)) {
+        return true;
+    }
+    printf("SPI Flash: Clearing block protection (status 0x%02X)\n", status);
+    flash_command(FLASH_CMD_WRITE_ENABLE);
+    // Keep the other bits: SRWD, and QE on parts that hold it in this register
+    uint8_t cmd[2] = { FLASH_CMD_WRITE_STATUS, (uint8_t)(status & ~FLASH_STATUS_BP_MASK) };
+    spi_master_select();
+    spi_master_write(cmd, sizeof(cmd));
+    spi_master_deselect();
+    if (!flash_wait_ready(FLASH_PAGE_TIMEOUT_US * 100)) {
+        return false;
+    }
+    return (flash_read_status() & FLASH_STATUS_BP_MASK) == 0;
+}
+
+static void flash_erase_sector_start(const FlashInfo* info, uint32_t addr) {
+    flash_command(FLASH_CMD_WRITE_ENABLE);
+    flash_begin_command(info, info->sector_erase_cmd, addr, false);
+    spi_master_deselect();
+}
+
+static void flash_program_page_start(const FlashInfo* info, uint32_t addr, const uint8_t* data, size_t len) {
+    flash_command(FLASH_CMD_WRITE_ENABLE);
+    flash_begin_command(info,
+                        (info->addr_bytes == 4) ? FLASH_CMD_PAGE_PROGRAM_4B : FLASH_CMD_PAGE_PROGRAM,
+                        addr, false);
+    spi_master_write_dma_start(data, len);
+    spi_master_dma_wait();
+    spi_master_deselect();
+}
+
+static bool is_blank(const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] != 0xFF) return false;
+    }
+    return true;
+}
+
+// NOR programming can only clear bits, so no erase is needed if the new
+// data never asks for a 0 -> 1 transition
+static bool is_programmable(const uint8_t* current, const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if ((current[i] & data[i]) != data[i]) return false;
+    }
+    return true;
+}
+
+// Next sector of the image, filled from SD in slices while the flash is busy
+typedef struct {
+    FIL* file;
+    uint8_t* buf;
+    size_t want;
+    size_t have;
+    uint32_t crc;
+    bool error;
+} ImagePrefetch;
+
+static void prefetch_begin(ImagePrefetch* pf, uint8_t* buf, size_t want) {
+    pf->buf = buf;
+    pf->want = want;
+    pf->have = 0;
+}
+
+static void prefetch_step(ImagePrefetch* pf, size_t max) {
+    if (pf->error || pf->have >= pf->want) return;
+    size_t n = MIN(max, pf->want - pf->have);
+    UINT got;
+    FRESULT fr = f_read(pf->file, pf->buf + pf->have, n, &got);
+    if (fr != FR_OK || got != n) {
+        printf("SPI Flash: f_read error: %d\n", fr);
+        pf->error = true;
+        return;
+    }
+    pf->crc = crc32_update(pf->crc, pf->buf + pf->have, n);
+    pf->have += n;
+}
+
+bool spi_flash_program(const char* filename, FlashProgramStats* stats) {
+    FlashInfo info;
+    if (!spi_flash_probe(&info)) {
+        return false;
+    }
+    if (info.sector_size != FLASH_SECTOR_SIZE || info.page_size > FLASH_SECTOR_SIZE) {
+        printf("SPI Flash: Unsupported geometry (sector %lu, page %lu)\n",
+               info.sector_size, info.page_size);
+        return false;
+    }
+    if (ensureSDMounted() != FR_OK) {
+        printf("SPI Flash: SD card not available\n");
+        return false;
+    }
+
+    FIL file;
+    FRESULT fr = f_open(&file, filename, FA_READ);
+    if (fr != FR_OK) {
+        printf("SPI Flash: f_open error: %d\n", fr);
+        return false;
+    }
+    uint32_t image_size = f_size(&file);
+    if (image_size == 0 || image_size > info.size_bytes) {
+        printf("SPI Flash: Image is %lu bytes, flash is %lu bytes\n", image_size, info.size_bytes);
+        f_close(&file);
+        return false;
+    }
+
+    uint baud = spi_flash_calibrate_clock(&info);
+    if (!flash_unprotect()) {
+        printf("SPI Flash: Part is write protected\n");
+        f_close(&file);
+        return false;
+    }
+
+    crc32_init_table();
+    uint8_t* image_buf[2] = { &dump_buf[0][0], &dump_buf[0][FLASH_SECTOR_SIZE] };
+    uint8_t* current = dump_buf[1];
+    FlashProgramStats result = {0};
+    ImagePrefetch pf = { .file = &file, .crc = 0xFFFFFFFF, .error = false };
+    bool ok = true;
+
+    printf("Programming %lu bytes from %s...\n", image_size, filename);
+    uint32_t start = time_us_32();
+
+    uint cur = 0;
+    prefetch_begin(&pf, image_buf[cur], MIN(FLASH_SECTOR_SIZE, image_size));
+    prefetch_step(&pf, FLASH_SECTOR_SIZE);
+
+    for (uint32_t addr = 0; addr < image_size && ok; addr += FLASH_SECTOR_SIZE) {
+        if (pf.error) {
+            ok = false;
+            break;
+        }
+        uint8_t* data = image_buf[cur];
+        size_t len = pf.have;
+
+        // A quick read of what is already there decides erase / skip
+        read_region_dma(&info, addr, current, len);
+        bool same = memcmp(current, data, len) == 0;
+        bool need_erase = !same && !is_programmable(current, data, len);
+
+        if (need_erase) {
+            flash_erase_sector_start(&info, addr);
+            result.sectors_erased++;
+        } else if (same) {
+            result.sectors_skipped++;
+        }
+
+        // Queue up the next sector; during an erase the whole read overlaps it
+        uint32_t next_addr = addr + FLASH_SECTOR_SIZE;
+        cur ^= 1;
+        prefetch_begin(&pf, image_buf[cur], next_addr < image_size ?
+                       MIN(FLASH_SECTOR_SIZE, image_size - next_addr) : 0);
+        if (need_erase) {
+            prefetch_step(&pf, FLASH_SECTOR_SIZE);
+            if (!flash_wait_ready(FLASH_ERASE_TIMEOUT_US)) {
+                printf("SPI Flash: Erase timeout at 0x%08lX\n", addr);
+                ok = false;
+                break;
+            }
+        }
+
+        for (size_t off = 0; off < len && !same; off += info.page_size) {
+            size_t n = MIN(info.page_size, len - off);
+            if (need_erase ? is_blank(data + off, n) : memcmp(current + off, data + off, n) == 0) {
+                continue;
+            }
+            flash_program_page_start(&info, addr + off, data + off, n);
+            result.pages_programmed++;
+
+            // One page worth of SD reading hides under the program time
+            prefetch_step(&pf, info.page_size);
+            if (!flash_wait_ready(FLASH_PAGE_TIMEOUT_US)) {
+                printf("SPI Flash: Program timeout at 0x%08lX\n", addr + off);
+                ok = false;
+                break;
+            }
+        }
+        prefetch_step(&pf, FLASH_SECTOR_SIZE);
+
+        if ((next_addr & 0x3FFFF) == 0) {
+            printf("  %lu / %lu KB\n", next_addr / 1024, image_size / 1024);
+        }
+    }
+    f_close(&file);
+    if (!ok || pf.error) {
+        return false;
+    }
+    uint32_t image_crc = pf.crc ^ 0xFFFFFFFF;
+
+    // Verify: stream the programmed range through the sniffer, nothing kept in RAM
+    uint32_t verify_start = time_us_32();
+    crc_sniffer_start();
+    flash_begin_read(&info, 0);
+    spi_master_read_dma_discard(image_size);
+    spi_master_dma_wait();
+    spi_master_deselect();
+    uint32_t flash_crc = crc_sniffer_stop();
+    uint32_t end = time_us_32();
+
+    result.transfer.bytes = image_size;
+    result.transfer.crc32 = image_crc;
+    result.transfer.elapsed_us = end - start;
+    result.transfer.spi_baud = baud;
+    result.transfer.mb_per_s = (float)image_size / (float)(end - start);
+    result.verify_us = end - verify_start;
+    result.verified = (flash_crc == image_crc);
+
+    printf("Program complete: %lu bytes in %.2f s (%.2f MB/s end-to-end)\n",
+           image_size, result.transfer.elapsed_us / 1000000.0f, result.transfer.mb_per_s);
+    printf("  Sectors erased: %lu, unchanged: %lu, pages programmed: %lu\n",
+           result.sectors_erased, result.sectors_skipped, result.pages_programmed);
+    printf("  Verify %s in %.2f s (image 0x%08lX, flash 0x%08lX)\n",
+           result.verified ? "PASSED" : "FAILED", result.verify_us / 1000000.0f,
+           image_crc, flash_crc);
+
+    if (stats) {
+        *stats = result;
+    }
+    return result.verified;
+}
@@ -0,0 +1,74 @@
+#ifndef SPI_FLASH_H
+#define SPI_FLASH_H
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "spi.h"
+
+// Standard SPI NOR command set
+#define FLASH_CMD_READ_JEDEC_ID 0x9F
+#define FLASH_CMD_READ_SFDP 0x5A
+#define FLASH_CMD_RELEASE_PD 0xAB
+#define FLASH_CMD_FAST_READ 0x0B
+#define FLASH_CMD_FAST_READ_4B 0x0C
+#define FLASH_CMD_READ_STATUS 0x05
+#define FLASH_CMD_WRITE_STATUS 0x01
+#define FLASH_CMD_WRITE_ENABLE 0x06
+#define FLASH_CMD_PAGE_PROGRAM 0x02
+#define FLASH_CMD_PAGE_PROGRAM_4B 0x12
+#define FLASH_CMD_SECTOR_ERASE 0x20
+#define FLASH_CMD_SECTOR_ERASE_4B 0x21
+
+#define FLASH_STATUS_WIP 0x01
+#define FLASH_STATUS_BP_MASK 0x3C   // Block protect bits
+#define SFDP_SIGNATURE 0x50444653   // "SFDP" little-endian
+
+#define FLASH_DUMP_FILE "flash.bin"
+#define FLASH_DUMP_CHUNK_SIZE 16384     // Two of these are double-buffered
+#define FLASH_CALIBRATION_BYTES 4096    // Reference window for clock search
+
+#define FLASH_IMAGE_FILE "image.bin"
+#define FLASH_SECTOR_SIZE 4096
+#define FLASH_PAGE_TIMEOUT_US 5000
+#define FLASH_ERASE_TIMEOUT_US 2000000
+
+// What we learned about the attached part
+typedef struct {
+    uint8_t manufacturer_id;
+    uint8_t memory_type;
+    uint8_t capacity_id;
+    uint32_t size_bytes;
+    bool has_sfdp;
+    uint8_t addr_bytes;        // 3 or 4
+    uint32_t page_size;
+    uint32_t sector_size;
+    uint8_t sector_erase_cmd;
+} FlashInfo;
+
+// Result of a full-chip transfer
+typedef struct {
+    uint32_t bytes;
+    uint32_t crc32;            // Standard CRC-32 (same as zlib/crc32 on the host)
+    uint32_t elapsed_us;
+    uint32_t spi_baud;
+    float mb_per_s;
+} FlashTransferStats;
+
+// Result of programming an image
+typedef struct {
+    FlashTransferStats transfer;
+    uint32_t sectors_erased;
+    uint32_t sectors_skipped;      // Already matched the image
+    uint32_t pages_programmed;
+    uint32_t verify_us;
+    bool verified;
+} FlashProgramStats;
+
+// Function declarations
+bool spi_flash_init(void);
+bool spi_flash_probe(FlashInfo* info);
+uint spi_flash_calibrate_clock(const FlashInfo* info);
+bool spi_flash_dump(const char* filename, FlashTransferStats* stats);
+bool spi_flash_program(const char* filename, FlashProgramStats* stats);
+
+#endif // SPI_FLASH_H
@@ -0,0 +1,357 @@
+#include "uart_bridge.h"
+#include "buddy1/sd_card.h"
+#include "resources.h"
+#include "pico/stdio_usb.h"
+#include "tusb.h"
+#include <string.h>
+
+// The RX channel is re-armed by a control channel each time its count runs
+// out. Reloading with 2^31 keeps the count a whole number of rings, so the
+// byte total derived from it always agrees with the DMA write pointer.
+#define RX_RELOAD_COUNT 0x80000000u
+#define RX_RING_MASK (BRIDGE_RX_RING_SIZE - 1)
+#define TX_RING_MASK (BRIDGE_TX_RING_SIZE - 1)
+#define BRIDGE_PIN_MASK ((1u << BRIDGE_UART_TX_PIN) | (1u << BRIDGE_UART_RX_PIN))
+
+// Private bridge state
+typedef struct {
+    int rx_dma;
+    int rx_ctrl_dma;
+    int tx_dma;
+    uint32_t rx_last_count;
+    uint32_t rx_produced;       // Absolute byte positions, wrap at 2^32
+    uint32_t usb_pos;
+    uint32_t log_pos;
+    uint32_t decode_pos;
+    uint32_t tx_head;
+    uint32_t tx_tail;
+    uint32_t tx_inflight;
+    uint32_t last_rx_time;
+    uint32_t last_usb_time;
+    uint8_t escape_count;
+    uint32_t line_coding_rate;
+} Bridge_State;
+
+static Bridge_State bridge;
+
+static uint8_t rx_ring[BRIDGE_RX_RING_SIZE] __attribute__((aligned(BRIDGE_RX_RING_SIZE)));
+static uint8_t tx_ring[BRIDGE_TX_RING_SIZE] __attribute__((aligned(BRIDGE_TX_RING_SIZE)));
+static const uint32_t rx_reload_count = RX_RELOAD_COUNT;
+
+static bool claim_channels(void) {
+    bridge.rx_dma = res_claim_dma("uart_bridge");
+    bridge.rx_ctrl_dma = res_claim_dma("uart_bridge");
+    bridge.tx_dma = res_claim_dma("uart_bridge");
+    return bridge.rx_dma >= 0 && bridge.rx_ctrl_dma >= 0 && bridge.tx_dma >= 0;
+}
+
+static void release_channels(void) {
+    if (bridge.rx_dma >= 0) {
+        dma_channel_config c = dma_get_channel_config(bridge.rx_dma);
+        channel_config_set_chain_to(&c, bridge.rx_dma);     // Stop the re-arm loop first
+        dma_channel_set_config(bridge.rx_dma, &c, false);
+        dma_channel_abort(bridge.rx_dma);
+        res_release_dma(bridge.rx_dma);
+    }
+    if (bridge.rx_ctrl_dma >= 0) {
+        dma_channel_abort(bridge.rx_ctrl_dma);
+        res_release_dma(bridge.rx_ctrl_dma);
+    }
+    if (bridge.tx_dma >= 0) {
+        dma_channel_abort(bridge.tx_dma);
+        res_release_dma(bridge.tx_dma);
+    }
+    bridge.rx_dma = bridge.rx_ctrl_dma = bridge.tx_dma = -1;
+}
+
+static void start_rx_dma(void) {
+    uart_hw_t* hw = uart_get_hw(BRIDGE_UART);
+
+    dma_channel_config ctrl = dma_channel_get_default_config(bridge.rx_ctrl_dma);
+    channel_config_set_transfer_data_size(&ctrl, DMA_SIZE_32);
+    channel_config_set_read_increment(&ctrl, false);
+    channel_config_set_write_increment(&ctrl, false);
+    dma_channel_configure(bridge.rx_ctrl_dma, &ctrl,
+                          &dma_hw->ch[bridge.rx_dma].al1_transfer_count_trig,
+                          &rx_reload_count, 1, false);
+
+    dma_channel_config c = dma_channel_get_default_config(bridge.rx_dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, BRIDGE_RX_RING_BITS);
+    channel_config_set_dreq(&c, uart_get_dreq(BRIDGE_UART, false));
+    channel_config_set_chain_to(&c, bridge.rx_ctrl_dma);
+    dma_channel_configure(bridge.rx_dma, &c, rx_ring, &hw->dr, RX_RELOAD_COUNT, true);
+    bridge.rx_last_count = RX_RELOAD_COUNT;
+}
+
+static void setup_tx_dma(void) {
+    dma_channel_config c = dma_channel_get_default_config(bridge.tx_dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_ring(&c, false, BRIDGE_TX_RING_BITS);
+    channel_config_set_dreq(&c, uart_get_dreq(BRIDGE_UART, true));
+    dma_channel_configure(bridge.tx_dma, &c, &uart_get_hw(BRIDGE_UART)->dr, tx_ring, 0, false);
+}
+
+// Follow the host's SET_LINE_CODING so terminal programs can pick the rate
+static void apply_line_coding(UartBridgeStats* stats) {
+    cdc_line_coding_t coding;
+    tud_cdc_get_line_coding(&coding);
+    if (coding.bit_rate == bridge.line_coding_rate) {
+        return;
+    }
+    bridge.line_coding_rate = coding.bit_rate;
+    if (coding.bit_rate < 300 || coding.bit_rate > BRIDGE_MAX_BAUD) {
+        return;
+    }
+    uart_parity_t parity = coding.parity == 1 ? UART_PARITY_ODD :
+                           coding.parity == 2 ? UART_PARITY_EVEN : UART_PARITY_NONE;
+    uint data_bits = (coding.data_bits >= 5 && coding.data_bits <= 8) ? coding.data_bits : 8;
+    stats->baud = uart_set_baudrate(BRIDGE_UART, coding.bit_rate);
+    uart_set_format(BRIDGE_UART, data_bits, coding.stop_bits == 2 ? 2 : 1, parity);
+}
+
+static void update_rx_produced(UartBridgeStats* stats) {
+    uint32_t count = dma_channel_hw_addr(bridge.rx_dma)->transfer_count;
+    uint32_t delta = (bridge.rx_last_count - count) & (RX_RELOAD_COUNT - 1);
+    bridge.rx_last_count = count;
+    if (delta) {
+        bridge.rx_produced += delta;
+        bridge.last_rx_time = time_us_32();
+        stats->rx_bytes += delta;
+    }
+}
+
+// Readers that fall more than a ring behind lose the oldest data
+static uint32_t ring_pending(uint32_t* pos, uint32_t* dropped) {
+    uint32_t pending = bridge.rx_produced - *pos;
+    if (pending > BRIDGE_RX_RING_SIZE) {
+        *dropped += pending - BRIDGE_RX_RING_SIZE;
+        *pos = bridge.rx_produced - BRIDGE_RX_RING_SIZE;
+        pending = BRIDGE_RX_RING_SIZE;
+    }
+    return pending;
+}
+
+static uint32_t ring_segment(uint32_t pos, uint32_t pending, uint32_t max) {
+    uint32_t idx = pos & RX_RING_MASK;
+    uint32_t len = BRIDGE_RX_RING_SIZE - idx;
+    if (len > pending) len = pending;
+    if (len > max) len = max;
+    return len;
+}
+
+static void forward_to_usb(UartBridgeStats* stats) {
+    uint32_t pending = ring_pending(&bridge.usb_pos, &stats->rx_dropped);
+    if (pending > stats->max_rx_fill) {
+        stats->max_rx_fill = pending;
+    }
+    if (pending == 0) {
+        return;
+    }
+    bool idle = time_us_32() - bridge.last_rx_time >= BRIDGE_IDLE_FLUSH_US;
+    if (pending < BRIDGE_USB_CHUNK && !idle) {
+        return;
+    }
+    while (pending) {
+        uint32_t len = ring_segment(bridge.usb_pos, pending, BRIDGE_USB_CHUNK);
+        stdio_usb.out_chars((const char*)&rx_ring[bridge.usb_pos & RX_RING_MASK], len);
+        bridge.usb_pos += len;
+        pending -= len;
+    }
+    stdio_usb.out_flush();
+}
+
+// Straight from the ring to FatFs, no staging buffer
+static bool forward_to_sd(FIL* file, UartBridgeStats* stats, bool final) {
+    uint32_t pending = ring_pending(&bridge.log_pos, &stats->log_dropped);
+    while (pending >= BRIDGE_SD_CHUNK || (final && pending)) {
+        uint32_t len = ring_segment(bridge.log_pos, pending, BRIDGE_SD_CHUNK);
+        UINT written;
+        if (f_write(file, &rx_ring[bridge.log_pos & RX_RING_MASK], len, &written) != FR_OK ||
+            written != len) {
+            return false;
+        }
+        bridge.log_pos += len;
+        pending -= len;
+    }
+    return true;
+}
+
+// Decoder tap: scans new bytes in place and collects UART error events
+static void decode_rx(UartBridgeStats* stats) {
+    uint32_t dropped = 0;
+    uint32_t pending = ring_pending(&bridge.decode_pos, &dropped);
+    while (pending) {
+        uint32_t len = ring_segment(bridge.decode_pos, pending, pending);
+        const uint8_t* p = &rx_ring[bridge.decode_pos & RX_RING_MASK];
+        for (uint32_t i = 0; i < len; i++) {
+            uint8_t b = p[i];
+            if (b == '\n') {
+                stats->lines++;
+            } else if ((b < 0x20 && b != '\r' && b != '\t') || b >= 0x7F) {
+                stats->binary_bytes++;
+            }
+        }
+        bridge.decode_pos += len;
+        pending -= len;
+    }
+
+    uart_hw_t* hw = uart_get_hw(BRIDGE_UART);
+    uint32_t ris = hw->ris;
+    uint32_t errors = ris & (UART_UARTRIS_FERIS_BITS | UART_UARTRIS_PERIS_BITS |
+                             UART_UARTRIS_BERIS_BITS | UART_UARTRIS_OERIS_BITS);
+    if (errors) {
+        if (errors & UART_UARTRIS_FERIS_BITS) stats->framing_errors++;
+        if (errors & UART_UARTRIS_PERIS_BITS) stats->parity_errors++;
+        if (errors & UART_UARTRIS_BERIS_BITS) stats->breaks++;
+        if (errors & UART_UARTRIS_OERIS_BITS) stats->overruns++;
+        hw->icr = errors;
+    }
+}
+
+// USB -> TX ring -> DMA -> UART
+static void forward_to_uart(UartBridgeStats* stats) {
+    if (!dma_channel_is_busy(bridge.tx_dma)) {
+        bridge.tx_tail += bridge.tx_inflight;
+        bridge.tx_inflight = bridge.tx_head - bridge.tx_tail;
+        if (bridge.tx_inflight) {
+            // The read pointer carries on around the ring from the last transfer
+            dma_channel_set_trans_count(bridge.tx_dma, bridge.tx_inflight, true);
+        }
+    }
+
+    uint32_t used = bridge.tx_head - bridge.tx_tail;
+    uint32_t idx = bridge.tx_head & TX_RING_MASK;
+    uint32_t space = BRIDGE_TX_RING_SIZE - used;
+    if (space > BRIDGE_TX_RING_SIZE - idx) space = BRIDGE_TX_RING_SIZE - idx;
+    if (space == 0) {
+        return;
+    }
+
+    int n = stdio_usb.in_chars((char*)&tx_ring[idx], space);
+    if (n <= 0) {
+        return;
+    }
+    uint32_t now = time_us_32();
+
+    // Hayes-style escape: "+++" alone, with guard silence either side
+    for (int i = 0; i < n; i++) {
+        bool plus = tx_ring[idx + i] == '+';
+        bool guarded = bridge.escape_count > 0 ||
+                       (i == 0 && now - bridge.last_usb_time >= BRIDGE_ESCAPE_GUARD_US);
+        bridge.escape_count = (plus && guarded && bridge.escape_count < 3) ?
+                              bridge.escape_count + 1 : 0;
+    }
+    bridge.last_usb_time = now;
+    bridge.tx_head += n;
+    stats->tx_bytes += n;
+}
+
+bool uart_bridge_run(const UartBridgeConfig* cfg, UartBridgeStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    memset(&bridge, 0, sizeof(bridge));
+    bridge.rx_dma = bridge.rx_ctrl_dma = bridge.tx_dma = -1;
+
+    uint baud = cfg->baud > BRIDGE_MAX_BAUD ? BRIDGE_MAX_BAUD : cfg->baud;
+    if (!res_claim_pins("uart_bridge", BRIDGE_PIN_MASK, RES_PIN_EXCLUSIVE)) {
+        return false;
+    }
+    if (!claim_channels()) {
+        printf("Error: Could not claim DMA channels for UART bridge\n");
+        release_channels();
+        res_release_pins("uart_bridge", BRIDGE_PIN_MASK);
+        return false;
+    }
+
+    FIL log_file;
+    bool logging = false;
+    if (cfg->log_to_sd) {
+        FRESULT fr = ensureSDMounted();
+        if (fr == FR_OK) {
+            fr = f_open(&log_file, BRIDGE_LOG_FILE, FA_CREATE_ALWAYS | FA_WRITE);
+        }
+        if (fr != FR_OK) {
+            printf("Bridge: SD log unavailable (%d)\n", fr);
+            release_channels();
+            res_release_pins("uart_bridge", BRIDGE_PIN_MASK);
+            return false;
+        }
+        logging = true;
+    }
+
+    stats->baud = uart_init(BRIDGE_UART, baud);
+    gpio_set_function(BRIDGE_UART_TX_PIN, GPIO_FUNC_UART);
+    gpio_set_function(BRIDGE_UART_RX_PIN, GPIO_FUNC_UART);
+    gpio_pull_up(BRIDGE_UART_RX_PIN);
+    uart_set_fifo_enabled(BRIDGE_UART, true);
+
+    printf("UART bridge at %u baud (TX GP%d, RX GP%d)%s%s\n", stats->baud,
+           BRIDGE_UART_TX_PIN, BRIDGE_UART_RX_PIN,
+           cfg->decode ? ", decoding" : "", logging ? ", logging to " BRIDGE_LOG_FILE : "");
+    printf("Send +++ with 1 s of silence either side to return\n");
+    stdio_flush();
+    stdio_set_driver_enabled(&stdio_usb, false);
+
+    // Only a rate the host sets from now on should override cfg->baud
+    cdc_line_coding_t coding;
+    tud_cdc_get_line_coding(&coding);
+    bridge.line_coding_rate = coding.bit_rate;
+
+    setup_tx_dma();
+    start_rx_dma();
+    bridge.last_rx_time = bridge.last_usb_time = time_us_32();
+
+    bool ok = true;
+    while (true) {
+        apply_line_coding(stats);
+        update_rx_produced(stats);
+        forward_to_usb(stats);
+        if (cfg->decode) {
+            decode_rx(stats);
+        }
+        if (logging && !forward_to_sd(&log_file, stats, false)) {
+            ok = false;
+            break;
+        }
+        forward_to_uart(stats);
+
+        if (bridge.escape_count == 3 &&
+            time_us_32() - bridge.last_usb_time >= BRIDGE_ESCAPE_GUARD_US) {
+            break;
+        }
+    }
+
+    // Let queued TX drain before tearing down
+    while (dma_channel_is_busy(bridge.tx_dma)) {
+        tight_loop_contents();
+    }
+    uart_tx_wait_blocking(BRIDGE_UART);
+    update_rx_produced(stats);
+    if (logging) {
+        ok = forward_to_sd(&log_file, stats, true) && ok;
+        f_close(&log_file);
+    }
+    release_channels();
+    uart_deinit(BRIDGE_UART);
+    res_release_pins("uart_bridge", BRIDGE_PIN_MASK);
+
+    stdio_set_driver_enabled(&stdio_usb, true);
+    printf("Bridge closed: RX %llu bytes, TX %llu bytes, peak ring fill %lu / %u\n",
+           stats->rx_bytes, stats->tx_bytes, stats->max_rx_fill, BRIDGE_RX_RING_SIZE);
+    if (stats->rx_dropped || stats->log_dropped) {
+        printf("  Dropped: %lu to USB, %lu to SD\n", stats->rx_dropped, stats->log_dropped);
+    }
+    if (cfg->decode) {
+        printf("  Decoder: %lu lines, %lu binary bytes, errors FE %lu PE %lu BRK %lu OE %lu\n",
+               stats->lines, stats->binary_bytes, stats->framing_errors,
+               stats->parity_errors, stats->breaks, stats->overruns);
+    }
+    if (!ok) {
+        printf("  SD log write failed\n");
+    }
+    return ok;
+}
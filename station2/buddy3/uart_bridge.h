@@ -0,0 +1,57 @@
+#ifndef UART_BRIDGE_H
+#define UART_BRIDGE_H
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/uart.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+
+// Same hardware UART and pins as binary mode
+#define BRIDGE_UART uart1
+#define BRIDGE_UART_TX_PIN 8
+#define BRIDGE_UART_RX_PIN 9
+#define BRIDGE_DEFAULT_BAUD 115200
+#define BRIDGE_MAX_BAUD (3 * 1000 * 1000)
+
+// DMA rings must be aligned to their size
+#define BRIDGE_RX_RING_BITS 14              // 16 KB, ~50 ms at 3 Mbaud
+#define BRIDGE_TX_RING_BITS 12              // 4 KB
+#define BRIDGE_RX_RING_SIZE (1u << BRIDGE_RX_RING_BITS)
+#define BRIDGE_TX_RING_SIZE (1u << BRIDGE_TX_RING_BITS)
+
+#define BRIDGE_USB_CHUNK 512                // Forward to USB once this much is waiting...
+#define BRIDGE_IDLE_FLUSH_US 500            // ...or the line has been quiet this long
+#define BRIDGE_SD_CHUNK 4096                // Log writes, a multiple of the sector size
+#define BRIDGE_LOG_FILE "uart_log.bin"
+
+// Leave the bridge with "+++" surrounded by this much silence from the host
+#define BRIDGE_ESCAPE_GUARD_US (1000 * 1000)
+
+typedef struct {
+    uint baud;              // Initial rate; the host's CDC line coding overrides it
+    bool decode;            // Tee RX into the line decoder and error counters
+    bool log_to_sd;         // Tee RX into BRIDGE_LOG_FILE
+} UartBridgeConfig;
+
+typedef struct {
+    uint64_t rx_bytes;
+    uint64_t tx_bytes;
+    uint32_t rx_dropped;        // Overwritten in the ring before USB took them
+    uint32_t log_dropped;       // Overwritten before the SD logger took them
+    uint32_t max_rx_fill;
+    uint32_t lines;             // Decoder: complete lines seen
+    uint32_t binary_bytes;      // Decoder: non-printable, non-whitespace bytes
+    uint32_t framing_errors;    // Decoder: error events from the UART
+    uint32_t parity_errors;
+    uint32_t breaks;
+    uint32_t overruns;
+    uint baud;
+} UartBridgeStats;
+
+#define UART_BRIDGE_DEFAULT_CONFIG { .baud = BRIDGE_DEFAULT_BAUD, .decode = false, .log_to_sd = false }
+
+// Function declarations
+bool uart_bridge_run(const UartBridgeConfig* cfg, UartBridgeStats* stats);
+
+#endif // UART_BRIDGE_H
@@ -0,0 +1,347 @@
+#include "gang.h"
+#include "buddy1/sd_card.h"
+#include <string.h>
+
+#define VERIFY_WORDS 256
+#define FNC_ERASE 1                     // Init / UnInit function codes
+#define FNC_PROGRAM 2
+#define PROGRESS_BYTES (64 * 1024)
+
+static const uint clk_pins[GANG_MAX_TARGETS] = GANG_SWCLK_PINS;
+static const uint dio_pins[GANG_MAX_TARGETS] = GANG_SWDIO_PINS;
+
+static SwdPort ports[GANG_MAX_TARGETS];
+static uint num_ports;
+static uint32_t page[GANG_MAX_PAGE / 4];            // The one SD buffer, broadcast to all
+static uint32_t readback[GANG_MAX_TARGETS][VERIFY_WORDS];
+
+const char* gang_state_name(GangState state) {
+    switch (state) {
+    case GANG_IDLE: return "idle";
+    case GANG_NO_TARGET: return "no target";
+    case GANG_ERASING: return "erasing";
+    case GANG_PROGRAMMING: return "programming";
+    case GANG_VERIFYING: return "verifying";
+    case GANG_DONE: return "OK";
+    case GANG_FAILED: return "FAILED";
+    default: return "?";
+    }
+}
+
+static void fail(GangStats* stats, uint32_t* mask, uint i, const char* error, uint32_t addr) {
+    *mask &= ~(1u << i);
+    stats->target[i].state = GANG_FAILED;
+    stats->target[i].error = error;
+    stats->target[i].fail_addr = addr;
+}
+
+static void fail_all(GangStats* stats, uint32_t* mask, const char* error) {
+    SWD_FOR_EACH_PORT(i, num_ports, *mask) {
+        fail(stats, mask, i, error, 0);
+    }
+}
+
+// Records targets that dropped out of a gang transfer
+static void note_dropped(GangStats* stats, uint32_t before, uint32_t after, uint32_t addr) {
+    SWD_FOR_EACH_PORT(i, num_ports, before & ~after) {
+        fail(stats, &before, i, swd_error_string(&ports[i]), addr);
+    }
+}
+
+static void set_state(GangStats* stats, uint32_t mask, GangState state) {
+    SWD_FOR_EACH_PORT(i, num_ports, mask) {
+        stats->target[i].state = state;
+    }
+}
+
+static bool read_loader(FIL* file, GangLoader* ldr) {
+    UINT got;
+    if (f_read(file, ldr, sizeof(*ldr), &got) != FR_OK || got != sizeof(*ldr) ||
+        ldr->magic != GANG_LOADER_MAGIC) {
+        printf("Gang: %s is not a loader\n", GANG_LOADER_FILE);
+        return false;
+    }
+    if (ldr->page_size == 0 || ldr->page_size > GANG_MAX_PAGE || ldr->page_size % 4 ||
+        ldr->sector_size == 0 || ldr->sector_size % ldr->page_size) {
+        printf("Gang: unsupported geometry (page %lu, sector %lu)\n", ldr->page_size, ldr->sector_size);
+        return false;
+    }
+    return true;
+}
+
+// Fills the page buffer from SD, padding the tail with erased flash
+static bool read_chunk(FIL* file, uint32_t len, uint32_t pad_to) {
+    UINT got;
+    if (f_read(file, page, len, &got) != FR_OK || got != len) {
+        printf("Gang: f_read failed\n");
+        return false;
+    }
+    memset((uint8_t*)page + len, 0xFF, pad_to - len);
+    return true;
+}
+
+// Halts every target on its reset vector, so the loader starts from a clean
+// core with interrupts off. One reset wait covers all of them.
+static void reset_halt(uint32_t* mask, GangStats* stats) {
+    uint32_t demcr[GANG_MAX_TARGETS];
+    SWD_FOR_EACH_PORT(i, num_ports, *mask) {
+        if (!swd_reset_start(&ports[i], &demcr[i])) {
+            fail(stats, mask, i, swd_error_string(&ports[i]), 0);
+        }
+    }
+    sleep_ms(CM_RESET_MS);
+    SWD_FOR_EACH_PORT(i, num_ports, *mask) {
+        if (!swd_reset_finish(&ports[i], demcr[i])) {
+            fail(stats, mask, i, "didn't halt after reset", 0);
+        }
+    }
+}
+
+// Loader calls return to the BKPT at ldr->breakpoint, which halts the core
+static void start_call(const GangLoader* ldr, uint32_t* mask, GangStats* stats, uint32_t entry,
+                       uint32_t r0, uint32_t r1, uint32_t r2) {
+    SWD_FOR_EACH_PORT(i, num_ports, *mask) {
+        SwdPort* p = &ports[i];
+        if (!swd_write_core_reg(p, 0, r0) || !swd_write_core_reg(p, 1, r1) ||
+            !swd_write_core_reg(p, 2, r2) || !swd_write_core_reg(p, 9, ldr->static_base) ||
+            !swd_write_core_reg(p, CM_REG_SP, ldr->stack_top) ||
+            !swd_write_core_reg(p, CM_REG_LR, ldr->breakpoint | 1) ||
+            !swd_write_core_reg(p, CM_REG_XPSR, CM_XPSR_THUMB) ||
+            !swd_write_core_reg(p, CM_REG_PC, entry) || !swd_resume(p)) {
+            fail(stats, mask, i, swd_error_string(p), r0);
+        }
+    }
+}
+
+// Waits for every running call; a non-zero r0 is the loader reporting failure
+static void wait_calls(uint32_t* mask, GangStats* stats, uint32_t addr) {
+    uint32_t pending = *mask;
+    absolute_time_t timeout = make_timeout_time_ms(GANG_CALL_TIMEOUT_MS);
+    while (pending) {
+        SWD_FOR_EACH_PORT(i, num_ports, pending) {
+            SwdPort* p = &ports[i];
+            uint32_t dhcsr, r0;
+            if (!swd_mem_read32(p, CM_DHCSR, &dhcsr)) {
+                fail(stats, mask, i, swd_error_string(p), addr);
+                pending &= ~(1u << i);
+            } else if (dhcsr & CM_DHCSR_S_HALT) {
+                if (!swd_read_core_reg(p, 0, &r0)) {
+                    fail(stats, mask, i, swd_error_string(p), addr);
+                } else if (r0 != 0) {
+                    fail(stats, mask, i, "loader reported an error", addr);
+                }
+                pending &= ~(1u << i);
+            }
+        }
+        if (pending && time_reached(timeout)) {
+            SWD_FOR_EACH_PORT(i, num_ports, pending) {
+                swd_halt(&ports[i]);
+                fail(stats, mask, i, "loader timed out", addr);
+            }
+            break;
+        }
+    }
+}
+
+static void call(const GangLoader* ldr, uint32_t* mask, GangStats* stats, uint32_t entry,
+                 uint32_t r0, uint32_t r1, uint32_t r2) {
+    start_call(ldr, mask, stats, entry, r0, r1, r2);
+    wait_calls(mask, stats, r0);
+}
+
+static bool load_loader(FIL* file, const GangLoader* ldr, uint32_t* mask, GangStats* stats) {
+    uint32_t remaining = f_size(file) - sizeof(*ldr);
+    uint32_t addr = ldr->load_addr;
+    while (remaining && *mask) {
+        uint32_t n = MIN(remaining, GANG_MAX_PAGE);
+        if (!read_chunk(file, n, (n + 3) & ~3u)) {
+            return false;
+        }
+        uint32_t before = *mask;
+        swd_gang_write_words(ports, num_ports, mask, addr, page, (n + 3) / 4);
+        note_dropped(stats, before, *mask, addr);
+        addr += n;
+        remaining -= n;
+    }
+    return true;
+}
+
+// Pages go to the loader buffers alternately: while the targets program one
+// the next is read from SD and written into the other. With a single
+// buffer each write has to wait for the previous page.
+static bool program(FIL* file, const GangLoader* ldr, uint32_t* mask, GangStats* stats) {
+    bool double_buffered = ldr->buffer[1] != 0;
+    uint32_t end = ldr->flash_start + stats->image_size;
+    uint32_t running = 0;
+    uint b = 0;
+    for (uint32_t addr = ldr->flash_start; addr < end && *mask; addr += ldr->page_size) {
+        if (!read_chunk(file, MIN(ldr->page_size, end - addr), ldr->page_size)) {
+            return false;
+        }
+        if (running && !double_buffered) {
+            wait_calls(mask, stats, addr - ldr->page_size);
+        }
+        uint32_t before = *mask;
+        swd_gang_write_words(ports, num_ports, mask, ldr->buffer[b], page, ldr->page_size / 4);
+        note_dropped(stats, before, *mask, addr);
+        if (running && double_buffered) {
+            wait_calls(mask, stats, addr - ldr->page_size);
+        }
+        start_call(ldr, mask, stats, ldr->program_page, addr, ldr->page_size, ldr->buffer[b]);
+        running = *mask;
+        b ^= double_buffered;
+
+        uint32_t done = addr + ldr->page_size - ldr->flash_start;
+        if (done % PROGRESS_BYTES < ldr->page_size) {
+            printf("\r  Programmed %lu / %lu bytes", MIN(done, stats->image_size), stats->image_size);
+        }
+    }
+    if (running) {
+        wait_calls(mask, stats, end - ldr->page_size);
+    }
+    printf("\n");
+    return true;
+}
+
+// Reads back in lock-step and compares every target with the same SD chunk
+static bool verify(FIL* file, const GangLoader* ldr, uint32_t* mask, GangStats* stats) {
+    uint32_t* bufs[GANG_MAX_TARGETS];
+    for (uint i = 0; i < GANG_MAX_TARGETS; i++) {
+        bufs[i] = readback[i];
+    }
+    f_lseek(file, 0);
+    for (uint32_t off = 0; off < stats->image_size && *mask; off += VERIFY_WORDS * 4) {
+        uint32_t n = MIN(VERIFY_WORDS * 4, stats->image_size - off);
+        if (!read_chunk(file, n, (n + 3) & ~3u)) {
+            return false;
+        }
+        uint32_t addr = ldr->flash_start + off;
+        uint32_t before = *mask;
+        swd_gang_read_words(ports, num_ports, mask, addr, bufs, (n + 3) / 4);
+        note_dropped(stats, before, *mask, addr);
+        SWD_FOR_EACH_PORT(i, num_ports, *mask) {
+            if (memcmp(readback[i], page, n) != 0) {
+                uint32_t w = 0;
+                while (readback[i][w] == page[w]) w++;
+                fail(stats, mask, i, "verify mismatch", addr + w * 4);
+            }
+        }
+    }
+    return true;
+}
+
+// Lets the new firmware boot: debug off, vector catch off, then reset
+static void release(uint32_t mask) {
+    SWD_FOR_EACH_PORT(i, num_ports, mask) {
+        swd_mem_write32(&ports[i], CM_DHCSR, CM_DHCSR_KEY);
+        swd_mem_write32(&ports[i], CM_AIRCR, CM_AIRCR_SYSRESETREQ);
+    }
+}
+
+static void print_summary(const GangStats* stats) {
+    printf("Gang: %u of %u targets programmed in %lu ms\n", stats->passed, num_ports, stats->elapsed_ms);
+    for (uint i = 0; i < num_ports; i++) {
+        const GangTarget* t = &stats->target[i];
+        printf("  %u (SWCLK GP%u, SWDIO GP%u): %-9s", i, clk_pins[i], dio_pins[i], gang_state_name(t->state));
+        if (t->idcode) printf("  DPIDR 0x%08lx", t->idcode);
+        if (t->state == GANG_FAILED) printf("  %s at 0x%08lx", t->error, t->fail_addr);
+        else if (t->error) printf("  %s", t->error);
+        printf("\n");
+    }
+}
+
+// Programs GANG_IMAGE_FILE into every target that answers, with the loader
+// from GANG_LOADER_FILE. True if all connected targets passed.
+bool gang_program(const GangConfig* cfg, GangStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    num_ports = MIN(cfg->targets, GANG_MAX_TARGETS);
+    if (ensureSDMounted() != FR_OK) {
+        printf("Gang: SD card not available\n");
+        return false;
+    }
+    FIL ldr_file, image;
+    GangLoader ldr;
+    if (f_open(&ldr_file, GANG_LOADER_FILE, FA_READ) != FR_OK) {
+        printf("Gang: can't open %s\n", GANG_LOADER_FILE);
+        return false;
+    }
+    if (!read_loader(&ldr_file, &ldr)) {
+        f_close(&ldr_file);
+        return false;
+    }
+    if (f_open(&image, GANG_IMAGE_FILE, FA_READ) != FR_OK) {
+        printf("Gang: can't open %s\n", GANG_IMAGE_FILE);
+        f_close(&ldr_file);
+        return false;
+    }
+    stats->image_size = f_size(&image);
+
+    uint32_t start_ms = to_ms_since_boot(get_absolute_time());
+    uint32_t opened = 0, mask = 0;
+    for (uint i = 0; i < num_ports; i++) {
+        GangTarget* t = &stats->target[i];
+        t->state = GANG_NO_TARGET;
+        if (!swd_port_open(&ports[i], SWD_PIO, clk_pins[i], dio_pins[i], cfg->swd_hz)) {
+            t->error = "port unavailable";
+            continue;
+        }
+        opened |= 1u << i;
+        if (!swd_connect(&ports[i], cfg->targetsel)) {
+            t->error = swd_error_string(&ports[i]);
+            continue;
+        }
+        t->idcode = ports[i].idcode;
+        t->state = GANG_IDLE;
+        mask |= 1u << i;
+    }
+
+    if (mask && stats->image_size) {
+        printf("Gang: %s, %lu bytes to 0x%08lx, %d target(s)\n", GANG_IMAGE_FILE,
+               stats->image_size, ldr.flash_start, __builtin_popcount(mask));
+        reset_halt(&mask, stats);
+        if (!load_loader(&ldr_file, &ldr, &mask, stats)) {
+            fail_all(stats, &mask, "SD read failed");
+        }
+
+        set_state(stats, mask, GANG_ERASING);
+        call(&ldr, &mask, stats, ldr.init, ldr.flash_start, 0, FNC_ERASE);
+        uint32_t end = ldr.flash_start + stats->image_size;
+        for (uint32_t addr = ldr.flash_start; addr < end && mask; addr += ldr.sector_size) {
+            call(&ldr, &mask, stats, ldr.erase_sector, addr, 0, 0);
+        }
+        call(&ldr, &mask, stats, ldr.uninit, FNC_ERASE, 0, 0);
+
+        set_state(stats, mask, GANG_PROGRAMMING);
+        call(&ldr, &mask, stats, ldr.init, ldr.flash_start, 0, FNC_PROGRAM);
+        if (!program(&image, &ldr, &mask, stats)) {
+            fail_all(stats, &mask, "SD read failed");
+        }
+        call(&ldr, &mask, stats, ldr.uninit, FNC_PROGRAM, 0, 0);
+
+        if (cfg->verify) {
+            set_state(stats, mask, GANG_VERIFYING);
+            if (!verify(&image, &ldr, &mask, stats)) {
+                fail_all(stats, &mask, "SD read failed");
+            }
+        }
+        set_state(stats, mask, GANG_DONE);
+        stats->passed = __builtin_popcount(mask);
+        release(mask);
+    } else if (!stats->image_size) {
+        printf("Gang: %s is empty\n", GANG_IMAGE_FILE);
+    }
+
+    SWD_FOR_EACH_PORT(i, num_ports, opened) {
+        swd_port_close(&ports[i]);
+    }
+    f_close(&image);
+    f_close(&ldr_file);
+    stats->elapsed_ms = to_ms_since_boot(get_absolute_time()) - start_ms;
+    print_summary(stats);
+
+    uint failed = 0;
+    for (uint i = 0; i < num_ports; i++) {
+        failed += stats->target[i].state == GANG_FAILED;
+    }
+    return stats->passed > 0 && failed == 0;
+}
@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "swd.h"
+
+#ifndef GANG_H
+#define GANG_H
+
+// Gang programming: the same image into up to four SWD targets at once,
+// one PIO state machine per target port. Flashing goes through a loader
+// run on each target, with the same entry points as a CMSIS-Pack flash
+// algorithm (Init, UnInit, EraseSector, ProgramPage). Every page is read
+// once from SD into a single buffer and broadcast to all targets with
+// lock-step SWD writes, and the erase / program calls run on all targets
+// together, so N boards take about as long as one. The next page goes
+// into the second loader buffer while the targets program the current one.
+//
+// Targets that don't answer or fail are dropped and reported; the rest
+// carry on.
+
+#define GANG_MAX_TARGETS SWD_GANG_MAX
+#define GANG_SWCLK_PINS { 2, 5, 16, 18 }    // Target n on SWCLK / SWDIO pair n
+#define GANG_SWDIO_PINS { 3, 6, 17, 19 }
+#define GANG_MAX_PAGE 4096
+#define GANG_CALL_TIMEOUT_MS 5000           // Longest loader call (sector erase)
+#define GANG_LOADER_FILE "gang_ldr.bin"
+#define GANG_IMAGE_FILE "gang.bin"
+#define GANG_LOADER_MAGIC 0x52444C47        // "GLDR"
+
+// Header of GANG_LOADER_FILE; the loader code follows it and is copied to
+// load_addr. The fields are those of a .FLM flash algorithm, all absolute
+// target addresses. The functions return to breakpoint, a BKPT.
+typedef struct {
+    uint32_t magic;
+    uint32_t load_addr;
+    uint32_t init;                          // int Init(addr, clk, fnc)
+    uint32_t uninit;                        // int UnInit(fnc)
+    uint32_t erase_sector;                  // int EraseSector(addr)
+    uint32_t program_page;                  // int ProgramPage(addr, size, buf)
+    uint32_t breakpoint;
+    uint32_t static_base;                   // r9
+    uint32_t stack_top;
+    uint32_t buffer[2];                     // Page buffers; buffer[1] 0 if only one fits
+    uint32_t flash_start;                   // Where the image goes
+    uint32_t page_size;
+    uint32_t sector_size;
+} GangLoader;
+
+typedef enum {
+    GANG_IDLE,
+    GANG_NO_TARGET,
+    GANG_ERASING,
+    GANG_PROGRAMMING,
+    GANG_VERIFYING,
+    GANG_DONE,
+    GANG_FAILED
+} GangState;
+
+typedef struct {
+    GangState state;
+    uint32_t idcode;
+    uint32_t fail_addr;                     // Flash address being worked on at failure
+    const char* error;
+} GangTarget;
+
+typedef struct {
+    uint targets;                           // Ports to try, from port 0
+    uint32_t targetsel;                     // 0 unless the targets are multi-drop
+    uint32_t swd_hz;
+    bool verify;
+} GangConfig;
+
+#define GANG_DEFAULT_CONFIG { GANG_MAX_TARGETS, 0, SWD_DEFAULT_HZ, true }
+
+typedef struct {
+    GangTarget target[GANG_MAX_TARGETS];
+    uint32_t image_size;
+    uint32_t elapsed_ms;
+    uint passed;
+} GangStats;
+
+// Function declarations
+bool gang_program(const GangConfig* cfg, GangStats* stats);
+const char* gang_state_name(GangState state);
+
+#endif // GANG_H
@@ -0,0 +1,751 @@
+#include "gdb_server.h"
+#include "pico/cyw43_arch.h"
+#include "lwip/tcp.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define RX_SIZE (2 * GDB_MAX_PACKET)
+#define TX_SIZE (GDB_MAX_PACKET + 4)    // $, #, checksum
+#define MEM_CHUNK (GDB_MAX_PACKET / 2)  // Largest m reply, as hex
+#define GDB_SIGINT 2
+#define GDB_SIGTRAP 5
+
+static const char target_xml[] =
+    "<?xml version=\"1.0\"?>"
+    "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+    "<target><architecture>arm</architecture>"
+    "<feature name=\"org.gnu.gdb.arm.m-profile\">"
+    "<reg name=\"r0\" bitsize=\"32\"/><reg name=\"r1\" bitsize=\"32\"/>"
+    "<reg name=\"r2\" bitsize=\"32\"/><reg name=\"r3\" bitsize=\"32\"/>"
+    "<reg name=\"r4\" bitsize=\"32\"/><reg name=\"r5\" bitsize=\"32\"/>"
+    "<reg name=\"r6\" bitsize=\"32\"/><reg name=\"r7\" bitsize=\"32\"/>"
+    "<reg name=\"r8\" bitsize=\"32\"/><reg name=\"r9\" bitsize=\"32\"/>"
+    "<reg name=\"r10\" bitsize=\"32\"/><reg name=\"r11\" bitsize=\"32\"/>"
+    "<reg name=\"r12\" bitsize=\"32\"/>"
+    "<reg name=\"sp\" bitsize=\"32\" type=\"data_ptr\"/>"
+    "<reg name=\"lr\" bitsize=\"32\"/>"
+    "<reg name=\"pc\" bitsize=\"32\" type=\"code_ptr\"/>"
+    "<reg name=\"xpsr\" bitsize=\"32\"/>"
+    "</feature></target>";
+
+// Private target and connection state
+typedef struct {
+    SwdPort port;
+    bool attached;                      // Port open and target halted for GDB
+    bool running;                       // Resumed by c, a stop reply is owed
+    bool regs_valid;
+    uint32_t regs[GDB_NUM_REGS];
+    uint fpb_num;
+    uint fpb_rev;
+    uint32_t fpb_addr[GDB_MAX_HW_BREAKPOINTS];  // 0 when free
+    uint8_t fpb_type[GDB_MAX_HW_BREAKPOINTS];   // Z0 or Z1 that set it
+    struct {
+        uint32_t addr;                  // 0 when free
+        uint16_t insn;
+    } sw_bp[GDB_MAX_SW_BREAKPOINTS];
+} GdbTarget;
+
+static GdbTarget target;
+static const GdbConfig* config;
+static GdbStats* gdb_stats;
+
+static struct tcp_pcb* listen_pcb = NULL;
+static struct tcp_pcb* client = NULL;
+static bool client_new = false;         // Accepted, not yet attached
+static bool no_ack = false;
+static uint8_t rx_buf[RX_SIZE];
+static uint rx_len = 0;
+static char tx_buf[TX_SIZE];
+static uint8_t mem_buf[GDB_MAX_PACKET];
+
+/* Hex */
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static char* put_hex(char* out, const uint8_t* data, uint len) {
+    for (uint i = 0; i < len; i++) {
+        *out++ = hex_digits[data[i] >> 4];
+        *out++ = hex_digits[data[i] & 0xF];
+    }
+    return out;
+}
+
+static bool get_hex(const char* in, uint8_t* data, uint len) {
+    for (uint i = 0; i < len; i++) {
+        int hi = hex_value(in[2 * i]);
+        int lo = hex_value(in[2 * i + 1]);
+        if (hi < 0 || lo < 0) return false;
+        data[i] = (uint8_t)(hi << 4 | lo);
+    }
+    return true;
+}
+
+// Register values travel in target byte order
+static char* put_reg(char* out, uint32_t value) {
+    return put_hex(out, (const uint8_t*)&value, 4);
+}
+
+static bool get_reg(const char* in, uint32_t* value) {
+    return get_hex(in, (uint8_t*)value, 4);
+}
+
+/* Connection */
+
+static void client_gone(void) {
+    client = NULL;
+    client_new = false;
+    rx_len = 0;
+    no_ack = false;
+}
+
+static void close_client(void) {
+    tcp_recv(client, NULL);
+    tcp_err(client, NULL);
+    if (tcp_close(client) != ERR_OK) {
+        tcp_abort(client);
+    }
+    client_gone();
+}
+
+static void on_error(void* arg, err_t err) {
+    client_gone();                      // lwIP has already freed the PCB
+}
+
+// Data is only taken when it all fits; lwIP offers it again otherwise
+static err_t on_recv(void* arg, struct tcp_pcb* pcb, struct pbuf* p, err_t err) {
+    if (!p) {
+        tcp_close(pcb);
+        client_gone();
+        return ERR_OK;
+    }
+    if (p->tot_len > RX_SIZE - rx_len) {
+        return ERR_MEM;
+    }
+    pbuf_copy_partial(p, rx_buf + rx_len, p->tot_len, 0);
+    rx_len += p->tot_len;
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+    return ERR_OK;
+}
+
+static err_t on_accept(void* arg, struct tcp_pcb* pcb, err_t err) {
+    if (err != ERR_OK || !pcb) {
+        return ERR_VAL;
+    }
+    if (client) {
+        tcp_abort(pcb);                 // One debugger at a time
+        return ERR_ABRT;
+    }
+    client = pcb;
+    client_new = true;
+    tcp_nagle_disable(pcb);             // Every reply is a round trip GDB waits on
+    tcp_recv(pcb, on_recv);
+    tcp_err(pcb, on_error);
+    return ERR_OK;
+}
+
+// Copied data comes out of the lwIP heap, which is smaller than the send
+// buffer, so ERR_MEM just means waiting for ACKs to free some. A client
+// that takes nothing for GDB_SEND_TIMEOUT_MS is dropped.
+static void send_raw(const char* data, uint len) {
+    absolute_time_t deadline = make_timeout_time_ms(GDB_SEND_TIMEOUT_MS);
+    while (client) {
+        err_t err = ERR_MEM;
+        if (tcp_sndbuf(client) >= len) {
+            err = tcp_write(client, data, len, TCP_WRITE_FLAG_COPY);
+        }
+        if (err == ERR_OK) {
+            tcp_output(client);
+            return;
+        }
+        if (err != ERR_MEM || time_reached(deadline)) {
+            printf("GDB: send failed (%d), dropping the client\n", err);
+            gdb_stats->errors++;
+            close_client();
+            return;
+        }
+        tcp_output(client);
+        cyw43_arch_poll();
+    }
+}
+
+// Sends tx_buf[1..len] as a packet
+static void send_packet(uint len) {
+    uint8_t sum = 0;
+    for (uint i = 1; i <= len; i++) {
+        sum += (uint8_t)tx_buf[i];
+    }
+    tx_buf[0] = '$';
+    tx_buf[len + 1] = '#';
+    tx_buf[len + 2] = hex_digits[sum >> 4];
+    tx_buf[len + 3] = hex_digits[sum & 0xF];
+    send_raw(tx_buf, len + 4);
+}
+
+static void reply(const char* text) {
+    uint len = strlen(text);
+    memcpy(tx_buf + 1, text, len);
+    send_packet(len);
+}
+
+static void reply_stop(int signal) {
+    char text[4];
+    snprintf(text, sizeof(text), "S%02x", signal);
+    reply(text);
+}
+
+/* Target */
+
+static bool load_regs(void) {
+    if (target.regs_valid) {
+        return true;
+    }
+    for (uint i = 0; i < GDB_NUM_REGS; i++) {
+        if (!swd_read_core_reg(&target.port, i, &target.regs[i])) {
+            return false;
+        }
+    }
+    target.regs_valid = true;
+    return true;
+}
+
+static bool write_reg(uint reg, uint32_t value) {
+    if (!swd_write_core_reg(&target.port, reg, value)) {
+        target.regs_valid = false;
+        return false;
+    }
+    target.regs[reg] = value;
+    return true;
+}
+
+static void stopped(void) {
+    target.running = false;
+    target.regs_valid = false;
+    gdb_stats->halted = true;
+}
+
+// The target stopped answering while it ran. GDB is owed a stop reply,
+// so it gets an error instead of waiting forever, and the session ends.
+static void lost_target(void) {
+    printf("GDB: lost the target (%s)\n", swd_error_string(&target.port));
+    gdb_stats->errors++;
+    target.running = false;
+    reply("E01");
+    if (client) {
+        close_client();
+    }
+}
+
+static bool resume(void) {
+    target.regs_valid = false;
+    // So the stop reply only sees the debug events of this run
+    if (!swd_mem_write32(&target.port, CM_DFSR, CM_DFSR_ALL) || !swd_resume(&target.port)) {
+        return false;
+    }
+    target.running = true;
+    gdb_stats->halted = false;
+    return true;
+}
+
+// v1 FPBs only reach the code region and match a halfword within a word
+static uint32_t fpb_comp(uint32_t addr) {
+    if (target.fpb_rev == 0) {
+        return (addr & 0x1FFFFFFC) | ((addr & 2) ? 0x80000000 : 0x40000000) | 1;
+    }
+    return (addr & ~1u) | 1;
+}
+
+static bool set_hw_breakpoint(uint32_t addr, uint type) {
+    if (target.fpb_rev == 0 && addr >= 0x20000000) {
+        return false;
+    }
+    for (uint i = 0; i < target.fpb_num; i++) {
+        if (target.fpb_addr[i] == 0) {
+            if (!swd_mem_write32(&target.port, CM_FP_COMP0 + 4 * i, fpb_comp(addr))) return false;
+            target.fpb_addr[i] = addr;
+            target.fpb_type[i] = type;
+            return true;
+        }
+    }
+    return false;
+}
+
+// RAM only: the BKPT is written and read back, which flash won't pass
+static bool set_sw_breakpoint(uint32_t addr) {
+    for (uint i = 0; i < GDB_MAX_SW_BREAKPOINTS; i++) {
+        if (target.sw_bp[i].addr == 0) {
+            uint16_t insn, check, bkpt = CM_BKPT_INSN;
+            if (!swd_mem_read(&target.port, addr, (uint8_t*)&insn, 2) ||
+                !swd_mem_write(&target.port, addr, (const uint8_t*)&bkpt, 2) ||
+                !swd_mem_read(&target.port, addr, (uint8_t*)&check, 2) || check != bkpt) {
+                return false;
+            }
+            target.sw_bp[i].addr = addr;
+            target.sw_bp[i].insn = insn;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool clear_breakpoint(uint32_t addr) {
+    for (uint i = 0; i < target.fpb_num; i++) {
+        if (target.fpb_addr[i] == addr) {
+            target.fpb_addr[i] = 0;
+            return swd_mem_write32(&target.port, CM_FP_COMP0 + 4 * i, 0);
+        }
+    }
+    for (uint i = 0; i < GDB_MAX_SW_BREAKPOINTS; i++) {
+        if (target.sw_bp[i].addr == addr) {
+            target.sw_bp[i].addr = 0;
+            return swd_mem_write(&target.port, addr, (const uint8_t*)&target.sw_bp[i].insn, 2);
+        }
+    }
+    return false;
+}
+
+static void clear_all_breakpoints(void) {
+    for (uint i = 0; i < target.fpb_num; i++) {
+        if (target.fpb_addr[i]) clear_breakpoint(target.fpb_addr[i]);
+    }
+    for (uint i = 0; i < GDB_MAX_SW_BREAKPOINTS; i++) {
+        if (target.sw_bp[i].addr) clear_breakpoint(target.sw_bp[i].addr);
+    }
+    swd_mem_write32(&target.port, CM_FP_CTRL, CM_FP_CTRL_DISABLE);
+}
+
+// Stop reason for the swbreak / hwbreak features: which kind of breakpoint
+// GDB asked for at pc, or "" if the halt wasn't on one of its breakpoints
+static const char* breakpoint_kind(uint32_t pc) {
+    if (pc == 0) {
+        return "";                      // Free slots hold 0
+    }
+    for (uint i = 0; i < target.fpb_num; i++) {
+        if (target.fpb_addr[i] == pc) {
+            return target.fpb_type[i] == 0 ? "swbreak:;" : "hwbreak:;";
+        }
+    }
+    for (uint i = 0; i < GDB_MAX_SW_BREAKPOINTS; i++) {
+        if (target.sw_bp[i].addr == pc) {
+            return "swbreak:;";
+        }
+    }
+    return "";
+}
+
+// Stop reply for a halt while running. An FPB match and a BKPT both set
+// DFSR.BKPT, so the PC picks out which breakpoint it was.
+static void reply_halted(void) {
+    const char* reason = "";
+    uint32_t dfsr;
+    if (swd_mem_read32(&target.port, CM_DFSR, &dfsr) && (dfsr & CM_DFSR_BKPT) && load_regs()) {
+        reason = breakpoint_kind(target.regs[CM_REG_PC]);
+    }
+    char text[16];
+    snprintf(text, sizeof(text), "T%02x%s", GDB_SIGTRAP, reason);
+    reply(text);
+}
+
+static bool attach(void) {
+    memset(&target, 0, sizeof(target));
+    if (!swd_port_open(&target.port, SWD_PIO, SWCLK_PIN, SWDIO_PIN, config->swd_hz)) {
+        return false;
+    }
+    uint32_t fp_ctrl;
+    if (!swd_connect(&target.port, config->targetsel) || !swd_halt(&target.port) ||
+        !swd_mem_read32(&target.port, CM_FP_CTRL, &fp_ctrl) ||
+        !swd_mem_write32(&target.port, CM_FP_CTRL, CM_FP_CTRL_ENABLE)) {
+        printf("GDB: can't attach to the target (%s)\n", swd_error_string(&target.port));
+        swd_port_close(&target.port);
+        return false;
+    }
+    target.fpb_num = MIN(CM_FP_NUM_CODE(fp_ctrl), GDB_MAX_HW_BREAKPOINTS);
+    target.fpb_rev = CM_FP_REV(fp_ctrl);
+    for (uint i = 0; i < target.fpb_num; i++) {
+        swd_mem_write32(&target.port, CM_FP_COMP0 + 4 * i, 0);
+    }
+    target.attached = true;
+    gdb_stats->connected = gdb_stats->halted = true;
+    printf("GDB: attached, DPIDR 0x%08lx, %u hardware breakpoints\n", target.port.idcode, target.fpb_num);
+    return true;
+}
+
+// The target is left running, as it was before GDB came along
+static void detach(void) {
+    if (!target.attached) {
+        return;
+    }
+    clear_all_breakpoints();
+    swd_mem_write32(&target.port, CM_DHCSR, CM_DHCSR_KEY);
+    swd_port_close(&target.port);
+    target.attached = false;
+    gdb_stats->connected = gdb_stats->halted = false;
+    printf("GDB: detached\n");
+}
+
+/* Packets */
+
+static void handle_query(char* pkt) {
+    if (strncmp(pkt, "qSupported", 10) == 0) {
+        snprintf(tx_buf + 1, TX_SIZE - 4, "PacketSize=%x;QStartNoAckMode+;qXfer:features:read+;"
+                 "swbreak+;hwbreak+", GDB_MAX_PACKET);
+        send_packet(strlen(tx_buf + 1));
+    } else if (strncmp(pkt, "qXfer:features:read:target.xml:", 31) == 0) {
+        char* end;
+        uint32_t offset = strtoul(pkt + 31, &end, 16);
+        uint32_t len = strtoul(end + 1, NULL, 16);
+        uint32_t size = sizeof(target_xml) - 1;
+        offset = MIN(offset, size);
+        len = MIN(MIN(len, size - offset), GDB_MAX_PACKET - 1);
+        tx_buf[1] = offset + len < size ? 'm' : 'l';
+        memcpy(tx_buf + 2, target_xml + offset, len);
+        send_packet(len + 1);
+    } else if (strncmp(pkt, "qRcmd,", 6) == 0) {
+        char cmd[16] = {0};
+        uint len = strlen(pkt + 6) / 2;
+        if (len < sizeof(cmd) && get_hex(pkt + 6, (uint8_t*)cmd, len) && strcmp(cmd, "reset") == 0) {
+            target.regs_valid = false;
+            reply(swd_reset_halt(&target.port) ? "OK" : "E01");
+        } else {
+            reply("");
+        }
+    } else if (strcmp(pkt, "qAttached") == 0) {
+        reply("1");
+    } else if (strncmp(pkt, "qSymbol", 7) == 0) {
+        reply("OK");
+    } else {
+        reply("");
+    }
+}
+
+static void handle_memory(char* pkt, uint len) {
+    char* p;
+    uint32_t addr = strtoul(pkt + 1, &p, 16);
+    uint32_t count = strtoul(p + 1, &p, 16);
+    bool ok;
+    if (pkt[0] == 'm') {
+        count = MIN(count, MEM_CHUNK);
+        if (!swd_mem_read(&target.port, addr, mem_buf, count)) {
+            reply("E01");
+            return;
+        }
+        gdb_stats->mem_bytes += count;
+        send_packet(put_hex(tx_buf + 1, mem_buf, count) - (tx_buf + 1));
+        return;
+    }
+    if (*p != ':' || count > sizeof(mem_buf)) {
+        reply("E02");
+        return;
+    }
+    p++;
+    if (pkt[0] == 'M') {
+        ok = (uint)(pkt + len - p) == 2 * count && get_hex(p, mem_buf, count);
+    } else {
+        // X: binary, with '#', '$', '}' and '*' escaped as '}' then c ^ 0x20
+        uint n = 0;
+        for (char* end = pkt + len; p < end && n < count; n++) {
+            mem_buf[n] = *p == '}' && p + 1 < end ? (uint8_t)(p[1] ^ 0x20) : (uint8_t)*p;
+            p += *p == '}' ? 2 : 1;
+        }
+        ok = n == count;
+    }
+    if (!ok) {
+        reply("E02");
+        return;
+    }
+    target.regs_valid = false;          // The stack might be what changed
+    if (count && !swd_mem_write(&target.port, addr, mem_buf, count)) {
+        reply("E01");
+        return;
+    }
+    gdb_stats->mem_bytes += count;
+    reply("OK");
+}
+
+static void handle_packet(char* pkt, uint len) {
+    gdb_stats->packets++;
+    pkt[len] = '\0';
+    char* p;
+    switch (pkt[0]) {
+    case '?':
+        reply_stop(GDB_SIGTRAP);
+        break;
+    case 'g': {
+        if (!load_regs()) {
+            reply("E01");
+            break;
+        }
+        char* out = tx_buf + 1;
+        for (uint i = 0; i < GDB_NUM_REGS; i++) {
+            out = put_reg(out, target.regs[i]);
+        }
+        send_packet(out - (tx_buf + 1));
+        break;
+    }
+    case 'G': {
+        bool ok = len - 1 >= GDB_NUM_REGS * 8;
+        for (uint i = 0; ok && i < GDB_NUM_REGS; i++) {
+            uint32_t value;
+            ok = get_reg(pkt + 1 + 8 * i, &value) && write_reg(i, value);
+        }
+        reply(ok ? "OK" : "E01");
+        break;
+    }
+    case 'p': {
+        uint reg = strtoul(pkt + 1, NULL, 16);
+        if (reg >= GDB_NUM_REGS) {
+            reply("E00");
+        } else if (!load_regs()) {
+            reply("E01");
+        } else {
+            send_packet(put_reg(tx_buf + 1, target.regs[reg]) - (tx_buf + 1));
+        }
+        break;
+    }
+    case 'P': {
+        uint reg = strtoul(pkt + 1, &p, 16);
+        uint32_t value;
+        bool ok = reg < GDB_NUM_REGS && *p == '=' && get_reg(p + 1, &value) && write_reg(reg, value);
+        reply(ok ? "OK" : "E01");
+        break;
+    }
+    case 'm':
+    case 'M':
+    case 'X':
+        handle_memory(pkt, len);
+        break;
+    case 'c':
+    case 's': {
+        bool ok = len == 1 || write_reg(CM_REG_PC, strtoul(pkt + 1, NULL, 16));
+        if (ok && pkt[0] == 'c') {
+            if (!resume()) reply("E01");
+            break;                      // The stop reply comes when it halts
+        }
+        target.regs_valid = false;
+        if (ok && swd_step(&target.port)) {
+            reply_stop(GDB_SIGTRAP);
+        } else {
+            reply("E01");
+        }
+        break;
+    }
+    case 'Z':
+    case 'z': {
+        uint type = strtoul(pkt + 1, &p, 16);
+        uint32_t addr = strtoul(p + 1, NULL, 16);
+        bool ok;
+        if (type > 1) {
+            reply("");                  // No watchpoints
+            break;
+        }
+        if (pkt[0] == 'z') {
+            ok = clear_breakpoint(addr);
+        } else {
+            ok = set_hw_breakpoint(addr, type) || (type == 0 && set_sw_breakpoint(addr));
+        }
+        reply(ok ? "OK" : "E01");
+        break;
+    }
+    case 'D':
+        reply("OK");
+        detach();
+        close_client();
+        break;
+    case 'k':
+        detach();
+        close_client();
+        break;
+    case 'H':
+        reply("OK");
+        break;
+    case 'q':
+        handle_query(pkt);
+        break;
+    case 'Q':
+        if (strcmp(pkt, "QStartNoAckMode") == 0) {
+            reply("OK");
+            no_ack = true;
+        } else {
+            reply("");
+        }
+        break;
+    default:
+        reply("");
+        break;
+    }
+}
+
+// Frames packets out of rx_buf: $data#cc, or a bare Ctrl-C to interrupt
+static void process_input(void) {
+    uint pos = 0;
+    while (pos < rx_len && client) {
+        uint8_t c = rx_buf[pos];
+        if (c == 0x03) {
+            pos++;
+            if (target.running) {
+                if (swd_halt(&target.port)) {
+                    stopped();
+                    reply_stop(GDB_SIGINT);
+                } else {
+                    lost_target();
+                }
+            }
+            continue;
+        }
+        if (c != '$') {
+            pos++;                      // Acks and line noise
+            continue;
+        }
+        uint8_t* hash = memchr(rx_buf + pos, '#', rx_len - pos);
+        if (!hash || hash + 3 > rx_buf + rx_len) {
+            if (pos == 0 && rx_len == RX_SIZE) {
+                pos = rx_len;           // Larger than any packet we allow
+            }
+            break;
+        }
+        uint8_t* data = rx_buf + pos + 1;
+        uint len = hash - data;
+        uint8_t sum = 0;
+        for (uint i = 0; i < len; i++) {
+            sum += data[i];
+        }
+        int hi = hex_value(hash[1]), lo = hex_value(hash[2]);
+        pos = hash + 3 - rx_buf;
+        if (!no_ack) {
+            send_raw(((hi << 4) | lo) == sum ? "+" : "-", 1);
+        }
+        // While running only an interrupt makes sense
+        if ((no_ack || ((hi << 4) | lo) == sum) && !target.running) {
+            handle_packet((char*)data, len);
+        }
+    }
+    if (pos < rx_len) {
+        memmove(rx_buf, rx_buf + pos, rx_len - pos);
+        rx_len -= pos;
+    } else {
+        rx_len = 0;                     // Everything used, or the client is gone
+    }
+}
+
+/* Public API */
+
+// Serves GDB until a key is pressed
+bool gdb_server_run(const GdbConfig* cfg, gdb_status_handler_t on_status, GdbStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    config = cfg;
+    gdb_stats = stats;
+    target.attached = false;
+
+    listen_pcb = tcp_new();
+    if (!listen_pcb || tcp_bind(listen_pcb, IP_ADDR_ANY, cfg->port) != ERR_OK) {
+        printf("GDB: can't bind port %u\n", cfg->port);
+        if (listen_pcb) tcp_close(listen_pcb);
+        listen_pcb = NULL;
+        return false;
+    }
+    // On failure tcp_listen() leaves the bound pcb allocated
+    struct tcp_pcb* pcb = tcp_listen(listen_pcb);
+    if (!pcb) {
+        printf("GDB: can't listen on port %u\n", cfg->port);
+        tcp_close(listen_pcb);
+        listen_pcb = NULL;
+        return false;
+    }
+    listen_pcb = pcb;
+    tcp_accept(listen_pcb, on_accept);
+    printf("GDB: listening on %s:%u (SWCLK GP%d, SWDIO GP%d), any key stops\n",
+           ip4addr_ntoa(netif_ip4_addr(netif_default)), cfg->port, SWCLK_PIN, SWDIO_PIN);
+
+    uint32_t last_poll_us = time_us_32();
+    uint32_t last_status_us = last_poll_us;
+    GdbStats last = *stats;
+    uint poll_errors = 0;
+    while (getchar_timeout_us(0) == PICO_ERROR_TIMEOUT) {
+        cyw43_arch_poll();
+        if (client_new) {
+            client_new = false;
+            if (!attach()) {
+                close_client();
+                stats->errors++;
+            }
+        }
+        if (!client && target.attached) {
+            detach();                   // GDB went away without a D
+        }
+        if (client) {
+            process_input();
+        }
+
+        uint32_t now = time_us_32();
+        if (target.running && now - last_poll_us >= GDB_POLL_US) {
+            last_poll_us = now;
+            uint32_t dhcsr;
+            if (!swd_mem_read32(&target.port, CM_DHCSR, &dhcsr)) {
+                stats->errors++;
+                if (++poll_errors >= GDB_MAX_POLL_ERRORS) {
+                    poll_errors = 0;
+                    lost_target();
+                }
+            } else {
+                poll_errors = 0;
+                if (dhcsr & CM_DHCSR_S_HALT) {
+                    stopped();
+                    reply_halted();
+                }
+            }
+        }
+        if (on_status && (now - last_status_us >= 1000000 ||
+                          stats->connected != last.connected || stats->halted != last.halted)) {
+            last_status_us = now;
+            last = *stats;
+            on_status(stats);
+        }
+    }
+
+    if (client) {
+        close_client();
+    }
+    detach();
+    tcp_close(listen_pcb);
+    listen_pcb = NULL;
+    printf("GDB: %lu packets, %lu memory bytes, %lu errors\n", stats->packets, stats->mem_bytes, stats->errors);
+    if (on_status) on_status(stats);
+    return true;
+}
+
+// Dashboard buttons: through the GDB session when one is attached,
+// otherwise over a port opened just for the command
+static bool target_command(bool halt) {
+    if (target.attached) {
+        if (halt) {
+            return !target.running || swd_halt(&target.port);   // GDB hears about it on the next poll
+        }
+        printf("GDB: target is under debugger control\n");
+        return false;
+    }
+    SwdPort port;
+    if (!swd_port_open(&port, SWD_PIO, SWCLK_PIN, SWDIO_PIN, SWD_DEFAULT_HZ)) {
+        return false;
+    }
+    bool ok = swd_connect(&port, 0) && (halt ? swd_halt(&port) : swd_resume(&port));
+    if (!ok) {
+        printf("GDB: target %s failed (%s)\n", halt ? "halt" : "resume", swd_error_string(&port));
+    }
+    swd_port_close(&port);
+    return ok;
+}
+
+bool gdb_target_halt(void) {
+    return target_command(true);
+}
+
+bool gdb_target_resume(void) {
+    return target_command(false);
+}
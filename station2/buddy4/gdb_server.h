@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "swd.h"
+
+#ifndef GDB_SERVER_H
+#define GDB_SERVER_H
+
+// GDB remote serial protocol server on the WiFi access point, backed by the
+// PIO SWD engine:  (gdb) target extended-remote 192.168.4.1:3333
+//
+// One client at a time. The target is halted when GDB connects and resumed,
+// breakpoints cleared, when it leaves. Memory goes through MEM-AP block
+// transfers, with packets up to GDB_MAX_PACKET so a `m`, `M` or binary `X`
+// moves 2 KB or more per round trip; no-ack mode saves the rest. Registers
+// are read in one pass when the core stops and served from that copy.
+// Breakpoints use the FPB where it reaches, BKPT instructions in RAM
+// otherwise; steps run with interrupts masked. "monitor reset" resets and
+// halts the target. Flash can't be written from GDB.
+
+#define GDB_PORT 3333
+#define GDB_MAX_PACKET 4096             // Advertised PacketSize
+#define GDB_POLL_US 1000                // DHCSR polling while the target runs
+#define GDB_MAX_POLL_ERRORS 10          // Failed polls in a row before the target counts as lost
+#define GDB_SEND_TIMEOUT_MS 2000        // Reply not taken by lwIP in this long drops the client
+#define GDB_MAX_HW_BREAKPOINTS 8
+#define GDB_MAX_SW_BREAKPOINTS 16
+#define GDB_NUM_REGS 17                 // r0-r12, sp, lr, pc, xpsr
+
+typedef struct {
+    uint16_t port;
+    uint32_t targetsel;                 // 0 unless the target is on a multi-drop bus
+    uint32_t swd_hz;
+} GdbConfig;
+
+#define GDB_DEFAULT_CONFIG { GDB_PORT, 0, SWD_DEFAULT_HZ }
+
+typedef struct {
+    bool connected;
+    bool halted;
+    uint32_t packets;
+    uint32_t mem_bytes;                 // Read and written for m / M / X
+    uint32_t errors;
+} GdbStats;
+
+typedef void (*gdb_status_handler_t)(const GdbStats* stats);
+
+// Function declarations
+bool gdb_server_run(const GdbConfig* cfg, gdb_status_handler_t on_status, GdbStats* stats);
+bool gdb_target_halt(void);
+bool gdb_target_resume(void);
+
+#endif // GDB_SERVER_H
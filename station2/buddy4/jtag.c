@@ -0,0 +1,427 @@
+#include "jtag.h"
+#include "jtag.pio.h"
+#include "buddy1/sd_card.h"
+#include "resources.h"
+#include "hardware/clocks.h"
+#include <string.h>
+
+#define TCK_MASK (1u << JTAG_TCK_PIN)
+#define TDI_MASK (1u << JTAG_TDI_PIN)
+#define JTAG_PIN_MASK (TCK_MASK | TDI_MASK | (1u << JTAG_TMS_PIN) | (1u << JTAG_TDO_PIN))
+
+// Private JTAG engine state
+typedef struct {
+    PIO pio;
+    int sm;
+    uint offset;
+    int tx_dma;
+    int rx_dma;
+    uint32_t tck_hz;
+    bool initialized;
+    JTAGScan queue[JTAG_QUEUE_DEPTH];
+    uint queue_len;
+} JTAG_Config;
+
+static JTAG_Config jtag = {
+    .pio = JTAG_PIO,
+    .sm = -1,
+    .offset = 0,
+    .tx_dma = -1,
+    .rx_dma = -1,
+    .tck_hz = 0,
+    .initialized = false,
+    .queue_len = 0
+};
+
+// DMA needs real memory for constant TDI and for discarded TDO
+static uint8_t fill_byte;
+static uint8_t sink_byte;
+
+static uint8_t probe_tdi[(2 * JTAG_MAX_BSR_BITS) / 8];
+static uint8_t probe_tdo[(2 * JTAG_MAX_BSR_BITS) / 8];
+
+static inline bool get_bit(const uint8_t* buf, uint32_t i) {
+    return (buf[i / 8] >> (i % 8)) & 1;
+}
+
+static inline void set_bit(uint8_t* buf, uint32_t i, bool v) {
+    if (v) buf[i / 8] |= 1u << (i % 8);
+    else buf[i / 8] &= ~(1u << (i % 8));
+}
+
+static int first_one(const uint8_t* buf, uint32_t from, uint32_t to) {
+    for (uint32_t i = from; i < to; i++) {
+        if (get_bit(buf, i)) return i;
+    }
+    return -1;
+}
+
+// Slow path for TMS moves and the odd bits that don't fill a PIO byte. The
+// state machine is stopped so its pins can be forced with SET instructions.
+static void slow_begin(void) {
+    pio_sm_set_enabled(jtag.pio, jtag.sm, false);
+}
+
+static void slow_end(void) {
+    pio_sm_set_enabled(jtag.pio, jtag.sm, true);
+}
+
+static bool clock_bit(bool tms, bool tdi) {
+    gpio_put(JTAG_TMS_PIN, tms);
+    pio_sm_set_pins_with_mask(jtag.pio, jtag.sm, tdi ? TDI_MASK : 0, TCK_MASK | TDI_MASK);
+    bool tdo = gpio_get(JTAG_TDO_PIN);
+    pio_sm_set_pins_with_mask(jtag.pio, jtag.sm, TCK_MASK, TCK_MASK);
+    pio_sm_set_pins_with_mask(jtag.pio, jtag.sm, 0, TCK_MASK);
+    return tdo;
+}
+
+// Clock a TMS pattern, LSB first, with TDI held high
+static void tms_sequence(uint32_t tms, uint count) {
+    slow_begin();
+    for (uint i = 0; i < count; i++) {
+        clock_bit((tms >> i) & 1, true);
+    }
+    slow_end();
+}
+
+// Fast path: whole bytes through the PIO, both directions on DMA
+static void shift_bytes(const uint8_t* tdi, uint8_t fill, uint8_t* tdo, uint32_t nbytes) {
+    io_wo_8* txf = (io_wo_8*)&jtag.pio->txf[jtag.sm];
+    const io_ro_8* rxf = (const io_ro_8*)&jtag.pio->rxf[jtag.sm] + 3;   // Byte lands in 31:24
+    fill_byte = fill;
+
+    dma_channel_config rx_cfg = dma_channel_get_default_config(jtag.rx_dma);
+    channel_config_set_transfer_data_size(&rx_cfg, DMA_SIZE_8);
+    channel_config_set_read_increment(&rx_cfg, false);
+    channel_config_set_write_increment(&rx_cfg, tdo != NULL);
+    channel_config_set_dreq(&rx_cfg, pio_get_dreq(jtag.pio, jtag.sm, false));
+    dma_channel_configure(jtag.rx_dma, &rx_cfg, tdo ? tdo : &sink_byte, rxf, nbytes, false);
+
+    dma_channel_config tx_cfg = dma_channel_get_default_config(jtag.tx_dma);
+    channel_config_set_transfer_data_size(&tx_cfg, DMA_SIZE_8);
+    channel_config_set_read_increment(&tx_cfg, tdi != NULL);
+    channel_config_set_write_increment(&tx_cfg, false);
+    channel_config_set_dreq(&tx_cfg, pio_get_dreq(jtag.pio, jtag.sm, true));
+    dma_channel_configure(jtag.tx_dma, &tx_cfg, txf, tdi ? tdi : &fill_byte, nbytes, false);
+
+    dma_start_channel_mask((1u << jtag.tx_dma) | (1u << jtag.rx_dma));
+    dma_channel_wait_for_finish_blocking(jtag.rx_dma);
+}
+
+// Shift 'bits' through the current Shift-xR state. With 'exit' the last bit
+// goes out with TMS high, leaving the TAP in Exit1-xR.
+static void shift_bits(const uint8_t* tdi, uint8_t fill, uint8_t* tdo, uint32_t bits, bool exit) {
+    uint32_t body = exit ? bits - 1 : bits;
+    uint32_t nbytes = body / 8;
+
+    gpio_put(JTAG_TMS_PIN, 0);
+    if (nbytes) {
+        shift_bytes(tdi, fill, tdo, nbytes);
+    }
+    if (tdo && bits > nbytes * 8) {
+        tdo[nbytes] = 0;
+    }
+
+    slow_begin();
+    for (uint32_t i = nbytes * 8; i < bits; i++) {
+        bool in = tdi ? get_bit(tdi, i) : (fill & 1);
+        bool out = clock_bit(exit && i == bits - 1, in);
+        if (tdo) set_bit(tdo, i, out);
+    }
+    slow_end();
+}
+
+uint32_t jtag_set_tck(uint32_t tck_hz) {
+    if (tck_hz > JTAG_MAX_TCK_HZ) tck_hz = JTAG_MAX_TCK_HZ;
+    uint32_t sys_hz = clock_get_hz(clk_sys);
+    float div = (float)sys_hz / (4.0f * (float)tck_hz);
+    if (div < 1.0f) div = 1.0f;
+    if (jtag.sm >= 0) {
+        pio_sm_set_clkdiv(jtag.pio, jtag.sm, div);
+    }
+    jtag.tck_hz = (uint32_t)((float)sys_hz / (4.0f * div));
+    return jtag.tck_hz;
+}
+
+bool jtag_init(uint32_t tck_hz) {
+    if (jtag.initialized) {
+        jtag_set_tck(tck_hz);
+        return true;
+    }
+
+    if (!pio_can_add_program(jtag.pio, &jtag_program)) {
+        printf("Error: No PIO space for JTAG\n");
+        return false;
+    }
+    if (!res_claim_pins("jtag", JTAG_PIN_MASK, RES_PIN_EXCLUSIVE)) {
+        return false;
+    }
+    jtag.sm = res_claim_pio_sm("jtag", jtag.pio);
+    if (jtag.sm < 0) {
+        res_release_pins("jtag", JTAG_PIN_MASK);
+        return false;
+    }
+    jtag.tx_dma = res_claim_dma("jtag");
+    jtag.rx_dma = res_claim_dma("jtag");
+    if (jtag.tx_dma < 0 || jtag.rx_dma < 0) {
+        printf("Error: Could not claim DMA channels for JTAG\n");
+        jtag_deinit();
+        return false;
+    }
+    jtag.offset = pio_add_program(jtag.pio, &jtag_program);
+
+    gpio_init(JTAG_TMS_PIN);
+    gpio_set_dir(JTAG_TMS_PIN, GPIO_OUT);
+    gpio_put(JTAG_TMS_PIN, 1);
+
+    jtag_set_tck(tck_hz);
+    uint32_t sys_hz = clock_get_hz(clk_sys);
+    jtag_program_init(jtag.pio, jtag.sm, jtag.offset, JTAG_TCK_PIN, JTAG_TDI_PIN, JTAG_TDO_PIN,
+                      (float)sys_hz / (4.0f * (float)jtag.tck_hz));
+    jtag.initialized = true;
+    jtag.queue_len = 0;
+
+    printf("JTAG ready at %lu Hz (TCK GP%d, TMS GP%d, TDI GP%d, TDO GP%d)\n",
+           jtag.tck_hz, JTAG_TCK_PIN, JTAG_TMS_PIN, JTAG_TDI_PIN, JTAG_TDO_PIN);
+    jtag_reset();
+    return true;
+}
+
+void jtag_deinit(void) {
+    if (jtag.initialized) {
+        pio_sm_set_enabled(jtag.pio, jtag.sm, false);
+        pio_remove_program(jtag.pio, &jtag_program, jtag.offset);
+    }
+    if (jtag.sm >= 0) {
+        res_release_pio_sm(jtag.pio, jtag.sm);
+        jtag.sm = -1;
+    }
+    res_release_dma(jtag.tx_dma);
+    res_release_dma(jtag.rx_dma);
+    jtag.tx_dma = jtag.rx_dma = -1;
+
+    // Hand TCK/TDI back to SIO so swd_init() can take them again
+    gpio_init(JTAG_TCK_PIN);
+    gpio_init(JTAG_TDI_PIN);
+    res_release_pins("jtag", JTAG_PIN_MASK);
+    jtag.initialized = false;
+}
+
+void jtag_reset(void) {
+    // Five TMS-high clocks reach Test-Logic-Reset from anywhere, then idle
+    tms_sequence(0x1F, 6);
+    jtag.queue_len = 0;
+}
+
+static bool queue_scan(bool is_ir, const uint8_t* tdi, uint8_t* tdo, uint32_t bits) {
+    if (bits == 0 || jtag.queue_len >= JTAG_QUEUE_DEPTH) {
+        return false;
+    }
+    JTAGScan* scan = &jtag.queue[jtag.queue_len++];
+    scan->is_ir = is_ir;
+    scan->tdi = tdi;
+    scan->tdo = tdo;
+    scan->bits = bits;
+    return true;
+}
+
+bool jtag_queue_ir(const uint8_t* tdi, uint8_t* tdo, uint32_t bits) {
+    return queue_scan(true, tdi, tdo, bits);
+}
+
+bool jtag_queue_dr(const uint8_t* tdi, uint8_t* tdo, uint32_t bits) {
+    return queue_scan(false, tdi, tdo, bits);
+}
+
+// Run every queued scan back-to-back. Each scan goes straight from Update-xR
+// to the next Select-DR, only the last one returns to Run-Test/Idle.
+void jtag_queue_flush(void) {
+    for (uint i = 0; i < jtag.queue_len; i++) {
+        const JTAGScan* scan = &jtag.queue[i];
+        if (scan->is_ir) {
+            tms_sequence(0x3, 4);   // Select-DR, Select-IR, Capture-IR, Shift-IR
+        } else {
+            tms_sequence(0x1, 3);   // Select-DR, Capture-DR, Shift-DR
+        }
+        shift_bits(scan->tdi, 0xFF, scan->tdo, scan->bits, true);
+        tms_sequence(0x1, 1);       // Exit1 -> Update
+    }
+    if (jtag.queue_len) {
+        tms_sequence(0x0, 1);       // Update -> Run-Test/Idle
+    }
+    jtag.queue_len = 0;
+}
+
+// Flush a register with zeros then ones; the first one out gives its length
+static int measure_register(bool is_ir, uint32_t flush_bits) {
+    uint32_t bytes = flush_bits / 8;
+    memset(probe_tdi, 0x00, bytes);
+    memset(probe_tdi + bytes, 0xFF, bytes);
+    queue_scan(is_ir, probe_tdi, probe_tdo, flush_bits * 2);
+    jtag_queue_flush();
+    int pos = first_one(probe_tdo, flush_bits, flush_bits * 2);
+    return pos < 0 ? -1 : pos - (int)flush_bits;
+}
+
+int jtag_detect_chain(JTAGChainInfo* info) {
+    if (!jtag_init(jtag.tck_hz ? jtag.tck_hz : JTAG_DEFAULT_TCK_HZ)) {
+        return -1;
+    }
+    memset(info, 0, sizeof(*info));
+    uint32_t start = time_us_32();
+
+    // Total IR length, which also leaves every device in BYPASS
+    jtag_reset();
+    int ir_len = measure_register(true, JTAG_MAX_IR_BITS);
+    if (ir_len <= 0) {
+        printf("JTAG: No chain found (TDO stuck %s)\n", ir_len == 0 ? "high" : "low");
+        return 0;
+    }
+
+    // One BYPASS bit per device
+    int count = measure_register(false, JTAG_MAX_IR_BITS);
+    if (count <= 0) {
+        printf("JTAG: IR length %d but no devices in BYPASS\n", ir_len);
+        return 0;
+    }
+    if (count > JTAG_MAX_DEVICES) {
+        printf("JTAG: %d devices found, reporting the first %d\n", count, JTAG_MAX_DEVICES);
+        count = JTAG_MAX_DEVICES;
+    }
+    info->device_count = count;
+    info->total_ir_len = ir_len;
+
+    // Reset selects IDCODE where implemented (LSB 1), BYPASS otherwise (one 0 bit)
+    jtag_reset();
+    queue_scan(false, NULL, probe_tdo, count * 32);
+    jtag_queue_flush();
+
+    uint32_t pos = 0;
+    for (int d = 0; d < count; d++) {
+        if (get_bit(probe_tdo, pos)) {
+            uint32_t id = 0;
+            for (int b = 0; b < 32; b++) {
+                id |= (uint32_t)get_bit(probe_tdo, pos + b) << b;
+            }
+            info->idcodes[d] = id;
+            pos += 32;
+        } else {
+            info->idcodes[d] = 0;
+            pos += 1;
+        }
+    }
+    uint32_t elapsed = time_us_32() - start;
+
+    printf("JTAG chain: %d device(s), total IR length %d (%lu us at %lu Hz)\n",
+           count, ir_len, elapsed, jtag.tck_hz);
+    for (int d = 0; d < count; d++) {
+        uint32_t id = info->idcodes[d];
+        if (id) {
+            printf("  #%d IDCODE 0x%08lX (mfr 0x%03lX, part 0x%04lX, ver %lu)\n",
+                   d, id, (id >> 1) & 0x7FF, (id >> 12) & 0xFFFF, id >> 28);
+        } else {
+            printf("  #%d no IDCODE (BYPASS after reset)\n", d);
+        }
+    }
+    return count;
+}
+
+bool jtag_boundary_sample(const JTAGBoundaryConfig* cfg, uint32_t samples, const char* filename) {
+    JTAGChainInfo chain;
+    if (jtag_detect_chain(&chain) <= 0) {
+        return false;
+    }
+    if (cfg->device >= chain.device_count ||
+        cfg->ir_bits_before + cfg->ir_len > chain.total_ir_len) {
+        printf("JTAG: Boundary config doesn't fit the detected chain\n");
+        return false;
+    }
+
+    // SAMPLE in the target's IR field, BYPASS (all ones) everywhere else
+    static uint8_t ir_buf[JTAG_MAX_IR_BITS / 8];
+    memset(ir_buf, 0xFF, sizeof(ir_buf));
+    for (int i = 0; i < cfg->ir_len; i++) {
+        set_bit(ir_buf, cfg->ir_bits_before + i, (cfg->sample_opcode >> i) & 1);
+    }
+    queue_scan(true, ir_buf, NULL, chain.total_ir_len);
+    jtag_queue_flush();
+
+    // Devices between the target and TDO each add one BYPASS bit ahead of the BSR
+    uint32_t skip = cfg->device;
+    uint32_t bsr_len = cfg->bsr_len;
+    if (bsr_len == 0) {
+        int dr_len = measure_register(false, JTAG_MAX_BSR_BITS);
+        if (dr_len <= (int)(chain.device_count - 1)) {
+            printf("JTAG: Could not measure the boundary register\n");
+            return false;
+        }
+        bsr_len = dr_len - (chain.device_count - 1);
+        printf("JTAG: Boundary register is %lu bits\n", bsr_len);
+    }
+    if (bsr_len > JTAG_MAX_BSR_BITS) {
+        printf("JTAG: Boundary register too long (%lu bits)\n", bsr_len);
+        return false;
+    }
+
+    if (ensureSDMounted() != FR_OK) {
+        printf("JTAG: SD card not available\n");
+        return false;
+    }
+    FIL file;
+    FRESULT fr = f_open(&file, filename, FA_CREATE_ALWAYS | FA_WRITE);
+    if (fr != FR_OK) {
+        printf("JTAG: f_open error: %d\n", fr);
+        return false;
+    }
+
+    // Records are [uint32 timestamp_us][BSR bits, LSB first]
+    static uint8_t record_buf[4096];
+    uint32_t record_size = 4 + (bsr_len + 7) / 8;
+    uint32_t fill = 0;
+    bool ok = true;
+
+    printf("Sampling %lu bits x %lu to %s...\n", bsr_len, samples, filename);
+    uint32_t start = time_us_32();
+
+    for (uint32_t n = 0; n < samples && ok; n++) {
+        // Capture-DR latches the pins, Shift-DR clocks them out
+        uint32_t now = time_us_32();
+        queue_scan(false, NULL, probe_tdo, skip + bsr_len);
+        jtag_queue_flush();
+
+        if (fill + record_size > sizeof(record_buf)) {
+            UINT written;
+            if (f_write(&file, record_buf, fill, &written) != FR_OK || written != fill) {
+                printf("JTAG: f_write failed\n");
+                ok = false;
+                break;
+            }
+            fill = 0;
+        }
+        memcpy(&record_buf[fill], &now, 4);
+        uint8_t* bits = &record_buf[fill + 4];
+        if (skip == 0) {
+            memcpy(bits, probe_tdo, record_size - 4);
+        } else {
+            for (uint32_t b = 0; b < bsr_len; b++) {
+                set_bit(bits, b, get_bit(probe_tdo, skip + b));
+            }
+        }
+        fill += record_size;
+    }
+
+    UINT written;
+    if (ok && fill && (f_write(&file, record_buf, fill, &written) != FR_OK || written != fill)) {
+        ok = false;
+    }
+    uint32_t elapsed = time_us_32() - start;
+    f_close(&file);
+    if (!ok) {
+        return false;
+    }
+
+    printf("Boundary scan: %lu samples in %lu ms (%.0f samples/s at %lu Hz TCK)\n",
+           samples, elapsed / 1000,
+           elapsed ? (float)samples * 1000000.0f / (float)elapsed : 0.0f, jtag.tck_hz);
+    return true;
+}
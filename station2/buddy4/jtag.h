@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+
+#ifndef JTAG_H
+#define JTAG_H
+
+// TCK/TMS share the SWCLK/SWDIO pins from swd.h, as on a standard 10-pin header
+#define JTAG_TCK_PIN 2
+#define JTAG_TMS_PIN 3
+#define JTAG_TDI_PIN 5
+#define JTAG_TDO_PIN 6
+
+#define JTAG_PIO pio0
+#define JTAG_DEFAULT_TCK_HZ (10 * 1000 * 1000)
+#define JTAG_MAX_TCK_HZ (31250 * 1000)      // clk_sys / 4 cycles per bit
+
+#define JTAG_MAX_DEVICES 8
+#define JTAG_MAX_IR_BITS 256                // Flush length for chain probing
+#define JTAG_QUEUE_DEPTH 32
+
+#define JTAG_DEFAULT_SAMPLE_OPCODE 0x02     // SAMPLE/PRELOAD on many parts; check the BSDL
+#define JTAG_MAX_BSR_BITS 2048
+#define JTAG_BSCAN_FILE "bscan.bin"
+
+// What was found on the scan chain (device 0 is nearest TDO)
+typedef struct {
+    uint8_t device_count;
+    uint16_t total_ir_len;
+    uint32_t idcodes[JTAG_MAX_DEVICES];     // 0 for devices that reset into BYPASS
+} JTAGChainInfo;
+
+// One queued IR or DR scan, executed back-to-back by jtag_queue_flush()
+typedef struct {
+    bool is_ir;
+    uint32_t bits;
+    const uint8_t* tdi;     // NULL shifts all ones
+    uint8_t* tdo;           // NULL discards
+} JTAGScan;
+
+typedef struct {
+    uint8_t device;
+    uint8_t ir_len;
+    uint8_t ir_bits_before;     // IR bits of devices between the target and TDO
+    uint32_t sample_opcode;
+    uint16_t bsr_len;           // 0 = measure it
+} JTAGBoundaryConfig;
+
+// Function declarations
+bool jtag_init(uint32_t tck_hz);
+void jtag_deinit(void);
+uint32_t jtag_set_tck(uint32_t tck_hz);
+void jtag_reset(void);
+bool jtag_queue_ir(const uint8_t* tdi, uint8_t* tdo, uint32_t bits);
+bool jtag_queue_dr(const uint8_t* tdi, uint8_t* tdo, uint32_t bits);
+void jtag_queue_flush(void);
+int jtag_detect_chain(JTAGChainInfo* info);
+bool jtag_boundary_sample(const JTAGBoundaryConfig* cfg, uint32_t samples, const char* filename);
+
+#endif
@@ -0,0 +1,352 @@
+#include "pinfinder.h"
+#include "resources.h"
+#include "buddy1/sd_card.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const uint8_t default_pins[PINFINDER_PIN_COUNT] = PINFINDER_PINS;
+
+// The candidates this run could claim; pins held by other engines are skipped
+static uint8_t candidates[PINFINDER_PIN_COUNT];
+static int pin_count;
+
+static const uint32_t uart_bauds[] = {
+    1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600
+};
+
+// Every candidate back to a plain input. Pull-ups for the JTAG/SWD passes so
+// an open pin reads all ones (never a valid IDCODE or ACK), pull-downs for
+// the UART pass so only driven lines look idle-high.
+static void release_pins(bool pull_up) {
+    for (int i = 0; i < pin_count; i++) {
+        gpio_init(candidates[i]);
+        gpio_set_pulls(candidates[i], pull_up, !pull_up);
+    }
+}
+
+static inline void half_period(void) {
+    busy_wait_us_32(PINFINDER_HALF_PERIOD_US);
+}
+
+static void clock_pulse(uint clk) {
+    half_period();
+    gpio_put(clk, 1);
+    half_period();
+    gpio_put(clk, 0);
+}
+
+static void drive(uint pin, bool level) {
+    gpio_put(pin, level);
+    gpio_set_dir(pin, GPIO_OUT);
+}
+
+static void release(uint pin) {
+    gpio_set_dir(pin, GPIO_IN);
+}
+
+static bool valid_idcode(uint32_t id) {
+    uint32_t mfr = (id >> 1) & 0x7F;    // JEP106 code within its bank
+    return (id & 1) && id != 0xFFFFFFFF && mfr != 0 && mfr != 0x7F;
+}
+
+/* UART */
+
+// Passive: watch all candidates at once for UART-like traffic. Any pin that
+// toggles is driven by the target and is kept out of the active passes.
+static uint32_t find_uart(PinFinderResult* result) {
+    uint32_t mask = 0;
+    for (int i = 0; i < pin_count; i++) {
+        mask |= 1u << candidates[i];
+    }
+    release_pins(false);
+    sleep_us(100);
+
+    uint32_t edges[NUM_BANK0_GPIOS] = {0};
+    uint32_t last_edge[NUM_BANK0_GPIOS] = {0};
+    uint32_t min_width[NUM_BANK0_GPIOS];
+    for (int i = 0; i < NUM_BANK0_GPIOS; i++) min_width[i] = UINT32_MAX;
+
+    uint32_t first = gpio_get_all() & mask;
+    uint32_t last = first;
+    uint32_t start = time_us_32();
+    while (time_us_32() - start < PINFINDER_UART_WINDOW_MS * 1000) {
+        uint32_t now_level = gpio_get_all() & mask;
+        uint32_t changed = now_level ^ last;
+        if (changed) {
+            uint32_t now = time_us_32();
+            for (int i = 0; i < pin_count; i++) {
+                uint pin = candidates[i];
+                if (!(changed & (1u << pin))) continue;
+                if (edges[pin]++ > 0 && now - last_edge[pin] < min_width[pin]) {
+                    min_width[pin] = now - last_edge[pin];
+                }
+                last_edge[pin] = now;
+            }
+            last = now_level;
+        }
+    }
+
+    uint32_t busy = 0;
+    for (int i = 0; i < pin_count; i++) {
+        uint pin = candidates[i];
+        if (edges[pin] == 0) continue;
+        busy |= 1u << pin;
+
+        // UART idles high between bursts
+        bool idle_high = (first & last) & (1u << pin);
+        if (edges[pin] < PINFINDER_UART_MIN_EDGES || !idle_high || min_width[pin] == 0) continue;
+        if (result->uart_count >= PINFINDER_MAX_HITS) continue;
+
+        uint32_t raw_baud = 1000000 / min_width[pin];
+        uint32_t best = uart_bauds[0];
+        for (int b = 0; b < sizeof(uart_bauds) / sizeof(uart_bauds[0]); b++) {
+            if (abs((int)raw_baud - (int)uart_bauds[b]) < abs((int)raw_baud - (int)best)) {
+                best = uart_bauds[b];
+            }
+        }
+        UARTPinHit* hit = &result->uart[result->uart_count++];
+        hit->pin = pin;
+        hit->edges = edges[pin];
+        hit->baud = best;
+    }
+    return busy;
+}
+
+/* JTAG */
+
+static void jtag_tms(uint tck, uint tms, uint32_t seq, int count) {
+    for (int i = 0; i < count; i++) {
+        gpio_put(tms, (seq >> i) & 1);
+        clock_pulse(tck);
+    }
+}
+
+// Test-Logic-Reset, then Run-Test/Idle -> Shift-DR with IDCODE selected
+static void jtag_enter_shift_dr(uint tck, uint tms) {
+    jtag_tms(tck, tms, 0x5F, 9);
+    gpio_put(tms, 0);
+}
+
+// One TCK/TMS assignment tests every other candidate as TDO in the same pass:
+// the whole port is sampled on each clock.
+static int scan_jtag_pair(uint tck, uint tms, uint32_t tdo_mask, PinFinderResult* result) {
+    drive(tck, 0);
+    drive(tms, 1);
+    jtag_enter_shift_dr(tck, tms);
+
+    uint32_t ids[NUM_BANK0_GPIOS] = {0};
+    uint32_t live = tdo_mask;
+    for (int i = 0; i < 32 && live; i++) {
+        uint32_t sample = gpio_get_all();
+        if (i == 0) {
+            live &= sample;     // IDCODE LSB is always 1
+        }
+        for (int c = 0; c < pin_count; c++) {
+            uint pin = candidates[c];
+            if ((live & (1u << pin)) && (sample & (1u << pin))) {
+                ids[pin] |= 1u << i;
+            }
+        }
+        clock_pulse(tck);
+    }
+    jtag_tms(tck, tms, 0x1F, 5);
+    release(tck);
+    release(tms);
+
+    int found = 0;
+    for (int c = 0; c < pin_count; c++) {
+        uint pin = candidates[c];
+        if (!(live & (1u << pin)) || !valid_idcode(ids[pin])) continue;
+        if (result->jtag_count >= PINFINDER_MAX_HITS) break;
+        JTAGPinHit* hit = &result->jtag[result->jtag_count++];
+        hit->tck = tck;
+        hit->tms = tms;
+        hit->tdo = pin;
+        hit->tdi = 0xFF;
+        hit->idcode = ids[pin];
+        found++;
+    }
+    return found;
+}
+
+// With TCK/TMS/TDO known, a pattern driven on the right TDI pin comes back out
+// of TDO after the IDCODE registers of every device in the chain.
+static void find_tdi(JTAGPinHit* hit, uint32_t busy) {
+    const uint32_t bits = 32 * (PINFINDER_MAX_CHAIN + 1);
+
+    for (int c = 0; c < pin_count; c++) {
+        uint tdi = candidates[c];
+        if (tdi == hit->tck || tdi == hit->tms || tdi == hit->tdo || (busy & (1u << tdi))) {
+            continue;
+        }
+        drive(hit->tck, 0);
+        drive(hit->tms, 1);
+        drive(tdi, 0);
+        jtag_enter_shift_dr(hit->tck, hit->tms);
+
+        uint32_t window = 0;
+        bool match = false;
+        for (uint32_t i = 0; i < bits && !match; i++) {
+            gpio_put(tdi, i < 32 ? (PINFINDER_TDI_PATTERN >> i) & 1 : 0);
+            window = (window >> 1) | ((uint32_t)gpio_get(hit->tdo) << 31);
+            match = i >= 32 && window == PINFINDER_TDI_PATTERN;
+            clock_pulse(hit->tck);
+        }
+        jtag_tms(hit->tck, hit->tms, 0x1F, 5);
+        release(hit->tck);
+        release(hit->tms);
+        release(tdi);
+
+        if (match) {
+            hit->tdi = tdi;
+            return;
+        }
+    }
+}
+
+/* SWD */
+
+static void swd_write(uint clk, uint dio, uint32_t data, int count) {
+    for (int i = 0; i < count; i++) {
+        gpio_put(dio, (data >> i) & 1);
+        clock_pulse(clk);
+    }
+}
+
+static uint32_t swd_read(uint clk, uint dio, int count) {
+    uint32_t data = 0;
+    for (int i = 0; i < count; i++) {
+        data |= (uint32_t)gpio_get(dio) << i;
+        clock_pulse(clk);
+    }
+    return data;
+}
+
+// Same wake-up as swd_init(): line reset, JTAG-to-SWD, dormant wake, then a
+// DP IDCODE read. A wrong pair is dropped as soon as the ACK isn't OK.
+static bool scan_swd_pair(uint clk, uint dio, uint32_t* idcode) {
+    drive(clk, 0);
+    drive(dio, 1);
+
+    swd_write(clk, dio, 0xFFFFFFFF, 32);
+    swd_write(clk, dio, 0xFFFFF, 20);
+    swd_write(clk, dio, 0xE79E, 16);
+    swd_write(clk, dio, 0xFFFFFFFF, 32);
+    swd_write(clk, dio, 0xFFFFF, 20);
+    swd_write(clk, dio, 0x00, 20);
+    swd_write(clk, dio, 0xFF, 8);
+    swd_write(clk, dio, 0x6209F392, 32);
+    swd_write(clk, dio, 0x86852D95, 32);
+    swd_write(clk, dio, 0xE3DDAFE9, 32);
+    swd_write(clk, dio, 0x19BC0EA2, 32);
+    swd_write(clk, dio, 0x0, 4);
+    swd_write(clk, dio, 0x1A, 8);
+    swd_write(clk, dio, 0xFFFFFFFF, 32);
+    swd_write(clk, dio, 0xFFFFF, 20);
+    swd_write(clk, dio, 0x00, 8);
+
+    swd_write(clk, dio, 0xA5, 8);       // DP read, IDCODE
+    release(dio);
+    clock_pulse(clk);                   // Turnaround
+
+    bool ok = false;
+    uint32_t ack = swd_read(clk, dio, 3);
+    if (ack == 0x1) {
+        uint32_t id = swd_read(clk, dio, 32);
+        uint32_t parity = swd_read(clk, dio, 1);
+        ok = (parity == (uint32_t)__builtin_parity(id)) && valid_idcode(id);
+        *idcode = id;
+    }
+
+    clock_pulse(clk);                   // Turnaround back to host
+    drive(dio, 0);
+    swd_write(clk, dio, 0x00, 8);
+    release(clk);
+    release(dio);
+    return ok;
+}
+
+void pinfinder_run(PinFinderResult* result) {
+    memset(result, 0, sizeof(*result));
+    uint32_t start = time_us_32();
+
+    uint32_t wanted = 0;
+    for (int i = 0; i < PINFINDER_PIN_COUNT; i++) {
+        wanted |= 1u << default_pins[i];
+    }
+    // Never drive the SD bus, even before the card has been mounted and claimed
+    wanted &= ~SD_PIN_MASK;
+    uint32_t claimed = res_claim_available_pins("pinfinder", wanted, RES_PIN_EXCLUSIVE);
+    pin_count = 0;
+    for (int i = 0; i < PINFINDER_PIN_COUNT; i++) {
+        if (claimed & (1u << default_pins[i])) candidates[pin_count++] = default_pins[i];
+    }
+    if (pin_count < 2) {
+        printf("Pin finder: not enough free candidate pins\n");
+        res_release_pins("pinfinder", claimed);
+        return;
+    }
+
+    printf("Pin finder: %d candidates (", pin_count);
+    for (int i = 0; i < pin_count; i++) {
+        printf(i ? " GP%d" : "GP%d", candidates[i]);
+    }
+    printf(")\n");
+
+    // Listen first so target outputs are never driven against
+    uint32_t busy = find_uart(result);
+
+    uint32_t all = claimed;
+
+    release_pins(true);
+    for (int a = 0; a < pin_count; a++) {
+        for (int b = 0; b < pin_count; b++) {
+            uint p = candidates[a], q = candidates[b];
+            if (p == q || (busy & ((1u << p) | (1u << q)))) continue;
+
+            uint32_t tdo_mask = all & ~((1u << p) | (1u << q));
+            result->permutations += pin_count - 2;
+            scan_jtag_pair(p, q, tdo_mask, result);
+
+            uint32_t id;
+            result->permutations++;
+            if (scan_swd_pair(p, q, &id) && result->swd_count < PINFINDER_MAX_HITS) {
+                SWDPinHit* hit = &result->swd[result->swd_count++];
+                hit->swclk = p;
+                hit->swdio = q;
+                hit->idcode = id;
+            }
+        }
+    }
+    for (int i = 0; i < result->jtag_count; i++) {
+        find_tdi(&result->jtag[i], busy);
+    }
+
+    // Leave everything floating for whatever gets attached next
+    for (int i = 0; i < pin_count; i++) {
+        gpio_init(candidates[i]);
+        gpio_disable_pulls(candidates[i]);
+    }
+    res_release_pins("pinfinder", claimed);
+    result->elapsed_ms = (time_us_32() - start) / 1000;
+
+    printf("Pin finder: %lu permutations in %lu ms\n", result->permutations, result->elapsed_ms);
+    for (int i = 0; i < result->jtag_count; i++) {
+        JTAGPinHit* hit = &result->jtag[i];
+        printf("  JTAG: TCK GP%d, TMS GP%d, TDO GP%d, ", hit->tck, hit->tms, hit->tdo);
+        if (hit->tdi != 0xFF) printf("TDI GP%d", hit->tdi);
+        else printf("TDI not found");
+        printf(" (IDCODE 0x%08lX)\n", hit->idcode);
+    }
+    for (int i = 0; i < result->swd_count; i++) {
+        printf("  SWD: SWCLK GP%d, SWDIO GP%d (DPIDR 0x%08lX)\n",
+               result->swd[i].swclk, result->swd[i].swdio, result->swd[i].idcode);
+    }
+    for (int i = 0; i < result->uart_count; i++) {
+        printf("  UART TX from target on GP%d, ~%lu baud (%lu edges)\n",
+               result->uart[i].pin, result->uart[i].baud, result->uart[i].edges);
+    }
+    if (!result->jtag_count && !result->swd_count && !result->uart_count) {
+        printf("  Nothing found\n");
+    }
+}
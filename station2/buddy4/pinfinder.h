@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+
+#ifndef PINFINDER_H
+#define PINFINDER_H
+
+// Candidate header pins. Skips the SD card (GP10-12, GP15), the I2C master,
+// the PWM/ADC inputs and the buttons. SD_PIN_MASK is filtered out again at
+// run time, and any candidate another engine holds is left out of the search.
+#define PINFINDER_PINS { 2, 3, 4, 5, 6, 8, 9, 13, 14, 16, 27, 28 }
+#define PINFINDER_PIN_COUNT 12
+
+#define PINFINDER_HALF_PERIOD_US 1      // ~250 kHz bit-bang, safe for unknown targets
+#define PINFINDER_UART_WINDOW_MS 250
+#define PINFINDER_UART_MIN_EDGES 10
+#define PINFINDER_TDI_PATTERN 0x5A3C96E1
+#define PINFINDER_MAX_CHAIN 8           // Devices to look past when hunting TDI
+#define PINFINDER_MAX_HITS 8
+
+typedef struct {
+    uint8_t tck;
+    uint8_t tms;
+    uint8_t tdo;
+    uint8_t tdi;            // 0xFF if not found
+    uint32_t idcode;
+} JTAGPinHit;
+
+typedef struct {
+    uint8_t swclk;
+    uint8_t swdio;
+    uint32_t idcode;
+} SWDPinHit;
+
+typedef struct {
+    uint8_t pin;
+    uint32_t edges;
+    uint32_t baud;          // Nearest standard rate to the shortest pulse
+} UARTPinHit;
+
+typedef struct {
+    JTAGPinHit jtag[PINFINDER_MAX_HITS];
+    uint8_t jtag_count;
+    SWDPinHit swd[PINFINDER_MAX_HITS];
+    uint8_t swd_count;
+    UARTPinHit uart[PINFINDER_MAX_HITS];
+    uint8_t uart_count;
+    uint32_t permutations;  // Pin assignments actually clocked
+    uint32_t elapsed_ms;
+} PinFinderResult;
+
+// Function declarations
+void pinfinder_run(PinFinderResult* result);
+
+#endif
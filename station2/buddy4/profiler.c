@@ -0,0 +1,221 @@
+#include "profiler.h"
+#include "buddy1/sd_card.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define PROBE_SAMPLES 16
+#define PCSR_NO_PC 0xFFFFFFFFu          // Read while the core isn't executing
+
+typedef struct {
+    uint32_t addr;
+    uint32_t count;                     // 0 marks a free slot
+} ProfBin;
+
+static SwdPort port;
+static ProfBin bins[PROF_BINS];
+static uint32_t samples[PROF_BATCH];
+
+// Open addressing with linear probing; kept under 3/4 full so probes stay short
+static void bin_sample(uint32_t pc, uint8_t shift, ProfStats* stats) {
+    uint32_t addr = pc & ~((1u << shift) - 1);
+    uint32_t i = ((addr >> shift) * 2654435761u) >> (32 - PROF_BINS_LOG2);
+    while (bins[i].count) {
+        if (bins[i].addr == addr) {
+            bins[i].count++;
+            stats->samples++;
+            return;
+        }
+        i = (i + 1) & (PROF_BINS - 1);
+    }
+    if (stats->addresses >= PROF_BINS / 4 * 3) {
+        stats->overflow++;
+        return;
+    }
+    bins[i].addr = addr;
+    bins[i].count = 1;
+    stats->addresses++;
+    stats->samples++;
+}
+
+static int by_count(const void* a, const void* b) {
+    uint32_t ca = ((const ProfBin*)a)->count;
+    uint32_t cb = ((const ProfBin*)b)->count;
+    return ca < cb ? 1 : ca > cb ? -1 : 0;
+}
+
+static const ProfBin* busiest(void) {
+    const ProfBin* top = &bins[0];
+    for (uint i = 1; i < PROF_BINS; i++) {
+        if (bins[i].count > top->count) top = &bins[i];
+    }
+    return top;
+}
+
+// Falls back to the default clock if the wiring won't take the fast one
+static bool connect(const ProfConfig* cfg) {
+    if (!swd_port_open(&port, SWD_PIO, SWCLK_PIN, SWDIO_PIN, cfg->swd_hz)) {
+        return false;
+    }
+    if (swd_connect(&port, cfg->targetsel)) {
+        return true;
+    }
+    if (cfg->swd_hz > SWD_DEFAULT_HZ) {
+        swd_port_close(&port);
+        if (swd_port_open(&port, SWD_PIO, SWCLK_PIN, SWDIO_PIN, SWD_DEFAULT_HZ) &&
+            swd_connect(&port, cfg->targetsel)) {
+            return true;
+        }
+    }
+    printf("Profiler: no SWD target (%s)\n", swd_error_string(&port));
+    swd_port_close(&port);
+    return false;
+}
+
+// PCSR reads as zero where it isn't implemented
+static bool has_pcsr(void) {
+    uint32_t probe[PROBE_SAMPLES];
+    if (!swd_mem_read_repeat(&port, CM_DWT_PCSR, probe, PROBE_SAMPLES)) {
+        return false;
+    }
+    for (int i = 0; i < PROBE_SAMPLES; i++) {
+        if (probe[i] != 0 && probe[i] != PCSR_NO_PC) return true;
+    }
+    return false;
+}
+
+// One block of PCSR reads, or one halt-and-read, into the histogram
+static bool take_samples(const ProfConfig* cfg, ProfStats* stats) {
+    if (stats->mode == PROF_MODE_PCSR) {
+        if (!swd_mem_read_repeat(&port, CM_DWT_PCSR, samples, PROF_BATCH)) {
+            return false;
+        }
+        for (int i = 0; i < PROF_BATCH; i++) {
+            if (samples[i] == PCSR_NO_PC) {
+                stats->no_pc++;
+            } else {
+                bin_sample(samples[i], cfg->bin_shift, stats);
+            }
+        }
+        return true;
+    }
+    uint32_t pc;
+    bool ok = swd_halt(&port) && swd_read_core_reg(&port, CM_REG_PC, &pc);
+    if (!swd_resume(&port) || !ok) {
+        return false;
+    }
+    bin_sample(pc, cfg->bin_shift, stats);
+    return true;
+}
+
+static bool save_profile(const ProfStats* stats) {
+    if (ensureSDMounted() != FR_OK) {
+        return false;
+    }
+    FIL file;
+    if (f_open(&file, PROF_FILE, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) {
+        printf("Profiler: f_open failed\n");
+        return false;
+    }
+    bool ok = f_puts("address,count\n", &file) >= 0;
+    for (uint32_t i = 0; ok && i < stats->addresses; i++) {
+        char line[32];
+        int len = snprintf(line, sizeof(line), "0x%08lx,%lu\n", bins[i].addr, bins[i].count);
+        ok = f_puts(line, &file) == len;
+    }
+    ok = f_close(&file) == FR_OK && ok;
+    if (!ok) {
+        printf("Profiler: SD write failed\n");
+    }
+    return ok;
+}
+
+// Samples until a key is pressed or duration_s runs out, then saves the
+// histogram. The target keeps running throughout and is left as found.
+bool profiler_run(const ProfConfig* cfg, ProfStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    memset(bins, 0, sizeof(bins));
+    if (!connect(cfg)) {
+        return false;
+    }
+    uint32_t dhcsr, demcr;
+    if (!swd_mem_read32(&port, CM_DHCSR, &dhcsr) || !swd_mem_read32(&port, CM_DEMCR, &demcr)) {
+        printf("Profiler: can't read the debug registers (%s)\n", swd_error_string(&port));
+        swd_port_close(&port);
+        return false;
+    }
+    if (dhcsr & CM_DHCSR_S_HALT) {
+        printf("Profiler: target is halted, resume it first\n");
+        swd_port_close(&port);
+        return false;
+    }
+    // The DWT only runs with TRCENA set
+    swd_mem_write32(&port, CM_DEMCR, demcr | CM_DEMCR_TRCENA);
+
+    stats->mode = cfg->mode;
+    if (stats->mode == PROF_MODE_AUTO) {
+        stats->mode = has_pcsr() ? PROF_MODE_PCSR : PROF_MODE_HALT;
+    }
+    printf("Profiler: DPIDR 0x%08lx, SWD at %lu Hz, %s, %u-byte bins, any key stops\n",
+           port.idcode, port.freq_hz,
+           stats->mode == PROF_MODE_PCSR ? "sampling DWT_PCSR" : "halting to sample PC",
+           1u << cfg->bin_shift);
+
+    uint32_t start_us = time_us_32();
+    uint32_t last_sample_us = start_us - cfg->halt_period_us;
+    uint32_t second_start_us = start_us;
+    uint64_t second_start_samples = 0;
+    uint fails = 0;
+    bool ok = true;
+
+    while (getchar_timeout_us(0) == PICO_ERROR_TIMEOUT) {
+        uint32_t now = time_us_32();
+        if (cfg->duration_s && now - start_us >= cfg->duration_s * 1000000) {
+            break;
+        }
+        if (stats->mode == PROF_MODE_PCSR || now - last_sample_us >= cfg->halt_period_us) {
+            last_sample_us = now;
+            if (take_samples(cfg, stats)) {
+                fails = 0;
+            } else {
+                stats->errors++;
+                if (++fails >= PROF_MAX_ERRORS) {
+                    printf("Profiler: lost the target (%s)\n", swd_error_string(&port));
+                    ok = false;
+                    break;
+                }
+            }
+        }
+        if (now - second_start_us >= 1000000) {
+            stats->samples_per_s = (uint32_t)((stats->samples - second_start_samples) * 1000000 /
+                                              (now - second_start_us));
+            second_start_us = now;
+            second_start_samples = stats->samples;
+            const ProfBin* top = busiest();
+            printf("Profiler: %lu samples/s, %llu total, %lu addresses, busiest 0x%08lx (%lu%%)\n",
+                   stats->samples_per_s, stats->samples, stats->addresses, top->addr,
+                   stats->samples ? (uint32_t)(top->count * 100 / stats->samples) : 0);
+        }
+    }
+
+    // Leave the debug logic as it was found
+    if (ok) {
+        swd_mem_write32(&port, CM_DEMCR, demcr);
+        if (!(dhcsr & CM_DHCSR_C_DEBUGEN)) {
+            swd_mem_write32(&port, CM_DHCSR, CM_DHCSR_KEY);
+        }
+    }
+    swd_port_close(&port);
+
+    qsort(bins, PROF_BINS, sizeof(bins[0]), by_count);
+    printf("\nProfiler: %llu samples at %lu addresses, %lu without a PC, %lu dropped (table full), %lu errors\n",
+           stats->samples, stats->addresses, stats->no_pc, stats->overflow, stats->errors);
+    for (uint32_t i = 0; i < MIN(stats->addresses, PROF_TOP); i++) {
+        printf("  0x%08lx  %10lu  %5.1f%%\n", bins[i].addr, bins[i].count,
+               100.0f * bins[i].count / stats->samples);
+    }
+    if (!stats->samples || !save_profile(stats)) {
+        return false;
+    }
+    printf("  Saved to %s\n", PROF_FILE);
+    return ok;
+}
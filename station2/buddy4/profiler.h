@@ -0,0 +1,56 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "swd.h"
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// Statistical PC-sampling profiler over SWD, for firmware that can't be
+// rebuilt. Cores with a DWT PC sample register (DWT_PCSR) are sampled
+// without stopping: the register is read back-to-back with the MEM-AP
+// auto-increment off, so each sample costs one SWD packet. Cores without
+// it are halted briefly every halt_period_us to read the PC, then resumed.
+//
+// Samples are binned by address on the device and saved to SD as
+// "address,count" lines, busiest first, for symbolizing on the host:
+//   cut -d, -f1 profile.csv | tail -n +2 | arm-none-eabi-addr2line -fpe fw.elf
+
+#define PROF_BINS_LOG2 12
+#define PROF_BINS (1 << PROF_BINS_LOG2)     // Distinct addresses kept
+#define PROF_BATCH 256                      // PCSR reads per block
+#define PROF_HALT_PERIOD_US 1000            // 1 kHz when halting
+#define PROF_MAX_ERRORS 10                  // Failed reads in a row before giving up
+#define PROF_TOP 10                         // Shown on USB at the end
+#define PROF_FILE "profile.csv"
+
+typedef enum {
+    PROF_MODE_AUTO,                     // PCSR if the core has it, else halting
+    PROF_MODE_PCSR,
+    PROF_MODE_HALT
+} ProfMode;
+
+typedef struct {
+    ProfMode mode;
+    uint32_t targetsel;                 // 0 unless the target is on a multi-drop bus
+    uint32_t swd_hz;
+    uint8_t bin_shift;                  // Bin width 2^n bytes; 1 = every Thumb halfword
+    uint32_t halt_period_us;
+    uint32_t duration_s;                // 0 runs until a key is pressed
+} ProfConfig;
+
+#define PROF_DEFAULT_CONFIG { PROF_MODE_AUTO, 0, SWD_MAX_HZ, 1, PROF_HALT_PERIOD_US, 0 }
+
+typedef struct {
+    ProfMode mode;                      // What was actually used
+    uint64_t samples;                   // Binned samples
+    uint32_t samples_per_s;             // Over the last second
+    uint32_t no_pc;                     // PCSR all-ones: core halted or asleep
+    uint32_t overflow;                  // Samples that found the table full
+    uint32_t addresses;                 // Bins in use
+    uint32_t errors;
+} ProfStats;
+
+// Function declarations
+bool profiler_run(const ProfConfig* cfg, ProfStats* stats);
+
+#endif // PROFILER_H
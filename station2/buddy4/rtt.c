@@ -0,0 +1,306 @@
+#include "rtt.h"
+#include "buddy1/sd_card.h"
+#include <string.h>
+
+// Control block layout (32-bit target)
+#define CB_ID_WORDS 3
+#define CB_NUM_UP 16
+#define CB_UP_DESC 24
+#define DESC_SIZE 24                    // sName, pBuffer, SizeOfBuffer, WrOff, RdOff, Flags
+#define DESC_BUFFER 4
+#define DESC_LENGTH 8
+#define DESC_WROFF 12
+#define DESC_RDOFF 16
+
+#define SCAN_WORDS 256
+#define SD_BUF_SIZE 8192
+#define DOWN_QUEUE 64
+
+// "SEGGER RTT" and its zero padding, as little-endian words
+static const uint32_t CB_ID[CB_ID_WORDS] = { 0x47474553, 0x52205245, 0x00005454 };
+
+// Private link state
+typedef struct {
+    SwdPort port;
+    uint32_t cb;
+    uint32_t up_desc;
+    uint32_t up_buffer;
+    uint32_t up_size;
+    uint32_t down_desc;                 // 0 without a down buffer
+    uint32_t down_buffer;
+    uint32_t down_size;
+} RttLink;
+
+static RttLink rtt;
+
+static uint32_t scan_buf[2 + SCAN_WORDS];
+static uint8_t chunk[RTT_CHUNK_BYTES] __attribute__((aligned(4)));
+static uint8_t sd_buf[SD_BUF_SIZE];
+static uint sd_len = 0;
+static uint8_t down_queue[DOWN_QUEUE];
+static uint down_len = 0;
+static char line[RTT_TAIL_CHARS];
+static uint line_len = 0;
+
+static bool in_ram(const RttConfig* cfg, uint32_t addr, uint32_t len) {
+    return addr >= cfg->ram_start && len <= cfg->ram_size &&
+           addr - cfg->ram_start <= cfg->ram_size - len;
+}
+
+// A stale copy of the ID (a stack buffer, say) won't have sane descriptors
+static bool check_control_block(const RttConfig* cfg, uint32_t cb) {
+    uint32_t head[2 + DESC_SIZE / 4];
+    if (!swd_mem_read_words(&rtt.port, cb + CB_NUM_UP, head, 2 + DESC_SIZE / 4)) {
+        return false;
+    }
+    uint32_t num_up = head[0];
+    uint32_t num_down = head[1];
+    const uint32_t* up = &head[2];
+    if (num_up == 0 || num_up > RTT_MAX_BUFFERS || num_down > RTT_MAX_BUFFERS ||
+        up[DESC_LENGTH / 4] == 0 || !in_ram(cfg, up[DESC_BUFFER / 4], up[DESC_LENGTH / 4])) {
+        return false;
+    }
+    rtt.cb = cb;
+    rtt.up_desc = cb + CB_UP_DESC;
+    rtt.up_buffer = up[DESC_BUFFER / 4];
+    rtt.up_size = up[DESC_LENGTH / 4];
+    rtt.down_desc = 0;
+
+    if (num_down) {
+        uint32_t down[DESC_SIZE / 4];
+        uint32_t desc = rtt.up_desc + num_up * DESC_SIZE;
+        if (swd_mem_read_words(&rtt.port, desc, down, DESC_SIZE / 4) &&
+            down[DESC_LENGTH / 4] && in_ram(cfg, down[DESC_BUFFER / 4], down[DESC_LENGTH / 4])) {
+            rtt.down_desc = desc;
+            rtt.down_buffer = down[DESC_BUFFER / 4];
+            rtt.down_size = down[DESC_LENGTH / 4];
+        }
+    }
+    return true;
+}
+
+// Word-aligned scan; the last two words of each block are kept in front of
+// the next so an ID straddling the boundary is still seen
+static bool find_control_block(const RttConfig* cfg) {
+    uint32_t end = cfg->ram_start + cfg->ram_size;
+    scan_buf[0] = scan_buf[1] = 0;
+    for (uint32_t addr = cfg->ram_start; addr < end; addr += SCAN_WORDS * 4) {
+        uint32_t n = MIN(SCAN_WORDS, (end - addr) / 4);
+        if (!swd_mem_read_words(&rtt.port, addr, &scan_buf[2], n)) {
+            printf("RTT: read at 0x%08lx failed: %s\n", addr, swd_error_string(&rtt.port));
+            return false;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            if (scan_buf[i] == CB_ID[0] && scan_buf[i + 1] == CB_ID[1] &&
+                scan_buf[i + 2] == CB_ID[2] && check_control_block(cfg, addr + 4 * i - 8)) {
+                return true;
+            }
+        }
+        scan_buf[0] = scan_buf[n];
+        scan_buf[1] = scan_buf[n + 1];
+    }
+    return false;
+}
+
+static bool attach(const RttConfig* cfg) {
+    if (!swd_connect(&rtt.port, cfg->targetsel)) {
+        printf("RTT: SWD connect failed: %s\n", swd_error_string(&rtt.port));
+        return false;
+    }
+    printf("RTT: DPIDR 0x%08lx, scanning 0x%08lx-0x%08lx\n", rtt.port.idcode,
+           cfg->ram_start, cfg->ram_start + cfg->ram_size);
+    if (!find_control_block(cfg)) {
+        printf("RTT: no control block found\n");
+        return false;
+    }
+    printf("RTT: control block at 0x%08lx, up buffer %lu bytes at 0x%08lx",
+           rtt.cb, rtt.up_size, rtt.up_buffer);
+    if (rtt.down_desc) {
+        printf(", down buffer %lu bytes", rtt.down_size);
+    }
+    printf("\n");
+    return true;
+}
+
+static bool flush_sd(FIL* file) {
+    UINT written;
+    bool ok = f_write(file, sd_buf, sd_len, &written) == FR_OK && written == sd_len;
+    sd_len = 0;
+    return ok;
+}
+
+static void output(FIL* file, const uint8_t* data, uint32_t n, RttStats* stats, bool* sd_ok) {
+    fwrite(data, 1, n, stdout);
+
+    for (uint32_t i = 0; i < n; ) {
+        if (sd_len == SD_BUF_SIZE) {
+            *sd_ok = flush_sd(file) && *sd_ok;
+        }
+        uint32_t m = MIN(n - i, SD_BUF_SIZE - sd_len);
+        memcpy(sd_buf + sd_len, data + i, m);
+        sd_len += m;
+        i += m;
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+        char c = data[i];
+        if (c == '\n') {
+            line[line_len] = '\0';
+            memcpy(stats->tail, line, line_len + 1);
+            line_len = 0;
+        } else if (c >= ' ' && c < 0x7F && line_len < RTT_TAIL_CHARS - 1) {
+            line[line_len++] = c;
+        }
+    }
+}
+
+// Drains one contiguous stretch of up buffer 0. Returns the byte count, or
+// -1 if the target didn't answer or the offsets make no sense.
+static int32_t poll_up(FIL* file, RttStats* stats, bool* sd_ok) {
+    uint32_t off[2];
+    if (!swd_mem_read_words(&rtt.port, rtt.up_desc + DESC_WROFF, off, 2)) {
+        return -1;
+    }
+    uint32_t wr = off[0];
+    uint32_t rd = off[1];
+    if (wr >= rtt.up_size || rd >= rtt.up_size) {
+        return -1;
+    }
+    if (wr == rd) {
+        return 0;
+    }
+    uint32_t n = MIN(wr > rd ? wr - rd : rtt.up_size - rd, RTT_CHUNK_BYTES);
+    if (!swd_mem_read(&rtt.port, rtt.up_buffer + rd, chunk, n) ||
+        !swd_mem_write32(&rtt.port, rtt.up_desc + DESC_RDOFF, (rd + n) % rtt.up_size)) {
+        return -1;
+    }
+    output(file, chunk, n, stats, sd_ok);
+    stats->bytes += n;
+    return n;
+}
+
+// Writes what fits of the queued keys into down buffer 0
+static bool push_down(RttStats* stats) {
+    uint32_t off[2];
+    if (!swd_mem_read_words(&rtt.port, rtt.down_desc + DESC_WROFF, off, 2)) {
+        return false;
+    }
+    uint32_t wr = off[0];
+    uint32_t rd = off[1];
+    if (wr >= rtt.down_size || rd >= rtt.down_size) {
+        return false;
+    }
+    uint32_t space = (rd + rtt.down_size - wr - 1) % rtt.down_size;
+    uint32_t n = MIN(MIN(space, down_len), rtt.down_size - wr);
+    if (n == 0) {
+        return true;
+    }
+    if (!swd_mem_write(&rtt.port, rtt.down_buffer + wr, down_queue, n) ||
+        !swd_mem_write32(&rtt.port, rtt.down_desc + DESC_WROFF, (wr + n) % rtt.down_size)) {
+        return false;
+    }
+    memmove(down_queue, down_queue + n, down_len - n);
+    down_len -= n;
+    stats->down_bytes += n;
+    return true;
+}
+
+// Streams up buffer 0 until Ctrl-] is pressed
+bool rtt_run(const RttConfig* cfg, rtt_status_handler_t on_status, RttStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (ensureSDMounted() != FR_OK) {
+        return false;
+    }
+    FIL file;
+    if (f_open(&file, RTT_FILE, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) {
+        printf("RTT: f_open failed\n");
+        return false;
+    }
+    if (!swd_port_open(&rtt.port, SWD_PIO, SWCLK_PIN, SWDIO_PIN, cfg->swd_hz)) {
+        f_close(&file);
+        return false;
+    }
+    printf("RTT: SWD at %lu Hz on SWCLK GP%d, SWDIO GP%d\n", rtt.port.freq_hz, SWCLK_PIN, SWDIO_PIN);
+    if (!attach(cfg)) {
+        swd_port_close(&rtt.port);
+        f_close(&file);
+        return false;
+    }
+    stats->cb_addr = rtt.cb;
+    stats->up_size = rtt.up_size;
+    printf("RTT: streaming to USB and %s, Ctrl-] stops\n\n", RTT_FILE);
+
+    sd_len = down_len = line_len = 0;
+    bool sd_ok = true;
+    uint32_t interval_us = 0;
+    uint32_t last_poll_us = time_us_32();
+    uint32_t second_start_us = last_poll_us;
+    uint64_t second_start_bytes = 0;
+    uint fails = 0;
+
+    while (true) {
+        int c = getchar_timeout_us(0);
+        if (c == RTT_EXIT_CHAR) {
+            break;
+        }
+        if (c != PICO_ERROR_TIMEOUT && down_len < DOWN_QUEUE) {
+            down_queue[down_len++] = (uint8_t)c;
+        }
+
+        uint32_t now = time_us_32();
+        if (now - last_poll_us >= interval_us) {
+            last_poll_us = now;
+            stats->polls++;
+            int32_t n = poll_up(&file, stats, &sd_ok);
+            bool ok = n >= 0 && (!down_len || !rtt.down_desc || push_down(stats));
+            if (ok) {
+                fails = 0;
+                // Busy: straight on. Idle: back off.
+                interval_us = n > 0 ? 0 : MIN(MAX(interval_us * 2, RTT_POLL_MIN_US), RTT_POLL_MAX_US);
+            } else {
+                stats->errors++;
+                interval_us = RTT_POLL_MAX_US;
+                if (++fails >= RTT_RECONNECT_ERRORS) {
+                    // Target reset or went away: start over, control block and all
+                    printf("\nRTT: lost the target (%s), reconnecting\n", swd_error_string(&rtt.port));
+                    stats->reconnects++;
+                    fails = 0;
+                    interval_us = 1000 * 1000;
+                    if (attach(cfg)) {
+                        stats->cb_addr = rtt.cb;
+                        stats->up_size = rtt.up_size;
+                        interval_us = 0;
+                    }
+                }
+            }
+            stats->poll_interval_us = interval_us;
+        }
+
+        if (sd_len >= SD_BUF_SIZE / 2) {
+            sd_ok = flush_sd(&file) && sd_ok;
+        }
+        if (now - second_start_us >= 1000000) {
+            stats->bytes_per_s = (uint32_t)((stats->bytes - second_start_bytes) * 1000000 /
+                                            (now - second_start_us));
+            if (stats->bytes_per_s > stats->peak_bytes_per_s) {
+                stats->peak_bytes_per_s = stats->bytes_per_s;
+            }
+            second_start_us = now;
+            second_start_bytes = stats->bytes;
+            if (on_status) on_status(stats);
+        }
+    }
+    swd_port_close(&rtt.port);
+    sd_ok = flush_sd(&file) && sd_ok;
+    sd_ok = f_close(&file) == FR_OK && sd_ok;
+
+    printf("\nRTT: %llu bytes up (peak %lu B/s), %lu down, %lu polls, %lu errors, %lu reconnects\n",
+           stats->bytes, stats->peak_bytes_per_s, stats->down_bytes, stats->polls,
+           stats->errors, stats->reconnects);
+    if (sd_ok) {
+        printf("  Saved to %s\n", RTT_FILE);
+    } else {
+        printf("RTT: SD write failed\n");
+    }
+    return sd_ok;
+}
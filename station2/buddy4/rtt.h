@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "swd.h"
+
+#ifndef RTT_H
+#define RTT_H
+
+// SEGGER RTT reader over SWD. The target keeps running: its RTT control
+// block is found by scanning RAM for the "SEGGER RTT" ID through the MEM-AP,
+// then up buffer 0 is drained with block reads and its RdOff written back,
+// exactly as a J-Link would. Each poll reads WrOff/RdOff in one batch and a
+// whole contiguous stretch of the buffer in the next.
+//
+// Polling adapts to the traffic: while there is data the next poll follows
+// straight on, and each empty poll doubles the gap up to RTT_POLL_MAX_US so
+// an idle target isn't hammered. Output goes to USB and SD; the last line
+// and the data rate go to the dashboard through the status callback, once
+// a second. Keys typed on USB go to down buffer 0; Ctrl-] stops.
+
+#define RTT_RAM_START 0x20000000u
+#define RTT_RAM_SIZE (264 * 1024)       // RP2040 SRAM; set for other targets
+#define RTT_MAX_BUFFERS 16              // Sanity limit on MaxNumUp/DownBuffers
+#define RTT_CHUNK_BYTES 4096            // Largest single read from the up buffer
+#define RTT_POLL_MIN_US 50              // First step after an empty poll
+#define RTT_POLL_MAX_US 10000
+#define RTT_RECONNECT_ERRORS 3          // Failed polls in a row before reconnecting
+#define RTT_TAIL_CHARS 64
+#define RTT_EXIT_CHAR 0x1D              // Ctrl-]
+#define RTT_FILE "rtt.log"
+
+typedef struct {
+    uint32_t ram_start;
+    uint32_t ram_size;
+    uint32_t targetsel;                 // 0 unless the target is on a multi-drop bus
+    uint32_t swd_hz;
+} RttConfig;
+
+#define RTT_DEFAULT_CONFIG { RTT_RAM_START, RTT_RAM_SIZE, 0, SWD_DEFAULT_HZ }
+
+typedef struct {
+    uint32_t cb_addr;                   // Control block, 0 until found
+    uint32_t up_size;
+    uint64_t bytes;
+    uint32_t bytes_per_s;               // Over the last second
+    uint32_t peak_bytes_per_s;
+    uint32_t down_bytes;
+    uint32_t polls;
+    uint32_t errors;
+    uint32_t reconnects;
+    uint32_t poll_interval_us;
+    char tail[RTT_TAIL_CHARS];          // Last complete line, printable characters only
+} RttStats;
+
+typedef void (*rtt_status_handler_t)(const RttStats* stats);
+
+// Function declarations
+bool rtt_run(const RttConfig* cfg, rtt_status_handler_t on_status, RttStats* stats);
+
+#endif // RTT_H
@@ -0,0 +1,548 @@
+#include "sniffer.h"
+#include "sniffer.pio.h"
+#include "buddy1/sd_card.h"
+#include "resources.h"
+#include <string.h>
+
+// Same re-arm scheme as the UART bridge: reloading with 2^31 words keeps the
+// count a whole number of rings, so the word total derived from it always
+// agrees with the DMA write pointer.
+#define RELOAD_COUNT 0x80000000u
+#define RING_WORDS (SNIFF_RING_SIZE / 4)
+#define RING_MASK (RING_WORDS - 1)
+#define LINE_RESET_CYCLES 50
+#define TEXT_BUF_SIZE 4096
+#define EVENT_QUEUE 128
+
+#define SWD_PIN_MASK ((1u << SNIFF_CLK_PIN) | (1u << SNIFF_DATA_PIN))
+#define JTAG_PIN_MASK ((1u << JTAG_TCK_PIN) | (1u << JTAG_TMS_PIN) | \
+                       (1u << JTAG_TDI_PIN) | (1u << JTAG_TDO_PIN))
+
+typedef enum {
+    SWD_IDLE = 0,
+    SWD_TRN,                    // Turnaround before the ACK
+    SWD_ACK,
+    SWD_WRITE_TRN,              // Turnaround back to the host before write data
+    SWD_DATA                    // 32 data bits and parity
+} SwdPhase;
+
+typedef enum {
+    TAP_RESET = 0, TAP_IDLE,
+    TAP_SELECT_DR, TAP_CAPTURE_DR, TAP_SHIFT_DR, TAP_EXIT1_DR, TAP_PAUSE_DR, TAP_EXIT2_DR, TAP_UPDATE_DR,
+    TAP_SELECT_IR, TAP_CAPTURE_IR, TAP_SHIFT_IR, TAP_EXIT1_IR, TAP_PAUSE_IR, TAP_EXIT2_IR, TAP_UPDATE_IR,
+    TAP_UNKNOWN
+} TapState;
+
+// Next TAP state for TMS = 0 and TMS = 1
+static const uint8_t TAP_NEXT[16][2] = {
+    [TAP_RESET]      = { TAP_IDLE, TAP_RESET },
+    [TAP_IDLE]       = { TAP_IDLE, TAP_SELECT_DR },
+    [TAP_SELECT_DR]  = { TAP_CAPTURE_DR, TAP_SELECT_IR },
+    [TAP_CAPTURE_DR] = { TAP_SHIFT_DR, TAP_EXIT1_DR },
+    [TAP_SHIFT_DR]   = { TAP_SHIFT_DR, TAP_EXIT1_DR },
+    [TAP_EXIT1_DR]   = { TAP_PAUSE_DR, TAP_UPDATE_DR },
+    [TAP_PAUSE_DR]   = { TAP_PAUSE_DR, TAP_EXIT2_DR },
+    [TAP_EXIT2_DR]   = { TAP_SHIFT_DR, TAP_UPDATE_DR },
+    [TAP_UPDATE_DR]  = { TAP_IDLE, TAP_SELECT_DR },
+    [TAP_SELECT_IR]  = { TAP_CAPTURE_IR, TAP_RESET },
+    [TAP_CAPTURE_IR] = { TAP_SHIFT_IR, TAP_EXIT1_IR },
+    [TAP_SHIFT_IR]   = { TAP_SHIFT_IR, TAP_EXIT1_IR },
+    [TAP_EXIT1_IR]   = { TAP_PAUSE_IR, TAP_UPDATE_IR },
+    [TAP_PAUSE_IR]   = { TAP_PAUSE_IR, TAP_EXIT2_IR },
+    [TAP_EXIT2_IR]   = { TAP_SHIFT_IR, TAP_UPDATE_IR },
+    [TAP_UPDATE_IR]  = { TAP_IDLE, TAP_SELECT_DR },
+};
+
+// Private sniffer state
+typedef struct {
+    SniffMode mode;
+    int sm;
+    uint offset;
+    const pio_program_t* program;
+    int dma;
+    int ctrl_dma;
+    uint32_t last_count;
+    uint32_t produced;          // Absolute word positions, wrap at 2^32
+    uint32_t pos;
+    uint32_t flushed_at;
+    uint32_t last_word_us;
+    uint64_t cycle;
+
+    // SWD decoder
+    SwdPhase phase;
+    uint8_t window;             // Last 8 host bits, oldest in bit 0
+    uint8_t bits;
+    uint32_t shift;
+    uint32_t ones;
+    bool prev_target;           // Falling-edge sample from the cycle before
+    uint32_t select;            // Last DP SELECT write
+
+    // JTAG decoder
+    TapState tap;
+    uint8_t tms_ones;
+
+    SniffEvent evt;
+    SniffStats* stats;
+} Sniffer;
+
+static Sniffer sniff = { .sm = -1, .dma = -1, .ctrl_dma = -1 };
+
+static uint32_t ring[RING_WORDS] __attribute__((aligned(SNIFF_RING_SIZE)));
+static const uint32_t reload_count = RELOAD_COUNT;
+
+// Decoded entries wait here for the SD writer and the status echo
+static SniffEvent events[EVENT_QUEUE];
+static uint32_t event_head = 0;
+static uint32_t event_tail = 0;
+static uint32_t echo_tail = 0;
+static uint32_t event_drops = 0;
+
+static char text[TEXT_BUF_SIZE];
+static uint text_len = 0;
+
+static void sniff_release(void) {
+    if (sniff.dma >= 0) {
+        dma_channel_config c = dma_get_channel_config(sniff.dma);
+        channel_config_set_chain_to(&c, sniff.dma);     // Stop the re-arm loop first
+        dma_channel_set_config(sniff.dma, &c, false);
+        dma_channel_abort(sniff.dma);
+        res_release_dma(sniff.dma);
+    }
+    if (sniff.ctrl_dma >= 0) {
+        dma_channel_abort(sniff.ctrl_dma);
+        res_release_dma(sniff.ctrl_dma);
+    }
+    sniff.dma = sniff.ctrl_dma = -1;
+    if (sniff.sm >= 0) {
+        pio_sm_set_enabled(SNIFF_PIO, sniff.sm, false);
+        pio_remove_program(SNIFF_PIO, sniff.program, sniff.offset);
+        res_release_pio_sm(SNIFF_PIO, sniff.sm);
+        sniff.sm = -1;
+    }
+    res_release_pins("sniffer", sniff.mode == SNIFF_SWD ? SWD_PIN_MASK : JTAG_PIN_MASK);
+}
+
+static bool sniff_setup(SniffMode mode) {
+    sniff.mode = mode;
+    sniff.program = mode == SNIFF_SWD ? &swd_sniff_program : &jtag_sniff_program;
+    if (!pio_can_add_program(SNIFF_PIO, sniff.program)) {
+        printf("Error: No PIO space for the sniffer\n");
+        return false;
+    }
+    uint32_t pins = mode == SNIFF_SWD ? SWD_PIN_MASK : JTAG_PIN_MASK;
+    if (!res_claim_pins("sniffer", pins, RES_PIN_SHARED_INPUT)) {
+        return false;
+    }
+    sniff.sm = res_claim_pio_sm("sniffer", SNIFF_PIO);
+    sniff.dma = res_claim_dma("sniffer");
+    sniff.ctrl_dma = res_claim_dma("sniffer");
+    if (sniff.sm < 0 || sniff.dma < 0 || sniff.ctrl_dma < 0) {
+        int sm = sniff.sm;
+        sniff.sm = -1;                  // Program not loaded yet
+        if (sm >= 0) res_release_pio_sm(SNIFF_PIO, sm);
+        sniff_release();
+        return false;
+    }
+
+    for (uint pin = 0; pin < 32; pin++) {
+        if (pins & (1u << pin)) {
+            gpio_init(pin);
+            gpio_set_dir(pin, GPIO_IN);
+        }
+    }
+    sniff.offset = pio_add_program(SNIFF_PIO, sniff.program);
+    if (mode == SNIFF_SWD) {
+        swd_sniff_program_init(SNIFF_PIO, sniff.sm, sniff.offset, SNIFF_DATA_PIN);
+    } else {
+        jtag_sniff_program_init(SNIFF_PIO, sniff.sm, sniff.offset, JTAG_TMS_PIN);
+    }
+
+    dma_channel_config ctrl = dma_channel_get_default_config(sniff.ctrl_dma);
+    channel_config_set_transfer_data_size(&ctrl, DMA_SIZE_32);
+    channel_config_set_read_increment(&ctrl, false);
+    channel_config_set_write_increment(&ctrl, false);
+    dma_channel_configure(sniff.ctrl_dma, &ctrl,
+                          &dma_hw->ch[sniff.dma].al1_transfer_count_trig,
+                          &reload_count, 1, false);
+
+    dma_channel_config c = dma_channel_get_default_config(sniff.dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, SNIFF_RING_BITS);
+    channel_config_set_dreq(&c, pio_get_dreq(SNIFF_PIO, sniff.sm, false));
+    channel_config_set_chain_to(&c, sniff.ctrl_dma);
+    dma_channel_configure(sniff.dma, &c, ring, &SNIFF_PIO->rxf[sniff.sm], RELOAD_COUNT, true);
+    sniff.last_count = RELOAD_COUNT;
+    return true;
+}
+
+static void update_produced(void) {
+    uint32_t count = dma_channel_hw_addr(sniff.dma)->transfer_count;
+    uint32_t delta = (sniff.last_count - count) & (RELOAD_COUNT - 1);
+    sniff.last_count = count;
+    if (delta) {
+        sniff.produced += delta;
+        sniff.last_word_us = time_us_32();
+    }
+}
+
+// Once the bus has been quiet for a while, shift idle (zero) bits in until
+// the PIO pushes, so the tail of the last packet reaches the decoder. A
+// clock edge landing during the padding would be misplaced by a bit; at
+// SNIFF_FLUSH_US of quiet that is a risk worth taking.
+static void flush_partial_word(void) {
+    if (sniff.produced == sniff.flushed_at ||
+        time_us_32() - sniff.last_word_us < SNIFF_FLUSH_US) {
+        return;
+    }
+    // Pad whole samples so the bit pairs / nibbles stay aligned
+    uint width = sniff.mode == SNIFF_SWD ? 2 : 4;
+    uint32_t before = sniff.produced;
+    for (uint i = 0; i < 32 / width && sniff.produced == before; i++) {
+        pio_sm_exec(SNIFF_PIO, sniff.sm, pio_encode_in(pio_null, width));
+        busy_wait_us(1);
+        update_produced();
+    }
+    sniff.flushed_at = sniff.produced;
+}
+
+static void emit(const SniffEvent* e) {
+    if (event_head - event_tail >= count_of(events)) {
+        event_drops++;
+        return;
+    }
+    events[event_head % count_of(events)] = *e;
+    event_head++;
+}
+
+/* SWD */
+
+static bool valid_request(uint8_t req) {
+    return (req & (SWD_REQ_START | 0x40 | SWD_REQ_PARK)) == (SWD_REQ_START | SWD_REQ_PARK) &&
+           __builtin_parity(req & 0x3E) == 0;
+}
+
+static void swd_finish(uint8_t ack) {
+    SniffEvent* e = &sniff.evt;
+    SniffStats* s = sniff.stats;
+    e->ack = ack;
+    s->packets++;
+    if (ack == SWD_ACK_OK) s->ack_ok++;
+    else if (ack == SWD_ACK_WAIT) s->ack_wait++;
+    else if (ack == SWD_ACK_FAULT) s->ack_fault++;
+    else s->no_ack++;
+    if (!e->parity_ok) s->parity_errors++;
+
+    bool ap = e->request & SWD_REQ_AP;
+    bool read = e->request & SWD_REQ_READ;
+    uint8_t addr = (e->request & SWD_REQ_ADDR_MASK) >> 1;
+    e->ap_addr = ap ? DP_SELECT_APBANK(sniff.select) | addr : addr;
+    if (!ap && !read && addr == DP_SELECT && ack == SWD_ACK_OK && e->parity_ok) {
+        sniff.select = e->data;
+    }
+    emit(e);
+    sniff.phase = SWD_IDLE;
+    sniff.window = 0;
+}
+
+// One SWCLK cycle: host is the rising-edge sample, target the falling-edge
+// sample from the cycle before, i.e. what the host reads at this edge
+static inline void swd_cycle(bool host, bool target) {
+    SniffEvent* e = &sniff.evt;
+    switch (sniff.phase) {
+    case SWD_IDLE:
+        if (host) {
+            sniff.ones++;
+        } else {
+            if (sniff.ones >= LINE_RESET_CYCLES) {
+                SniffEvent r = { .type = SNIFF_EVT_LINE_RESET, .cycle = sniff.cycle - sniff.ones,
+                                 .time_us = sniff.last_word_us };
+                emit(&r);
+                sniff.stats->line_resets++;
+            }
+            sniff.ones = 0;
+        }
+        sniff.window = (sniff.window >> 1) | (host << 7);
+        if ((sniff.window & SWD_REQ_START) && valid_request(sniff.window)) {
+            memset(e, 0, sizeof(*e));
+            e->type = SNIFF_EVT_SWD;
+            e->cycle = sniff.cycle - 7;
+            e->time_us = sniff.last_word_us;
+            e->request = sniff.window;
+            e->parity_ok = true;
+            sniff.phase = SWD_TRN;
+            sniff.ones = 0;
+        }
+        break;
+    case SWD_TRN:
+        sniff.phase = SWD_ACK;
+        sniff.bits = 0;
+        sniff.shift = 0;
+        break;
+    case SWD_ACK:
+        sniff.shift |= (uint32_t)target << sniff.bits;
+        if (++sniff.bits < 3) break;
+        if (sniff.shift != SWD_ACK_OK) {
+            swd_finish(sniff.shift);
+            break;
+        }
+        e->ack = SWD_ACK_OK;
+        sniff.phase = (e->request & SWD_REQ_READ) ? SWD_DATA : SWD_WRITE_TRN;
+        sniff.bits = 0;
+        sniff.shift = 0;
+        break;
+    case SWD_WRITE_TRN:
+        sniff.phase = SWD_DATA;
+        break;
+    case SWD_DATA: {
+        bool bit = (e->request & SWD_REQ_READ) ? target : host;
+        if (sniff.bits < 32) {
+            sniff.shift |= (uint32_t)bit << sniff.bits++;
+            break;
+        }
+        e->data = sniff.shift;
+        e->parity_ok = bit == __builtin_parity(sniff.shift);
+        swd_finish(SWD_ACK_OK);
+        break;
+    }
+    }
+    sniff.cycle++;
+}
+
+// Sixteen cycles per word: bit 2k is the rising-edge sample of cycle k,
+// bit 2k + 1 the falling-edge one
+static void __not_in_flash_func(swd_decode_word)(uint32_t w) {
+    if (w == 0 && sniff.phase == SWD_IDLE && sniff.window == 0 && sniff.ones == 0) {
+        sniff.cycle += 16;      // Idle bus, nothing to look at
+        sniff.prev_target = false;
+        return;
+    }
+    for (uint k = 0; k < 16; k++, w >>= 2) {
+        swd_cycle(w & 1, sniff.prev_target);
+        sniff.prev_target = (w >> 1) & 1;
+    }
+}
+
+/* JTAG */
+
+static void __not_in_flash_func(jtag_decode_word)(uint32_t w) {
+    SniffEvent* e = &sniff.evt;
+    for (uint k = 0; k < 8; k++, w >>= 4) {
+        bool tms = w & 1;
+        bool tdi = (w >> 2) & 1;
+        bool tdo = (w >> 3) & 1;
+        sniff.cycle++;
+
+        // Five TMS highs reach Test-Logic-Reset from anywhere, which is
+        // also how the decoder finds its footing
+        sniff.tms_ones = tms ? sniff.tms_ones + 1 : 0;
+        if (sniff.tms_ones == 5 && sniff.tap != TAP_RESET) {
+            sniff.tap = TAP_RESET;
+            SniffEvent r = { .type = SNIFF_EVT_TAP_RESET, .cycle = sniff.cycle,
+                             .time_us = sniff.last_word_us };
+            emit(&r);
+            continue;
+        }
+        if (sniff.tap == TAP_UNKNOWN) {
+            continue;
+        }
+
+        TapState state = sniff.tap;
+        if (state == TAP_SHIFT_DR || state == TAP_SHIFT_IR) {
+            if (e->bits < SNIFF_JTAG_MAX_BITS) {
+                e->tdi |= (uint64_t)tdi << e->bits;
+                e->tdo |= (uint64_t)tdo << e->bits;
+            }
+            e->bits++;
+        }
+        TapState next = TAP_NEXT[state][tms];
+        if (next == TAP_CAPTURE_DR || next == TAP_CAPTURE_IR) {
+            memset(e, 0, sizeof(*e));
+            e->type = next == TAP_CAPTURE_DR ? SNIFF_EVT_DR : SNIFF_EVT_IR;
+            e->cycle = sniff.cycle;
+            e->time_us = sniff.last_word_us;
+        } else if (next == TAP_UPDATE_DR || next == TAP_UPDATE_IR) {
+            emit(e);
+            sniff.stats->scans++;
+        } else if (next == TAP_RESET && state != TAP_RESET) {
+            SniffEvent r = { .type = SNIFF_EVT_TAP_RESET, .cycle = sniff.cycle,
+                             .time_us = sniff.last_word_us };
+            emit(&r);
+        }
+        sniff.tap = next;
+    }
+}
+
+/* Output */
+
+static int format_event(const SniffEvent* e, char* buf, size_t len) {
+    int n = snprintf(buf, len, "%12llu %10lu  ", e->cycle, e->time_us);
+    switch (e->type) {
+    case SNIFF_EVT_SWD: {
+        bool ap = e->request & SWD_REQ_AP;
+        bool read = e->request & SWD_REQ_READ;
+        const char* ack = e->ack == SWD_ACK_OK ? "OK" : e->ack == SWD_ACK_WAIT ? "WAIT" :
+                          e->ack == SWD_ACK_FAULT ? "FAULT" : "NOACK";
+        n += snprintf(buf + n, len - n, "%s %s %-9s %-5s", ap ? "AP" : "DP", read ? "R" : "W",
+                      swd_reg_name(ap, read, e->ap_addr), ack);
+        if (e->ack == SWD_ACK_OK) {
+            n += snprintf(buf + n, len - n, " 0x%08lx%s", e->data, e->parity_ok ? "" : " PARITY");
+        }
+        break;
+    }
+    case SNIFF_EVT_LINE_RESET:
+        n += snprintf(buf + n, len - n, "LINE RESET");
+        break;
+    case SNIFF_EVT_TAP_RESET:
+        n += snprintf(buf + n, len - n, "TAP RESET");
+        break;
+    default:
+        n += snprintf(buf + n, len - n, "%s %4u bits TDI 0x%llx TDO 0x%llx%s",
+                      e->type == SNIFF_EVT_IR ? "IR" : "DR", e->bits, e->tdi, e->tdo,
+                      e->bits > SNIFF_JTAG_MAX_BITS ? " (truncated)" : "");
+        break;
+    }
+    n += snprintf(buf + n, len - n, "\n");
+    return n;
+}
+
+static bool flush_text(FIL* file) {
+    UINT written;
+    bool ok = f_write(file, text, text_len, &written) == FR_OK && written == text_len;
+    text_len = 0;
+    return ok;
+}
+
+static bool write_events(FIL* file) {
+    bool ok = true;
+    while (ok && event_tail != event_head) {
+        if (text_len > TEXT_BUF_SIZE - 160) {
+            ok = flush_text(file);
+        }
+        text_len += format_event(&events[event_tail % count_of(events)], text + text_len,
+                                 TEXT_BUF_SIZE - text_len);
+        event_tail++;
+    }
+    return ok;
+}
+
+// Status line, then the newest entries since the last one
+static void print_status(void) {
+    SniffStats* s = sniff.stats;
+    if (sniff.mode == SNIFF_SWD) {
+        printf("Sniffer: %llu cycles, %lu packets (%lu OK, %lu WAIT, %lu FAULT, %lu no ACK), "
+               "%lu parity errors, %lu line resets, %lu overruns\n",
+               s->cycles, s->packets, s->ack_ok, s->ack_wait, s->ack_fault, s->no_ack,
+               s->parity_errors, s->line_resets, s->overruns);
+    } else {
+        printf("Sniffer: %llu cycles, %lu scans, %lu overruns\n", s->cycles, s->scans, s->overruns);
+    }
+    uint32_t fresh = event_head - echo_tail;
+    if (fresh > SNIFF_RECENT) {
+        printf("  ... %lu more in %s\n", fresh - SNIFF_RECENT, SNIFF_FILE);
+        echo_tail = event_head - SNIFF_RECENT;
+    }
+    char line[128];
+    for (; echo_tail != event_head; echo_tail++) {
+        format_event(&events[echo_tail % count_of(events)], line, sizeof(line));
+        printf("  %s", line);
+    }
+}
+
+// Decodes the ring into SNIFF_FILE until a key is pressed
+bool sniffer_run(SniffMode mode, SniffStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (ensureSDMounted() != FR_OK) {
+        return false;
+    }
+    FIL file;
+    if (f_open(&file, SNIFF_FILE, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) {
+        printf("Sniffer: f_open failed\n");
+        return false;
+    }
+    if (!sniff_setup(mode)) {
+        f_close(&file);
+        return false;
+    }
+
+    sniff.stats = stats;
+    sniff.produced = sniff.pos = 0;
+    sniff.flushed_at = UINT32_MAX;      // A short first burst still gets flushed
+    sniff.last_word_us = time_us_32();
+    sniff.cycle = 0;
+    sniff.phase = SWD_IDLE;
+    sniff.window = 0;
+    sniff.ones = 0;
+    sniff.prev_target = false;
+    sniff.select = 0;
+    sniff.tap = TAP_UNKNOWN;
+    sniff.tms_ones = 0;
+    event_head = event_tail = echo_tail = 0;
+    event_drops = 0;
+    text_len = 0;
+
+    f_puts(mode == SNIFF_SWD ? "cycle time_us port dir register ack data\n"
+                             : "cycle time_us scan bits tdi tdo\n", &file);
+    pio_sm_set_enabled(SNIFF_PIO, sniff.sm, true);
+    if (mode == SNIFF_SWD) {
+        printf("Sniffer: SWD on SWCLK GP%d, SWDIO GP%d, any key stops\n", SNIFF_CLK_PIN, SNIFF_DATA_PIN);
+    } else {
+        printf("Sniffer: JTAG on TCK GP%d, TMS GP%d, TDI GP%d, TDO GP%d, any key stops\n",
+               JTAG_TCK_PIN, JTAG_TMS_PIN, JTAG_TDI_PIN, JTAG_TDO_PIN);
+    }
+
+    bool ok = true;
+    uint32_t start_us = time_us_32();
+    uint32_t last_status_us = start_us;
+    while (ok && getchar_timeout_us(0) == PICO_ERROR_TIMEOUT) {
+        update_produced();
+        uint32_t pending = sniff.produced - sniff.pos;
+        if (pending > RING_WORDS) {
+            // Fell a whole ring behind: skip to the oldest intact word and
+            // drop the packet in progress
+            stats->overruns += pending - RING_WORDS;
+            sniff.cycle += (uint64_t)(pending - RING_WORDS) * (mode == SNIFF_SWD ? 16 : 8);
+            sniff.pos = sniff.produced - RING_WORDS;
+            sniff.phase = SWD_IDLE;
+            sniff.window = 0;
+            sniff.tap = TAP_UNKNOWN;
+        }
+        while (sniff.pos != sniff.produced && event_head - event_tail < count_of(events)) {
+            uint32_t w = ring[sniff.pos & RING_MASK];
+            sniff.pos++;
+            if (mode == SNIFF_SWD) swd_decode_word(w);
+            else jtag_decode_word(w);
+        }
+        stats->cycles = sniff.cycle;
+
+        ok = write_events(&file);
+        if (text_len > TEXT_BUF_SIZE / 2) {
+            ok = ok && flush_text(&file);
+        }
+        if (time_us_32() - last_status_us >= 1000000) {
+            last_status_us = time_us_32();
+            print_status();
+        }
+        if (sniff.pos == sniff.produced) {
+            flush_partial_word();
+        }
+    }
+    stats->duration_ms = (time_us_32() - start_us) / 1000;
+    sniff_release();
+
+    ok = write_events(&file) && ok;
+    ok = flush_text(&file) && ok;
+    ok = f_close(&file) == FR_OK && ok;
+
+    print_status();
+    if (event_drops) {
+        printf("Sniffer: %lu entries dropped (log queue full)\n", event_drops);
+    }
+    if (ok) {
+        printf("  Saved to %s\n", SNIFF_FILE);
+    } else {
+        printf("Sniffer: SD write failed\n");
+    }
+    return ok;
+}
@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "swd.h"
+#include "jtag.h"
+
+#ifndef SNIFFER_H
+#define SNIFFER_H
+
+// Passive SWD / JTAG bus sniffer. Nothing is driven: the pins are shared
+// inputs on the same header the debugger and target are wired to.
+//
+// A PIO state machine follows the target's clock and pushes samples; one
+// DMA channel streams them into a ring that a control channel re-arms
+// forever, so capture never needs the CPU. The decoder runs in the
+// foreground and only has to keep up on average, with the ring absorbing
+// bursts. At a continuous 4 MHz SWCLK the ring holds ~30 ms.
+//
+// SWD: SWDIO is sampled on both clock edges. Host bits change after the
+// falling edge and are taken at the rising edge; target bits change after
+// the rising edge and are taken at the falling one, so neither is read
+// while it moves. Packets (request, ACK, data, parity, turnaround) are named
+// with the DP/AP registers from swd.h, with the AP bank tracked from SELECT
+// writes. Line resets are logged too.
+//
+// JTAG: TMS/TDI/TDO are sampled on the rising edge of TCK, the TAP state is
+// followed and every completed IR/DR scan is logged.
+//
+// Each entry carries the clock cycle it started on (exact) and the time the
+// decoder first saw it. The PIO only pushes whole words, so after the bus
+// goes quiet the decoder pads the last partial word with idle bits.
+
+#define SNIFF_PIO pio0
+#define SNIFF_CLK_PIN SWCLK_PIN         // Also TCK
+#define SNIFF_DATA_PIN SWDIO_PIN        // Also TMS; must be SNIFF_CLK_PIN + 1
+#define SNIFF_RING_BITS 14              // 16 KB of samples
+#define SNIFF_RING_SIZE (1u << SNIFF_RING_BITS)
+#define SNIFF_FLUSH_US 2000             // Quiet time before the partial word is padded out
+#define SNIFF_RECENT 8                  // Entries echoed with each status line
+#define SNIFF_JTAG_MAX_BITS 64          // Longer scans log their first 64 bits
+#define SNIFF_FILE "sniff.log"
+
+typedef enum {
+    SNIFF_SWD = 0,
+    SNIFF_JTAG
+} SniffMode;
+
+typedef enum {
+    SNIFF_EVT_SWD = 0,                  // One SWD packet
+    SNIFF_EVT_LINE_RESET,               // 50+ cycles with SWDIO high
+    SNIFF_EVT_IR,                       // JTAG scans
+    SNIFF_EVT_DR,
+    SNIFF_EVT_TAP_RESET                 // TAP entered Test-Logic-Reset
+} SniffEventType;
+
+typedef struct {
+    SniffEventType type;
+    uint64_t cycle;                     // SWCLK / TCK cycle the entry starts on
+    uint32_t time_us;
+    uint8_t request;                    // SWD request byte
+    uint8_t ack;                        // SWD ACK, 3 bits as sent
+    bool parity_ok;
+    uint8_t ap_addr;                    // AP register including the SELECT bank
+    uint32_t data;
+    uint16_t bits;                      // JTAG scan length
+    uint64_t tdi;
+    uint64_t tdo;
+} SniffEvent;
+
+typedef struct {
+    uint64_t cycles;
+    uint32_t packets;
+    uint32_t ack_ok;
+    uint32_t ack_wait;
+    uint32_t ack_fault;
+    uint32_t no_ack;                    // Nothing (or garbage) came back
+    uint32_t parity_errors;
+    uint32_t line_resets;
+    uint32_t scans;
+    uint32_t overruns;                  // Samples lost because the decoder fell a ring behind
+    uint32_t duration_ms;
+} SniffStats;
+
+// Function declarations
+bool sniffer_run(SniffMode mode, SniffStats* stats);
+
+#endif // SNIFFER_H
@@ -1,4 +1,15 @@
 #include "swd.h"
+#include "swd.pio.h"
+#include "resources.h"
+#include "hardware/clocks.h"
+#include <string.h>
+
+#define IDLE_CYCLES 8               // After writes, so the last one completes
+#define POWERUP_TIMEOUT_MS 100
+
+// Program offset per PIO, shared by every port on it
+static uint prog_offset[NUM_PIOS];
+static uint prog_users[NUM_PIOS];
 
 void cycle() {
     gpio_put(SWCLK_PIN, 1);
@@ -52,7 +63,7 @@ void swd_init() {
 }
 
 uint32_t read_idcode() {
-    write_swdio(0xA5, 8);
+    write_swdio(swd_request(false, true, DP_IDCODE), 8);
     gpio_set_dir(SWDIO_PIN, GPIO_IN);
     cycle(); cycle(); cycle(); cycle();
 
@@ -68,4 +79,653 @@ uint32_t read_idcode() {
     
     printf("SWD: Read IDCODE: 0x%08X\n", idcode);  // Add this line
     return idcode;
-}
\ No newline at end of file
+}
+
+// Packet header for a DP or AP access; addr is the register address, of
+// which only A[3:2] goes on the wire
+uint8_t swd_request(bool ap, bool read, uint8_t addr) {
+    uint8_t req = SWD_REQ_START | SWD_REQ_PARK | (addr & 0xC) << 1;
+    if (ap) req |= SWD_REQ_AP;
+    if (read) req |= SWD_REQ_READ;
+    if (__builtin_parity(req & 0x1E)) req |= SWD_REQ_PARITY;
+    return req;
+}
+
+// For AP accesses addr includes the SELECT bank (bits 7:4)
+const char* swd_reg_name(bool ap, bool read, uint8_t addr) {
+    if (!ap) {
+        switch (addr & 0xC) {
+        case DP_IDCODE: return read ? "IDCODE" : "ABORT";
+        case DP_CTRL_STAT: return "CTRL/STAT";
+        case DP_SELECT: return read ? "RESEND" : "SELECT";
+        default: return read ? "RDBUFF" : "TARGETSEL";
+        }
+    }
+    switch (addr & 0xFC) {
+    case AP_CSW: return "CSW";
+    case AP_TAR: return "TAR";
+    case AP_DRW: return "DRW";
+    case AP_BD0: return "BD0";
+    case AP_BD1: return "BD1";
+    case AP_BD2: return "BD2";
+    case AP_BD3: return "BD3";
+    case AP_CFG: return "CFG";
+    case AP_BASE: return "BASE";
+    case AP_IDR: return "IDR";
+    default: return "AP?";
+    }
+}
+
+/* PIO transaction engine */
+
+static inline void put_write(SwdPort* p, uint32_t data, uint bits) {
+    pio_sm_put_blocking(p->pio, p->sm, (bits - 1) | 1u << 8 | (p->offset + swd_offset_write) << 9);
+    pio_sm_put_blocking(p->pio, p->sm, data);
+}
+
+static inline void put_read(SwdPort* p, uint bits) {
+    pio_sm_put_blocking(p->pio, p->sm, (bits - 1) | (p->offset + swd_offset_read) << 9);
+}
+
+static inline uint32_t get_read(SwdPort* p, uint bits) {
+    return pio_sm_get_blocking(p->pio, p->sm) >> (32 - bits);
+}
+
+// Request, then turnaround and ACK. Writes also take the turnaround back to
+// the host here, so the data can follow straight away.
+static inline void queue_request(SwdPort* p, uint8_t req) {
+    put_write(p, req, 8);
+    put_read(p, (req & SWD_REQ_READ) ? 4 : 5);
+}
+
+static inline uint8_t take_ack(SwdPort* p, uint8_t req) {
+    return (get_read(p, (req & SWD_REQ_READ) ? 4 : 5) >> 1) & 0x7;
+}
+
+// Re-sends a request the target answered with WAIT. Anything but OK ends
+// the packet with the host driving again.
+static bool accept(SwdPort* p, uint8_t req, uint8_t ack) {
+    for (uint retry = 0; ack == SWD_ACK_WAIT && retry < SWD_WAIT_RETRIES; retry++) {
+        if (req & SWD_REQ_READ) {
+            put_read(p, 1);
+            get_read(p, 1);
+        }
+        queue_request(p, req);
+        ack = take_ack(p, req);
+    }
+    if (ack == SWD_ACK_OK) {
+        return true;
+    }
+    if (req & SWD_REQ_READ) {
+        put_read(p, 1);
+        get_read(p, 1);
+    }
+    p->ack = ack;
+    p->parity_error = false;
+    return false;
+}
+
+// Collects a read data phase queued as 32 bits, then parity and turnaround
+static bool take_data(SwdPort* p, uint32_t* data) {
+    uint32_t value = get_read(p, 32);
+    uint32_t parity = get_read(p, 2) & 1;
+    if (parity != (uint32_t)__builtin_parity(value)) {
+        p->parity_error = true;
+        p->ack = SWD_ACK_OK;
+        return false;
+    }
+    *data = value;
+    return true;
+}
+
+static bool transfer(SwdPort* p, uint8_t req, uint32_t* data) {
+    queue_request(p, req);
+    if (!accept(p, req, take_ack(p, req))) {
+        return false;
+    }
+    if (req & SWD_REQ_READ) {
+        put_read(p, 32);
+        put_read(p, 2);
+        return take_data(p, data);
+    }
+    put_write(p, *data, 32);
+    put_write(p, __builtin_parity(*data), 1 + IDLE_CYCLES);
+    return true;
+}
+
+// A FAULT leaves sticky errors that block every later AP access
+static bool check(SwdPort* p, bool ok) {
+    if (!ok && p->ack == SWD_ACK_FAULT) {
+        uint32_t clear = DP_ABORT_CLEAR_ALL;
+        transfer(p, swd_request(false, false, DP_ABORT), &clear);
+        p->ack = SWD_ACK_FAULT;
+        p->tar = SWD_UNKNOWN;
+    }
+    return ok;
+}
+
+bool swd_port_open(SwdPort* port, PIO pio, uint clk_pin, uint dio_pin, uint32_t freq_hz) {
+    memset(port, 0, sizeof(*port));
+    port->pio = pio;
+    port->sm = -1;
+    port->clk_pin = clk_pin;
+    port->dio_pin = dio_pin;
+
+    uint idx = pio_get_index(pio);
+    if (prog_users[idx] == 0 && !pio_can_add_program(pio, &swd_program)) {
+        printf("Error: No PIO space for SWD\n");
+        return false;
+    }
+    uint32_t pins = (1u << clk_pin) | (1u << dio_pin);
+    if (!res_claim_pins("swd", pins, RES_PIN_EXCLUSIVE)) {
+        return false;
+    }
+    port->sm = res_claim_pio_sm("swd", pio);
+    if (port->sm < 0) {
+        res_release_pins("swd", pins);
+        return false;
+    }
+    if (prog_users[idx]++ == 0) {
+        prog_offset[idx] = pio_add_program(pio, &swd_program);
+    }
+    port->offset = prog_offset[idx];
+
+    uint32_t sys_hz = clock_get_hz(clk_sys);
+    float clkdiv = (float)sys_hz / (4.0f * MIN(freq_hz, SWD_MAX_HZ));
+    if (clkdiv < 1.0f) clkdiv = 1.0f;
+    port->freq_hz = (uint32_t)(sys_hz / (4.0f * clkdiv));
+    swd_program_init(pio, port->sm, port->offset, clk_pin, dio_pin, clkdiv);
+    pio_sm_set_enabled(pio, port->sm, true);
+
+    port->select = port->csw = port->tar = SWD_UNKNOWN;
+    return true;
+}
+
+void swd_port_close(SwdPort* port) {
+    if (port->sm < 0) {
+        return;
+    }
+    uint idx = pio_get_index(port->pio);
+    pio_sm_set_enabled(port->pio, port->sm, false);
+    if (--prog_users[idx] == 0) {
+        pio_remove_program(port->pio, &swd_program, prog_offset[idx]);
+    }
+    res_release_pio_sm(port->pio, port->sm);
+    port->sm = -1;
+
+    gpio_init(port->clk_pin);
+    gpio_init(port->dio_pin);
+    res_release_pins("swd", (1u << port->clk_pin) | (1u << port->dio_pin));
+}
+
+// Same wake-up as swd_init(), then DPIDR, debug power-up and MEM-AP 0.
+// targetsel picks a target on a multi-drop bus (0 for none).
+bool swd_connect(SwdPort* port, uint32_t targetsel) {
+    SwdPort* p = port;
+    put_write(p, 0xFFFFFFFF, 32);
+    put_write(p, 0xFFFFF, 20);
+    put_write(p, 0xE79E, 16);
+    put_write(p, 0xFFFFFFFF, 32);
+    put_write(p, 0xFFFFF, 20);
+    put_write(p, 0x00, 20);
+    put_write(p, 0xFF, 8);
+    put_write(p, 0x6209F392, 32);
+    put_write(p, 0x86852D95, 32);
+    put_write(p, 0xE3DDAFE9, 32);
+    put_write(p, 0x19BC0EA2, 32);
+    put_write(p, 0x0, 4);
+    put_write(p, 0x1A, 8);
+    put_write(p, 0xFFFFFFFF, 32);
+    put_write(p, 0xFFFFF, 20);
+    put_write(p, 0x00, 8);
+
+    if (targetsel) {
+        // No target answers a TARGETSEL, so the ACK is clocked and ignored
+        queue_request(p, swd_request(false, false, DP_TARGETSEL));
+        take_ack(p, swd_request(false, false, DP_TARGETSEL));
+        put_write(p, targetsel, 32);
+        put_write(p, __builtin_parity(targetsel), 1 + IDLE_CYCLES);
+    }
+
+    p->select = p->csw = p->tar = SWD_UNKNOWN;
+    p->parity_error = false;
+    if (!swd_read_dp(p, DP_IDCODE, &p->idcode)) {
+        return false;
+    }
+    if (!swd_write_dp(p, DP_ABORT, DP_ABORT_CLEAR_ALL) ||
+        !swd_write_dp(p, DP_SELECT, 0) ||
+        !swd_write_dp(p, DP_CTRL_STAT, DP_CTRL_POWERUP_REQ)) {
+        return false;
+    }
+    absolute_time_t timeout = make_timeout_time_ms(POWERUP_TIMEOUT_MS);
+    uint32_t ctrl = 0;
+    while ((ctrl & DP_CTRL_POWERUP_ACK) != DP_CTRL_POWERUP_ACK) {
+        if (!swd_read_dp(p, DP_CTRL_STAT, &ctrl) || time_reached(timeout)) {
+            printf("SWD: debug power-up not acknowledged (CTRL/STAT 0x%08lx)\n", ctrl);
+            return false;
+        }
+    }
+
+    uint32_t idr, csw;
+    if (!swd_read_ap(p, AP_IDR, &idr) || !swd_read_ap(p, AP_CSW, &csw)) {
+        return false;
+    }
+    if (idr == 0) {
+        printf("SWD: no AP 0 (IDR reads 0)\n");
+        return false;
+    }
+    p->csw = csw;
+    return true;
+}
+
+bool swd_read_dp(SwdPort* port, uint8_t addr, uint32_t* data) {
+    return check(port, transfer(port, swd_request(false, true, addr), data));
+}
+
+bool swd_write_dp(SwdPort* port, uint8_t addr, uint32_t data) {
+    if (!check(port, transfer(port, swd_request(false, false, addr), &data))) {
+        return false;
+    }
+    if (addr == DP_SELECT) {
+        port->select = data;
+    }
+    return true;
+}
+
+static bool select_bank(SwdPort* p, uint8_t addr) {
+    uint32_t select = DP_SELECT_APBANK(addr);       // Always AP 0
+    return p->select == select || swd_write_dp(p, DP_SELECT, select);
+}
+
+// AP reads are posted: the value comes back through RDBUFF
+bool swd_read_ap(SwdPort* port, uint8_t addr, uint32_t* data) {
+    uint32_t posted;
+    if (!select_bank(port, addr) ||
+        !check(port, transfer(port, swd_request(true, true, addr), &posted))) {
+        return false;
+    }
+    return swd_read_dp(port, DP_RDBUFF, data);
+}
+
+bool swd_write_ap(SwdPort* port, uint8_t addr, uint32_t data) {
+    if (!select_bank(port, addr) ||
+        !check(port, transfer(port, swd_request(true, false, addr), &data))) {
+        return false;
+    }
+    if (addr == AP_CSW) port->csw = data;
+    if (addr == AP_TAR) port->tar = data;
+    return true;
+}
+
+/* MEM-AP access */
+
+static bool set_csw(SwdPort* p, uint32_t size, uint32_t inc) {
+    uint32_t csw = (p->csw & ~(AP_CSW_SIZE_MASK | AP_CSW_INC_MASK)) | size | inc;
+    return p->csw == csw || swd_write_ap(p, AP_CSW, csw);
+}
+
+static bool set_tar(SwdPort* p, uint32_t addr) {
+    return p->tar == addr || swd_write_ap(p, AP_TAR, addr);
+}
+
+// Where TAR ends up after auto-increment; past a 1 KB boundary it may have
+// wrapped, so it has to be written again
+static void advance_tar(SwdPort* p, uint32_t end) {
+    p->tar = (end % SWD_TAR_WRAP) ? end : SWD_UNKNOWN;
+}
+
+bool swd_mem_read32(SwdPort* port, uint32_t addr, uint32_t* data) {
+    return swd_mem_read_words(port, addr, data, 1);
+}
+
+bool swd_mem_write32(SwdPort* port, uint32_t addr, uint32_t data) {
+    return swd_mem_write_words(port, addr, &data, 1);
+}
+
+// Posted DRW reads, each one's data phase overlapping the next request.
+// Packet 0 only starts the first access; RDBUFF collects the last word.
+// With inc off every read is of addr itself.
+static bool read_page(SwdPort* p, uint32_t addr, uint32_t* buf, uint32_t count, uint32_t inc) {
+    if (!set_csw(p, AP_CSW_SIZE_32, inc) || !set_tar(p, addr) || !select_bank(p, AP_DRW)) {
+        return false;
+    }
+    const uint8_t drw = swd_request(true, true, AP_DRW);
+    const uint8_t rdbuff = swd_request(false, true, DP_RDBUFF);
+    p->tar = SWD_UNKNOWN;
+
+    queue_request(p, drw);
+    if (!check(p, accept(p, drw, take_ack(p, drw)))) {
+        return false;
+    }
+    bool ok = true;
+    for (uint32_t i = 0; i <= count; i++) {
+        put_read(p, 32);
+        put_read(p, 2);
+        uint8_t next = i + 1 < count ? drw : rdbuff;
+        if (i < count) {
+            queue_request(p, next);
+        }
+        uint32_t value;
+        ok = take_data(p, &value) && ok;    // Keep clocking so the pipeline drains
+        if (i > 0) {
+            buf[i - 1] = value;
+        }
+        if (i < count && !check(p, accept(p, next, take_ack(p, next)))) {
+            return false;
+        }
+    }
+    advance_tar(p, inc ? addr + count * 4 : addr);
+    return ok;
+}
+
+static bool write_page(SwdPort* p, uint32_t addr, const uint32_t* buf, uint32_t count) {
+    if (!set_csw(p, AP_CSW_SIZE_32, AP_CSW_INC_SINGLE) || !set_tar(p, addr) || !select_bank(p, AP_DRW)) {
+        return false;
+    }
+    const uint8_t drw = swd_request(true, false, AP_DRW);
+    p->tar = SWD_UNKNOWN;
+    for (uint32_t i = 0; i < count; i++) {
+        queue_request(p, drw);
+        if (!check(p, accept(p, drw, take_ack(p, drw)))) {
+            return false;
+        }
+        put_write(p, buf[i], 32);
+        put_write(p, __builtin_parity(buf[i]), 1);
+    }
+    put_write(p, 0, IDLE_CYCLES);
+    advance_tar(p, addr + count * 4);
+    return true;
+}
+
+bool swd_mem_read_words(SwdPort* port, uint32_t addr, uint32_t* buf, uint32_t count) {
+    while (count) {
+        uint32_t n = MIN(count, (SWD_TAR_WRAP - addr % SWD_TAR_WRAP) / 4);
+        if (!read_page(port, addr, buf, n, AP_CSW_INC_SINGLE)) {
+            return false;
+        }
+        addr += n * 4;
+        buf += n;
+        count -= n;
+    }
+    return true;
+}
+
+// count reads of one register, for sampling rather than copying memory
+bool swd_mem_read_repeat(SwdPort* port, uint32_t addr, uint32_t* buf, uint32_t count) {
+    return read_page(port, addr, buf, count, AP_CSW_INC_OFF);
+}
+
+bool swd_mem_write_words(SwdPort* port, uint32_t addr, const uint32_t* buf, uint32_t count) {
+    while (count) {
+        uint32_t n = MIN(count, (SWD_TAR_WRAP - addr % SWD_TAR_WRAP) / 4);
+        if (!write_page(port, addr, buf, n)) {
+            return false;
+        }
+        addr += n * 4;
+        buf += n;
+        count -= n;
+    }
+    return true;
+}
+
+// Any alignment; the partial words at either end come from whole-word reads
+bool swd_mem_read(SwdPort* port, uint32_t addr, uint8_t* buf, uint32_t len) {
+    uint32_t bounce[64];
+    while (len) {
+        uint32_t offset = addr & 3;
+        uint32_t words = MIN((offset + len + 3) / 4, count_of(bounce));
+        if (!swd_mem_read_words(port, addr - offset, bounce, words)) {
+            return false;
+        }
+        uint32_t n = MIN(len, words * 4 - offset);
+        memcpy(buf, (uint8_t*)bounce + offset, n);
+        addr += n;
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+// Bytes at either end go out as 8-bit accesses on their own byte lane
+static bool write_byte(SwdPort* p, uint32_t addr, uint8_t value) {
+    if (!set_csw(p, AP_CSW_SIZE_8, AP_CSW_INC_SINGLE) || !set_tar(p, addr) ||
+        !swd_write_ap(p, AP_DRW, (uint32_t)value << (8 * (addr & 3)))) {
+        return false;
+    }
+    advance_tar(p, addr + 1);
+    return true;
+}
+
+bool swd_mem_write(SwdPort* port, uint32_t addr, const uint8_t* buf, uint32_t len) {
+    while (len && (addr & 3)) {
+        if (!write_byte(port, addr++, *buf++)) return false;
+        len--;
+    }
+    uint32_t bounce[64];
+    while (len >= 4) {
+        uint32_t words = MIN(len / 4, count_of(bounce));
+        memcpy(bounce, buf, words * 4);
+        if (!swd_mem_write_words(port, addr, bounce, words)) {
+            return false;
+        }
+        addr += words * 4;
+        buf += words * 4;
+        len -= words * 4;
+    }
+    while (len--) {
+        if (!write_byte(port, addr++, *buf++)) return false;
+    }
+    return true;
+}
+
+/* Gang access: one block on several ports at once */
+
+// Each packet goes to every port before any ACK is collected, so the state
+// machines clock in step and N ports take about as long as one. A port that
+// fails drops out of *mask and keeps its error for swd_error_string().
+static void gang_write_page(SwdPort* ports, uint n, uint32_t* mask, uint32_t addr,
+                            const uint32_t* buf, uint32_t count) {
+    const uint8_t drw = swd_request(true, false, AP_DRW);
+    SWD_FOR_EACH_PORT(i, n, *mask) {
+        SwdPort* p = &ports[i];
+        if (!set_csw(p, AP_CSW_SIZE_32, AP_CSW_INC_SINGLE) || !set_tar(p, addr) || !select_bank(p, AP_DRW)) {
+            *mask &= ~(1u << i);
+        }
+        p->tar = SWD_UNKNOWN;
+    }
+    for (uint32_t w = 0; w < count; w++) {
+        SWD_FOR_EACH_PORT(i, n, *mask) {
+            queue_request(&ports[i], drw);
+        }
+        SWD_FOR_EACH_PORT(i, n, *mask) {
+            SwdPort* p = &ports[i];
+            if (!check(p, accept(p, drw, take_ack(p, drw)))) {
+                *mask &= ~(1u << i);
+                continue;
+            }
+            put_write(p, buf[w], 32);
+            put_write(p, __builtin_parity(buf[w]), 1);
+        }
+    }
+    SWD_FOR_EACH_PORT(i, n, *mask) {
+        put_write(&ports[i], 0, IDLE_CYCLES);
+        advance_tar(&ports[i], addr + count * 4);
+    }
+}
+
+// read_page() across ports, into one buffer per port
+static void gang_read_page(SwdPort* ports, uint n, uint32_t* mask, uint32_t addr,
+                           uint32_t* const bufs[], uint32_t count) {
+    const uint8_t drw = swd_request(true, true, AP_DRW);
+    const uint8_t rdbuff = swd_request(false, true, DP_RDBUFF);
+    SWD_FOR_EACH_PORT(i, n, *mask) {
+        SwdPort* p = &ports[i];
+        if (!set_csw(p, AP_CSW_SIZE_32, AP_CSW_INC_SINGLE) || !set_tar(p, addr) || !select_bank(p, AP_DRW)) {
+            *mask &= ~(1u << i);
+            continue;
+        }
+        p->tar = SWD_UNKNOWN;
+        queue_request(p, drw);
+    }
+    SWD_FOR_EACH_PORT(i, n, *mask) {
+        SwdPort* p = &ports[i];
+        if (!check(p, accept(p, drw, take_ack(p, drw)))) {
+            *mask &= ~(1u << i);
+        }
+    }
+    uint32_t bad = 0;
+    for (uint32_t w = 0; w <= count; w++) {
+        uint8_t next = w + 1 < count ? drw : rdbuff;
+        SWD_FOR_EACH_PORT(i, n, *mask) {
+            put_read(&ports[i], 32);
+            put_read(&ports[i], 2);
+            if (w < count) {
+                queue_request(&ports[i], next);
+            }
+        }
+        SWD_FOR_EACH_PORT(i, n, *mask) {
+            SwdPort* p = &ports[i];
+            uint32_t value;
+            if (!take_data(p, &value)) {
+                bad |= 1u << i;         // Keep clocking so the pipeline drains
+            } else if (w > 0 && !(bad & (1u << i))) {
+                bufs[i][w - 1] = value;
+            }
+            if (w < count && !check(p, accept(p, next, take_ack(p, next)))) {
+                *mask &= ~(1u << i);
+            }
+        }
+    }
+    SWD_FOR_EACH_PORT(i, n, *mask) {
+        advance_tar(&ports[i], addr + count * 4);
+    }
+    *mask &= ~bad;
+}
+
+void swd_gang_write_words(SwdPort* ports, uint n, uint32_t* mask, uint32_t addr,
+                          const uint32_t* buf, uint32_t count) {
+    while (count && *mask) {
+        uint32_t words = MIN(count, (SWD_TAR_WRAP - addr % SWD_TAR_WRAP) / 4);
+        gang_write_page(ports, n, mask, addr, buf, words);
+        addr += words * 4;
+        buf += words;
+        count -= words;
+    }
+}
+
+// bufs[i] is only written for ports in *mask
+void swd_gang_read_words(SwdPort* ports, uint n, uint32_t* mask, uint32_t addr,
+                         uint32_t* const bufs[], uint32_t count) {
+    uint32_t done = 0;
+    while (done < count && *mask) {
+        uint32_t words = MIN(count - done, (SWD_TAR_WRAP - addr % SWD_TAR_WRAP) / 4);
+        uint32_t* page[SWD_GANG_MAX];
+        SWD_FOR_EACH_PORT(i, n, *mask) {
+            page[i] = bufs[i] + done;
+        }
+        gang_read_page(ports, n, mask, addr, page, words);
+        addr += words * 4;
+        done += words;
+    }
+}
+
+/* Cortex-M core debug */
+
+// Waits for any of the DHCSR status bits in mask
+static bool wait_dhcsr(SwdPort* p, uint32_t mask, uint32_t* dhcsr) {
+    for (int i = 0; i < CM_POLL_RETRIES; i++) {
+        if (!swd_mem_read32(p, CM_DHCSR, dhcsr)) return false;
+        if (*dhcsr & mask) return true;
+    }
+    p->ack = SWD_CORE_TIMEOUT;
+    return false;
+}
+
+bool swd_halt(SwdPort* port) {
+    uint32_t dhcsr;
+    return swd_mem_write32(port, CM_DHCSR, CM_DHCSR_KEY | CM_DHCSR_C_DEBUGEN | CM_DHCSR_C_HALT) &&
+           wait_dhcsr(port, CM_DHCSR_S_HALT, &dhcsr);
+}
+
+// Debug stays enabled so the core can be halted again straight away
+bool swd_resume(SwdPort* port) {
+    return swd_mem_write32(port, CM_DHCSR, CM_DHCSR_KEY | CM_DHCSR_C_DEBUGEN);
+}
+
+// One instruction with interrupts masked, so the step doesn't land in a
+// handler. C_MASKINTS may only change while halted.
+bool swd_step(SwdPort* port) {
+    uint32_t dhcsr;
+    const uint32_t ctrl = CM_DHCSR_KEY | CM_DHCSR_C_DEBUGEN;
+    return swd_mem_write32(port, CM_DHCSR, ctrl | CM_DHCSR_C_HALT | CM_DHCSR_C_MASKINTS) &&
+           swd_mem_write32(port, CM_DHCSR, ctrl | CM_DHCSR_C_STEP | CM_DHCSR_C_MASKINTS) &&
+           wait_dhcsr(port, CM_DHCSR_S_HALT, &dhcsr) &&
+           swd_mem_write32(port, CM_DHCSR, ctrl | CM_DHCSR_C_HALT);
+}
+
+// System reset with vector catch, so the core stops on its first instruction.
+// Split in two so a gang can share one CM_RESET_MS wait: start each port,
+// sleep, then finish each with the DEMCR value start returned.
+bool swd_reset_start(SwdPort* port, uint32_t* demcr) {
+    if (!swd_mem_write32(port, CM_DHCSR, CM_DHCSR_KEY | CM_DHCSR_C_DEBUGEN) ||
+        !swd_mem_read32(port, CM_DEMCR, demcr) ||
+        !swd_mem_write32(port, CM_DEMCR, *demcr | CM_DEMCR_VC_CORERESET)) {
+        return false;
+    }
+    swd_mem_write32(port, CM_AIRCR, CM_AIRCR_SYSRESETREQ);     // May not be acknowledged
+    return true;
+}
+
+bool swd_reset_finish(SwdPort* port, uint32_t demcr) {
+    uint32_t dhcsr;
+    swd_mem_read32(port, CM_DHCSR, &dhcsr);         // Clears S_RESET_ST and any error from the reset
+    return wait_dhcsr(port, CM_DHCSR_S_HALT, &dhcsr) &&
+           swd_mem_write32(port, CM_DEMCR, demcr & ~CM_DEMCR_VC_CORERESET);
+}
+
+bool swd_reset_halt(SwdPort* port) {
+    uint32_t demcr;
+    if (!swd_reset_start(port, &demcr)) {
+        return false;
+    }
+    sleep_ms(CM_RESET_MS);
+    return swd_reset_finish(port, demcr);
+}
+
+// Core must be halted. DHCSR, DCRSR and DCRDR are adjacent, so one block
+// read returns S_REGRDY and the value together; it only repeats if the
+// transfer hadn't finished yet, which at these clock rates it has.
+bool swd_read_core_reg(SwdPort* port, uint reg, uint32_t* value) {
+    if (!swd_mem_write32(port, CM_DCRSR, reg)) {
+        return false;
+    }
+    uint32_t regs[3];
+    for (int i = 0; i < CM_POLL_RETRIES; i++) {
+        if (!swd_mem_read_words(port, CM_DHCSR, regs, 3)) return false;
+        if (regs[0] & CM_DHCSR_S_REGRDY) {
+            *value = regs[2];
+            return true;
+        }
+    }
+    port->ack = SWD_CORE_TIMEOUT;
+    return false;
+}
+
+// Value first: the DCRSR write is what moves DCRDR into the register
+bool swd_write_core_reg(SwdPort* port, uint reg, uint32_t value) {
+    uint32_t dhcsr;
+    return swd_mem_write32(port, CM_DCRDR, value) &&
+           swd_mem_write32(port, CM_DCRSR, reg | CM_DCRSR_REGWNR) &&
+           wait_dhcsr(port, CM_DHCSR_S_REGRDY, &dhcsr);
+}
+
+const char* swd_error_string(const SwdPort* port) {
+    if (port->parity_error) return "parity error";
+    switch (port->ack) {
+    case SWD_ACK_WAIT: return "WAIT timeout";
+    case SWD_ACK_FAULT: return "FAULT";
+    case 0x7: return "no response";
+    case SWD_CORE_TIMEOUT: return "core not responding";
+    default: return "protocol error";
+    }
+}
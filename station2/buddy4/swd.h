@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include "pico/stdlib.h"
 #include "hardware/gpio.h"
+#include "hardware/pio.h"
 
 #ifndef SWD_H
 #define SWD_H
@@ -9,10 +10,160 @@
 #define SWDIO_PIN 3
 #define tfmhz 0.95
 
+// Request bits, LSB first: start, APnDP, RnW, A[2:3], parity, stop, park
+#define SWD_REQ_START 0x01
+#define SWD_REQ_AP 0x02
+#define SWD_REQ_READ 0x04
+#define SWD_REQ_ADDR_MASK 0x18
+#define SWD_REQ_PARITY 0x20
+#define SWD_REQ_PARK 0x80
+
+#define SWD_ACK_OK 0x1
+#define SWD_ACK_WAIT 0x2
+#define SWD_ACK_FAULT 0x4
+
+// DP registers (A[3:2] << 2). Some addresses mean different things for
+// reads and writes.
+#define DP_IDCODE 0x0           // Read
+#define DP_ABORT 0x0            // Write
+#define DP_CTRL_STAT 0x4
+#define DP_SELECT 0x8           // Write
+#define DP_RESEND 0x8           // Read
+#define DP_RDBUFF 0xC           // Read
+#define DP_TARGETSEL 0xC        // Write
+
+// MEM-AP registers; the bank (bits 7:4) comes from DP SELECT
+#define AP_CSW 0x00
+#define AP_TAR 0x04
+#define AP_DRW 0x0C
+#define AP_BD0 0x10
+#define AP_BD1 0x14
+#define AP_BD2 0x18
+#define AP_BD3 0x1C
+#define AP_CFG 0xF4
+#define AP_BASE 0xF8
+#define AP_IDR 0xFC
+
+#define DP_SELECT_APBANK(select) ((select) & 0xF0)
+#define DP_SELECT_APSEL(select) ((select) >> 24)
+
+#define DP_ABORT_CLEAR_ALL 0x1E         // STKCMPCLR | STKERRCLR | WDERRCLR | ORUNERRCLR
+#define DP_CTRL_POWERUP_REQ 0x50000000  // CSYSPWRUPREQ | CDBGPWRUPREQ
+#define DP_CTRL_POWERUP_ACK 0xA0000000
+
+#define AP_CSW_SIZE_8 0x0
+#define AP_CSW_SIZE_32 0x2
+#define AP_CSW_SIZE_MASK 0x7
+#define AP_CSW_INC_OFF 0x00
+#define AP_CSW_INC_SINGLE 0x10
+#define AP_CSW_INC_MASK 0x30
+
+// Cortex-M debug registers, the same on ARMv6-M and ARMv7-M
+#define CM_DHCSR 0xE000EDF0u
+#define CM_DCRSR 0xE000EDF4u
+#define CM_DCRDR 0xE000EDF8u
+#define CM_DEMCR 0xE000EDFCu
+#define CM_DWT_CTRL 0xE0001000u
+#define CM_DWT_PCSR 0xE000101Cu
+
+#define CM_DHCSR_KEY 0xA05F0000u        // Must accompany every DHCSR write
+#define CM_DHCSR_C_DEBUGEN 0x00000001u
+#define CM_DHCSR_C_HALT 0x00000002u
+#define CM_DHCSR_C_STEP 0x00000004u
+#define CM_DHCSR_C_MASKINTS 0x00000008u
+#define CM_DHCSR_S_REGRDY 0x00010000u
+#define CM_DHCSR_S_HALT 0x00020000u
+#define CM_DCRSR_REGWNR 0x00010000u
+#define CM_DEMCR_TRCENA 0x01000000u     // Powers the DWT
+#define CM_DEMCR_VC_CORERESET 0x00000001u   // Halt on the reset vector
+#define CM_DFSR 0xE000ED30u             // Debug fault status, write one to clear
+#define CM_DFSR_BKPT 0x00000002u        // BKPT instruction or FPB match
+#define CM_DFSR_ALL 0x0000001Fu
+#define CM_AIRCR 0xE000ED0Cu
+#define CM_AIRCR_SYSRESETREQ 0x05FA0004u    // With VECTKEY
+#define CM_RESET_MS 20                  // SYSRESETREQ to reset vector catch
+#define CM_FP_CTRL 0xE0002000u          // Flash patch / breakpoint unit
+#define CM_FP_COMP0 0xE0002008u
+#define CM_FP_CTRL_ENABLE 0x3u          // With KEY
+#define CM_FP_CTRL_DISABLE 0x2u
+#define CM_FP_NUM_CODE(ctrl) ((((ctrl) >> 8) & 0x70) | (((ctrl) >> 4) & 0xF))
+#define CM_FP_REV(ctrl) ((ctrl) >> 28)  // 0: code region only, 1: any address
+#define CM_BKPT_INSN 0xBE00             // BKPT #0
+#define CM_REG_SP 13
+#define CM_REG_LR 14
+#define CM_REG_PC 15
+#define CM_REG_XPSR 16
+#define CM_XPSR_THUMB 0x01000000u
+#define CM_POLL_RETRIES 100
+
+// PIO transaction engine. Each SwdPort is one SWCLK/SWDIO pair on its own
+// state machine; ports on the same PIO share the program. Packets are
+// pipelined through the FIFOs: the next request is clocking out while the
+// CPU checks the last one, and block reads use posted AP reads so a word
+// costs one packet. MEM-AP TAR auto-increment is only guaranteed within
+// 1 KB, so blocks are split there.
+#define SWD_PIO pio1
+#define SWD_DEFAULT_HZ (8 * 1000 * 1000)
+#define SWD_MAX_HZ (31250 * 1000)       // clk_sys / 4 cycles per bit
+#define SWD_WAIT_RETRIES 100
+#define SWD_TAR_WRAP 1024
+#define SWD_UNKNOWN 0xFFFFFFFFu         // Cached register not known
+#define SWD_CORE_TIMEOUT 0x8            // SwdPort.ack when the core never set S_HALT/S_REGRDY
+
+// Gang access drives ports[0..n) in step; mask has a bit per live port
+#define SWD_GANG_MAX NUM_PIO_STATE_MACHINES
+#define SWD_FOR_EACH_PORT(i, n, mask) \
+    for (uint i = 0; i < (n); i++) if ((mask) & (1u << i))
+
+typedef struct {
+    PIO pio;
+    int sm;
+    uint offset;
+    uint clk_pin;
+    uint dio_pin;
+    uint32_t freq_hz;
+    uint32_t idcode;
+    uint32_t select;                    // Cached DP SELECT
+    uint32_t csw;                       // Cached AP CSW
+    uint32_t tar;                       // Where the next DRW access lands
+    uint8_t ack;                        // ACK of the last failed packet
+    bool parity_error;
+} SwdPort;
+
 void cycle();
 void write_swdio(uint32_t data, int num_bits);
 int read_swdio();
 void swd_init();
 uint32_t read_idcode();
+uint8_t swd_request(bool ap, bool read, uint8_t addr);
+const char* swd_reg_name(bool ap, bool read, uint8_t addr);
+
+bool swd_port_open(SwdPort* port, PIO pio, uint clk_pin, uint dio_pin, uint32_t freq_hz);
+void swd_port_close(SwdPort* port);
+bool swd_connect(SwdPort* port, uint32_t targetsel);
+bool swd_read_dp(SwdPort* port, uint8_t addr, uint32_t* data);
+bool swd_write_dp(SwdPort* port, uint8_t addr, uint32_t data);
+bool swd_read_ap(SwdPort* port, uint8_t addr, uint32_t* data);
+bool swd_write_ap(SwdPort* port, uint8_t addr, uint32_t data);
+bool swd_mem_read32(SwdPort* port, uint32_t addr, uint32_t* data);
+bool swd_mem_write32(SwdPort* port, uint32_t addr, uint32_t data);
+bool swd_mem_read_words(SwdPort* port, uint32_t addr, uint32_t* buf, uint32_t count);
+bool swd_mem_read_repeat(SwdPort* port, uint32_t addr, uint32_t* buf, uint32_t count);
+bool swd_mem_write_words(SwdPort* port, uint32_t addr, const uint32_t* buf, uint32_t count);
+bool swd_mem_read(SwdPort* port, uint32_t addr, uint8_t* buf, uint32_t len);
+bool swd_mem_write(SwdPort* port, uint32_t addr, const uint8_t* buf, uint32_t len);
+void swd_gang_write_words(SwdPort* ports, uint n, uint32_t* mask, uint32_t addr,
+                          const uint32_t* buf, uint32_t count);
+void swd_gang_read_words(SwdPort* ports, uint n, uint32_t* mask, uint32_t addr,
+                         uint32_t* const bufs[], uint32_t count);
+bool swd_halt(SwdPort* port);
+bool swd_resume(SwdPort* port);
+bool swd_step(SwdPort* port);
+bool swd_reset_start(SwdPort* port, uint32_t* demcr);
+bool swd_reset_finish(SwdPort* port, uint32_t demcr);
+bool swd_reset_halt(SwdPort* port);
+bool swd_read_core_reg(SwdPort* port, uint reg, uint32_t* value);
+bool swd_write_core_reg(SwdPort* port, uint reg, uint32_t value);
+const char* swd_error_string(const SwdPort* port);
 
 #endif
\ No newline at end of file
@@ -1,6 +1,6 @@
 #include "wifi_dashboard.h"
 
-#define MAX_BUFFER_SIZE 1024
+#define MAX_BUFFER_SIZE 1536
 
 // Static variables
 static DashboardData current_data = {0};
@@ -100,9 +100,20 @@ void register_dashboard_callback(dashboard_command_callback callback) {
     command_handler = callback;
 }
 
+// Target output goes into the page as text, so markup characters are masked
+static void html_safe(char *dst, const char *src, size_t size) {
+    size_t i = 0;
+    for (; i < size - 1 && src[i]; i++) {
+        dst[i] = strchr("<>&\"", src[i]) ? '?' : src[i];
+    }
+    dst[i] = '\0';
+}
+
 static void update_http_response(char *response, const ip4_addr_t *client_ip) {
     char client_ip_str[16];
     ip4addr_ntoa_r(client_ip, client_ip_str, sizeof(client_ip_str));
+    char rtt_line[DASHBOARD_LINE_CHARS];
+    html_safe(rtt_line, current_data.rtt_line, sizeof(rtt_line));
 
     snprintf(response, MAX_BUFFER_SIZE,
         "<!DOCTYPE html>"
@@ -125,12 +136,15 @@ static void update_http_response(char *response, const ip4_addr_t *client_ip) {
                 "<p>PWM Duty Cycle: %.1f%%</p>"
                 "<p>Analog Frequency: %.2f Hz</p>"
                 "<p>UART Baud Rate: %.0f bps</p>"
+                "<p>Encoder: %ld counts, %.1f counts/s, %.1f rpm</p>"
             "</div>"
 
             "<div class=\"data-box\">"
                 "<h2>Debug Information</h2>"
                 "<p>IDCODE: 0x%08X</p>"
                 "<p>Device Status: %s</p>"
+                "<p>Target log (RTT): %lu B/s</p>"
+                "<pre>%s</pre>"
             "</div>"
         "</body>"
         "</html>",
@@ -138,8 +152,13 @@ static void update_http_response(char *response, const ip4_addr_t *client_ip) {
         current_data.pwm_duty_cycle,
         current_data.analog_frequency,
         current_data.uart_baud_rate,
+        current_data.encoder_count,
+        current_data.encoder_velocity,
+        current_data.encoder_rpm,
         current_data.idcode,
-        current_data.device_halted ? "HALTED" : "RUNNING"
+        current_data.device_halted ? "HALTED" : "RUNNING",
+        current_data.rtt_bytes_per_s,
+        rtt_line
     );
 }
 
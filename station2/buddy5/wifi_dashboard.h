@@ -20,6 +20,7 @@
 #define AP_NETMASK "255.255.255.0"
 #define AP_GATEWAY "192.168.4.1"
 #define HTTP_PORT 42069
+#define DASHBOARD_LINE_CHARS 64
 
 // Structure to hold all dashboard data
 typedef struct {
@@ -28,17 +29,20 @@ typedef struct {
     float pwm_duty_cycle;
     float analog_frequency;
     float uart_baud_rate;
+    int32_t encoder_count;
+    float encoder_velocity;     // Counts per second
+    float encoder_rpm;
     
     // Debug data
     uint32_t idcode;
     bool device_halted;
+    uint32_t rtt_bytes_per_s;
+    char rtt_line[DASHBOARD_LINE_CHARS];    // Last line of target RTT output
 } DashboardData;
 
 // Function declarations
 bool init_wifi_dashboard(void);
 void update_dashboard_data(DashboardData *data);
-bool send_halt_command(void);
-bool send_resume_command(void);
 uint32_t get_device_idcode(void);
 void handle_dashboard_events(void);
 
@@ -1,15 +1,43 @@
 #include <stdio.h>
 #include "pico/stdlib.h"
 #include "buddy2/adc.h"
+#include "buddy2/adc_decimate.h"
+#include "buddy2/ets.h"
+#include "buddy2/autoset.h"
+#include "buddy2/goertzel.h"
+#include "buddy2/pdm.h"
+#include "buddy2/i2s.h"
+#include "buddy2/quadrature.h"
+#include "buddy2/pwm_multi.h"
 #include "buddy2/pwm.h"
 #include "buddy3/protocol_analyzer.h"
+#include "buddy3/spi_flash.h"
+#include "buddy3/i2c.h"
+#include "buddy3/binmode.h"
+#include "buddy3/uart_bridge.h"
 #include "buddy4/swd.h"
+#include "buddy4/jtag.h"
+#include "buddy4/pinfinder.h"
+#include "buddy4/sniffer.h"
+#include "buddy4/rtt.h"
+#include "buddy4/profiler.h"
+#include "buddy4/gang.h"
+#include "buddy4/gdb_server.h"
 #include "buddy5/wifi_dashboard.h"
+#include "resources.h"
+#include "dma_service.h"
+#include "gpio_irq.h"
+#include "fixmath.h"
+#include "interp_kernels.h"
 
 static void display_menu(void);
-static void gpio_callback(uint gpio, uint32_t events);
 static void handle_dashboard_command(const char* cmd);
+static void process_command(char cmd);
+static void rtt_status(const RttStats* stats);
+static void gdb_status(const GdbStats* stats);
 static DashboardData dashboard_data = {0};
+static EEPROMConfig eeprom_config = EEPROM_DEFAULT_CONFIG;
+static JTAGChainInfo jtag_chain = {0};
 
 static void display_menu(void) {
     printf("\nSystem Ready:\n");
@@ -19,78 +47,326 @@ static void display_menu(void) {
     printf("  * UART RX: GP4\n");
     // printf("  * I2C SCL: GP8, SDA: GP9\n");
     // printf("  * SPI SCK: GP10, MOSI: GP11, MISO: GP12\n");
-    printf("Press respective buttons to start/stop capture\n\n");
+    printf("Press respective buttons to start/stop capture\n");
+    printf("Serial commands:\n");
+    printf("  f: Probe SPI flash (SCK GP%d, MOSI GP%d, MISO GP%d, CS GP%d)\n",
+           SPI_MASTER_SCK_PIN, SPI_MASTER_MOSI_PIN, SPI_MASTER_MISO_PIN, SPI_MASTER_CS_PIN);
+    printf("  d: Dump SPI flash to SD (%s)\n", FLASH_DUMP_FILE);
+    printf("  p: Program SPI flash from SD (%s)\n", FLASH_IMAGE_FILE);
+    printf("  i: Scan I2C bus (SDA GP%d, SCL GP%d) at %u Hz\n",
+           I2C_MASTER_SDA_PIN, I2C_MASTER_SCL_PIN, i2c_master_get_baud());
+    printf("  c: Cycle I2C clock (100k / 400k / 1M)\n");
+    printf("  e: Dump EEPROM 0x%02X to SD (%s)\n", eeprom_config.dev_addr, EEPROM_DUMP_FILE);
+    printf("  w: Write EEPROM 0x%02X from SD (%s)\n", eeprom_config.dev_addr, EEPROM_IMAGE_FILE);
+    printf("  j: Detect JTAG chain (TCK GP%d, TMS GP%d, TDI GP%d, TDO GP%d)\n",
+           JTAG_TCK_PIN, JTAG_TMS_PIN, JTAG_TDI_PIN, JTAG_TDO_PIN);
+    printf("  b: Boundary-scan SAMPLE of device 0 to SD (%s)\n", JTAG_BSCAN_FILE);
+    printf("  n: Find JTAG/SWD/UART pins on an unknown header\n");
+    printf("  T: Stream target RTT log over SWD to USB and SD (%s), Ctrl-] stops\n", RTT_FILE);
+    printf("  P: Profile target PC over SWD to SD (%s), any key stops\n", PROF_FILE);
+    printf("  D: GDB server over WiFi on port %d, any key stops\n", GDB_PORT);
+    printf("  F: Gang-program up to %d SWD targets with %s (loader %s)\n",
+           GANG_MAX_TARGETS, GANG_IMAGE_FILE, GANG_LOADER_FILE);
+    printf("  s: Sniff SWD traffic (SWCLK GP%d, SWDIO GP%d) to SD (%s), any key stops (S: JTAG)\n",
+           SNIFF_CLK_PIN, SNIFF_DATA_PIN, SNIFF_FILE);
+    printf("  u: USB-UART bridge (TX GP%d, RX GP%d)\n", BRIDGE_UART_TX_PIN, BRIDGE_UART_RX_PIN);
+    printf("  l: USB-UART bridge with decoder and SD log (%s)\n", BRIDGE_LOG_FILE);
+    printf("  r: Show pin / PIO / DMA / IRQ owners\n");
+    printf("  m: Show DMA IRQ stats (M to reset)\n");
+    printf("  a: Autoset - probe the inputs and pick rate, depth, trigger and analyzer\n");
+    printf("  g: DTMF / tone detector on GP26 at 8 kS/s, any key stops (G: on the PDM mic)\n");
+    printf("  o: Record PDM mic (CLK GP%d, DATA GP%d) at 16 kHz to SD (%s), 10 s or any key\n",
+           PDM_CLK_PIN, PDM_DATA_PIN, PDM_FILE);
+    printf("  q: Record I2S stereo 24-bit (DATA GP%d, BCLK GP%d, LRCLK GP%d) to SD (%s), any key stops\n",
+           I2S_DATA_PIN, I2S_BCLK_PIN, I2S_LRCLK_PIN, I2S_FILE);
+    printf("  Q: Same for a 4-slot 16-bit TDM bus\n");
+    printf("  v: Start/stop quadrature decoder (A GP%d, B GP%d, index GP%d)\n",
+           QUAD_A_PIN, QUAD_B_PIN, QUAD_INDEX_PIN);
+    printf("  V: Log encoder position and velocity to USB and SD (%s), any key stops\n", QUAD_FILE);
+    printf("  y: Measure 8 PWM / servo inputs at once (GP5-7, 9, 17-19, 27), %d ms updates, any key stops\n",
+           PWM_MULTI_DEFAULT_UPDATE_MS);
+    printf("  h: Enhanced-resolution ADC on GP26, 1 s (next ratio each press)\n");
+    printf("  t: Equivalent-time capture of GP26, triggered on GP%d, to SD (%s)\n",
+           ETS_TRIGGER_PIN, ETS_FILE);
+    printf("  k: Benchmark fixed-point and interpolator kernels\n");
+    printf("  x: Binary bit-bang mode for host scripts (UART TX GP%d, RX GP%d)\n\n",
+           BINMODE_UART_TX_PIN, BINMODE_UART_RX_PIN);
 }
 
-static void handle_dashboard_command(const char* cmd) {
-    if (strcmp(cmd, "halt") == 0) {
-        printf("Received halt command\n");
-        dashboard_data.device_halted = true;
-        //TODO: Add your halt implementation here
-    } 
-    else if (strcmp(cmd, "resume") == 0) {
-        printf("Received resume command\n");
-        dashboard_data.device_halted = false;
-        //TODO: Add your resume implementation here
-    }
-}
-
-
-// Unified GPIO callback
-static void gpio_callback(uint gpio, uint32_t events) {
-    uint32_t now = time_us_32();
-    static uint32_t last_button_time = 0;
-    
-    // Button handling with debouncing
-    if (events & GPIO_IRQ_EDGE_FALL) {
-        // Debounce all buttons - ignore events too close together
-        if (now - last_button_time < 200000) { // 200ms debounce
-            return;
-        }
-        last_button_time = now;
-
-        // PWM Button (GP21)
-        if (gpio == PWM_BUTTON_PIN) {
-            if (!is_capturing()) {
-                start_capture();
-            } else {
-                stop_capture();
-                display_menu();
+static void process_command(char cmd) {
+    switch (cmd) {
+        case 'f': {
+            FlashInfo info;
+            spi_flash_probe(&info);
+            break;
+        }
+        case 'd': {
+            FlashTransferStats stats;
+            if (!spi_flash_dump(FLASH_DUMP_FILE, &stats)) {
+                printf("Flash dump failed\n");
             }
+            display_menu();
+            break;
         }
-        // ADC Button (GP20)
-        else if (gpio == ADC_BUTTON_PIN) {
-            if (!is_adc_capturing()) {
-                adc_start_capture();
-            } else {
-                adc_stop_capture();
-                display_menu();
+        case 'p': {
+            FlashProgramStats stats;
+            if (!spi_flash_program(FLASH_IMAGE_FILE, &stats)) {
+                printf("Flash programming failed\n");
             }
+            display_menu();
+            break;
+        }
+        case 'i': {
+            uint8_t found[I2C_SCAN_LAST_ADDR - I2C_SCAN_FIRST_ADDR + 1];
+            i2c_master_scan(found, sizeof(found));
+            break;
         }
-        // Protocol Button (GP22)
-        else if (gpio == PROTOCOL_BUTTON_PIN) {
-            if (!is_protocol_capturing()) {
-                start_protocol_capture();
+        case 'c': {
+            uint baud = i2c_master_get_baud();
+            baud = (baud <= I2C_BAUD_STANDARD) ? I2C_BAUD_FAST :
+                   (baud <= I2C_BAUD_FAST) ? I2C_BAUD_FAST_PLUS : I2C_BAUD_STANDARD;
+            printf("I2C clock set to %u Hz\n", i2c_master_set_baud(baud));
+            break;
+        }
+        case 'e': {
+            I2CTransferStats stats;
+            if (!eeprom_dump(&eeprom_config, EEPROM_DUMP_FILE, &stats)) {
+                printf("EEPROM dump failed\n");
+            }
+            display_menu();
+            break;
+        }
+        case 'w': {
+            I2CTransferStats stats;
+            if (!eeprom_write_image(&eeprom_config, EEPROM_IMAGE_FILE, &stats)) {
+                printf("EEPROM write failed\n");
+            }
+            display_menu();
+            break;
+        }
+        case 'j':
+            jtag_detect_chain(&jtag_chain);
+            break;
+        case 'b': {
+            // Single-device default; IR split unknown for longer chains
+            if (jtag_chain.device_count == 0 && jtag_detect_chain(&jtag_chain) <= 0) {
+                break;
+            }
+            if (jtag_chain.device_count != 1) {
+                printf("Boundary sample needs a single-device chain (found %d)\n",
+                       jtag_chain.device_count);
+                break;
+            }
+            JTAGBoundaryConfig cfg = {
+                .device = 0,
+                .ir_len = jtag_chain.total_ir_len,
+                .ir_bits_before = 0,
+                .sample_opcode = JTAG_DEFAULT_SAMPLE_OPCODE,
+                .bsr_len = 0
+            };
+            if (!jtag_boundary_sample(&cfg, 1000, JTAG_BSCAN_FILE)) {
+                printf("Boundary sample failed\n");
+            }
+            display_menu();
+            break;
+        }
+        case 'n': {
+            PinFinderResult result;
+            pinfinder_run(&result);
+            break;
+        }
+        case 's':
+        case 'S': {
+            SniffStats sniff_stats;
+            sniffer_run(cmd == 's' ? SNIFF_SWD : SNIFF_JTAG, &sniff_stats);
+            break;
+        }
+        case 'T': {
+            RttConfig cfg = RTT_DEFAULT_CONFIG;
+            RttStats rtt_stats;
+            rtt_run(&cfg, rtt_status, &rtt_stats);
+            break;
+        }
+        case 'P': {
+            ProfConfig cfg = PROF_DEFAULT_CONFIG;
+            ProfStats prof_stats;
+            profiler_run(&cfg, &prof_stats);
+            break;
+        }
+        case 'D': {
+            GdbConfig cfg = GDB_DEFAULT_CONFIG;
+            GdbStats gdb_stats;
+            gdb_server_run(&cfg, gdb_status, &gdb_stats);
+            break;
+        }
+        case 'F': {
+            GangConfig cfg = GANG_DEFAULT_CONFIG;
+            GangStats gang_stats;
+            gang_program(&cfg, &gang_stats);
+            break;
+        }
+        case 'u':
+        case 'l': {
+            UartBridgeConfig cfg = UART_BRIDGE_DEFAULT_CONFIG;
+            UartBridgeStats stats;
+            cfg.decode = cfg.log_to_sd = (cmd == 'l');
+            uart_bridge_run(&cfg, &stats);
+            display_menu();
+            break;
+        }
+        case 'r':
+            res_print();
+            break;
+        case 'm':
+            dma_service_print_stats();
+            break;
+        case 'a': {
+            AutosetResult autoset;
+            autoset_run(&autoset);
+            break;
+        }
+        case 'g':
+            goertzel_run(8000, GOERTZEL_SRC_ADC, NULL, 0);
+            break;
+        case 'G':
+            goertzel_run(8000, GOERTZEL_SRC_PDM, NULL, 0);
+            break;
+        case 'o': {
+            PdmStats pdm_stats;
+            pdm_record(16000, 10000, &pdm_stats);
+            break;
+        }
+        case 'v':
+            if (quad_is_running()) {
+                quad_stop();
+                printf("Quadrature decoder stopped\n");
+            } else if (quad_start(true)) {
+                printf("Quadrature decoder running\n");
+            }
+            break;
+        case 'V':
+            quad_log(QUAD_DEFAULT_CPR);
+            break;
+        case 'y':
+            pwm_multi_run(PWM_MULTI_DEFAULT_UPDATE_MS);
+            break;
+        case 'q':
+        case 'Q': {
+            I2SStats i2s_stats;
+            if (cmd == 'q') {
+                i2s_record(I2S_MODE_I2S, 2, 24, &i2s_stats);
             } else {
-                stop_protocol_capture();
+                i2s_record(I2S_MODE_TDM, 4, 16, &i2s_stats);
+            }
+            break;
+        }
+        case 'h': {
+            static uint hires_ratio = ADC_DECIM_MAX_RATIO;
+            hires_ratio = hires_ratio >= ADC_DECIM_MAX_RATIO ? ADC_DECIM_MIN_RATIO : hires_ratio * 2;
+            adc_hires_measure(hires_ratio, 1000);
+            break;
+        }
+        case 't': {
+            ETSResult ets_result;
+            ets_capture(ETS_DEFAULT_STEPS, &ets_result);
+            break;
+        }
+        case 'k':
+            fixmath_benchmark();
+            interp_kernels_benchmark();
+            break;
+        case 'M':
+            dma_service_reset_stats();
+            printf("DMA IRQ stats reset\n");
+            break;
+        case 'x':
+            binmode_run();
+            display_menu();
+            break;
+        case '\n':
+        case '\r':
+            break;
+        default:
+            if (cmd >= ' ') {
+                printf("Invalid command: '%c'\n", cmd);
                 display_menu();
             }
+            break;
+    }
+}
+
+// RTT runs in the foreground, so it hands its status over once a second
+// and the dashboard keeps being served meanwhile
+static void rtt_status(const RttStats* stats) {
+    dashboard_data.rtt_bytes_per_s = stats->bytes_per_s;
+    snprintf(dashboard_data.rtt_line, sizeof(dashboard_data.rtt_line), "%s", stats->tail);
+    update_dashboard_data(&dashboard_data);
+    handle_dashboard_events();
+}
+
+// GDB mode reports the target state as it changes
+static void gdb_status(const GdbStats* stats) {
+    dashboard_data.device_halted = stats->halted;
+    update_dashboard_data(&dashboard_data);
+}
+
+static void handle_dashboard_command(const char* cmd) {
+    if (strcmp(cmd, "halt") == 0) {
+        printf("Received halt command\n");
+        if (gdb_target_halt()) {
+            dashboard_data.device_halted = true;
+        }
+    } 
+    else if (strcmp(cmd, "resume") == 0) {
+        printf("Received resume command\n");
+        if (gdb_target_resume()) {
+            dashboard_data.device_halted = false;
         }
     }
+    update_dashboard_data(&dashboard_data);
+}
 
-    // PWM Signal (GP7)
-    if (gpio == PWM_PIN && is_capturing()) {
+
+// PWM Signal (GP7)
+static void pwm_edge_irq(uint gpio, uint32_t events, uint32_t now) {
+    if (is_capturing()) {
         handle_pwm_edge(gpio, events, now);
     }
-    
-    // Protocol Analysis Signals
-    if ((gpio == UART_RX_PIN || gpio == I2C_SCL_PIN || gpio == I2C_SDA_PIN ||
-         gpio == SPI_SCK_PIN || gpio == SPI_MOSI_PIN || gpio == SPI_MISO_PIN) &&
-        is_protocol_capturing()) {
+}
+
+// Protocol Analysis Signals
+static void protocol_edge_irq(uint gpio, uint32_t events, uint32_t now) {
+    if (is_protocol_capturing()) {
         handle_protocol_edge(gpio, events, now);
     }
 }
 
+// Buttons, debounced by the sampling timer
+static void button_pressed(uint gpio) {
+    if (gpio == PWM_BUTTON_PIN) {
+        if (!is_capturing()) {
+            start_capture();
+        } else {
+            stop_capture();
+            display_menu();
+        }
+    } else if (gpio == ADC_BUTTON_PIN) {
+        if (!is_adc_capturing()) {
+            adc_start_capture();
+        } else {
+            adc_stop_capture();
+            display_menu();
+        }
+    } else if (gpio == PROTOCOL_BUTTON_PIN) {
+        if (!is_protocol_capturing()) {
+            start_protocol_capture();
+        } else {
+            stop_protocol_capture();
+            display_menu();
+        }
+    }
+}
+
 int main() {
     stdio_init_all();
     sleep_ms(2000);
@@ -98,8 +374,15 @@ int main() {
     printf("\nIntegrated Signal Analyzer Program\n");
     printf("================================\n");
 
-    swd_init();
-    uint32_t idcode = read_idcode();
+    // SWD only holds its pins for the boot-time IDCODE read, then JTAG and the
+    // pin finder can use the header
+    uint32_t idcode = 0;
+    uint32_t swd_pins = (1u << SWCLK_PIN) | (1u << SWDIO_PIN);
+    if (res_claim_pins("swd", swd_pins, RES_PIN_EXCLUSIVE)) {
+        swd_init();
+        idcode = read_idcode();
+        res_release_pins("swd", swd_pins);
+    }
     printf("IDCODE: 0x%08X\n", idcode);
     dashboard_data.idcode = idcode;
     printf("Main: Dashboard IDCODE set to: 0x%08X\n", dashboard_data.idcode);
@@ -111,42 +394,58 @@ int main() {
     }
     register_dashboard_callback(handle_dashboard_command);
     
-    // Initialize all GPIO interrupts with unified callback
-    gpio_set_irq_enabled_with_callback(PWM_PIN, 
-        GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true, &gpio_callback);
+    // Buttons are plain inputs any engine may also watch
+    res_claim_pins("buttons", (1u << PWM_BUTTON_PIN) | (1u << ADC_BUTTON_PIN) |
+                   (1u << PROTOCOL_BUTTON_PIN), RES_PIN_SHARED_INPUT);
 
     // Initialize all modules
+    dma_service_init();
     adc_analyzer_init();
     pwm_analyzer_init();
     protocol_analyzer_init();
 
-    // Enable interrupts for other pins without callback
-    gpio_set_irq_enabled(PWM_BUTTON_PIN, GPIO_IRQ_EDGE_FALL, true);
-    gpio_set_irq_enabled(ADC_BUTTON_PIN, GPIO_IRQ_EDGE_FALL, true);
-    
-    // Enable protocol analysis pin interrupts
-    gpio_set_irq_enabled(UART_RX_PIN, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true);
-    // gpio_set_irq_enabled(I2C_SCL_PIN, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true);
-    // gpio_set_irq_enabled(I2C_SDA_PIN, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true);
-    // gpio_set_irq_enabled(SPI_SCK_PIN, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true);
-    // gpio_set_irq_enabled(SPI_MOSI_PIN, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true);
-    // gpio_set_irq_enabled(SPI_MISO_PIN, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true);
-    gpio_set_irq_enabled(PROTOCOL_BUTTON_PIN, GPIO_IRQ_EDGE_FALL, true);
+    // Signal pins get their own handlers ahead of anything slow
+    gpio_irq_register(PWM_PIN, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL,
+                      GPIO_IRQ_PRIO_SIGNAL, pwm_edge_irq);
+    gpio_irq_register(UART_RX_PIN, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL,
+                      GPIO_IRQ_PRIO_SIGNAL, protocol_edge_irq);
 
+    gpio_button_add(PWM_BUTTON_PIN, button_pressed);
+    gpio_button_add(ADC_BUTTON_PIN, button_pressed);
+    gpio_button_add(PROTOCOL_BUTTON_PIN, button_pressed);
+
+    res_print();
     display_menu();
 
     // Main loop
     while (1) {
+        // Serial commands for the active (master) modes
+        int c = getchar_timeout_us(0);
+        if (c != PICO_ERROR_TIMEOUT) {
+            process_command((char)c);
+        }
+
         // Update dashboard data
         if (is_capturing()) {
             PWMMetrics pwm = get_pwm_metrics();
-            dashboard_data.pwm_frequency = pwm.frequency;
-            dashboard_data.pwm_duty_cycle = pwm.duty_cycle;
+            dashboard_data.pwm_frequency = pwm.frequency_mhz / 1000.0f;
+            dashboard_data.pwm_duty_cycle = uq16_to_float(pwm.duty_cycle);
             
             printf("PWM - Frequency: %.2f Hz, Duty Cycle: %.1f%%\n", 
-                   pwm.frequency, pwm.duty_cycle);
+                   dashboard_data.pwm_frequency, dashboard_data.pwm_duty_cycle);
         }
         
+        if (quad_is_running()) {
+            QuadMetrics quad = quad_get_metrics();
+            dashboard_data.encoder_count = quad.count;
+            dashboard_data.encoder_velocity = quad_counts_per_s(&quad);
+            dashboard_data.encoder_rpm = quad_rpm(&quad, QUAD_DEFAULT_CPR);
+
+            printf("Encoder - Count: %ld, Velocity: %.1f counts/s (%.1f rpm)%s\n",
+                   quad.count, dashboard_data.encoder_velocity, dashboard_data.encoder_rpm,
+                   quad.period_mode ? " [period]" : "");
+        }
+
         if (is_adc_capturing() && is_transfer_complete()) {
             clear_transfer_complete();
             float freq = analyze_current_capture();